@@ -0,0 +1,200 @@
+#include "Benchmark.h"
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../Lab6/tinygltf/tiny_gltf.h"
+#undef TINYGLTF_IMPLEMENTATION
+#undef STB_IMAGE_IMPLEMENTATION
+#undef STB_IMAGE_WRITE_IMPLEMENTATION
+
+#include <cstdio>
+#include <fstream>
+
+
+// Loading of the models of Lab6 as SceneManager::LoadScene and TextureManager::LoadTexture do it on the CPU. The parse
+// cases read the glTF with its buffers but skip the images, the load cases decode the images as tinygltf does by
+// default. The texture cases decode the images of a model with stb_image into RGBA8 as LoadTexture does and build the
+// mip chain with a 2x2 box filter in the stored (gamma) space, as GenerateMips does for the UNORM views. The lab does not
+// compress textures, so there is no case for block compression. Models whose files are missing are skipped.
+namespace {
+    struct Model {
+        const char* name;
+        const char* file; // relative to the data directory
+    };
+
+    const Model models[] = {
+        { "models/scene", "models/scene/untitled.gltf" },
+        { "models/statue", "models/statue/scene.gltf" },
+    };
+
+    bool SkipImage(tinygltf::Image*, const int, std::string*, std::string*, int, int, const unsigned char*, int, void*) {
+        return true;
+    }
+
+    bool Load(tinygltf::Model& model, const std::string& fileName, bool withImages, std::string& error) {
+        tinygltf::TinyGLTF loader;
+        if (!withImages) {
+            loader.SetImageLoader(SkipImage, nullptr);
+        }
+        std::string warning;
+        model = tinygltf::Model();
+        return loader.LoadASCIIFromFile(&model, &error, &warning, fileName);
+    }
+
+    struct Image {
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> texels;
+    };
+
+    // the image files of the model that exist, read from the JSON so that they are found even if the buffers are missing
+    std::vector<std::string> GetImageFiles(const std::string& fileName, size_t& imageCount) {
+        imageCount = 0;
+        std::vector<std::string> files;
+        std::ifstream stream(fileName);
+        nlohmann::json document = nlohmann::json::parse(stream, nullptr, false);
+        if (document.is_discarded() || !document.contains("images")) {
+            return files;
+        }
+        std::string directory = fileName.substr(0, fileName.find_last_of('/') + 1);
+        for (const nlohmann::json& image : document["images"]) {
+            ++imageCount;
+            if (!image.contains("uri")) {
+                continue;
+            }
+            std::string file = directory + image["uri"].get<std::string>();
+            if (std::ifstream(file).good()) {
+                files.push_back(file);
+            }
+        }
+        return files;
+    }
+
+    bool Decode(const std::string& file, Image& image) {
+        int components = 0;
+        unsigned char* data = stbi_load(file.c_str(), &image.width, &image.height, &components, 4);
+        if (!data) {
+            return false;
+        }
+        image.texels.assign(data, data + (size_t)image.width * image.height * 4);
+        stbi_image_free(data);
+        return true;
+    }
+
+    // all levels down to 1x1, an odd side repeats its last texel
+    uint64_t BuildMipChain(const Image& image, std::vector<uint8_t>& chain) {
+        chain.clear();
+        const uint8_t* source = image.texels.data();
+        int width = image.width;
+        int height = image.height;
+        std::vector<uint8_t> level;
+        std::vector<uint8_t> previous;
+        uint64_t bytes = 0;
+        while (width > 1 || height > 1) {
+            int w = (std::max)(width / 2, 1);
+            int h = (std::max)(height / 2, 1);
+            level.resize((size_t)w * h * 4);
+            for (int y = 0; y < h; ++y) {
+                const uint8_t* row0 = source + (size_t)(std::min)(2 * y, height - 1) * width * 4;
+                const uint8_t* row1 = source + (size_t)(std::min)(2 * y + 1, height - 1) * width * 4;
+                for (int x = 0; x < w; ++x) {
+                    int x0 = (std::min)(2 * x, width - 1) * 4;
+                    int x1 = (std::min)(2 * x + 1, width - 1) * 4;
+                    for (int c = 0; c < 4; ++c) {
+                        level[((size_t)y * w + x) * 4 + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                    }
+                }
+            }
+            chain.insert(chain.end(), level.begin(), level.end());
+            bytes += level.size();
+            previous.swap(level);
+            source = previous.data();
+            width = w;
+            height = h;
+        }
+        return bytes;
+    }
+}
+
+std::vector<BenchmarkResult> RunAssetLoadingBenchmark() {
+    std::vector<BenchmarkResult> results;
+    for (const Model& m : models) {
+        std::string fileName = GetDataDirectory() + "/" + m.file;
+        size_t imageCount = 0;
+        std::vector<std::string> imageFiles = GetImageFiles(fileName, imageCount);
+        tinygltf::Model model;
+        std::string error;
+        if (Load(model, fileName, false, error)) {
+            size_t bufferBytes = 0;
+            for (const tinygltf::Buffer& buffer : model.buffers) {
+                bufferBytes += buffer.data.size();
+            }
+            printf("asset loading, %s: %zu nodes, %zu meshes, %zu accessors, %.2f MB of buffers, %zu of %zu images found\n",
+                m.name, model.nodes.size(), model.meshes.size(), model.accessors.size(), bufferBytes / (1024.0 * 1024.0),
+                imageFiles.size(), imageCount);
+
+            results.push_back(RunBenchmark(std::string("gltf/parse ") + m.name, 4, [&](uint64_t n) {
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < n; ++i) {
+                    Load(model, fileName, false, error);
+                    sum += model.accessors.size();
+                }
+                return sum;
+            }));
+            if (imageFiles.size() == imageCount) {
+                results.push_back(RunBenchmark(std::string("gltf/load with images ") + m.name, 1, [&](uint64_t n) {
+                    uint64_t sum = 0;
+                    for (uint64_t i = 0; i < n; ++i) {
+                        Load(model, fileName, true, error);
+                        sum += model.images.empty() ? 0 : model.images[0].image.size();
+                    }
+                    return sum;
+                }));
+            }
+        }
+        else {
+            error.erase(error.find_last_not_of('\n') + 1);
+            printf("asset loading, %s: glTF skipped, %s\n", m.name, error.c_str());
+        }
+
+        if (imageFiles.empty()) {
+            continue;
+        }
+        std::vector<Image> images(imageFiles.size());
+        size_t texelBytes = 0;
+        for (size_t i = 0; i < imageFiles.size(); ++i) {
+            Decode(imageFiles[i], images[i]);
+            texelBytes += images[i].texels.size();
+        }
+        std::vector<uint8_t> chain;
+        uint64_t mipBytes = 0;
+        for (const Image& image : images) {
+            mipBytes += BuildMipChain(image, chain);
+        }
+        printf("asset loading, %s: %zu images decode to %.2f MB, the mip chains add %.2f MB\n", m.name, images.size(),
+            texelBytes / (1024.0 * 1024.0), mipBytes / (1024.0 * 1024.0));
+
+        results.push_back(RunBenchmark(std::string("texture/decode ") + m.name, 1, [&](uint64_t n) {
+            uint64_t sum = 0;
+            Image image;
+            for (uint64_t i = 0; i < n; ++i) {
+                for (const std::string& file : imageFiles) {
+                    Decode(file, image);
+                    sum += image.texels.size();
+                }
+            }
+            return sum;
+        }));
+        results.push_back(RunBenchmark(std::string("texture/mip chain ") + m.name, 2, [&](uint64_t n) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                for (const Image& image : images) {
+                    sum += BuildMipChain(image, chain);
+                }
+            }
+            return sum;
+        }));
+    }
+    return results;
+}
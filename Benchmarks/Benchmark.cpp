@@ -0,0 +1,124 @@
+#include "Benchmark.h"
+
+#include "../Lab6/tinygltf/json.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+
+namespace {
+    const int repetitions = 7;
+    volatile uint64_t sink = 0;
+    std::string dataDirectory = "../Lab6";
+    uint32_t failureCount = 0;
+}
+
+BenchmarkResult RunBenchmark(const std::string& name, uint64_t iterations, const std::function<uint64_t(uint64_t)>& body) {
+    sink += body(iterations / 10 + 1); // warm up caches and the allocator
+
+    std::vector<double> times;
+    for (int i = 0; i < repetitions; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        sink += body(iterations);
+        times.push_back(std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.nanosecondsPerIteration = times[repetitions / 2] / (double)iterations;
+    return result;
+}
+
+void PrintResult(const BenchmarkResult& result) {
+    printf("%-48s %12llu iterations %12.2f ns/iteration\n", result.name.c_str(), (unsigned long long)result.iterations,
+        result.nanosecondsPerIteration);
+}
+
+void ReportFailures(const char* check, uint32_t failures) {
+    if (failures > 0) {
+        printf("CHECK FAILED: %s, %u failures\n", check, failures);
+        failureCount += failures;
+    }
+}
+
+uint32_t GetFailureCount() {
+    return failureCount;
+}
+
+void SetDataDirectory(const std::string& directory) {
+    dataDirectory = directory;
+}
+
+const std::string& GetDataDirectory() {
+    return dataDirectory;
+}
+
+bool WriteResults(const std::string& fileName, const std::vector<BenchmarkResult>& results) {
+    std::ofstream stream(fileName);
+    if (!stream) {
+        return false;
+    }
+    stream << "{\n    \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        char time[64];
+        snprintf(time, sizeof(time), "%.3f", results[i].nanosecondsPerIteration);
+        stream << "        { \"name\": " << nlohmann::json(results[i].name).dump() << ", \"iterations\": " << results[i].iterations
+            << ", \"ns_per_iteration\": " << time << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    stream << "    ]\n}\n";
+    return stream.good();
+}
+
+bool ReadResults(const std::string& fileName, std::vector<BenchmarkResult>& results) {
+    results.clear();
+    std::ifstream stream(fileName);
+    nlohmann::json document = nlohmann::json::parse(stream, nullptr, false);
+    if (document.is_discarded() || !document.contains("benchmarks") || !document["benchmarks"].is_array()) {
+        return false;
+    }
+    for (const nlohmann::json& entry : document["benchmarks"]) {
+        if (!entry.contains("name") || !entry.contains("ns_per_iteration")) {
+            return false;
+        }
+        BenchmarkResult result;
+        result.name = entry["name"].get<std::string>();
+        result.iterations = entry.value("iterations", (uint64_t)0);
+        result.nanosecondsPerIteration = entry["ns_per_iteration"].get<double>();
+        results.push_back(result);
+    }
+    return true;
+}
+
+uint32_t CompareResults(const std::vector<BenchmarkResult>& before, const std::vector<BenchmarkResult>& after,
+    double thresholdPercent) {
+    std::map<std::string, double> beforeTimes;
+    for (const BenchmarkResult& r : before) {
+        beforeTimes[r.name] = r.nanosecondsPerIteration;
+    }
+    printf("%-48s %14s %14s %9s\n", "case", "before, ns", "after, ns", "change");
+    uint32_t regressions = 0;
+    for (const BenchmarkResult& r : after) {
+        auto found = beforeTimes.find(r.name);
+        if (found == beforeTimes.end()) {
+            printf("%-48s %14s %14.2f %9s\n", r.name.c_str(), "-", r.nanosecondsPerIteration, "new");
+            continue;
+        }
+        double change = found->second > 0.0 ? (r.nanosecondsPerIteration / found->second - 1.0) * 100.0 : 0.0;
+        bool regression = change > thresholdPercent;
+        regressions += regression ? 1 : 0;
+        printf("%-48s %14.2f %14.2f %+8.1f%%%s\n", r.name.c_str(), found->second, r.nanosecondsPerIteration, change,
+            regression ? "  slower" : (change < -thresholdPercent ? "  faster" : ""));
+        beforeTimes.erase(found);
+    }
+    for (const BenchmarkResult& r : before) {
+        if (beforeTimes.count(r.name) != 0) {
+            printf("%-48s %14.2f %14s %9s\n", r.name.c_str(), r.nanosecondsPerIteration, "-", "removed");
+        }
+    }
+    printf("%u of %zu cases slower by more than %.1f%%\n", regressions, after.size(), thresholdPercent);
+    return regressions;
+}
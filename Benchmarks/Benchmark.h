@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Result of one measured case, time is the median over the repetitions
+struct BenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;
+    double nanosecondsPerIteration = 0.0;
+};
+
+// Calls body(iterations) several times and keeps the median, so that a single preempted run does not distort the result.
+// body must return a value depending on the work done, it is accumulated to keep the compiler from removing the work.
+BenchmarkResult RunBenchmark(const std::string& name, uint64_t iterations, const std::function<uint64_t(uint64_t)>& body);
+
+void PrintResult(const BenchmarkResult& result);
+
+// checks report what went wrong before the measurements, main exits with 1 if any check failed
+void ReportFailures(const char* check, uint32_t failures);
+uint32_t GetFailureCount();
+
+// directory of the lab data (models, textures), "../Lab6" by default, as the benchmarks are run from their directory
+void SetDataDirectory(const std::string& directory);
+const std::string& GetDataDirectory();
+
+// {"benchmarks": [{"name": ..., "iterations": ..., "ns_per_iteration": ...}, ...]}, one result per line
+bool WriteResults(const std::string& fileName, const std::vector<BenchmarkResult>& results);
+// reads what WriteResults wrote
+bool ReadResults(const std::string& fileName, std::vector<BenchmarkResult>& results);
+// prints the cases of both runs side by side, returns the number of cases slower by more than thresholdPercent
+uint32_t CompareResults(const std::vector<BenchmarkResult>& before, const std::vector<BenchmarkResult>& after,
+    double thresholdPercent);
+
+// returns the results of all cases of the benchmark
+std::vector<BenchmarkResult> RunIncludeCacheBenchmark();
+std::vector<BenchmarkResult> RunHandleTraversalBenchmark();
+std::vector<BenchmarkResult> RunRingAllocatorBenchmark();
+std::vector<BenchmarkResult> RunLightBinningBenchmark();
+std::vector<BenchmarkResult> RunShadowCascadesBenchmark();
+std::vector<BenchmarkResult> RunShadowAtlasBenchmark();
+std::vector<BenchmarkResult> RunReadbackRingBenchmark();
+std::vector<BenchmarkResult> RunExposureHistogramBenchmark();
+std::vector<BenchmarkResult> RunToneCurveLutBenchmark();
+std::vector<BenchmarkResult> RunFrameGraphBenchmark();
+std::vector<BenchmarkResult> RunCommandRecorderBenchmark();
+std::vector<BenchmarkResult> RunCpuProfilerBenchmark();
+std::vector<BenchmarkResult> RunAssetLoadingBenchmark();
+std::vector<BenchmarkResult> RunIblBakeBenchmark();
+std::vector<BenchmarkResult> RunSceneTraversalBenchmark();
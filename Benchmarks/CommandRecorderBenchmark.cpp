@@ -0,0 +1,167 @@
+#include "Benchmark.h"
+
+#include "../Lab6/CommandRecorder.hpp"
+#include "../Lab6/RenderQueue.hpp"
+
+#include <cstdio>
+#include <random>
+
+
+// Command recorder of the null context. A synthetic opaque pass binds what the scene binds per draw (shaders, the
+// material textures and samplers, states, the buffers of the primitive, a range of the constant ring) through the
+// recorder, in the order of submission and sorted by the RenderQueue keys, to count the state changes each order
+// costs. The log of the same submission has to give the same hash with other objects bound, so that it can be used to
+// compare the commands of frames between versions. The cases measure what the recording adds to every command.
+namespace {
+    using Command = CommandRecorder::Command;
+    using Stage = CommandRecorder::Stage;
+
+    struct DrawItem {
+        uint32_t permutation;
+        uint32_t material;
+        uint32_t state;
+        uint32_t mesh;
+        uint32_t indexCount;
+        float depth;
+    };
+
+    std::vector<DrawItem> MakeDrawItems(uint32_t count, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::vector<DrawItem> items(count);
+        for (DrawItem& item : items) {
+            item.permutation = random() % 8;
+            item.material = random() % 64;
+            item.state = random() % 3;
+            item.mesh = random() % 256;
+            item.indexCount = 36 + random() % 3000;
+            item.depth = (random() % 10000) / 10000.0f;
+        }
+        return items;
+    }
+
+    // fake objects: equal ids give equal pointers, base separates the objects of two runs
+    const void* Object(uintptr_t base, uint32_t kind, uint32_t id) {
+        return (const void*)(base + (((uintptr_t)kind << 20) | id) * 16);
+    }
+
+    void Submit(CommandRecorder& recorder, const std::vector<DrawItem>& items, const std::vector<RenderQueue::DrawPacket>& packets,
+        uintptr_t base) {
+        recorder.RecordCommand(Command::clearState);
+        const void* topology = (const void*)(uintptr_t)4;
+        recorder.RecordState(Command::setTopology, Stage::inputAssembler, topology);
+        const void* sampler = Object(base, 0, 0);
+        recorder.RecordBind(Command::setSamplers, Stage::pixel, 0, 1, &sampler);
+        uint32_t constantOffset = 0;
+        for (const RenderQueue::DrawPacket& packet : packets) {
+            const DrawItem& item = items[packet.index];
+            recorder.RecordState(Command::setInputLayout, Stage::inputAssembler, Object(base, 1, item.permutation));
+            recorder.RecordState(Command::setShader, Stage::vertex, Object(base, 2, item.permutation));
+            recorder.RecordState(Command::setShader, Stage::pixel, Object(base, 3, item.permutation));
+            const void* textures[3] = { Object(base, 4, item.material * 3), Object(base, 4, item.material * 3 + 1),
+                Object(base, 4, item.material * 3 + 2) };
+            recorder.RecordBind(Command::setShaderResources, Stage::pixel, 0, 3, textures);
+            recorder.RecordState(Command::setRasterizerState, Stage::rasterizer, Object(base, 5, item.state));
+            recorder.RecordState(Command::setBlendState, Stage::outputMerger, Object(base, 6, 0));
+            recorder.RecordState(Command::setDepthStencilState, Stage::outputMerger, Object(base, 7, 0));
+            const void* vertexBuffer = Object(base, 8, item.mesh);
+            recorder.RecordBind(Command::setVertexBuffers, Stage::inputAssembler, 0, 1, &vertexBuffer);
+            const void* indexBuffer = Object(base, 9, item.mesh);
+            recorder.RecordBind(Command::setIndexBuffer, Stage::inputAssembler, 0, 1, &indexBuffer);
+            const void* constantRing = Object(base, 10, 0);
+            recorder.RecordBind(Command::setConstantBuffers, Stage::vertex, 0, 1, &constantRing, &constantOffset);
+            constantOffset += 16;
+            recorder.RecordDraw(Command::drawIndexed, item.indexCount, 1);
+        }
+    }
+
+    void SortedPackets(const std::vector<DrawItem>& items, RenderQueue& queue) {
+        queue.Clear();
+        for (uint32_t i = 0; i < items.size(); ++i) {
+            queue.Push(RenderQueue::MakeKey(0, items[i].permutation, items[i].material, items[i].state, items[i].depth), i);
+        }
+        queue.Sort();
+    }
+
+    std::vector<RenderQueue::DrawPacket> UnsortedPackets(const std::vector<DrawItem>& items) {
+        std::vector<RenderQueue::DrawPacket> packets(items.size());
+        for (uint32_t i = 0; i < items.size(); ++i) {
+            packets[i].index = i;
+        }
+        return packets;
+    }
+
+    void CheckSubmission() {
+        const uint32_t drawCount = 4096;
+        std::vector<DrawItem> items = MakeDrawItems(drawCount, 7);
+        RenderQueue queue;
+        SortedPackets(items, queue);
+        std::vector<RenderQueue::DrawPacket> unsorted = UnsortedPackets(items);
+
+        CommandRecorder recorder;
+        recorder.SetLogging(true);
+        const struct {
+            const char* name;
+            const std::vector<RenderQueue::DrawPacket>* packets;
+        } orders[] = { { "in submission order", &unsorted }, { "sorted by key", &queue.GetPackets() } };
+        std::vector<uint32_t> stateChanges;
+        for (const auto& order : orders) {
+            recorder.BeginFrame();
+            Submit(recorder, items, *order.packets, 0x10000);
+            CommandRecorder::Statistics statistics = recorder.GetStatistics();
+            uint64_t hash = recorder.GetLogHash();
+
+            // the same commands with other objects give the same log and the same counts
+            recorder.BeginFrame();
+            Submit(recorder, items, *order.packets, 0x40000000);
+            bool sameHash = recorder.GetLogHash() == hash;
+            bool sameCounts = recorder.GetStatistics().stateChanges == statistics.stateChanges;
+
+            printf("command recorder, %u draws %s: %u commands, %u binds, %u state changes, %u redundant binds, "
+                "log hash %016llx (%s)\n", statistics.draws, order.name, statistics.commands, statistics.binds,
+                statistics.stateChanges, statistics.redundantBinds, (unsigned long long)hash,
+                sameHash && sameCounts ? "stable" : "UNSTABLE");
+            ReportFailures("command recorder log", sameHash && sameCounts ? 0 : 1);
+            stateChanges.push_back(statistics.stateChanges);
+        }
+        // sorting by key exists to save state changes
+        ReportFailures("command recorder sorting", stateChanges[1] < stateChanges[0] ? 0 : 1);
+
+        // viewports are values, setting the same ones again is still a change
+        recorder.BeginFrame();
+        recorder.RecordValues(Command::setViewports, Stage::rasterizer, 1);
+        recorder.RecordValues(Command::setViewports, Stage::rasterizer, 1);
+        const CommandRecorder::Statistics& values = recorder.GetStatistics();
+        ReportFailures("command recorder values", values.stateChanges == 2 && values.redundantBinds == 0 ? 0 : 1);
+    }
+}
+
+std::vector<BenchmarkResult> RunCommandRecorderBenchmark() {
+    CheckSubmission();
+
+    std::vector<BenchmarkResult> results;
+    const uint32_t drawCount = 4096;
+    std::vector<DrawItem> items = MakeDrawItems(drawCount, 11);
+    RenderQueue queue;
+    SortedPackets(items, queue);
+    CommandRecorder recorder;
+    results.push_back(RunBenchmark("command recorder/4096 sorted draws", 64, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            recorder.BeginFrame();
+            Submit(recorder, items, queue.GetPackets(), 0x10000);
+            sum += recorder.GetStatistics().stateChanges;
+        }
+        return sum;
+    }));
+    recorder.SetLogging(true);
+    results.push_back(RunBenchmark("command recorder/4096 sorted draws, logged and hashed", 64, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            recorder.BeginFrame();
+            Submit(recorder, items, queue.GetPackets(), 0x10000);
+            sum += recorder.GetLogHash();
+        }
+        return sum;
+    }));
+    return results;
+}
@@ -0,0 +1,82 @@
+#include "Benchmark.h"
+
+#include "../Lab6/CpuProfiler.hpp"
+
+#include <cstdio>
+#include <thread>
+
+
+// CPU profiler of Lab6. Nested scopes on several threads have to come back with the depth of their nesting, inside
+// their parents and on the ring of their own thread; the cases measure what a scope costs with the profiler disabled
+// and enabled.
+namespace {
+    const char* const names[] = { "Level 0", "Level 1", "Level 2", "Level 3" };
+
+    void Nested(uint32_t depth, uint32_t count) {
+        CpuProfileScope scope(names[depth]);
+        if (depth + 1 < 4) {
+            for (uint32_t i = 0; i < count; ++i) {
+                Nested(depth + 1, count);
+            }
+        }
+    }
+
+    void CheckNesting() {
+        CpuProfiler& profiler = CpuProfiler::Get();
+        profiler.SetEnabled(true);
+        uint64_t begin = profiler.Now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([]() {
+                Nested(0, 3);
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        profiler.SetEnabled(false);
+
+        std::vector<CpuProfiler::Event> events;
+        profiler.GetEvents(events, begin);
+        uint32_t violations = 0;
+        std::vector<const CpuProfiler::Event*> stack;
+        for (const CpuProfiler::Event& event : events) {
+            if (!stack.empty() && stack.back()->thread != event.thread) {
+                stack.clear();
+            }
+            while (!stack.empty() && stack.back()->end <= event.begin && stack.back()->depth >= event.depth) {
+                stack.pop_back();
+            }
+            if (event.depth != stack.size() || (!stack.empty() && (event.begin < stack.back()->begin || event.end > stack.back()->end))
+                || event.name != names[event.depth]) {
+                ++violations;
+            }
+            stack.push_back(&event);
+        }
+        // 1 + 3 + 9 + 27 scopes per thread
+        printf("cpu profiler check: %zu events of 4 threads (160 expected), %u nesting violations\n", events.size(), violations);
+        ReportFailures("cpu profiler", violations + (events.size() == 160 ? 0 : 1));
+    }
+}
+
+std::vector<BenchmarkResult> RunCpuProfilerBenchmark() {
+    CheckNesting();
+
+    std::vector<BenchmarkResult> results;
+    CpuProfiler& profiler = CpuProfiler::Get();
+    results.push_back(RunBenchmark("cpu profiler/scope, disabled", 1 << 20, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            CPU_PROFILE_SCOPE("Scope");
+        }
+        return n;
+    }));
+    profiler.SetEnabled(true);
+    results.push_back(RunBenchmark("cpu profiler/scope, enabled", 1 << 20, [&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            CPU_PROFILE_SCOPE("Scope");
+        }
+        return n;
+    }));
+    profiler.SetEnabled(false);
+    return results;
+}
@@ -0,0 +1,143 @@
+#include "Benchmark.h"
+
+#include "../Lab6/ExposureHistogram.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+
+
+// Exposure histogram of Lab6 on synthetic RGBA float frames like the HDR frame of the lab: a sky gradient, a lit ground
+// and a few small very bright lights. Before the measurements the SSE2 kernel is checked to give exactly the bins of the
+// reference on frames of odd sizes with padded rows and special values, the center span to match the per pixel test,
+// and the metering to follow the exposure of the frame and to ignore the small lights that pull the log average up.
+namespace {
+    std::vector<float> MakeFrame(uint32_t width, uint32_t height, uint32_t rowPitch, float scale, uint32_t seed) {
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> noise(0.8f, 1.2f);
+        std::vector<float> frame((size_t)rowPitch * height, -1.0f);
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                float* p = &frame[(size_t)y * rowPitch + 4 * x];
+                float v = (float)y / height;
+                float base = v < 0.4f ? 2.0f + 4.0f * v : 0.3f * noise(random);
+                bool light = random() % 500 == 0;
+                p[0] = scale * (light ? 2000.0f : base * 0.9f);
+                p[1] = scale * (light ? 1800.0f : base);
+                p[2] = scale * (light ? 1500.0f : base * (v < 0.4f ? 1.3f : 0.7f));
+                p[3] = 1.0f;
+            }
+        }
+        return frame;
+    }
+
+    double LogAverage(const std::vector<float>& frame, uint32_t width, uint32_t height, uint32_t rowPitch) {
+        double sum = 0.0;
+        for (uint32_t y = 0; y < height; ++y) {
+            for (uint32_t x = 0; x < width; ++x) {
+                const float* p = &frame[(size_t)y * rowPitch + 4 * x];
+                sum += std::log(ExposureHistogram::GetLuminance(p[0], p[1], p[2]) + 1.0);
+            }
+        }
+        return std::exp(sum / ((double)width * height)) - 1.0;
+    }
+
+    void CheckHistogram() {
+        // the bins of both kernels, with special values and the bounds of the bins sprinkled over the frames
+        std::mt19937 random(3);
+        const float specials[] = { 0.0f, -0.0f, -1.0f, std::numeric_limits<float>::infinity(), std::numeric_limits<float>::quiet_NaN(),
+            std::numeric_limits<float>::denorm_min(), std::ldexp(1.0f, ExposureHistogram::minLog2), std::ldexp(1.25f, 3),
+            std::nextafter(std::ldexp(1.25f, 3), 0.0f), 1e30f };
+        uint32_t binMismatches = 0;
+        for (uint32_t n = 0; n < 50; ++n) {
+            uint32_t width = 1 + random() % 300;
+            uint32_t height = 1 + random() % 200;
+            uint32_t rowPitch = 4 * width + 4 * (random() % 3);
+            std::vector<float> frame = MakeFrame(width, height, rowPitch, std::ldexp(1.0f, (int)(random() % 24) - 12), n);
+            for (uint32_t k = 0; k < width * height / 10; ++k) {
+                frame[(size_t)(random() % height) * rowPitch + 4 * (random() % width) + random() % 3] = specials[random() % 10];
+            }
+            uint32_t centerWeight = 1 + random() % 8;
+            uint32_t reference[ExposureHistogram::binCount] = {};
+            uint32_t simd[ExposureHistogram::binCount] = {};
+            ExposureHistogram::AccumulateReference(frame.data(), width, height, rowPitch, centerWeight, reference);
+            ExposureHistogram::Accumulate(frame.data(), width, height, rowPitch, centerWeight, simd);
+            for (uint32_t i = 0; i < ExposureHistogram::binCount; ++i) {
+                binMismatches += reference[i] != simd[i] ? 1 : 0;
+            }
+        }
+
+        uint32_t spanMismatches = 0;
+        for (uint32_t width = 1; width <= 300; width += 7) {
+            for (uint32_t height = 1; height <= 200; height += 13) {
+                for (uint32_t y = 0; y < height; ++y) {
+                    uint32_t x0, x1;
+                    ExposureHistogram::GetCenterSpan(y, width, height, x0, x1);
+                    for (uint32_t x = 0; x < width; ++x) {
+                        spanMismatches += ExposureHistogram::IsCenter(x, y, width, height) != (x >= x0 && x < x1) ? 1 : 0;
+                    }
+                }
+            }
+        }
+        printf("exposure histogram check: %u bins differ between the SSE2 kernel and the reference in 50 frames, "
+            "%u center span mismatches\n", binMismatches, spanMismatches);
+        ReportFailures("exposure histogram", binMismatches + spanMismatches);
+
+        // the metered luminance doubles with the frame, the lights are clipped by the upper percentile
+        const uint32_t width = 640;
+        const uint32_t height = 360;
+        ExposureHistogram::Settings settings;
+        float previous = 0.0f;
+        for (int32_t stop = -4; stop <= 4; stop += 4) {
+            std::vector<float> frame = MakeFrame(width, height, 4 * width, std::ldexp(1.0f, stop), 1);
+            uint32_t bins[ExposureHistogram::binCount] = {};
+            ExposureHistogram::Accumulate(frame.data(), width, height, 4 * width, settings.centerWeight, bins);
+            ExposureHistogram::Metering metering = ExposureHistogram::Evaluate(bins, settings.lowPercentile, settings.highPercentile);
+            printf("exposure metering at %+d stops: luminance %.4f (%.2f times the previous), percentiles %.3f..%.3f, "
+                "log(1 + L) average of the frame %.4f\n", stop, metering.averageLuminance,
+                previous > 0.0f ? metering.averageLuminance / previous : 0.0f, metering.lowLuminance, metering.highLuminance,
+                LogAverage(frame, width, height, 4 * width));
+            // 4 stops brighter has to meter 16 times brighter
+            ReportFailures("exposure metering", previous > 0.0f && std::abs(metering.averageLuminance / previous / 16.0f - 1.0f) > 0.05f ? 1 : 0);
+            previous = metering.averageLuminance;
+        }
+    }
+}
+
+std::vector<BenchmarkResult> RunExposureHistogramBenchmark() {
+    CheckHistogram();
+
+    std::vector<BenchmarkResult> results;
+    const uint32_t width = 1280;
+    const uint32_t height = 720;
+    std::vector<float> frame = MakeFrame(width, height, 4 * width, 1.0f, 5);
+    results.push_back(RunBenchmark("exposure histogram/reference 1280x720", 4, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            uint32_t bins[ExposureHistogram::binCount] = {};
+            ExposureHistogram::AccumulateReference(frame.data(), width, height, 4 * width, 4, bins);
+            sum += bins[i % ExposureHistogram::binCount];
+        }
+        return sum;
+    }));
+    results.push_back(RunBenchmark("exposure histogram/kernel 1280x720", 4, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            uint32_t bins[ExposureHistogram::binCount] = {};
+            ExposureHistogram::Accumulate(frame.data(), width, height, 4 * width, 4, bins);
+            sum += bins[i % ExposureHistogram::binCount];
+        }
+        return sum;
+    }));
+    results.push_back(RunBenchmark("exposure histogram/evaluate percentiles", 65536, [&](uint64_t n) {
+        uint32_t bins[ExposureHistogram::binCount] = {};
+        ExposureHistogram::Accumulate(frame.data(), width, height, 4 * width, 4, bins);
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += (uint64_t)(ExposureHistogram::Evaluate(bins, 0.4f, 0.9f + (float)(i % 8) * 0.01f).averageLuminance * 1000.0f);
+        }
+        return sum;
+    }));
+    return results;
+}
@@ -0,0 +1,339 @@
+#include "Benchmark.h"
+
+#include "../Lab6/FrameGraph.hpp"
+
+#include <cstdio>
+#include <random>
+
+
+// Frame graph of Lab6. The graph of a 1280x720 frame is declared as SceneManager and ToneMapping declare it for several
+// settings and compared with the textures the lab kept for the whole run before; random graphs check that the compiler
+// never culls a pass whose results are used, never puts textures with overlapping lifetimes or different descriptions
+// into one slot and reports the peak of the live bytes exactly.
+namespace {
+    // DXGI_FORMAT values
+    const uint32_t formatR8G8B8A8Unorm = 28;
+    const uint32_t formatR32Typeless = 39;
+    const uint32_t formatR32Float = 41;
+
+    struct Settings {
+        const char* name;
+        bool deferred;
+        bool lighting; // any of the ambient, directional or point lights reads the G-buffer
+        bool transparent;
+        bool readbackSort;
+        bool toneMapping;
+        bool brightnessChain;
+    };
+
+    FrameGraph::TextureDesc Desc(uint32_t width, uint32_t height, uint32_t format, bool depthStencil = false) {
+        FrameGraph::TextureDesc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.format = format;
+        desc.bytesPerTexel = 4;
+        desc.depthStencil = depthStencil;
+        return desc;
+    }
+
+    int Levels(uint32_t width, uint32_t height) {
+        int n = 0;
+        uint32_t minSide = (std::min)(width, height);
+        while (minSide >>= 1) {
+            n++;
+        }
+        return n;
+    }
+
+    // the passes of SceneManager::DeclarePasses and ToneMapping::DeclarePasses
+    void DeclareFrame(FrameGraph& graph, const Settings& settings, uint32_t width, uint32_t height) {
+        int n = Levels(width, height);
+        uint32_t backBuffer = graph.ImportTexture("Back buffer");
+        uint32_t target = settings.toneMapping ? graph.ImportTexture("HDR frame") : backBuffer;
+        uint32_t depth = graph.ImportTexture("Scene depth");
+        FrameGraph::TextureDesc depthDesc = Desc(width, height, formatR32Typeless, true);
+        FrameGraph::TextureDesc targetDesc = Desc(width, height, formatR8G8B8A8Unorm);
+
+        if (settings.transparent && settings.readbackSort) {
+            uint32_t pass = graph.AddPass("Transparent sort readback", true);
+            graph.CreateTexture(pass, "Transparent depth", depthDesc);
+            for (int i = 0; i < n + 1; ++i) {
+                graph.CreateTexture(pass, "Transparent depth max", Desc(1 << i, 1 << i, formatR32Float));
+            }
+        }
+
+        uint32_t pass = graph.AddPass("G-buffer");
+        uint32_t color = graph.CreateTexture(pass, "G-buffer color", targetDesc);
+        uint32_t features = graph.CreateTexture(pass, "G-buffer features", targetDesc);
+        uint32_t normals = graph.CreateTexture(pass, "G-buffer normals", targetDesc);
+        uint32_t emissive = settings.deferred ? graph.CreateTexture(pass, "G-buffer emissive", targetDesc) : FrameGraph::invalidIndex;
+        graph.Write(pass, depth);
+        graph.Write(pass, target);
+
+        pass = graph.AddPass("Depth copy");
+        graph.Read(pass, depth);
+        uint32_t depthCopy = graph.CreateTexture(pass, "Depth copy", depthDesc);
+
+        pass = graph.AddPass("Lighting");
+        if (settings.lighting) {
+            graph.Read(pass, color);
+            graph.Read(pass, features);
+            graph.Read(pass, normals);
+            graph.Read(pass, depthCopy);
+            if (settings.deferred) {
+                graph.Read(pass, emissive);
+            }
+        }
+        graph.Write(pass, target);
+
+        if (settings.transparent) {
+            pass = graph.AddPass("Transparent");
+            graph.Read(pass, depthCopy);
+            graph.Write(pass, target);
+        }
+
+        if (settings.toneMapping) {
+            uint32_t chainPass = graph.AddPass("Brightness chain");
+            graph.Read(chainPass, target);
+            uint32_t level0[3] = {};
+            for (int i = n; i >= 0; i--) {
+                for (int k = 0; k < 3; k++) {
+                    level0[k] = graph.CreateTexture(chainPass, "Brightness", Desc(1 << i, 1 << i, formatR32Float));
+                }
+            }
+            pass = graph.AddPass("Exposure histogram", !settings.brightnessChain);
+            graph.Read(pass, target);
+            pass = graph.AddPass("Tone mapping");
+            graph.Read(pass, target);
+            if (settings.brightnessChain) {
+                for (int k = 0; k < 3; k++) {
+                    graph.Read(pass, level0[k]);
+                }
+            }
+            graph.Write(pass, backBuffer);
+        }
+    }
+
+    // the textures SceneManager and ToneMapping kept for the whole run before the frame graph
+    uint64_t FormerBytes(uint32_t width, uint32_t height) {
+        uint64_t chain = 0;
+        for (int i = 0; i <= Levels(width, height); ++i) {
+            chain += 4ull << (2 * i);
+        }
+        return 6ull * width * height * 4 + chain * 4;
+    }
+
+    // the compiled graph against the brute force answers, returns the number of violations
+    uint32_t Validate(const FrameGraph& graph, const std::vector<uint32_t>& accessPass, const std::vector<uint32_t>& accessTexture,
+        const std::vector<uint8_t>& accessWrite, const std::vector<uint8_t>& sideEffect) {
+        uint32_t violations = 0;
+        const uint32_t passCount = graph.GetPassCount();
+        const uint32_t textureCount = graph.GetTextureCount();
+
+        // a texture is needed if it is imported or read by a live pass; a culled pass must not write a needed texture
+        // read after it, and a live pass must have a reason to be live
+        for (uint32_t p = 0; p < passCount; ++p) {
+            bool writesNeeded = false;
+            for (size_t a = 0; a < accessPass.size(); ++a) {
+                if (accessPass[a] != p || !accessWrite[a]) {
+                    continue;
+                }
+                uint32_t t = accessTexture[a];
+                bool needed = graph.IsImported(t);
+                for (size_t b = 0; b < accessPass.size() && !needed; ++b) {
+                    needed = accessTexture[b] == t && !accessWrite[b] && accessPass[b] > p && graph.IsPassLive(accessPass[b]);
+                }
+                for (size_t b = 0; b < accessPass.size() && !needed; ++b) {
+                    // written again by a later live pass, which needs the contents
+                    needed = accessTexture[b] == t && accessWrite[b] && accessPass[b] > p && graph.IsPassLive(accessPass[b]);
+                }
+                writesNeeded = writesNeeded || needed;
+            }
+            if (graph.IsPassLive(p) != (sideEffect[p] || writesNeeded)) {
+                ++violations;
+            }
+        }
+
+        // slots: one description, no overlapping lifetimes; every texture of a live pass has a slot
+        std::vector<uint64_t> liveBytes(passCount, 0);
+        uint64_t textureBytes = 0;
+        for (uint32_t t = 0; t < textureCount; ++t) {
+            uint32_t first, last;
+            bool used = graph.GetLifetime(t, first, last);
+            if (graph.IsImported(t)) {
+                continue;
+            }
+            if (used != (graph.GetPhysicalIndex(t) != FrameGraph::invalidIndex)) {
+                ++violations;
+            }
+            if (!used) {
+                continue;
+            }
+            textureBytes += graph.GetTextureDesc(t).GetBytes();
+            for (uint32_t p = first; p <= last; ++p) {
+                liveBytes[p] += graph.GetTextureDesc(t).GetBytes();
+            }
+            if (graph.GetPhysicalDesc(graph.GetPhysicalIndex(t)) != graph.GetTextureDesc(t)) {
+                ++violations;
+            }
+            for (uint32_t u = t + 1; u < textureCount; ++u) {
+                uint32_t otherFirst, otherLast;
+                if (graph.IsImported(u) || !graph.GetLifetime(u, otherFirst, otherLast) || graph.GetPhysicalIndex(u) != graph.GetPhysicalIndex(t)) {
+                    continue;
+                }
+                if (otherFirst <= last && first <= otherLast) {
+                    ++violations;
+                }
+            }
+        }
+        uint64_t peak = 0;
+        for (uint64_t bytes : liveBytes) {
+            peak = (std::max)(peak, bytes);
+        }
+        const FrameGraph::Statistics& statistics = graph.GetStatistics();
+        if (statistics.peakBytes != peak || statistics.textureBytes != textureBytes || statistics.physicalBytes > textureBytes
+            || statistics.physicalBytes < peak) {
+            ++violations;
+        }
+        return violations;
+    }
+
+    void CheckRandomGraphs() {
+        std::mt19937 random(11);
+        FrameGraph graph;
+        uint32_t violations = 0;
+        uint64_t textureBytes = 0;
+        uint64_t physicalBytes = 0;
+        uint64_t peakBytes = 0;
+        uint32_t culled = 0;
+        uint32_t passes = 0;
+        const uint32_t graphCount = 500;
+        for (uint32_t g = 0; g < graphCount; ++g) {
+            graph.Reset();
+            std::vector<uint32_t> accessPass;
+            std::vector<uint32_t> accessTexture;
+            std::vector<uint8_t> accessWrite;
+            std::vector<uint8_t> sideEffect;
+            std::vector<uint32_t> textures; // created so far
+            auto access = [&](uint32_t pass, uint32_t texture, bool write) {
+                if (write) {
+                    graph.Write(pass, texture);
+                }
+                else {
+                    graph.Read(pass, texture);
+                }
+                accessPass.push_back(pass);
+                accessTexture.push_back(texture);
+                accessWrite.push_back(write ? 1 : 0);
+            };
+
+            uint32_t imported = graph.ImportTexture("Imported");
+            uint32_t passCount = 2 + random() % 40;
+            for (uint32_t p = 0; p < passCount; ++p) {
+                bool effect = random() % 10 == 0;
+                uint32_t pass = graph.AddPass("Pass", effect);
+                sideEffect.push_back(effect ? 1 : 0);
+                uint32_t reads = textures.empty() ? 0 : random() % 4;
+                for (uint32_t r = 0; r < reads; ++r) {
+                    access(pass, textures[random() % textures.size()], random() % 8 == 0);
+                }
+                uint32_t creates = random() % 3;
+                for (uint32_t c = 0; c < creates; ++c) {
+                    // a few descriptions, so that both sharing and separate slots happen
+                    uint32_t size = 64u << (random() % 3);
+                    uint32_t texture = graph.CreateTexture(pass, "Texture", Desc(size, size, random() % 2 ? formatR32Float : formatR8G8B8A8Unorm));
+                    accessPass.push_back(pass);
+                    accessTexture.push_back(texture);
+                    accessWrite.push_back(1);
+                    textures.push_back(texture);
+                }
+                if (random() % 6 == 0) {
+                    access(pass, imported, true);
+                }
+            }
+            graph.Compile();
+            violations += Validate(graph, accessPass, accessTexture, accessWrite, sideEffect);
+            const FrameGraph::Statistics& statistics = graph.GetStatistics();
+            textureBytes += statistics.textureBytes;
+            physicalBytes += statistics.physicalBytes;
+            peakBytes += statistics.peakBytes;
+            culled += statistics.culledPasses;
+            passes += statistics.passes;
+        }
+        printf("frame graph check: %u violations in %u random graphs, %u of %u passes culled, slots take %.1f%% of the bytes "
+            "without aliasing, the peak of the live bytes %.1f%%\n", violations, graphCount, culled, passes,
+            100.0 * physicalBytes / textureBytes, 100.0 * peakBytes / textureBytes);
+        ReportFailures("frame graph", violations);
+    }
+
+    void CheckLab6Frame() {
+        const uint32_t width = 1280;
+        const uint32_t height = 720;
+        const Settings settings[] = {
+            { "default, histogram", true, true, false, false, true, false },
+            { "default, brightness chain", true, true, false, false, true, true },
+            { "transparent, readback sort, chain", true, true, true, true, true, true },
+            { "forward, fresnel", false, false, false, false, false, false },
+        };
+        FrameGraph graph;
+        for (const Settings& s : settings) {
+            graph.Reset();
+            DeclareFrame(graph, s, width, height);
+            graph.Compile();
+            const FrameGraph::Statistics& statistics = graph.GetStatistics();
+            printf("frame graph %ux%u, %s: %u passes, %u culled, %u textures in %u slots, %.2f MB (%.2f MB without aliasing, "
+                "peak live %.2f MB, %.2f MB kept before)\n", width, height, s.name, statistics.passes, statistics.culledPasses,
+                statistics.textures, statistics.physicalTextures, statistics.physicalBytes / (1024.0 * 1024.0),
+                statistics.textureBytes / (1024.0 * 1024.0), statistics.peakBytes / (1024.0 * 1024.0),
+                FormerBytes(width, height) / (1024.0 * 1024.0));
+        }
+    }
+}
+
+std::vector<BenchmarkResult> RunFrameGraphBenchmark() {
+    CheckLab6Frame();
+    CheckRandomGraphs();
+
+    std::vector<BenchmarkResult> results;
+    FrameGraph graph;
+    Settings settings = { "transparent, readback sort, chain", true, true, true, true, true, true };
+    results.push_back(RunBenchmark("frame graph/declare and compile Lab6 frame", 4096, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            graph.Reset();
+            settings.brightnessChain = i % 2 == 0;
+            DeclareFrame(graph, settings, 1280, 720);
+            graph.Compile();
+            sum += graph.GetStatistics().physicalTextures;
+        }
+        return sum;
+    }));
+
+    // a long chain of post effects: every pass reads the two previous results
+    const uint32_t passCount = 256;
+    results.push_back(RunBenchmark("frame graph/declare and compile 256 passes", 256, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            graph.Reset();
+            uint32_t target = graph.ImportTexture("Back buffer");
+            uint32_t previous[2] = { FrameGraph::invalidIndex, FrameGraph::invalidIndex };
+            for (uint32_t p = 0; p < passCount; ++p) {
+                uint32_t pass = graph.AddPass("Effect");
+                for (uint32_t k = 0; k < 2; ++k) {
+                    if (previous[k] != FrameGraph::invalidIndex) {
+                        graph.Read(pass, previous[k]);
+                    }
+                }
+                previous[1] = previous[0];
+                previous[0] = graph.CreateTexture(pass, "Effect", Desc(1280 >> (p % 3), 720 >> (p % 3), formatR32Float));
+            }
+            uint32_t pass = graph.AddPass("Present");
+            graph.Read(pass, previous[0]);
+            graph.Write(pass, target);
+            graph.Compile();
+            sum += graph.GetStatistics().physicalTextures;
+        }
+        return sum;
+    }));
+    return results;
+}
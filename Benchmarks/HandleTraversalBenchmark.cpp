@@ -0,0 +1,281 @@
+#include "Benchmark.h"
+
+#include "../Lab6/HandlePool.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+
+// Cost of gathering everything needed to draw one primitive, as the render loop of Lab6 does it.
+// The legacy case reproduces the layout before the handles: primitives store shared pointers to the shader objects,
+// which return the D3D objects as shared pointers by value, and the vertex buffers are found through the attribute list.
+// The pooled case uses the POD tables of the scene manager. D3D objects are replaced by dummy objects of the same role.
+namespace {
+    const uint32_t primitiveCount = 4096;
+    const uint32_t materialCount = 64;
+    const uint32_t shaderSetCount = 32;
+    const uint32_t textureCount = 128;
+    const uint32_t accessorsPerPrimitive = 4;
+    const uint32_t texturesPerMaterial = 5;
+
+    struct Object {
+        uint64_t id = 0;
+    };
+
+    std::shared_ptr<Object> MakeObject(uint64_t id) {
+        std::shared_ptr<Object> object = std::make_shared<Object>();
+        object->id = id;
+        return object;
+    }
+
+    // legacy layout
+
+    struct LegacyShader {
+        std::shared_ptr<Object> GetShader() const {
+            return shader;
+        };
+
+        std::shared_ptr<Object> GetInputLayout() const {
+            return inputLayout;
+        };
+
+        std::shared_ptr<Object> shader;
+        std::shared_ptr<Object> inputLayout;
+    };
+
+    struct LegacyTexture {
+        std::shared_ptr<Object> GetSRV(bool isSRGB) const {
+            return isSRGB ? SRVSRGB : SRV;
+        };
+
+        std::shared_ptr<Object> SRV;
+        std::shared_ptr<Object> SRVSRGB;
+    };
+
+    struct LegacyAccessor {
+        std::shared_ptr<Object> buffer;
+        uint32_t byteStride = 0;
+        uint32_t byteOffset = 0;
+    };
+
+    struct LegacyMaterial {
+        std::shared_ptr<Object> blendState;
+        std::shared_ptr<Object> depthStencilState;
+        std::shared_ptr<Object> rasterizerState;
+        int textureIds[texturesPerMaterial];
+    };
+
+    struct LegacyPrimitive {
+        std::vector<int> attributes;
+        int indicesAccessorId = -1;
+        int materialId = -1;
+        std::shared_ptr<LegacyShader> VS;
+        std::shared_ptr<LegacyShader> PS;
+        std::shared_ptr<LegacyShader> shadowVS;
+    };
+
+    // pooled layout, the same as in Scene.h
+
+    struct ShaderSet {
+        Object* inputLayout = nullptr;
+        Object* VS = nullptr;
+        Object* PS = nullptr;
+    };
+
+    struct TextureViews {
+        Object* SRV = nullptr;
+        Object* SRVSRGB = nullptr;
+    };
+
+    struct Material {
+        Object* blendState = nullptr;
+        Object* depthStencilState = nullptr;
+        Object* rasterizerState = nullptr;
+        Handle<TextureViews> textures[texturesPerMaterial];
+    };
+
+    struct Primitive {
+        Handle<Material> material;
+        Handle<ShaderSet> shaders;
+        uint32_t vertexBufferCount = 0;
+        Object* vertexBuffers[accessorsPerPrimitive] = {};
+        uint32_t strides[accessorsPerPrimitive] = {};
+        uint32_t offsets[accessorsPerPrimitive] = {};
+        Object* indexBuffer = nullptr;
+    };
+
+    uint64_t Fold(uint64_t hash, const Object* object) {
+        return hash * 31 + object->id;
+    }
+}
+
+std::vector<BenchmarkResult> RunHandleTraversalBenchmark() {
+    std::mt19937 random(42);
+    uint64_t id = 0;
+
+    // objects shared by both layouts
+    std::vector<std::shared_ptr<Object>> buffers;
+    for (uint32_t i = 0; i < primitiveCount * (accessorsPerPrimitive + 1); ++i) {
+        buffers.push_back(MakeObject(++id));
+    }
+    std::vector<LegacyShader> shaders(shaderSetCount * 2);
+    for (auto& s : shaders) {
+        s.shader = MakeObject(++id);
+        s.inputLayout = MakeObject(++id);
+    }
+    std::vector<LegacyTexture> textures(textureCount);
+    for (auto& t : textures) {
+        t.SRV = MakeObject(++id);
+        t.SRVSRGB = MakeObject(++id);
+    }
+
+    std::vector<LegacyAccessor> legacyAccessors;
+    for (auto& b : buffers) {
+        LegacyAccessor accessor;
+        accessor.buffer = b;
+        accessor.byteStride = 12;
+        legacyAccessors.push_back(accessor);
+    }
+    std::vector<std::shared_ptr<LegacyShader>> legacyShaders;
+    for (auto& s : shaders) {
+        legacyShaders.push_back(std::make_shared<LegacyShader>(s));
+    }
+    std::vector<std::shared_ptr<LegacyTexture>> legacyTextures;
+    for (auto& t : textures) {
+        legacyTextures.push_back(std::make_shared<LegacyTexture>(t));
+    }
+    std::vector<LegacyMaterial> legacyMaterials(materialCount);
+    for (auto& m : legacyMaterials) {
+        m.blendState = MakeObject(++id);
+        m.depthStencilState = MakeObject(++id);
+        m.rasterizerState = MakeObject(++id);
+        for (auto& t : m.textureIds) {
+            t = random() % textureCount;
+        }
+    }
+    std::vector<LegacyPrimitive> legacyPrimitives(primitiveCount);
+    for (uint32_t i = 0; i < primitiveCount; ++i) {
+        LegacyPrimitive& p = legacyPrimitives[i];
+        for (uint32_t j = 0; j < accessorsPerPrimitive; ++j) {
+            p.attributes.push_back(i * (accessorsPerPrimitive + 1) + j);
+        }
+        p.indicesAccessorId = i * (accessorsPerPrimitive + 1) + accessorsPerPrimitive;
+        p.materialId = random() % materialCount;
+        uint32_t shaderSet = random() % shaderSetCount;
+        p.VS = legacyShaders[shaderSet * 2];
+        p.PS = legacyShaders[shaderSet * 2 + 1];
+        p.shadowVS = legacyShaders[shaderSet * 2];
+    }
+
+    HandlePool<TextureViews> texturePool;
+    std::vector<Handle<TextureViews>> textureHandles;
+    for (auto& t : textures) {
+        TextureViews views;
+        views.SRV = t.SRV.get();
+        views.SRVSRGB = t.SRVSRGB.get();
+        textureHandles.push_back(texturePool.Add(views));
+    }
+    HandlePool<ShaderSet> shaderSetPool;
+    std::vector<Handle<ShaderSet>> shaderSetHandles;
+    for (uint32_t i = 0; i < shaderSetCount; ++i) {
+        ShaderSet shaderSet;
+        shaderSet.inputLayout = shaders[i * 2].inputLayout.get();
+        shaderSet.VS = shaders[i * 2].shader.get();
+        shaderSet.PS = shaders[i * 2 + 1].shader.get();
+        shaderSetHandles.push_back(shaderSetPool.Add(shaderSet));
+    }
+    HandlePool<Material> materialPool;
+    std::vector<Handle<Material>> materialHandles;
+    for (auto& m : legacyMaterials) {
+        Material material;
+        material.blendState = m.blendState.get();
+        material.depthStencilState = m.depthStencilState.get();
+        material.rasterizerState = m.rasterizerState.get();
+        for (uint32_t j = 0; j < texturesPerMaterial; ++j) {
+            material.textures[j] = textureHandles[m.textureIds[j]];
+        }
+        materialHandles.push_back(materialPool.Add(material));
+    }
+    HandlePool<Primitive> primitivePool;
+    std::vector<Handle<Primitive>> primitiveHandles;
+    for (uint32_t i = 0; i < primitiveCount; ++i) {
+        const LegacyPrimitive& lp = legacyPrimitives[i];
+        Primitive primitive;
+        primitive.material = materialHandles[lp.materialId];
+        for (uint32_t j = 0; j < shaderSetCount; ++j) {
+            if (legacyShaders[j * 2] == lp.VS) {
+                primitive.shaders = shaderSetHandles[j];
+            }
+        }
+        for (auto a : lp.attributes) {
+            primitive.vertexBuffers[primitive.vertexBufferCount] = legacyAccessors[a].buffer.get();
+            primitive.strides[primitive.vertexBufferCount] = legacyAccessors[a].byteStride;
+            primitive.offsets[primitive.vertexBufferCount] = legacyAccessors[a].byteOffset;
+            ++primitive.vertexBufferCount;
+        }
+        primitive.indexBuffer = legacyAccessors[lp.indicesAccessorId].buffer.get();
+        primitiveHandles.push_back(primitivePool.Add(primitive));
+    }
+
+    // draw items reference the primitives in the order of the render queue, not in the order of creation
+    std::vector<uint32_t> order(primitiveCount);
+    for (uint32_t i = 0; i < primitiveCount; ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<const LegacyPrimitive*> legacyItems;
+    std::vector<Handle<Primitive>> items;
+    for (auto i : order) {
+        legacyItems.push_back(&legacyPrimitives[i]);
+        items.push_back(primitiveHandles[i]);
+    }
+
+    std::vector<BenchmarkResult> results;
+    results.push_back(RunBenchmark("traversal/legacy shared_ptr per draw", primitiveCount * 64, [&](uint64_t n) {
+        uint64_t hash = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            const LegacyPrimitive& primitive = *legacyItems[i % primitiveCount];
+            const LegacyMaterial& material = legacyMaterials[primitive.materialId];
+            hash = Fold(hash, material.blendState.get());
+            hash = Fold(hash, material.depthStencilState.get());
+            hash = Fold(hash, material.rasterizerState.get());
+            for (auto t : material.textureIds) {
+                hash = Fold(hash, legacyTextures[t]->GetSRV(false).get());
+            }
+            hash = Fold(hash, primitive.VS->GetInputLayout().get());
+            hash = Fold(hash, primitive.VS->GetShader().get());
+            hash = Fold(hash, primitive.PS->GetShader().get());
+            for (auto a : primitive.attributes) {
+                hash = Fold(hash, legacyAccessors[a].buffer.get());
+                hash += legacyAccessors[a].byteStride + legacyAccessors[a].byteOffset;
+            }
+            hash = Fold(hash, legacyAccessors[primitive.indicesAccessorId].buffer.get());
+        }
+        return hash;
+    }));
+    results.push_back(RunBenchmark("traversal/handles and POD tables", primitiveCount * 64, [&](uint64_t n) {
+        uint64_t hash = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            const Primitive& primitive = primitivePool[items[i % primitiveCount]];
+            const Material& material = materialPool[primitive.material];
+            const ShaderSet& shaderSet = shaderSetPool[primitive.shaders];
+            hash = Fold(hash, material.blendState);
+            hash = Fold(hash, material.depthStencilState);
+            hash = Fold(hash, material.rasterizerState);
+            for (auto t : material.textures) {
+                hash = Fold(hash, texturePool[t].SRV);
+            }
+            hash = Fold(hash, shaderSet.inputLayout);
+            hash = Fold(hash, shaderSet.VS);
+            hash = Fold(hash, shaderSet.PS);
+            for (uint32_t j = 0; j < primitive.vertexBufferCount; ++j) {
+                hash = Fold(hash, primitive.vertexBuffers[j]);
+                hash += primitive.strides[j] + primitive.offsets[j];
+            }
+            hash = Fold(hash, primitive.indexBuffer);
+        }
+        return hash;
+    }));
+    return results;
+}
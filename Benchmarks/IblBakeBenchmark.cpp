@@ -0,0 +1,253 @@
+#include "Benchmark.h"
+
+#include "../Lab6/tinygltf/stb_image.h"
+
+#include <cmath>
+#include <cstdio>
+
+
+// Image based lighting bakes of CubemapGenerator. Only the decoding of the HDR panorama runs on the CPU in the lab, the
+// bakes are pixel shaders; here they are ported to the CPU with the sample counts of the shaders, so that the cost of
+// their integrals can be followed between versions and compared with the GPU. The environment cube is sampled from the
+// panorama with the mapping of cubemapGeneratorPS, the irradiance texels with the 1000x250 samples of
+// cubemapGeneratorIrradiancePS (from the cube, nearest texels), the BRDF texels with the 1024 GGX samples of brdfPS.
+// The cases time parts of the bakes; the times of the whole bakes are printed.
+namespace {
+    const float pi = 3.14159265359f;
+    const int sideSize = 512; // CubemapGenerator::sideSize
+    const int irradianceSideSize = 32;
+    const int BRDFSideSize = 128;
+
+    struct Vector3 {
+        float x, y, z;
+    };
+
+    Vector3 operator+(const Vector3& a, const Vector3& b) {
+        return { a.x + b.x, a.y + b.y, a.z + b.z };
+    }
+
+    Vector3 operator*(const Vector3& a, float s) {
+        return { a.x * s, a.y * s, a.z * s };
+    }
+
+    float Dot(const Vector3& a, const Vector3& b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    Vector3 Cross(const Vector3& a, const Vector3& b) {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    Vector3 Normalize(const Vector3& a) {
+        return a * (1.0f / std::sqrt(Dot(a, a)));
+    }
+
+    struct Panorama {
+        int width = 0;
+        int height = 0;
+        std::vector<float> texels; // RGBA
+    };
+
+    struct Cube {
+        std::vector<float> faces[6]; // RGB, sideSize x sideSize
+    };
+
+    // direction of the texel of a face, in the order +X, -X, +Y, -Y, +Z, -Z of D3D
+    Vector3 FaceDirection(int face, float u, float v) {
+        float s = 2.0f * u - 1.0f;
+        float t = 1.0f - 2.0f * v;
+        switch (face) {
+        case 0: return { 1.0f, t, -s };
+        case 1: return { -1.0f, t, s };
+        case 2: return { s, 1.0f, -t };
+        case 3: return { s, -1.0f, t };
+        case 4: return { s, t, 1.0f };
+        default: return { -s, t, -1.0f };
+        }
+    }
+
+    const float* SampleCube(const Cube& cube, const Vector3& direction) {
+        float ax = std::fabs(direction.x), ay = std::fabs(direction.y), az = std::fabs(direction.z);
+        int face;
+        float s, t, m;
+        if (ax >= ay && ax >= az) {
+            face = direction.x > 0.0f ? 0 : 1;
+            m = ax;
+            s = direction.x > 0.0f ? -direction.z : direction.z;
+            t = direction.y;
+        }
+        else if (ay >= az) {
+            face = direction.y > 0.0f ? 2 : 3;
+            m = ay;
+            s = direction.x;
+            t = direction.y > 0.0f ? -direction.z : direction.z;
+        }
+        else {
+            face = direction.z > 0.0f ? 4 : 5;
+            m = az;
+            s = direction.z > 0.0f ? direction.x : -direction.x;
+            t = direction.y;
+        }
+        int x = (std::min)((int)((s / m * 0.5f + 0.5f) * sideSize), sideSize - 1);
+        int y = (std::min)((int)((0.5f - t / m * 0.5f) * sideSize), sideSize - 1);
+        return &cube.faces[face][((size_t)y * sideSize + x) * 3];
+    }
+
+    void RenderEnvironmentFace(const Panorama& panorama, int face, Cube& cube) {
+        std::vector<float>& texels = cube.faces[face];
+        texels.resize((size_t)sideSize * sideSize * 3);
+        for (int y = 0; y < sideSize; ++y) {
+            for (int x = 0; x < sideSize; ++x) {
+                Vector3 pos = Normalize(FaceDirection(face, (x + 0.5f) / sideSize, (y + 0.5f) / sideSize));
+                float u = 1.0f - std::atan2(pos.z, pos.x) / (2.0f * pi);
+                float v = -std::atan2(pos.y, std::sqrt(pos.x * pos.x + pos.z * pos.z)) / pi + 0.5f;
+                int px = (int)(u * panorama.width) % panorama.width;
+                int py = (std::min)((int)(v * panorama.height), panorama.height - 1);
+                const float* source = &panorama.texels[((size_t)py * panorama.width + px) * 4];
+                float* target = &texels[((size_t)y * sideSize + x) * 3];
+                target[0] = source[0];
+                target[1] = source[1];
+                target[2] = source[2];
+            }
+        }
+    }
+
+    Vector3 IrradianceTexel(const Cube& cube, const Vector3& normal) {
+        Vector3 dir = std::fabs(normal.z) < 0.999f ? Vector3{ 0.0f, 0.0f, 1.0f } : Vector3{ 1.0f, 0.0f, 0.0f };
+        Vector3 tangent = Normalize(Cross(dir, normal));
+        Vector3 binormal = Cross(normal, tangent);
+        Vector3 irradiance = { 0.0f, 0.0f, 0.0f };
+        const int N1 = 1000;
+        const int N2 = 250;
+        for (int i = 0; i < N1; i++) {
+            float phi = i * (2 * pi / N1);
+            float sinPhi = std::sin(phi), cosPhi = std::cos(phi);
+            for (int j = 0; j < N2; j++) {
+                float theta = j * (pi / 2 / N2);
+                float sinTheta = std::sin(theta), cosTheta = std::cos(theta);
+                Vector3 sampleVec = tangent * (sinTheta * cosPhi) + binormal * (sinTheta * sinPhi) + normal * cosTheta;
+                const float* color = SampleCube(cube, sampleVec);
+                float weight = cosTheta * sinTheta;
+                irradiance = irradiance + Vector3{ color[0], color[1], color[2] } * weight;
+            }
+        }
+        return irradiance * (pi / (N1 * N2));
+    }
+
+    float RadicalInverse(uint32_t bits) {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return float(bits) * 2.3283064365386963e-10f;
+    }
+
+    float GeometrySchlickGGX(float NdotV, float roughness) {
+        float k = (roughness * roughness) / 2.0f;
+        return NdotV / (NdotV * (1.0f - k) + k);
+    }
+
+    // N = (0, 0, 1), so the tangent frame of ImportanceSampleGGX is the identity
+    void IntegrateBRDF(float NdotV, float roughness, float& A, float& B) {
+        Vector3 V = { std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV };
+        A = 0.0f;
+        B = 0.0f;
+        const uint32_t sampleCount = 1024u;
+        float a = roughness * roughness;
+        for (uint32_t i = 0u; i < sampleCount; ++i) {
+            float phi = 2.0f * pi * i / sampleCount;
+            float xi = RadicalInverse(i);
+            float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a * a - 1.0f) * xi));
+            float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+            Vector3 H = { std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta };
+            Vector3 L = Normalize(H * (2.0f * Dot(V, H)) + V * -1.0f);
+
+            float NdotL = (std::max)(L.z, 0.0f);
+            float NdotH = (std::max)(H.z, 0.0f);
+            float VdotH = (std::max)(Dot(V, H), 0.0f);
+            if (NdotL > 0.0f) {
+                float G = GeometrySchlickGGX((std::max)(NdotV, 0.0f), roughness) * GeometrySchlickGGX(NdotL, roughness);
+                float G_Vis = (G * VdotH) / (NdotH * NdotV);
+                float Fc = std::pow(1.0f - VdotH, 5.0f);
+                A += (1.0f - Fc) * G_Vis;
+                B += Fc * G_Vis;
+            }
+        }
+        A /= float(sampleCount);
+        B /= float(sampleCount);
+    }
+}
+
+std::vector<BenchmarkResult> RunIblBakeBenchmark() {
+    std::vector<BenchmarkResult> results;
+
+    // the BRDF texture does not depend on the environment
+    BenchmarkResult brdfRow = RunBenchmark("ibl/BRDF row, 128 texels x 1024 samples", 4, [&](uint64_t n) {
+        uint64_t sum = 0;
+        float A, B;
+        for (uint64_t i = 0; i < n; ++i) {
+            float roughness = ((i % BRDFSideSize) + 0.5f) / BRDFSideSize;
+            for (int x = 0; x < BRDFSideSize; ++x) {
+                IntegrateBRDF((x + 0.5f) / BRDFSideSize, roughness, A, B);
+                sum += (uint64_t)(A * 1000.0f);
+            }
+        }
+        return sum;
+    });
+    results.push_back(brdfRow);
+    float A, B;
+    IntegrateBRDF(0.5f, 0.5f, A, B);
+    printf("ibl bake: BRDF(0.5, 0.5) = (%.4f, %.4f), the %dx%d BRDF texture takes %.1f ms on one core\n", A, B, BRDFSideSize,
+        BRDFSideSize, brdfRow.nanosecondsPerIteration * BRDFSideSize / 1e6);
+
+    std::string fileName = GetDataDirectory() + "/textures/hdr_text.hdr";
+    Panorama panorama;
+    int components = 0;
+    float* data = stbi_loadf(fileName.c_str(), &panorama.width, &panorama.height, &components, 4);
+    if (!data) {
+        printf("ibl bake: %s not found, the environment cases are skipped\n", fileName.c_str());
+        return results;
+    }
+    panorama.texels.assign(data, data + (size_t)panorama.width * panorama.height * 4);
+    stbi_image_free(data);
+
+    results.push_back(RunBenchmark("ibl/decode hdr_text.hdr", 2, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            int width, height, channels;
+            float* texels = stbi_loadf(fileName.c_str(), &width, &height, &channels, 4);
+            sum += (uint64_t)width * height;
+            stbi_image_free(texels);
+        }
+        return sum;
+    }));
+
+    Cube cube;
+    BenchmarkResult environment = RunBenchmark("ibl/environment cube, 6 faces 512x512", 1, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            for (int face = 0; face < 6; ++face) {
+                RenderEnvironmentFace(panorama, face, cube);
+                sum += (uint64_t)cube.faces[face][0];
+            }
+        }
+        return sum;
+    });
+    results.push_back(environment);
+
+    Vector3 irradiance = { 0.0f, 0.0f, 0.0f };
+    BenchmarkResult irradianceTexel = RunBenchmark("ibl/irradiance texel, 1000x250 samples", 2, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            irradiance = IrradianceTexel(cube, Normalize(FaceDirection((int)(i % 6), 0.3f, 0.7f)));
+            sum += (uint64_t)(irradiance.x * 1000.0f);
+        }
+        return sum;
+    });
+    results.push_back(irradianceTexel);
+    printf("ibl bake: %dx%d panorama, the environment cube takes %.1f ms, the 6x%dx%d irradiance map %.1f s on one core\n",
+        panorama.width, panorama.height, environment.nanosecondsPerIteration / 1e6, irradianceSideSize, irradianceSideSize,
+        irradianceTexel.nanosecondsPerIteration * 6 * irradianceSideSize * irradianceSideSize / 1e9);
+    return results;
+}
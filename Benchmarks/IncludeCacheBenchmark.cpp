@@ -0,0 +1,153 @@
+#include "Benchmark.h"
+
+#include "../Lab6/IncludeCache.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+
+// Include cache of the shader managers of Lab6 with an in-memory reader. Every file has to be read once however many
+// compiles open it, also from several threads at once, the returned pointers have to stay valid while other files are
+// added, failed reads must not be cached and an invalidated file has to be read again with its new content. The cases
+// measure an open of a cached file and a reread of PBR.hlsli after an invalidation.
+namespace {
+    struct Files {
+        std::atomic<uint32_t> reads{ 0 };
+        std::atomic<uint32_t> version{ 0 };
+
+        IncludeCache::Reader MakeReader() {
+            return [this](const std::string& name, std::string& content) {
+                if (name.compare(0, 7, "missing") == 0) {
+                    return false;
+                }
+                ++reads;
+                content = "// " + name + " version " + std::to_string(version.load()) + "\n";
+                return true;
+            };
+        }
+    };
+
+    std::string Name(uint32_t i) {
+        return "include" + std::to_string(i) + ".hlsli";
+    }
+
+    void CheckCache() {
+        uint32_t errors = 0;
+        Files files;
+        IncludeCache cache(files.MakeReader());
+
+        const char* first = nullptr;
+        size_t firstSize = 0;
+        errors += cache.Get(Name(0), first, firstSize) ? 0 : 1;
+        for (uint32_t i = 1; i < 1000; ++i) {
+            const char* data = nullptr;
+            size_t size = 0;
+            errors += cache.Get(Name(i), data, size) ? 0 : 1;
+        }
+        for (uint32_t n = 0; n < 100; ++n) {
+            const char* data = nullptr;
+            size_t size = 0;
+            cache.Get(Name(0), data, size);
+            errors += data == first && size == firstSize ? 0 : 1;
+        }
+        errors += std::string(first, firstSize) == "// include0.hlsli version 0\n" ? 0 : 1;
+        errors += files.reads == 1000 ? 0 : 1;
+
+        const char* data = nullptr;
+        size_t size = 0;
+        for (uint32_t n = 0; n < 2; ++n) {
+            errors += cache.Get("missing.hlsli", data, size) ? 1 : 0;
+        }
+        errors += cache.Contains("missing.hlsli") ? 1 : 0;
+        IncludeCache::Statistics statistics = cache.GetStatistics();
+        errors += statistics.reads == 1000 && statistics.hits == 100 && statistics.failures == 2 ? 0 : 1;
+
+        // an edited file is read again after the invalidation, the others stay cached
+        files.version = 1;
+        cache.Invalidate(Name(0));
+        errors += cache.Contains(Name(0)) || !cache.Contains(Name(1)) ? 1 : 0;
+        cache.Get(Name(0), data, size);
+        errors += std::string(data, size) == "// include0.hlsli version 1\n" ? 0 : 1;
+        errors += files.reads == 1001 ? 0 : 1;
+
+        // compiles on several threads open the same files
+        Files shared;
+        IncludeCache sharedCache(shared.MakeReader());
+        const uint32_t threadCount = 8;
+        const uint32_t nameCount = 16;
+        const char* pointers[threadCount][nameCount] = {};
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                for (uint32_t n = 0; n < 1000; ++n) {
+                    uint32_t i = (n * 7 + t) % nameCount;
+                    const char* p = nullptr;
+                    size_t s = 0;
+                    sharedCache.Get(Name(i), p, s);
+                    pointers[t][i] = p;
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        uint32_t differentPointers = 0;
+        for (uint32_t t = 1; t < threadCount; ++t) {
+            for (uint32_t i = 0; i < nameCount; ++i) {
+                differentPointers += pointers[t][i] != pointers[0][i] ? 1 : 0;
+            }
+        }
+        errors += differentPointers;
+        printf("include cache check: %u errors, %u reads of %u files by %u threads\n", errors, shared.reads.load(), nameCount,
+            threadCount);
+        errors += shared.reads == nameCount ? 0 : 1;
+        ReportFailures("include cache", errors);
+    }
+}
+
+std::vector<BenchmarkResult> RunIncludeCacheBenchmark() {
+    CheckCache();
+
+    std::vector<BenchmarkResult> results;
+    Files files;
+    IncludeCache cache(files.MakeReader());
+    for (uint32_t i = 0; i < 64; ++i) {
+        const char* data = nullptr;
+        size_t size = 0;
+        cache.Get(Name(i), data, size);
+    }
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < 64; ++i) {
+        names.push_back(Name(i));
+    }
+    results.push_back(RunBenchmark("include cache/open a cached file", 1 << 20, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            const char* data = nullptr;
+            size_t size = 0;
+            cache.Get(names[i % names.size()], data, size);
+            sum += size;
+        }
+        return sum;
+    }));
+
+    std::string fileName = GetDataDirectory() + "/shaders/PBR.hlsli";
+    IncludeCache diskCache;
+    const char* data = nullptr;
+    size_t size = 0;
+    if (!diskCache.Get(fileName, data, size)) {
+        printf("include cache: %s not found, the reread case is skipped\n", fileName.c_str());
+        return results;
+    }
+    results.push_back(RunBenchmark("include cache/reread PBR.hlsli", 1024, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            diskCache.Invalidate(fileName);
+            diskCache.Get(fileName, data, size);
+            sum += size;
+        }
+        return sum;
+    }));
+    return results;
+}
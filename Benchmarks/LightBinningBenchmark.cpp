@@ -0,0 +1,121 @@
+#include "Benchmark.h"
+
+#include "../Lab6/LightClusters.hpp"
+
+#include <cstdio>
+#include <random>
+
+
+// Cost of assigning point lights to the clusters of Lab6 for a camera like the one of the lab (60 degrees, 16:9).
+// The brute force case tests every light against every cluster, the clustered case is what the renderer does.
+// Before the measurements the result is checked: points sampled inside the lights must find them in their clusters.
+namespace {
+    const float fovY = 1.0472f;
+    const float aspect = 16.0f / 9.0f;
+
+    LightClusters::Settings MakeSettings() {
+        LightClusters::Settings settings;
+        settings.projectionScaleY = 1.0f / std::tan(fovY * 0.5f);
+        settings.projectionScaleX = settings.projectionScaleY / aspect;
+        settings.nearPlane = 0.1f;
+        settings.farPlane = 300.0f;
+        return settings;
+    }
+
+    // lights are spread over the visible volume, radii as for brightness 10..500 and a clamp limit of 0.5
+    std::vector<LightClusters::Light> MakeLights(uint32_t count, std::mt19937& random) {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<LightClusters::Light> lights(count);
+        for (auto& l : lights) {
+            float depth = 1.0f + unit(random) * 250.0f;
+            l.x = (unit(random) * 2.0f - 1.0f) * depth * std::tan(fovY * 0.5f) * aspect;
+            l.y = (unit(random) * 2.0f - 1.0f) * depth * std::tan(fovY * 0.5f);
+            l.z = -depth;
+            l.radius = std::sqrt((10.0f + unit(random) * 490.0f) / 0.5f);
+        }
+        return lights;
+    }
+
+    uint32_t CheckClusters(const LightClusters& clusters, const std::vector<LightClusters::Light>& lights, std::mt19937& random,
+        uint32_t& checked) {
+        const LightClusters::Settings& settings = clusters.GetSettings();
+        std::uniform_real_distribution<float> symmetric(-1.0f, 1.0f);
+        uint32_t misses = 0;
+        checked = 0;
+        for (uint32_t n = 0; n < 200000; ++n) {
+            uint32_t index = random() % lights.size();
+            const LightClusters::Light& l = lights[index];
+            float x = l.x + symmetric(random) * l.radius;
+            float y = l.y + symmetric(random) * l.radius;
+            float z = l.z + symmetric(random) * l.radius;
+            float depth = -z;
+            if ((x - l.x) * (x - l.x) + (y - l.y) * (y - l.y) + (z - l.z) * (z - l.z) > l.radius * l.radius
+                || depth < settings.nearPlane || depth >= settings.farPlane) {
+                continue;
+            }
+            float ndcX = x / depth * settings.projectionScaleX;
+            float ndcY = y / depth * settings.projectionScaleY;
+            if (ndcX < -1.0f || ndcX >= 1.0f || ndcY <= -1.0f || ndcY > 1.0f) {
+                continue;
+            }
+
+            // the same cell lookup as in LightCalc.hlsli
+            uint32_t tileX = (uint32_t)std::floor((ndcX * 0.5f + 0.5f) * settings.tilesX);
+            uint32_t tileY = (uint32_t)std::floor((0.5f - ndcY * 0.5f) * settings.tilesY);
+            float slice = std::floor(std::log(depth) * clusters.GetSliceScale() + clusters.GetSliceBias());
+            slice = (std::min)((std::max)(slice, 0.0f), (float)(settings.slices - 1));
+            const LightClusters::Cluster& cluster = clusters.GetClusters()[clusters.GetClusterIndex(tileX, tileY, (uint32_t)slice)];
+            bool found = false;
+            for (uint32_t k = 0; k < cluster.count && !found; ++k) {
+                found = clusters.GetLightIndices()[cluster.offset + k] == index;
+            }
+            ++checked;
+            misses += found ? 0 : 1;
+        }
+        return misses;
+    }
+}
+
+std::vector<BenchmarkResult> RunLightBinningBenchmark() {
+    std::mt19937 random(7);
+    LightClusters::Settings settings = MakeSettings();
+    std::vector<BenchmarkResult> results;
+
+    std::vector<LightClusters::Light> checkLights = MakeLights(1024, random);
+    LightClusters clusters;
+    clusters.Build(settings, checkLights.data(), (uint32_t)checkLights.size());
+    uint32_t checked = 0;
+    uint32_t misses = CheckClusters(clusters, checkLights, random, checked);
+    printf("light binning check: %u points inside lights, %u not found in their clusters\n", checked, misses);
+    ReportFailures("light binning", misses);
+
+    results.push_back(RunBenchmark("light binning/brute force 1024 lights", 4, [&](uint64_t n) {
+        uint64_t references = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            for (uint32_t s = 0; s < settings.slices; ++s) {
+                for (uint32_t y = 0; y < settings.tilesY; ++y) {
+                    for (uint32_t x = 0; x < settings.tilesX; ++x) {
+                        for (auto& l : checkLights) {
+                            references += clusters.Intersects(l, x, y, s) ? 1 : 0;
+                        }
+                    }
+                }
+            }
+        }
+        return references;
+    }));
+
+    const uint32_t lightCounts[] = { 256, 1024, 4096 };
+    for (auto count : lightCounts) {
+        std::vector<LightClusters::Light> lights = MakeLights(count, random);
+        results.push_back(RunBenchmark("light binning/clustered " + std::to_string(count) + " lights", 64, [&](uint64_t n) {
+            uint64_t references = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                clusters.Build(settings, lights.data(), (uint32_t)lights.size());
+                references += clusters.GetLightIndices().size();
+            }
+            return references;
+        }));
+    }
+    return results;
+}
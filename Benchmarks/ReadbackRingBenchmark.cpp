@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+
+#include "../Lab6/ReadbackRing.hpp"
+
+#include <cstdio>
+#include <random>
+
+
+// Readback ring of the eye adaptation of Lab2 and Lab6 against a simulated GPU that finishes the copy of a frame
+// a random number of frames later. Before the measurements the values are checked to arrive in the order of the frames,
+// never earlier than the latency of the ring, and without misses or drops while the GPU is not later than that latency;
+// a slower GPU costs misses and dropped values, but the CPU still never waits.
+namespace {
+    struct Simulation {
+        uint32_t errors = 0;
+        uint32_t framesWithoutValue = 0;
+        ReadbackRing::Statistics statistics;
+    };
+
+    Simulation Simulate(uint32_t slotCount, uint32_t maxDelay, uint32_t frames) {
+        std::mt19937 random(11);
+        ReadbackRing ring(slotCount);
+        uint64_t written[ReadbackRing::maxSlots] = {}; // frame of the copy in the slot
+        uint64_t done[ReadbackRing::maxSlots] = {}; // frame from which the copy is finished
+        Simulation simulation;
+        uint64_t lastValue = 0;
+        bool anyValue = false;
+        for (uint64_t frame = 0; frame < frames; ++frame) {
+            bool read = false;
+            for (uint32_t slot = ring.GetReadableSlot(); slot != ReadbackRing::invalidSlot; slot = ring.GetReadableSlot()) {
+                if (frame < done[slot]) {
+                    ring.OnMiss();
+                    break;
+                }
+                simulation.errors += frame - written[slot] < ring.GetLatency() ? 1 : 0;
+                simulation.errors += anyValue && written[slot] <= lastValue ? 1 : 0;
+                lastValue = written[slot];
+                anyValue = true;
+                read = true;
+                ring.OnRead(slot);
+            }
+            simulation.framesWithoutValue += read || frame < ring.GetLatency() ? 0 : 1;
+            uint32_t slot = ring.Write();
+            written[slot] = frame;
+            done[slot] = frame + random() % (maxDelay + 1);
+        }
+        simulation.statistics = ring.GetStatistics();
+        return simulation;
+    }
+
+    void CheckRing() {
+        for (uint32_t maxDelay = 0; maxDelay <= 4; maxDelay += 2) {
+            Simulation simulation = Simulate(3, maxDelay, 100000);
+            printf("readback ring check, 3 slots, GPU up to %u frames late: %u errors, %llu reads, %llu misses, %llu drops, "
+                "%u frames without a new value\n", maxDelay, simulation.errors, (unsigned long long)simulation.statistics.reads,
+                (unsigned long long)simulation.statistics.misses, (unsigned long long)simulation.statistics.drops,
+                simulation.framesWithoutValue);
+            uint32_t failures = simulation.errors;
+            if (maxDelay <= ReadbackRing(3).GetLatency()) {
+                failures += (uint32_t)(simulation.statistics.misses + simulation.statistics.drops) + simulation.framesWithoutValue;
+            }
+            ReportFailures("readback ring", failures);
+        }
+    }
+}
+
+std::vector<BenchmarkResult> RunReadbackRingBenchmark() {
+    CheckRing();
+
+    std::vector<BenchmarkResult> results;
+    results.push_back(RunBenchmark("readback ring/read and write a frame", 1 << 20, [&](uint64_t n) {
+        ReadbackRing ring(3);
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            uint32_t slot = ring.GetReadableSlot();
+            if (slot != ReadbackRing::invalidSlot) {
+                ring.OnRead(slot);
+                sum += slot;
+            }
+            sum += ring.Write();
+        }
+        return sum;
+    }));
+    return results;
+}
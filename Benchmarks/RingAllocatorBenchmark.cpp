@@ -0,0 +1,128 @@
+#include "Benchmark.h"
+
+#include "../Lab6/RingAllocator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+
+// Ring allocator of the dynamic constant buffer of Lab6 against a simulated GPU that completes the fence of a frame a
+// random number of frames later. Before the measurements the allocations are checked to be aligned to the 256 bytes of
+// the constant buffer offsets, to stay inside the ring, to never overlap memory of frames that are not retired, to
+// start at 0 when they wrap, and the frames to be retired in the order of their fences; a full ring has to refuse
+// allocations and an empty one to accept any that fits.
+namespace {
+    const size_t alignment = 256;
+
+    struct Allocation {
+        size_t offset;
+        size_t size;
+        uint64_t fence;
+    };
+
+    bool Overlap(const Allocation& a, size_t offset, size_t size) {
+        return offset < a.offset + a.size && a.offset < offset + size;
+    }
+
+    void CheckRing() {
+        std::mt19937 random(5);
+        const size_t capacity = 64 * 1024;
+        RingAllocator ring(capacity);
+        std::vector<Allocation> live;
+        uint32_t errors = 0;
+        uint32_t allocations = 0;
+        uint32_t refusals = 0;
+        uint64_t completed = 0;
+        for (uint64_t frame = 1; frame <= 20000; ++frame) {
+            // the GPU is up to 3 frames late, its fences complete in order
+            uint64_t delay = random() % 4;
+            if (frame > delay + 1 && frame - delay - 1 > completed) {
+                completed = frame - delay - 1;
+                ring.Retire(completed);
+                size_t before = live.size();
+                live.erase(std::remove_if(live.begin(), live.end(), [&](const Allocation& a) {
+                    return a.fence <= completed;
+                }), live.end());
+                errors += live.size() > before ? 1 : 0;
+                errors += ring.GetFramesInFlight() == (size_t)(frame - 1 - completed) ? 0 : 1;
+            }
+
+            uint32_t count = random() % 16;
+            for (uint32_t i = 0; i < count; ++i) {
+                size_t size = 16 + random() % 2048;
+                bool wrapped = false;
+                size_t offset = ring.Allocate(size, alignment, wrapped);
+                if (offset == RingAllocator::invalidOffset) {
+                    ++refusals;
+                    continue;
+                }
+                ++allocations;
+                errors += offset % alignment != 0 ? 1 : 0;
+                errors += offset + size > capacity ? 1 : 0;
+                errors += wrapped && offset != 0 ? 1 : 0;
+                for (const Allocation& a : live) {
+                    errors += Overlap(a, offset, size) ? 1 : 0;
+                }
+                live.push_back({ offset, size, frame });
+            }
+            ring.EndFrame(frame);
+        }
+        RingAllocator::Statistics statistics = ring.GetStatistics();
+        ring.Retire(UINT64_MAX);
+        errors += ring.GetFramesInFlight() == 0 && ring.GetStatistics().usedBytes == 0 ? 0 : 1;
+        printf("ring allocator check, 64 KB, GPU up to 3 frames late: %u errors, %u allocations, %u refused, %llu wraps\n", errors,
+            allocations, refusals, (unsigned long long)statistics.wraps);
+
+        // a ring that is never retired fills up exactly, refuses, and accepts again once the frames complete
+        uint32_t fullErrors = 0;
+        RingAllocator full(16 * alignment);
+        bool wrapped = false;
+        for (uint32_t i = 0; i < 16; ++i) {
+            fullErrors += full.Allocate(alignment, alignment, wrapped) == i * alignment ? 0 : 1;
+        }
+        fullErrors += full.Allocate(1, alignment, wrapped) == RingAllocator::invalidOffset ? 0 : 1;
+        fullErrors += full.Allocate(17 * alignment, alignment, wrapped) == RingAllocator::invalidOffset ? 0 : 1;
+        full.EndFrame(1);
+        fullErrors += full.Allocate(1, alignment, wrapped) == RingAllocator::invalidOffset ? 0 : 1;
+        full.Retire(1);
+        fullErrors += full.Allocate(16 * alignment, alignment, wrapped) == 0 ? 0 : 1;
+
+        // a later fence must not free an earlier frame that is still in flight
+        RingAllocator ordered(16 * alignment);
+        for (uint64_t fence = 1; fence <= 4; ++fence) {
+            ordered.Allocate(4 * alignment, alignment, wrapped);
+            ordered.EndFrame(fence);
+        }
+        ordered.Retire(2);
+        fullErrors += ordered.GetFramesInFlight() == 2 && ordered.GetStatistics().usedBytes == 8 * alignment ? 0 : 1;
+        fullErrors += ordered.Allocate(4 * alignment, alignment, wrapped) == 0 && wrapped ? 0 : 1;
+        fullErrors += ordered.Allocate(5 * alignment, alignment, wrapped) == RingAllocator::invalidOffset ? 0 : 1;
+        printf("ring allocator fill and retire order check: %u errors\n", fullErrors);
+        ReportFailures("ring allocator", errors + fullErrors);
+    }
+}
+
+std::vector<BenchmarkResult> RunRingAllocatorBenchmark() {
+    CheckRing();
+
+    std::vector<BenchmarkResult> results;
+    // a frame of the lab: a few hundred constant blocks, the GPU two frames behind
+    results.push_back(RunBenchmark("ring allocator/allocate a constant block", 1 << 20, [&](uint64_t n) {
+        RingAllocator ring(4 * 1024 * 1024);
+        uint64_t sum = 0;
+        uint64_t fence = 0;
+        bool wrapped = false;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += ring.Allocate(64 + (i & 3) * 64, alignment, wrapped);
+            if (i % 256 == 255) {
+                ring.EndFrame(++fence);
+                if (fence > 2) {
+                    ring.Retire(fence - 2);
+                }
+            }
+        }
+        return sum;
+    }));
+    return results;
+}
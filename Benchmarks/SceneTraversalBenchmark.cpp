@@ -0,0 +1,184 @@
+#include "Benchmark.h"
+
+#include "../Lab6/TransformHierarchy.hpp"
+#include "../Lab6/Culling.hpp"
+#include "../Lab6/RenderQueue.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+
+// Per-frame traversal of the scene of Lab6 over synthetic node counts: TransformHierarchy updates the world matrices,
+// the boxes of the meshes are transformed into a BoundsList and culled against the camera frustum, and the draw packets
+// of the visible ones are sorted by RenderQueue. Outside of Windows the classes are built over DirectXMathPortable.hpp,
+// so the SIMD paths of DirectXMath are measured only in the Visual Studio build; elsewhere the names of the cases that
+// run the stand-in say so. Transforms are updated with every node dirty, as after loading, and with 1% of the nodes
+// animated, as in a frame. Before the measurements the world matrices are checked against the products of the local
+// ones and the culling against a box test per plane.
+namespace {
+    using namespace DirectX;
+
+    const float fovY = 1.0472f;
+    const float aspect = 16.0f / 9.0f;
+    const float farPlane = 300.0f;
+    const uint32_t nodeCounts[] = { 1024, 16384, 131072 };
+#ifdef _WIN32
+    const char* const mathNote = "";
+#else
+    const char* const mathNote = ", scalar DirectXMath stand-in";
+#endif
+
+    // groups of up to 64 nodes with a root each, children follow their parents closely as in a glTF scene, the roots
+    // are spread in front of the camera and around it
+    void MakeHierarchy(uint32_t count, std::mt19937& random, TransformHierarchy& hierarchy) {
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        hierarchy.Clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            if (i % 64 == 0) {
+                hierarchy.AddNode(-1, XMMatrixMultiply(XMMatrixRotationY(unit(random) * 6.28f), XMMatrixTranslation(
+                    (unit(random) * 2.0f - 1.0f) * 200.0f, unit(random) * 10.0f, (unit(random) * 2.0f - 1.0f) * 200.0f)));
+            }
+            else {
+                uint32_t groupStart = i - i % 64;
+                hierarchy.AddNode((int)(groupStart + random() % (i - groupStart)), XMMatrixMultiply(XMMatrixRotationY(unit(random) * 6.28f),
+                    XMMatrixTranslation((unit(random) * 2.0f - 1.0f) * 2.0f, unit(random) * 2.0f, (unit(random) * 2.0f - 1.0f) * 2.0f)));
+            }
+        }
+    }
+
+    // the unit box around the origin of every node, as SceneManager::CollectDrawItems does for the meshes
+    void BuildBounds(const TransformHierarchy& hierarchy, BoundsList& bounds) {
+        AABB box;
+        box.min = XMFLOAT3(-1.0f, -1.0f, -1.0f);
+        box.max = XMFLOAT3(1.0f, 1.0f, 1.0f);
+        bounds.Clear();
+        for (uint32_t i = 0; i < hierarchy.Size(); ++i) {
+            bounds.Add(box.Transform(hierarchy.GetWorldTransformation(i)));
+        }
+    }
+
+    void Check(const TransformHierarchy& hierarchy, const BoundsList& bounds, const Frustum& frustum, uint32_t animatedUpdates,
+        uint32_t expectedUpdates) {
+        uint32_t errors = animatedUpdates == expectedUpdates ? 0 : 1;
+        for (uint32_t i = 0; i < hierarchy.Size(); ++i) {
+            int parent = hierarchy.GetParent(i);
+            XMMATRIX expected = parent >= 0 ? XMMatrixMultiply(hierarchy.GetLocalTransformation(i), hierarchy.GetWorldTransformation(parent))
+                : hierarchy.GetLocalTransformation(i);
+            const XMMATRIX& world = hierarchy.GetWorldTransformation(i);
+            for (int r = 0; r < 4; ++r) {
+                XMFLOAT4 a, b;
+                XMStoreFloat4(&a, world.r[r]);
+                XMStoreFloat4(&b, expected.r[r]);
+                errors += std::fabs(a.x - b.x) + std::fabs(a.y - b.y) + std::fabs(a.z - b.z) + std::fabs(a.w - b.w) > 1e-3f ? 1 : 0;
+            }
+        }
+
+        std::vector<uint8_t> visible;
+        bounds.Cull(frustum, visible);
+        for (uint32_t i = 0; i < bounds.Size(); ++i) {
+            AABB box = bounds.Get(i);
+            // the distance of the corner farthest inside, boxes that touch a plane may go either way with rounding
+            float margin = FLT_MAX;
+            for (uint32_t p = 0; p < frustum.planeCount; ++p) {
+                const XMFLOAT4& plane = frustum.planes[p];
+                float x = plane.x >= 0.0f ? box.max.x : box.min.x;
+                float y = plane.y >= 0.0f ? box.max.y : box.min.y;
+                float z = plane.z >= 0.0f ? box.max.z : box.min.z;
+                margin = (std::min)(margin, plane.x * x + plane.y * y + plane.z * z + plane.w);
+            }
+            errors += std::fabs(margin) > 1e-3f && (visible[i] != 0) != (margin >= 0.0f) ? 1 : 0;
+        }
+        printf("scene traversal check, %u nodes: %u errors\n", hierarchy.Size(), errors);
+        ReportFailures("scene traversal", errors);
+    }
+}
+
+std::vector<BenchmarkResult> RunSceneTraversalBenchmark() {
+    std::vector<BenchmarkResult> results;
+    std::mt19937 random(7);
+    const Frustum frustum = Frustum::FromMatrix(XMMatrixPerspectiveFovLH(fovY, aspect, 0.1f, farPlane));
+    for (uint32_t count : nodeCounts) {
+        TransformHierarchy hierarchy;
+        MakeHierarchy(count, random, hierarchy);
+        hierarchy.Update();
+
+        // every 100th node is animated, the nodes below it are recomputed with it
+        std::vector<uint32_t> animated;
+        std::vector<uint8_t> moved(count, 0);
+        uint32_t expectedUpdates = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            int parent = hierarchy.GetParent(i);
+            moved[i] = i % 100 == 0 || (parent >= 0 && moved[parent]) ? 1 : 0;
+            expectedUpdates += moved[i];
+            if (i % 100 == 0) {
+                animated.push_back(i);
+            }
+        }
+        for (uint32_t i : animated) {
+            hierarchy.SetLocalTransformation(i, hierarchy.GetLocalTransformation(i));
+        }
+        uint32_t animatedUpdates = hierarchy.Update();
+
+        BoundsList bounds;
+        BuildBounds(hierarchy, bounds);
+        std::vector<uint8_t> visible;
+        uint32_t visibleCount = bounds.Cull(frustum, visible);
+        Check(hierarchy, bounds, frustum, animatedUpdates, expectedUpdates);
+        printf("scene traversal, %u nodes: %u visible, 1%% animated recomputes %u world matrices\n", count, visibleCount,
+            animatedUpdates);
+
+        std::string suffix = ", " + std::to_string(count) + " nodes";
+        std::string mathSuffix = suffix + mathNote;
+        uint64_t iterations = (std::max)(1u, (1u << 20) / count);
+        results.push_back(RunBenchmark("scene/transforms all dirty" + mathSuffix, iterations, [&](uint64_t n) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                hierarchy.SetRootTransformation(XMMatrixIdentity());
+                sum += hierarchy.Update();
+            }
+            return sum;
+        }));
+        results.push_back(RunBenchmark("scene/transforms 1% dirty" + mathSuffix, iterations, [&](uint64_t n) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                for (uint32_t a : animated) {
+                    hierarchy.SetLocalTransformation(a, hierarchy.GetLocalTransformation(a));
+                }
+                sum += hierarchy.Update();
+            }
+            return sum;
+        }));
+        results.push_back(RunBenchmark("scene/bounds and cull" + mathSuffix, iterations, [&](uint64_t n) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                BuildBounds(hierarchy, bounds);
+                sum += bounds.Cull(frustum, visible);
+            }
+            return sum;
+        }));
+
+        // materials repeat in the groups, depth is the distance along the view direction over the far plane
+        std::vector<float> depths(count);
+        for (uint32_t j = 0; j < count; ++j) {
+            AABB box = bounds.Get(j);
+            depths[j] = (box.min.z + box.max.z) * 0.5f / farPlane;
+        }
+        RenderQueue queue;
+        results.push_back(RunBenchmark("scene/sort visible" + suffix, iterations, [&](uint64_t n) {
+            uint64_t sum = 0;
+            for (uint64_t i = 0; i < n; ++i) {
+                queue.Clear();
+                for (uint32_t j = 0; j < count; ++j) {
+                    if (visible[j]) {
+                        queue.Push(RenderQueue::MakeKey(1, j % 3, (j / 64) % 256, j % 2, depths[j]), j);
+                    }
+                }
+                queue.Sort();
+                sum += queue.Size() == 0 ? 0 : queue.GetPackets()[0].index;
+            }
+            return sum;
+        }));
+    }
+    return results;
+}
@@ -0,0 +1,120 @@
+#include "Benchmark.h"
+
+#include "../Lab6/ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+
+// Tile allocator of the shadow atlas of Lab6. Before the measurements random sequences of allocations and frees are
+// checked: the tiles must lie inside the atlas, be aligned to their sizes and never overlap, and the atlas must be whole
+// again after everything is freed. The sizes chosen for random requests must always fit when allocated from the largest.
+namespace {
+    bool Overlap(const ShadowAtlas::Tile& a, const ShadowAtlas::Tile& b) {
+        return a.x < b.x + b.size && b.x < a.x + a.size && a.y < b.y + b.size && b.y < a.y + a.size;
+    }
+
+    void CheckAllocator() {
+        std::mt19937 random(7);
+        ShadowAtlas atlas;
+        atlas.Reset(8192, 128);
+        std::vector<ShadowAtlas::Tile> tiles;
+        uint32_t errors = 0;
+        uint32_t allocations = 0;
+        uint32_t failures = 0;
+        for (uint32_t n = 0; n < 20000; ++n) {
+            if (!tiles.empty() && random() % 3 == 0) {
+                uint32_t index = random() % tiles.size();
+                atlas.Free(tiles[index]);
+                tiles[index] = tiles.back();
+                tiles.pop_back();
+                continue;
+            }
+            ShadowAtlas::Tile tile;
+            if (!atlas.Allocate(100 + random() % 3000, tile)) {
+                ++failures;
+                continue;
+            }
+            ++allocations;
+            errors += tile.x + tile.size > atlas.GetSize() || tile.y + tile.size > atlas.GetSize() ? 1 : 0;
+            errors += tile.x % tile.size != 0 || tile.y % tile.size != 0 ? 1 : 0;
+            for (auto& t : tiles) {
+                errors += Overlap(t, tile) ? 1 : 0;
+            }
+            tiles.push_back(tile);
+        }
+        for (auto& t : tiles) {
+            atlas.Free(t);
+        }
+        ShadowAtlas::Tile whole;
+        bool merged = atlas.GetAllocatedTexels() == 0 && atlas.Allocate(atlas.GetSize(), whole);
+        printf("shadow atlas allocator check: %u allocations, %u refused, %u errors, %s after freeing all tiles\n", allocations, failures,
+            errors, merged ? "whole" : "FRAGMENTED");
+        ReportFailures("shadow atlas allocator", errors + (merged ? 0 : 1));
+
+        // sizes for four cascades with random demands always fit into atlases of any size
+        uint32_t misfits = 0;
+        for (uint32_t n = 0; n < 10000; ++n) {
+            ShadowAtlas::Request requests[4];
+            for (auto& r : requests) {
+                r.desiredSize = (float)(random() % 9000);
+                r.screenCoverage = (float)(random() % 100) / 100.0f;
+            }
+            uint32_t atlasSize = 512u << (random() % 5);
+            uint32_t sizes[4];
+            ShadowAtlas::ChooseSizes(requests, 4, atlasSize, 256, atlasSize, sizes);
+            std::sort(sizes, sizes + 4, [](uint32_t a, uint32_t b) {
+                return a > b;
+            });
+            atlas.Reset(atlasSize, 256);
+            for (auto s : sizes) {
+                ShadowAtlas::Tile tile;
+                misfits += atlas.Allocate(s, tile) && tile.size == s ? 0 : 1;
+            }
+        }
+        printf("shadow atlas sizes check: %u tiles did not fit in 10000 random choices\n", misfits);
+        ReportFailures("shadow atlas sizes", misfits);
+
+        // the cascades of Lab6 in the default atlas: the nearer cascades cover more of the screen
+        ShadowAtlas::Request cascades[4] = { { 20000.0f, 0.45f }, { 6000.0f, 0.3f }, { 4000.0f, 0.2f }, { 9000.0f, 0.05f } };
+        uint32_t sizes[4];
+        ShadowAtlas::ChooseSizes(cascades, 4, 4096, 256, 4096, sizes);
+        printf("shadow atlas 4096x4096 (64 MB): cascade tiles %u, %u, %u, %u, former maps 4 x 4096x4096 (256 MB)\n", sizes[0], sizes[1],
+            sizes[2], sizes[3]);
+    }
+}
+
+std::vector<BenchmarkResult> RunShadowAtlasBenchmark() {
+    CheckAllocator();
+
+    std::vector<BenchmarkResult> results;
+    ShadowAtlas atlas;
+    results.push_back(RunBenchmark("shadow atlas/allocate and free 4 tiles", 65536, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            atlas.Reset(4096, 256);
+            ShadowAtlas::Tile tiles[4];
+            for (uint32_t k = 0; k < 4; ++k) {
+                atlas.Allocate(2048u >> ((i + k) % 3), tiles[k]);
+                sum += tiles[k].x + tiles[k].y;
+            }
+            for (auto& t : tiles) {
+                atlas.Free(t);
+            }
+        }
+        return sum;
+    }));
+    results.push_back(RunBenchmark("shadow atlas/choose sizes of 4 cascades", 65536, [&](uint64_t n) {
+        uint64_t sum = 0;
+        ShadowAtlas::Request requests[4] = { { 20000.0f, 0.45f }, { 6000.0f, 0.3f }, { 4000.0f, 0.2f }, { 9000.0f, 0.05f } };
+        for (uint64_t i = 0; i < n; ++i) {
+            requests[i % 4].screenCoverage = (float)(i % 100) / 100.0f;
+            uint32_t sizes[4];
+            ShadowAtlas::ChooseSizes(requests, 4, 4096, 256, 4096, sizes);
+            sum += sizes[0] + sizes[3];
+        }
+        return sum;
+    }));
+    return results;
+}
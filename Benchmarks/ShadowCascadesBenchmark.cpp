@@ -0,0 +1,149 @@
+#include "Benchmark.h"
+
+#include "../Lab6/ShadowCascades.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+
+// Shadow cascades of Lab6 for a camera like the one of the lab (60 degrees, 16:9, near 0.01, far 800) in a scene of 230 units.
+// Before the measurements the coverage efficiency (the fraction of shadow texels inside the view) of the fitted cascades
+// is compared with the former fixed boxes of 100, 200, 300 and 400 units around the focus, and the stabilized cascades
+// are checked to keep their size under camera rotation and their texel grid under camera movement; the number of box
+// moves is compared for the snap steps of one texel and of the 64 texel bands used by the cached maps.
+namespace {
+    const float fovY = 1.0472f;
+    const float aspect = 16.0f / 9.0f;
+    const ShadowCascades::Vector3 sceneMin = { -115.0f, -10.0f, -115.0f };
+    const ShadowCascades::Vector3 sceneMax = { 115.0f, 60.0f, 115.0f };
+
+    ShadowCascades::Vector3 LightDirection() {
+        float theta = 0.595f;
+        float phi = 1.3f;
+        return { std::cos(theta) * std::cos(phi), std::sin(theta), std::cos(theta) * std::sin(phi) };
+    }
+
+    // the camera at position looks at the horizontal direction yaw, tilted down by pitch
+    ShadowCascades::View MakeView(const ShadowCascades::Vector3& position, float yaw, float pitch) {
+        ShadowCascades::View view;
+        view.position = position;
+        view.forward = { std::cos(pitch) * std::cos(yaw), -std::sin(pitch), std::cos(pitch) * std::sin(yaw) };
+        view.right = { -std::sin(yaw), 0.0f, std::cos(yaw) };
+        view.up = {
+            view.right.y * view.forward.z - view.right.z * view.forward.y,
+            view.right.z * view.forward.x - view.right.x * view.forward.z,
+            view.right.x * view.forward.y - view.right.y * view.forward.x
+        };
+        view.projectionScaleY = 1.0f / std::tan(fovY * 0.5f);
+        view.projectionScaleX = view.projectionScaleY / aspect;
+        view.nearPlane = 0.01f;
+        view.farPlane = 800.0f;
+        return view;
+    }
+
+    // whether the box contains the whole frustum slice across the light
+    bool ContainsSlice(const ShadowCascades::Cascade& cascade) {
+        for (auto& c : cascade.corners) {
+            if (c.x < cascade.min.x || c.x > cascade.max.x || c.y < cascade.min.y || c.y > cascade.max.y) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    float Fraction(float value) {
+        return std::abs(value - std::round(value));
+    }
+
+    void CheckCascades() {
+        ShadowCascades::Settings settings;
+        ShadowCascades cascades;
+        ShadowCascades::View view = MakeView({ 0.0f, 30.0f, 50.0f }, -1.2f, 0.3f);
+        cascades.Build(settings, view, LightDirection(), sceneMin, sceneMax);
+
+        // the former cascades: squares of 100 * (i + 1) units around the light space position of the origin
+        ShadowCascades::Vector3 focus = cascades.ToLightSpace({ 0.0f, 0.0f, 0.0f });
+        for (uint32_t i = 0; i < cascades.GetCascadeCount(); ++i) {
+            ShadowCascades::Cascade fixed = cascades.GetCascade(i);
+            float halfSize = 50.0f * (i + 1);
+            fixed.min.x = focus.x - halfSize;
+            fixed.min.y = focus.y - halfSize;
+            fixed.max.x = focus.x + halfSize;
+            fixed.max.y = focus.y + halfSize;
+            printf("shadow cascade %u: view depths %.2f..%.2f, coverage %.3f%s, fixed box %.3f%s, texel %.4f\n", i,
+                cascades.GetCascade(i).nearDistance, cascades.GetCascade(i).farDistance,
+                ShadowCascades::ComputeCoverage(cascades.GetCascade(i), 256), ContainsSlice(cascades.GetCascade(i)) ? "" : " (slice cut)",
+                ShadowCascades::ComputeCoverage(fixed, 256), ContainsSlice(fixed) ? "" : " (slice cut)", cascades.GetCascade(i).texelSize);
+        }
+
+        settings.stabilize = false;
+        ShadowCascades tight;
+        tight.Build(settings, view, LightDirection(), sceneMin, sceneMax);
+        printf("shadow cascades without stabilization: coverage %.3f, %.3f, %.3f, %.3f\n",
+            ShadowCascades::ComputeCoverage(tight.GetCascade(0), 256), ShadowCascades::ComputeCoverage(tight.GetCascade(1), 256),
+            ShadowCascades::ComputeCoverage(tight.GetCascade(2), 256), ShadowCascades::ComputeCoverage(tight.GetCascade(3), 256));
+
+        // stabilized cascades must keep the texel size while the camera turns and the texel grid while it moves
+        settings.stabilize = true;
+        uint32_t sizeChanges = 0;
+        uint32_t gridMisses = 0;
+        ShadowCascades moved;
+        for (uint32_t n = 1; n <= 100; ++n) {
+            ShadowCascades::View movedView = MakeView({ 0.37f * n, 30.0f + 0.05f * n, 50.0f - 0.21f * n }, -1.2f + 0.013f * n, 0.3f);
+            moved.Build(settings, movedView, LightDirection(), sceneMin, sceneMax);
+            for (uint32_t i = 0; i < moved.GetCascadeCount(); ++i) {
+                const ShadowCascades::Cascade& a = cascades.GetCascade(i);
+                const ShadowCascades::Cascade& b = moved.GetCascade(i);
+                sizeChanges += b.texelSize != a.texelSize ? 1 : 0;
+                gridMisses += Fraction(b.min.x / a.texelSize) > 0.01f || Fraction(b.min.y / a.texelSize) > 0.01f ? 1 : 0;
+            }
+        }
+        printf("stable shadow cascades check: %u texel size changes, %u boxes off the texel grid in 100 camera moves\n", sizeChanges,
+            gridMisses);
+        ReportFailures("stable shadow cascades", sizeChanges + gridMisses);
+
+        // with the snap step of the cached shadow maps of Lab6 the boxes move rarely, every move scrolls a cached map
+        for (uint32_t snap = 1; snap <= 64; snap *= 64) {
+            settings.snapTexels = snap;
+            ShadowCascades previous;
+            previous.Build(settings, view, LightDirection(), sceneMin, sceneMax);
+            uint32_t boxMoves = 0;
+            for (uint32_t n = 1; n <= 100; ++n) {
+                ShadowCascades::View movedView = MakeView({ 0.37f * n, 30.0f + 0.05f * n, 50.0f - 0.21f * n }, -1.2f + 0.013f * n, 0.3f);
+                moved.Build(settings, movedView, LightDirection(), sceneMin, sceneMax);
+                for (uint32_t i = 0; i < moved.GetCascadeCount(); ++i) {
+                    boxMoves += moved.GetCascade(i).min.x != previous.GetCascade(i).min.x
+                        || moved.GetCascade(i).min.y != previous.GetCascade(i).min.y ? 1 : 0;
+                }
+                previous = moved;
+            }
+            printf("shadow cascades snapped to %u texels: %u box moves of %u in 100 camera moves\n", snap, boxMoves,
+                100 * moved.GetCascadeCount());
+        }
+    }
+}
+
+std::vector<BenchmarkResult> RunShadowCascadesBenchmark() {
+    CheckCascades();
+
+    std::vector<BenchmarkResult> results;
+    ShadowCascades::Settings settings;
+    ShadowCascades cascades;
+    results.push_back(RunBenchmark("shadow cascades/fit 4 cascades", 4096, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            ShadowCascades::View view = MakeView({ 0.01f * (i % 100), 30.0f, 50.0f }, -1.2f + 0.001f * (i % 100), 0.3f);
+            cascades.Build(settings, view, LightDirection(), sceneMin, sceneMax);
+            sum += (uint64_t)cascades.GetCascade(3).max.x;
+        }
+        return sum;
+    }));
+    results.push_back(RunBenchmark("shadow cascades/coverage 64x64 samples", 1024, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += (uint64_t)(ShadowCascades::ComputeCoverage(cascades.GetCascade(i % 4)) * 1000.0f);
+        }
+        return sum;
+    }));
+    return results;
+}
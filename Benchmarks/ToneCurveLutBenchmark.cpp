@@ -0,0 +1,112 @@
+#include "Benchmark.h"
+
+#include "../Lab6/ToneCurveLut.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+
+// Tone LUT of Lab6. Before the measurements the analytic reference is compared with the curve of the former tone mapping
+// shader, and the trilinear samples of the baked table are compared with the reference for random exposed colors over
+// the range of the table, without and with grading; the errors are given in the steps of an 8 bit target.
+namespace {
+    // the former tonemapPS.hlsl: Uncharted2Tonemap(E * color) * (1 / Uncharted2Tonemap(W))
+    float FormerTonemap(float x) {
+        const float A = 0.1f, B = 0.50f, C = 0.1f, D = 0.20f, E = 0.02f, F = 0.30f, W = 11.2f;
+        auto curve = [&](float v) {
+            return ((v * (A * v + C * B) + D * E) / (v * (A * v + B) + D * F)) - E / F;
+        };
+        return curve(x) * (1.0f / curve(W));
+    }
+
+    ToneCurveLut::Color RandomColor(std::mt19937& random) {
+        std::uniform_real_distribution<float> stops((float)ToneCurveLut::minLog2, (float)ToneCurveLut::maxLog2);
+        ToneCurveLut::Color color;
+        color.r = std::exp2(stops(random));
+        color.g = std::exp2(stops(random));
+        color.b = std::exp2(stops(random));
+        return color;
+    }
+
+    void CheckTable(const char* name, const ToneCurveLut::Settings& settings) {
+        std::vector<float> texels;
+        ToneCurveLut::Bake(settings, texels);
+        std::mt19937 random(9);
+        double maxError = 0.0;
+        double sumError = 0.0;
+        const uint32_t samples = 200000;
+        for (uint32_t n = 0; n < samples; ++n) {
+            ToneCurveLut::Color color = RandomColor(random);
+            ToneCurveLut::Color reference = ToneCurveLut::Evaluate(settings, color);
+            ToneCurveLut::Color sample = ToneCurveLut::Sample(texels, color);
+            // the target clamps to [0, 1]
+            double error = (std::max)((std::max)(
+                std::abs((std::min)(reference.r, 1.0f) - (std::min)(sample.r, 1.0f)),
+                std::abs((std::min)(reference.g, 1.0f) - (std::min)(sample.g, 1.0f))),
+                std::abs((std::min)(reference.b, 1.0f) - (std::min)(sample.b, 1.0f)));
+            maxError = (std::max)(maxError, error);
+            sumError += error;
+        }
+        printf("tone LUT check, %s: max error %.3f, mean error %.4f of 1/255 over 2^%d..2^%d\n", name, maxError * 255.0,
+            sumError / samples * 255.0, ToneCurveLut::minLog2, ToneCurveLut::maxLog2);
+        // the table must not differ from the curve by a step of the 8-bit target
+        ReportFailures("tone LUT table", maxError * 255.0 > 1.0 ? 1 : 0);
+    }
+
+    void CheckLut() {
+        ToneCurveLut::Settings settings;
+        uint32_t mismatches = 0;
+        for (uint32_t i = 0; i <= 1000; ++i) {
+            float x = std::exp2((float)ToneCurveLut::minLog2 + (ToneCurveLut::maxLog2 - ToneCurveLut::minLog2) * i / 1000.0f);
+            ToneCurveLut::Color color;
+            color.r = color.g = color.b = x;
+            mismatches += std::abs(ToneCurveLut::Evaluate(settings, color).g - FormerTonemap(x)) > 1e-6f ? 1 : 0;
+        }
+        printf("tone LUT reference check: %u of 1001 values differ from the former shader curve\n", mismatches);
+        ReportFailures("tone LUT reference", mismatches);
+
+        CheckTable("curve only", settings);
+        settings.whitePoint = 6.0f;
+        settings.saturation = 1.3f;
+        settings.colorFilter = { 1.0f, 0.9f, 0.75f };
+        CheckTable("warm grading", settings);
+    }
+}
+
+std::vector<BenchmarkResult> RunToneCurveLutBenchmark() {
+    CheckLut();
+
+    std::vector<BenchmarkResult> results;
+    ToneCurveLut::Settings settings;
+    std::vector<float> texels;
+    results.push_back(RunBenchmark("tone LUT/bake 32x32x32", 16, [&](uint64_t n) {
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < n; ++i) {
+            settings.saturation = 1.0f + (float)(i % 4) * 0.1f;
+            ToneCurveLut::Bake(settings, texels);
+            sum += (uint64_t)(texels[i % texels.size()] * 1000.0f);
+        }
+        return sum;
+    }));
+    std::mt19937 random(1);
+    std::vector<ToneCurveLut::Color> colors(4096);
+    for (auto& c : colors) {
+        c = RandomColor(random);
+    }
+    results.push_back(RunBenchmark("tone LUT/analytic curve per pixel", 1 << 20, [&](uint64_t n) {
+        float sum = 0.0f;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += ToneCurveLut::Evaluate(settings, colors[i % colors.size()]).g;
+        }
+        return (uint64_t)sum;
+    }));
+    results.push_back(RunBenchmark("tone LUT/trilinear sample per pixel", 1 << 20, [&](uint64_t n) {
+        float sum = 0.0f;
+        for (uint64_t i = 0; i < n; ++i) {
+            sum += ToneCurveLut::Sample(texels, colors[i % colors.size()]).g;
+        }
+        return (uint64_t)sum;
+    }));
+    return results;
+}
@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+// The benchmarks do not depend on D3D, outside of Visual Studio they are built from this directory with
+//     g++ -O2 -std=c++14 -pthread *.cpp -o benchmarks
+// Usage:
+//     benchmarks [--filter text] [--data directory] [--json results.json]
+//     benchmarks --compare before.json after.json [--threshold percent]
+// --filter runs only the groups whose name contains the text, --data sets the directory of the lab data (../Lab6),
+// --json writes the results for a later --compare, which exits with 1 if a case got slower than the threshold (5%).
+// A run exits with 1 if one of the checks that precede the measurements failed.
+namespace {
+    struct Group {
+        const char* name;
+        std::vector<BenchmarkResult>(*run)();
+    };
+
+    const Group groups[] = {
+        { "include cache", RunIncludeCacheBenchmark },
+        { "handle traversal", RunHandleTraversalBenchmark },
+        { "ring allocator", RunRingAllocatorBenchmark },
+        { "light binning", RunLightBinningBenchmark },
+        { "shadow cascades", RunShadowCascadesBenchmark },
+        { "shadow atlas", RunShadowAtlasBenchmark },
+        { "readback ring", RunReadbackRingBenchmark },
+        { "exposure histogram", RunExposureHistogramBenchmark },
+        { "tone curve lut", RunToneCurveLutBenchmark },
+        { "frame graph", RunFrameGraphBenchmark },
+        { "command recorder", RunCommandRecorderBenchmark },
+        { "cpu profiler", RunCpuProfilerBenchmark },
+        { "asset loading", RunAssetLoadingBenchmark },
+        { "ibl bake", RunIblBakeBenchmark },
+        { "scene traversal", RunSceneTraversalBenchmark },
+    };
+
+    int Compare(const char* beforeFile, const char* afterFile, double thresholdPercent) {
+        std::vector<BenchmarkResult> before, after;
+        if (!ReadResults(beforeFile, before)) {
+            fprintf(stderr, "cannot read the results from %s\n", beforeFile);
+            return 2;
+        }
+        if (!ReadResults(afterFile, after)) {
+            fprintf(stderr, "cannot read the results from %s\n", afterFile);
+            return 2;
+        }
+        return CompareResults(before, after, thresholdPercent) == 0 ? 0 : 1;
+    }
+
+    int Usage() {
+        fprintf(stderr, "usage: benchmarks [--filter text] [--data directory] [--json results.json]\n"
+            "       benchmarks --compare before.json after.json [--threshold percent]\n");
+        return 2;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* filter = nullptr;
+    const char* jsonFile = nullptr;
+    const char* compareFiles[2] = { nullptr, nullptr };
+    double thresholdPercent = 5.0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--data") == 0 && i + 1 < argc) {
+            SetDataDirectory(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+            compareFiles[0] = argv[++i];
+            compareFiles[1] = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            thresholdPercent = atof(argv[++i]);
+        }
+        else {
+            return Usage();
+        }
+    }
+    if (!!compareFiles[0]) {
+        return Compare(compareFiles[0], compareFiles[1], thresholdPercent);
+    }
+
+    std::vector<BenchmarkResult> results;
+    for (const Group& group : groups) {
+        if (!!filter && !strstr(group.name, filter)) {
+            continue;
+        }
+        std::vector<BenchmarkResult> groupResults = group.run();
+        results.insert(results.end(), groupResults.begin(), groupResults.end());
+    }
+    for (auto& r : results) {
+        PrintResult(r);
+    }
+    if (!!jsonFile && !WriteResults(jsonFile, results)) {
+        fprintf(stderr, "cannot write the results to %s\n", jsonFile);
+        return 2;
+    }
+    if (GetFailureCount() > 0) {
+        printf("%u check failures\n", GetFailureCount());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+
+// Frame bookkeeping of GPU to CPU readbacks through a ring of staging resources. Every frame the data is copied into
+// the next slot, and a slot is read only when it is at least GetLatency() frames old, by then the GPU has normally
+// finished the copy, so the map does not have to wait. A slot whose map would still wait stays in flight and is tried
+// again in the next frame; when all slots are in flight the oldest one is overwritten and its value is lost.
+// Does not own the resources and does not depend on D3D.
+class ReadbackRing {
+public:
+    static const uint32_t maxSlots = 8;
+    static const uint32_t invalidSlot = 0xFFFFFFFF;
+
+    struct Statistics {
+        uint64_t writes = 0;
+        uint64_t reads = 0;
+        uint64_t misses = 0; // maps that would have waited for the GPU
+        uint64_t drops = 0; // slots overwritten before they were read
+        uint32_t lastLatency = 0; // frames between the copy and the read of the last value
+    };
+
+    explicit ReadbackRing(uint32_t slotCount = 3) {
+        Reset(slotCount);
+    };
+
+    void Reset(uint32_t slotCount) {
+        slotCount_ = (std::min)((std::max)(slotCount, 1u), maxSlots);
+        next_ = 0;
+        frame_ = 0;
+        statistics_ = Statistics();
+        Discard();
+    };
+
+    // forgets the slots in flight, for example when they measure something that is no longer shown
+    void Discard() {
+        for (auto& slot : slots_) {
+            slot.inFlight = false;
+        }
+    };
+
+    // the oldest slot in flight that is old enough to be read in the current frame, or invalidSlot
+    uint32_t GetReadableSlot() const {
+        uint32_t oldest = invalidSlot;
+        for (uint32_t i = 0; i < slotCount_; ++i) {
+            if (slots_[i].inFlight && (oldest == invalidSlot || slots_[i].frame < slots_[oldest].frame)) {
+                oldest = i;
+            }
+        }
+        if (oldest == invalidSlot || frame_ - slots_[oldest].frame < GetLatency()) {
+            return invalidSlot;
+        }
+        return oldest;
+    };
+
+    // the value of the slot has been read, the slot is free again
+    void OnRead(uint32_t slot) {
+        if (slot >= slotCount_ || !slots_[slot].inFlight) {
+            return;
+        }
+        slots_[slot].inFlight = false;
+        statistics_.lastLatency = (uint32_t)(frame_ - slots_[slot].frame);
+        ++statistics_.reads;
+    };
+
+    // the map of the readable slot would have waited, it is tried again in the next frame
+    void OnMiss() {
+        ++statistics_.misses;
+    };
+
+    // the slot for the copy of the current frame; the frame ends with this call
+    uint32_t Write() {
+        uint32_t slot = next_;
+        if (slots_[slot].inFlight) {
+            ++statistics_.drops;
+        }
+        slots_[slot].inFlight = true;
+        slots_[slot].frame = frame_;
+        next_ = (next_ + 1) % slotCount_;
+        ++frame_;
+        ++statistics_.writes;
+        return slot;
+    };
+
+    uint32_t GetSlotCount() const {
+        return slotCount_;
+    };
+
+    // frames between the copy into a slot and its read when the GPU keeps up
+    uint32_t GetLatency() const {
+        return slotCount_ - 1;
+    };
+
+    uint64_t GetFrame() const {
+        return frame_;
+    };
+
+    const Statistics& GetStatistics() const {
+        return statistics_;
+    };
+
+    ~ReadbackRing() = default;
+
+private:
+    struct Slot {
+        uint64_t frame = 0;
+        bool inFlight = false;
+    };
+
+    Slot slots_[maxSlots]; // always remains only inside the class #
+    uint32_t slotCount_ = 1; // always remains only inside the class #
+    uint32_t next_ = 0; // always remains only inside the class #
+    uint64_t frame_ = 0; // always remains only inside the class #
+    Statistics statistics_; // always remains only inside the class #
+};
@@ -15,7 +15,8 @@ ToneMapping::ToneMapping()
 	m_downsamplePS = nullptr;
 	m_toneMapPS = nullptr;
 	m_adaptBuffer = nullptr;
-	m_readAvgTexture = nullptr;
+	for (UINT i = 0; i < READBACK_SLOTS; i++)
+		m_readAvgTextures[i] = nullptr;
 }
 
 ToneMapping::~ToneMapping()
@@ -50,7 +51,8 @@ void ToneMapping::CleanUpTexutes()
 		SAFE_RELEASE(scaledFrame.max.RTV);
 		SAFE_RELEASE(scaledFrame.max.texture);
 	}
-	SAFE_RELEASE(m_readAvgTexture);
+	for (UINT i = 0; i < READBACK_SLOTS; i++)
+		SAFE_RELEASE(m_readAvgTextures[i]);
 
 	m_scaledFrames.clear();
 	n = 0;
@@ -259,7 +261,9 @@ HRESULT ToneMapping::CreateTextures(ID3D11Device* device, int textureWidth, int
 		textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 		textureDesc.MiscFlags = 0;
 
-		result = device->CreateTexture2D(&textureDesc, NULL, &m_readAvgTexture);
+		for (UINT i = 0; i < READBACK_SLOTS && SUCCEEDED(result); i++)
+			result = device->CreateTexture2D(&textureDesc, NULL, &m_readAvgTextures[i]);
+		m_readback.Reset(READBACK_SLOTS);
 	}
 
 	return result;
@@ -371,19 +375,30 @@ void ToneMapping::RenderTonemap(ID3D11DeviceContext* deviceContext)
 	float dtime = std::chrono::duration<float, std::milli>(time - m_lastFrame).count() * 0.001;
 	m_lastFrame = time;
 
-	deviceContext->CopyResource(m_readAvgTexture, m_scaledFrames[0].avg.texture);
-	D3D11_MAPPED_SUBRESOURCE ResourceDesc = {};
-	HRESULT hr = deviceContext->Map(m_readAvgTexture, 0, D3D11_MAP_READ, 0, &ResourceDesc);
-
-	float avg;
-	if (ResourceDesc.pData)
+	// the copies of the previous frames that the GPU has finished are read without waiting
+	for (uint32_t slot = m_readback.GetReadableSlot(); slot != ReadbackRing::invalidSlot; slot = m_readback.GetReadableSlot())
 	{
-		float* pData = reinterpret_cast<float*>(ResourceDesc.pData);
-		avg = pData[0];
+		D3D11_MAPPED_SUBRESOURCE ResourceDesc = {};
+		HRESULT hr = deviceContext->Map(m_readAvgTextures[slot], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &ResourceDesc);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+		{
+			m_readback.OnMiss();
+			break;
+		}
+		if (FAILED(hr))
+			break;
+
+		if (ResourceDesc.pData)
+		{
+			float* pData = reinterpret_cast<float*>(ResourceDesc.pData);
+			measuredAvg = pData[0];
+		}
+		deviceContext->Unmap(m_readAvgTextures[slot], 0);
+		m_readback.OnRead(slot);
 	}
-	deviceContext->Unmap(m_readAvgTexture, 0);
+	deviceContext->CopyResource(m_readAvgTextures[m_readback.Write()], m_scaledFrames[0].avg.texture);
 
-	adapt += (avg - adapt) * (1.0f - exp(-dtime / s));
+	adapt += (measuredAvg - adapt) * (1.0f - exp(-dtime / s));
 
 	AdaptBuffer adaptBuffer;
 	adaptBuffer.adapt = XMFLOAT4(adapt, 0.0f, 0.0f, 0.0f);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "framework.h"
+#include "ReadbackRing.hpp"
 
 #include <vector>
 #include <chrono>
@@ -47,7 +48,10 @@ private:
 	ID3D11ShaderResourceView* m_frameSRV;
 	int n = 0;
 
-	ID3D11Texture2D* m_readAvgTexture;
+	// the average brightness is read back READBACK_SLOTS - 1 frames later, so the CPU does not wait for the GPU
+	static const UINT READBACK_SLOTS = 3;
+	ID3D11Texture2D* m_readAvgTextures[READBACK_SLOTS];
+	ReadbackRing m_readback;
 
 	ID3D11Buffer* m_adaptBuffer;
 
@@ -64,5 +68,6 @@ private:
 	std::chrono::time_point<std::chrono::steady_clock> m_lastFrame;
 
 	float adapt = 0.0f;
+	float measuredAvg = 0.0f;
 	float s = 0.5f;
 };
\ No newline at end of file
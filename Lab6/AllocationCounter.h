@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+
+namespace utilities {
+    // number of calls of the global operator new since the start of the program, counted over all threads
+    uint64_t GetHeapAllocationCount();
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+// counts the commands of a context, a bind of the object already bound to the slot is redundant
+class CommandRecorder {
+public:
+    enum class Command : uint8_t {
+        draw,
+        drawIndexed,
+        drawInstanced,
+        drawIndexedInstanced,
+        setShader,
+        setShaderResources,
+        setSamplers,
+        setConstantBuffers,
+        setVertexBuffers,
+        setIndexBuffer,
+        setInputLayout,
+        setTopology,
+        setRasterizerState,
+        setBlendState,
+        setDepthStencilState,
+        setRenderTargets,
+        setViewports,
+        setScissorRects,
+        clear,
+        upload, // UpdateSubresource
+        map,
+        copy,
+        generateMips,
+        query,
+        clearState,
+        count
+    };
+
+    enum class Stage : uint8_t {
+        none,
+        vertex,
+        pixel,
+        inputAssembler,
+        rasterizer,
+        outputMerger,
+        count
+    };
+
+    static const uint32_t maxSlots = 128; // shader resource views, the other kinds of slots are fewer
+
+    struct Statistics {
+        uint32_t commands = 0;
+        uint32_t draws = 0;
+        uint64_t instances = 0;
+        uint64_t vertices = 0; // vertices or indices of all instances
+        uint32_t binds = 0; // objects bound, one per slot
+        uint32_t stateChanges = 0; // binds of another object than the bound one
+        uint32_t redundantBinds = 0;
+        uint32_t uploads = 0; // UpdateSubresource and Map
+        uint64_t uploadBytes = 0;
+        uint32_t copies = 0;
+        uint32_t clears = 0;
+        uint32_t commandCounts[(size_t)Command::count] = {};
+    };
+
+    struct Entry {
+        Command command;
+        Stage stage;
+        uint8_t slot;
+        uint8_t count;
+        uint32_t value; // vertices of draws, bytes of uploads
+    };
+
+    // the statistics and the log are per frame, the bound objects stay as they are in the context
+    void BeginFrame() {
+        statistics_ = Statistics();
+        log_.clear();
+    };
+
+    void SetLogging(bool logging) {
+        logging_ = logging;
+    };
+
+    void RecordDraw(Command command, uint32_t vertexCount, uint32_t instanceCount) {
+        Record(command, Stage::none, 0, 1, vertexCount);
+        ++statistics_.draws;
+        statistics_.instances += instanceCount;
+        statistics_.vertices += (uint64_t)vertexCount * instanceCount;
+    };
+
+    // count objects from startSlot; offsets (in constants, for constant buffer ranges) may be null
+    void RecordBind(Command command, Stage stage, uint32_t startSlot, uint32_t count, const void* const* objects,
+        const uint32_t* offsets = nullptr) {
+        Record(command, stage, startSlot, count, 0);
+        uint32_t kind = (uint32_t)command * (uint32_t)Stage::count + (uint32_t)stage;
+        for (uint32_t i = 0; i < count; ++i) {
+            const void* object = objects ? objects[i] : nullptr;
+            uint32_t offset = offsets ? offsets[i] : 0;
+            ++statistics_.binds;
+            uint32_t slot = startSlot + i;
+            if (slot >= maxSlots) {
+                ++statistics_.stateChanges;
+                continue;
+            }
+            Bound& bound = bound_[kind][slot];
+            if (bound.generation == generation_ && bound.object == object && bound.offset == offset) {
+                ++statistics_.redundantBinds;
+            }
+            else {
+                ++statistics_.stateChanges;
+                bound.object = object;
+                bound.offset = offset;
+                bound.generation = generation_;
+            }
+        }
+    };
+
+    // single objects (states, shaders, the input layout) and values (the topology) bound to a stage
+    void RecordState(Command command, Stage stage, const void* object) {
+        RecordBind(command, stage, 0, 1, &object);
+    };
+
+    // values that are not compared with the bound ones (viewports, scissor rectangles), each is a state change
+    void RecordValues(Command command, Stage stage, uint32_t count) {
+        Record(command, stage, 0, count, 0);
+        statistics_.binds += count;
+        statistics_.stateChanges += count;
+    };
+
+    void RecordUpload(Command command, uint64_t bytes) {
+        Record(command, Stage::none, 0, 1, (uint32_t)(std::min)(bytes, (uint64_t)0xFFFFFFFF));
+        ++statistics_.uploads;
+        statistics_.uploadBytes += bytes;
+    };
+
+    void RecordCommand(Command command) {
+        Record(command, Stage::none, 0, 1, 0);
+        if (command == Command::copy) {
+            ++statistics_.copies;
+        }
+        else if (command == Command::clear) {
+            ++statistics_.clears;
+        }
+        else if (command == Command::clearState) {
+            ++generation_; // nothing is bound
+        }
+    };
+
+    const Statistics& GetStatistics() const {
+        return statistics_;
+    };
+
+    const std::vector<Entry>& GetLog() const {
+        return log_;
+    };
+
+    // FNV-1a of the log
+    uint64_t GetLogHash() const {
+        uint64_t hash = 14695981039346656037ull;
+        for (const Entry& entry : log_) {
+            uint8_t bytes[8] = { (uint8_t)entry.command, (uint8_t)entry.stage, entry.slot, entry.count };
+            std::memcpy(bytes + 4, &entry.value, sizeof(entry.value));
+            for (uint8_t b : bytes) {
+                hash = (hash ^ b) * 1099511628211ull;
+            }
+        }
+        return hash;
+    };
+
+private:
+    struct Bound {
+        const void* object = nullptr;
+        uint32_t offset = 0;
+        uint32_t generation = 0; // bound since the ClearState of this generation
+    };
+
+    void Record(Command command, Stage stage, uint32_t slot, uint32_t count, uint32_t value) {
+        ++statistics_.commands;
+        ++statistics_.commandCounts[(size_t)command];
+        if (logging_) {
+            Entry entry;
+            entry.command = command;
+            entry.stage = stage;
+            entry.slot = (uint8_t)(std::min)(slot, 255u);
+            entry.count = (uint8_t)(std::min)(count, 255u);
+            entry.value = value;
+            log_.push_back(entry);
+        }
+    };
+
+    Statistics statistics_;
+    std::vector<Entry> log_;
+    bool logging_ = false;
+    uint32_t generation_ = 1;
+    Bound bound_[(size_t)Command::count * (size_t)Stage::count][maxSlots];
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// hierarchical CPU profiler, a ring of events per thread, exported in the Chrome trace format
+class CpuProfiler {
+public:
+    static const uint32_t ringSize = 1 << 14;
+
+    struct Event {
+        const char* name = nullptr; // a string literal
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        uint32_t depth = 0;
+        uint32_t thread = 0; // in the order the threads recorded their first events
+    };
+
+    static CpuProfiler& Get() {
+        static CpuProfiler profiler;
+        return profiler;
+    };
+
+    void SetEnabled(bool enabled) {
+        enabled_.store(enabled, std::memory_order_relaxed);
+    };
+
+    bool IsEnabled() const {
+        return enabled_.load(std::memory_order_relaxed);
+    };
+
+    uint64_t Now() const {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count();
+    };
+
+    // the last frame lasts from the previous call to this one
+    void BeginFrame() {
+        uint64_t now = Now();
+        std::lock_guard<std::mutex> lock(mutex_);
+        lastFrameBegin_ = frameBegin_;
+        lastFrameEnd_ = now;
+        frameBegin_ = now;
+    };
+
+    void GetLastFrame(uint64_t& begin, uint64_t& end) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        begin = lastFrameBegin_;
+        end = lastFrameEnd_;
+    };
+
+    struct Ring {
+        std::mutex mutex;
+        std::vector<Event> events;
+        uint64_t written = 0;
+        uint32_t depth = 0; // only the thread of the ring uses it
+        uint32_t thread = 0;
+    };
+
+    // the ring of the current thread, the depth of the scope is taken from it
+    Ring& BeginScope(uint32_t& depth) {
+        Ring& ring = GetRing();
+        depth = ring.depth++;
+        return ring;
+    };
+
+    void EndScope(Ring& ring, const char* name, uint64_t begin, uint32_t depth) {
+        uint64_t end = Now();
+        ring.depth = depth;
+        std::lock_guard<std::mutex> lock(ring.mutex);
+        Event& event = ring.events[ring.written % ringSize];
+        event.name = name;
+        event.begin = begin;
+        event.end = end;
+        event.depth = depth;
+        event.thread = ring.thread;
+        ++ring.written;
+    };
+
+    // the events of all threads inside [begin, end), sorted by the beginning and the depth
+    void GetEvents(std::vector<Event>& events, uint64_t begin = 0, uint64_t end = UINT64_MAX) const {
+        events.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const std::unique_ptr<Ring>& ring : rings_) {
+            std::lock_guard<std::mutex> ringLock(ring->mutex);
+            uint64_t first = ring->written > ringSize ? ring->written - ringSize : 0;
+            for (uint64_t i = first; i < ring->written; ++i) {
+                const Event& event = ring->events[i % ringSize];
+                if (event.begin >= begin && event.end <= end) {
+                    events.push_back(event);
+                }
+            }
+        }
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+            return a.thread != b.thread ? a.thread < b.thread : a.begin != b.begin ? a.begin < b.begin : a.depth < b.depth;
+        });
+    };
+
+    // complete ("X") events of all the rings, in microseconds
+    bool WriteChromeTrace(const std::string& fileName) const {
+        std::vector<Event> events;
+        GetEvents(events);
+        std::ofstream file(fileName);
+        if (!file) {
+            return false;
+        }
+        file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); ++i) {
+            const Event& event = events[i];
+            file << (i == 0 ? "" : ",") << "\n{\"name\":\"";
+            for (const char* c = event.name; *c; ++c) {
+                if (*c == '"' || *c == '\\') {
+                    file << '\\';
+                }
+                file << *c;
+            }
+            file << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.begin / 1000.0
+                << ",\"dur\":" << (event.end - event.begin) / 1000.0 << "}";
+        }
+        file << "\n],\"displayTimeUnit\":\"ns\"}\n";
+        file.close();
+        return !file.fail();
+    };
+
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+private:
+    CpuProfiler() : start_(std::chrono::steady_clock::now()) {};
+
+    // the rings live as long as the profiler, so the cached pointer of a thread that ended is never used again
+    Ring& GetRing() {
+        thread_local Ring* cachedRing = nullptr;
+        if (!!cachedRing) {
+            return *cachedRing;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        rings_.emplace_back(new Ring());
+        cachedRing = rings_.back().get();
+        cachedRing->events.resize(ringSize);
+        cachedRing->thread = (uint32_t)rings_.size() - 1;
+        return *cachedRing;
+    };
+
+    std::atomic<bool> enabled_{ false };
+    std::chrono::steady_clock::time_point start_;
+    mutable std::mutex mutex_; // of the list of rings and of the frame
+    std::vector<std::unique_ptr<Ring>> rings_;
+    uint64_t frameBegin_ = 0;
+    uint64_t lastFrameBegin_ = 0;
+    uint64_t lastFrameEnd_ = 0;
+};
+
+
+class CpuProfileScope {
+public:
+    explicit CpuProfileScope(const char* name) {
+        CpuProfiler& profiler = CpuProfiler::Get();
+        if (profiler.IsEnabled()) {
+            name_ = name;
+            ring_ = &profiler.BeginScope(depth_);
+            begin_ = profiler.Now();
+        }
+    };
+
+    ~CpuProfileScope() {
+        if (!!ring_) {
+            CpuProfiler::Get().EndScope(*ring_, name_, begin_, depth_);
+        }
+    };
+
+    CpuProfileScope(const CpuProfileScope&) = delete;
+    CpuProfileScope& operator=(const CpuProfileScope&) = delete;
+
+private:
+    CpuProfiler::Ring* ring_ = nullptr; // null if the profiler was disabled when the scope began
+    const char* name_ = nullptr;
+    uint64_t begin_ = 0;
+    uint32_t depth_ = 0;
+};
+
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+// times the rest of the enclosing block, name must be a string literal
+#define CPU_PROFILE_SCOPE(name) CpuProfileScope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(name)
@@ -238,6 +238,7 @@ HRESULT CubemapGenerator::CreateBuffers() {
 }
 
 HRESULT CubemapGenerator::GenerateEnvironmentMap(const std::string& hdrname, std::shared_ptr<ID3D11ShaderResourceView>& environmentMap) {
+    CPU_PROFILE_SCOPE("CubemapGenerator::GenerateEnvironmentMap");
     if (!IsInit()) {
         return E_FAIL;
     }
@@ -311,6 +312,7 @@ HRESULT CubemapGenerator::CreateCubemapSubRTV(ID3D11Texture2D* texture, Sides si
 }
 
 HRESULT CubemapGenerator::GenerateIrradianceMap(std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap) {
+    CPU_PROFILE_SCOPE("CubemapGenerator::GenerateIrradianceMap");
     if (!IsInit()) {
         return E_FAIL;
     }
@@ -332,6 +334,7 @@ HRESULT CubemapGenerator::GenerateIrradianceMap(std::shared_ptr<ID3D11ShaderReso
 }
 
 HRESULT CubemapGenerator::GeneratePrefilteredMap(std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap) {
+    CPU_PROFILE_SCOPE("CubemapGenerator::GeneratePrefilteredMap");
     if (!IsInit()) {
         return E_FAIL;
     }
@@ -357,6 +360,7 @@ HRESULT CubemapGenerator::GeneratePrefilteredMap(std::shared_ptr<ID3D11ShaderRes
 }
 
 HRESULT CubemapGenerator::GenerateBRDF(std::shared_ptr<ID3D11ShaderResourceView>& BRDF) {
+    CPU_PROFILE_SCOPE("CubemapGenerator::GenerateBRDF");
     if (!IsInit()) {
         return E_FAIL;
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ManagerStorage.hpp"
+#include "CpuProfiler.hpp"
 
 
 class CubemapGenerator {
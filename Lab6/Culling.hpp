@@ -0,0 +1,191 @@
+#pragma once
+
+#ifdef _WIN32
+#include <directxmath.h>
+#else
+#include "DirectXMathPortable.hpp" // for the benchmarks outside of Windows
+#endif
+#include <vector>
+#include <cfloat>
+#include <cstdint>
+#include <algorithm>
+
+
+struct AABB {
+    DirectX::XMFLOAT3 min = { FLT_MAX, FLT_MAX, FLT_MAX };
+    DirectX::XMFLOAT3 max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    bool IsEmpty() const {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    };
+
+    void Extend(const DirectX::XMFLOAT3& point) {
+        min = { (std::min)(min.x, point.x), (std::min)(min.y, point.y), (std::min)(min.z, point.z) };
+        max = { (std::max)(max.x, point.x), (std::max)(max.y, point.y), (std::max)(max.z, point.z) };
+    };
+
+    // box that encloses the transformed box (row vectors, as everywhere with DirectXMath)
+    AABB Transform(const DirectX::XMMATRIX& transformation) const {
+        using namespace DirectX;
+        XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&min), XMLoadFloat3(&max)), 0.5f);
+        XMVECTOR extents = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&max), XMLoadFloat3(&min)), 0.5f);
+        XMVECTOR newCenter = XMVector3TransformCoord(center, transformation);
+        XMVECTOR newExtents = XMVectorMultiply(XMVectorSplatX(extents), XMVectorAbs(transformation.r[0]));
+        newExtents = XMVectorMultiplyAdd(XMVectorSplatY(extents), XMVectorAbs(transformation.r[1]), newExtents);
+        newExtents = XMVectorMultiplyAdd(XMVectorSplatZ(extents), XMVectorAbs(transformation.r[2]), newExtents);
+
+        AABB result;
+        XMStoreFloat3(&result.min, XMVectorSubtract(newCenter, newExtents));
+        XMStoreFloat3(&result.max, XMVectorAdd(newCenter, newExtents));
+        return result;
+    };
+};
+
+
+// Planes are stored as (a, b, c, d), a point p is inside if a * p.x + b * p.y + c * p.z + d >= 0.
+struct Frustum {
+    static const uint32_t maxPlaneCount = 8;
+
+    DirectX::XMFLOAT4 planes[maxPlaneCount];
+    uint32_t planeCount = 0;
+
+    // extracts the clip planes from a view-projection matrix with D3D depth range (also valid for reversed depth),
+    // without the z >= 0 plane the volume is unbounded on that side (towards the light for a shadow projection)
+    static Frustum FromMatrix(const DirectX::XMMATRIX& viewProjection, bool withNearPlane = true) {
+        using namespace DirectX;
+        XMMATRIX m = XMMatrixTranspose(viewProjection);
+        Frustum frustum;
+        frustum.AddPlane(XMVectorAdd(m.r[3], m.r[0])); // left
+        frustum.AddPlane(XMVectorSubtract(m.r[3], m.r[0])); // right
+        frustum.AddPlane(XMVectorAdd(m.r[3], m.r[1])); // bottom
+        frustum.AddPlane(XMVectorSubtract(m.r[3], m.r[1])); // top
+        frustum.AddPlane(XMVectorSubtract(m.r[3], m.r[2])); // z <= w
+        if (withNearPlane) {
+            frustum.AddPlane(m.r[2]); // z >= 0
+        }
+        return frustum;
+    };
+
+    void AddPlane(DirectX::FXMVECTOR plane) {
+        if (planeCount < maxPlaneCount) {
+            DirectX::XMStoreFloat4(&planes[planeCount++], DirectX::XMPlaneNormalize(plane));
+        }
+    };
+
+    // the planes are normalized, so the sphere is outside if its center is farther than the radius behind any of them
+    bool IntersectsSphere(const DirectX::XMFLOAT3& center, float radius) const {
+        for (uint32_t i = 0; i < planeCount; ++i) {
+            const DirectX::XMFLOAT4& p = planes[i];
+            if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    };
+};
+
+
+// World space boxes stored as centers and extents in separate arrays, so that four boxes are tested at once.
+// Depends only on DirectXMath.
+class BoundsList {
+public:
+    BoundsList() = default;
+
+    void Clear() {
+        count_ = 0;
+        for (auto& a : data_) {
+            a.clear();
+        }
+    };
+
+    uint32_t Add(const AABB& box) {
+        if (count_ % 4 == 0) {
+            for (auto& a : data_) {
+                a.resize(count_ + 4, 0.0f);
+            }
+        }
+        data_[CENTER_X][count_] = (box.min.x + box.max.x) * 0.5f;
+        data_[CENTER_Y][count_] = (box.min.y + box.max.y) * 0.5f;
+        data_[CENTER_Z][count_] = (box.min.z + box.max.z) * 0.5f;
+        data_[EXTENT_X][count_] = (box.max.x - box.min.x) * 0.5f;
+        data_[EXTENT_Y][count_] = (box.max.y - box.min.y) * 0.5f;
+        data_[EXTENT_Z][count_] = (box.max.z - box.min.z) * 0.5f;
+        return count_++;
+    };
+
+    AABB Get(uint32_t index) const {
+        AABB box;
+        box.min = { data_[CENTER_X][index] - data_[EXTENT_X][index], data_[CENTER_Y][index] - data_[EXTENT_Y][index],
+            data_[CENTER_Z][index] - data_[EXTENT_Z][index] };
+        box.max = { data_[CENTER_X][index] + data_[EXTENT_X][index], data_[CENTER_Y][index] + data_[EXTENT_Y][index],
+            data_[CENTER_Z][index] + data_[EXTENT_Z][index] };
+        return box;
+    };
+
+    uint32_t Size() const {
+        return count_;
+    };
+
+    // visible[i] = 1 if the box i intersects or lies inside all planes, returns the number of visible boxes
+    uint32_t Cull(const Frustum& frustum, std::vector<uint8_t>& visible) const {
+        using namespace DirectX;
+        XMVECTOR planes[Frustum::maxPlaneCount][4];
+        XMVECTOR absPlanes[Frustum::maxPlaneCount][3];
+        for (uint32_t p = 0; p < frustum.planeCount; ++p) {
+            planes[p][0] = XMVectorReplicate(frustum.planes[p].x);
+            planes[p][1] = XMVectorReplicate(frustum.planes[p].y);
+            planes[p][2] = XMVectorReplicate(frustum.planes[p].z);
+            planes[p][3] = XMVectorReplicate(frustum.planes[p].w);
+            absPlanes[p][0] = XMVectorAbs(planes[p][0]);
+            absPlanes[p][1] = XMVectorAbs(planes[p][1]);
+            absPlanes[p][2] = XMVectorAbs(planes[p][2]);
+        }
+
+        visible.resize(count_);
+        uint32_t visibleCount = 0;
+        for (uint32_t i = 0; i < count_; i += 4) {
+            XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data_[CENTER_X][i]));
+            XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data_[CENTER_Y][i]));
+            XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data_[CENTER_Z][i]));
+            XMVECTOR ex = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data_[EXTENT_X][i]));
+            XMVECTOR ey = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data_[EXTENT_Y][i]));
+            XMVECTOR ez = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&data_[EXTENT_Z][i]));
+
+            XMVECTOR inside = XMVectorTrueInt();
+            for (uint32_t p = 0; p < frustum.planeCount; ++p) {
+                XMVECTOR distance = XMVectorMultiplyAdd(cx, planes[p][0], planes[p][3]);
+                distance = XMVectorMultiplyAdd(cy, planes[p][1], distance);
+                distance = XMVectorMultiplyAdd(cz, planes[p][2], distance);
+                XMVECTOR radius = XMVectorMultiply(ex, absPlanes[p][0]);
+                radius = XMVectorMultiplyAdd(ey, absPlanes[p][1], radius);
+                radius = XMVectorMultiplyAdd(ez, absPlanes[p][2], radius);
+                inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorAdd(distance, radius), XMVectorZero()));
+            }
+
+            XMUINT4 mask;
+            XMStoreUInt4(&mask, inside);
+            const uint32_t lanes[4] = { mask.x, mask.y, mask.z, mask.w };
+            for (uint32_t j = 0; j < 4 && i + j < count_; ++j) {
+                visible[i + j] = lanes[j] != 0 ? 1 : 0;
+                visibleCount += visible[i + j];
+            }
+        }
+        return visibleCount;
+    };
+
+    ~BoundsList() = default;
+
+private:
+    enum {
+        CENTER_X,
+        CENTER_Y,
+        CENTER_Z,
+        EXTENT_X,
+        EXTENT_Y,
+        EXTENT_Z,
+        COMPONENT_COUNT
+    };
+
+    std::vector<float> data_[COMPONENT_COUNT]; // always remains only inside the class #
+    uint32_t count_ = 0; // always remains only inside the class #
+};
@@ -1,34 +1,43 @@
 #pragma once
 
 #include "framework.h"
-#include <fstream>
+#include "IncludeCache.hpp"
+#include <algorithm>
 
 
 class D3DInclude : public ID3DInclude {
 public:
+    D3DInclude(const std::shared_ptr<IncludeCache>& cache) : cache_(cache) {};
+
     HRESULT __stdcall Open(D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes) {
-        FILE* pFile = nullptr;
-        fopen_s(&pFile, pFileName, "rb");
-        if (pFile == nullptr) {
+        const char* data = nullptr;
+        size_t size = 0;
+        if (!cache_->Get(pFileName, data, size)) {
             return E_FAIL;
         }
 
-        fseek(pFile, 0, SEEK_END);
-        long size = ftell(pFile);
-        fseek(pFile, 0, SEEK_SET);
-
-        char* buffer = new char[size];
-        fread(buffer, 1, size, pFile);
-        fclose(pFile);
+        if (std::find(dependencies_.begin(), dependencies_.end(), pFileName) == dependencies_.end()) {
+            dependencies_.push_back(pFileName);
+        }
 
-        *ppData = buffer;
-        *pBytes = size;
+        *ppData = data;
+        *pBytes = (UINT)size;
 
         return S_OK;
     };
 
     HRESULT __stdcall Close(LPCVOID pData) {
-        free(const_cast<void*>(pData));
+        // the data belongs to the cache
         return S_OK;
     };
+
+    const std::vector<std::string>& GetDependencies() const {
+        return dependencies_;
+    };
+
+    ~D3DInclude() = default;
+
+private:
+    std::shared_ptr<IncludeCache> cache_; // provided externally <-
+    std::vector<std::string> dependencies_; // transmitted outward ->
 };
@@ -2,6 +2,7 @@
 
 #include "framework.h"
 #include "Utilities.hpp"
+#include "RenderContext.hpp"
 #include <memory>
 
 
@@ -9,7 +10,8 @@ class Device {
 public:
     Device() = default;
 
-    HRESULT Init(const std::shared_ptr<IDXGIAdapter>& adapter) {
+    // with recordCommands the commands of the context are counted, see RenderContext::GetRecorder
+    HRESULT Init(const std::shared_ptr<IDXGIAdapter>& adapter, bool recordCommands = false) {
         D3D_FEATURE_LEVEL level;
         ID3D11Device* device;
         ID3D11DeviceContext* deviceContext;
@@ -37,6 +39,36 @@ public:
         }
         device_ = std::shared_ptr<ID3D11Device>(device, utilities::DXRelPtrDeleter<ID3D11Device*>);
         deviceContext_ = std::shared_ptr<ID3D11DeviceContext>(deviceContext, utilities::DXPtrDeleter<ID3D11DeviceContext*>);
+        renderContext_ = std::make_shared<D3D11RenderContext>(deviceContext_);
+        if (recordCommands) {
+            renderContext_ = std::make_shared<RecordingRenderContext>(renderContext_);
+        }
+        return S_OK;
+    };
+
+    // A device without a GPU: the resources are created by the null driver (the reference one when there is no null
+    // driver), and the context only records the commands. The frames are rendered as usual but only the CPU work is
+    // done, so it can be measured and the commands of the frame counted.
+    HRESULT InitHeadless() {
+        D3D_FEATURE_LEVEL level = D3D_FEATURE_LEVEL_11_0;
+        ID3D11Device* device = nullptr;
+        ID3D11DeviceContext* deviceContext = nullptr;
+        D3D_FEATURE_LEVEL levels[] = { D3D_FEATURE_LEVEL_11_0 };
+        HRESULT result = E_FAIL;
+        for (D3D_DRIVER_TYPE driverType : { D3D_DRIVER_TYPE_NULL, D3D_DRIVER_TYPE_WARP }) {
+            result = D3D11CreateDevice(nullptr, driverType, NULL, 0, levels, 1, D3D11_SDK_VERSION, &device, &level, &deviceContext);
+            if (SUCCEEDED(result)) {
+                break;
+            }
+        }
+        if (D3D_FEATURE_LEVEL_11_0 != level || FAILED(result)) {
+            SAFE_RELEASE(device);
+            SAFE_RELEASE(deviceContext);
+            return E_FAIL;
+        }
+        device_ = std::shared_ptr<ID3D11Device>(device, utilities::DXRelPtrDeleter<ID3D11Device*>);
+        deviceContext_ = std::shared_ptr<ID3D11DeviceContext>(deviceContext, utilities::DXPtrDeleter<ID3D11DeviceContext*>);
+        renderContext_ = std::make_shared<RecordingRenderContext>();
         return S_OK;
     };
 
@@ -48,11 +80,18 @@ public:
         return device_;
     };
 
-    std::shared_ptr<ID3D11DeviceContext> GetDeviceContext() const {
+    // all the rendering goes through this context
+    std::shared_ptr<RenderContext> GetDeviceContext() const {
+        return renderContext_;
+    };
+
+    // only for what needs the D3D context itself: ImGui, annotations, queries of interfaces
+    std::shared_ptr<ID3D11DeviceContext> GetD3DDeviceContext() const {
         return deviceContext_;
     };
 
     void Cleanup() {
+        renderContext_.reset();
         if (deviceContext_) {
             deviceContext_->ClearState();
             deviceContext_.reset();
@@ -80,4 +119,5 @@ public:
 private:
     std::shared_ptr<ID3D11Device> device_; // transmitted outward ->
     std::shared_ptr<ID3D11DeviceContext> deviceContext_; // transmitted outward ->
+    std::shared_ptr<RenderContext> renderContext_; // transmitted outward ->
 };
\ No newline at end of file
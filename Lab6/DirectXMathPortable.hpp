@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+
+// Scalar stand-in for the part of DirectXMath used by TransformHierarchy and Culling, so that the benchmarks can build
+// them outside of Windows. Same names, row vectors and results as DirectXMath, without SIMD.
+namespace DirectX {
+    struct XMVECTOR {
+        float f[4];
+    };
+
+    typedef const XMVECTOR& FXMVECTOR;
+
+    struct XMMATRIX {
+        XMVECTOR r[4];
+    };
+
+    struct XMFLOAT3 {
+        float x, y, z;
+
+        XMFLOAT3() = default;
+        XMFLOAT3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {};
+    };
+
+    struct XMFLOAT4 {
+        float x, y, z, w;
+
+        XMFLOAT4() = default;
+        XMFLOAT4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {};
+    };
+
+    struct XMUINT4 {
+        uint32_t x, y, z, w;
+    };
+
+    inline XMVECTOR XMVectorSet(float x, float y, float z, float w) {
+        return { { x, y, z, w } };
+    };
+
+    inline XMVECTOR XMVectorReplicate(float value) {
+        return { { value, value, value, value } };
+    };
+
+    inline XMVECTOR XMVectorZero() {
+        return XMVectorReplicate(0.0f);
+    };
+
+    inline XMVECTOR XMVectorSplatX(FXMVECTOR v) {
+        return XMVectorReplicate(v.f[0]);
+    };
+
+    inline XMVECTOR XMVectorSplatY(FXMVECTOR v) {
+        return XMVectorReplicate(v.f[1]);
+    };
+
+    inline XMVECTOR XMVectorSplatZ(FXMVECTOR v) {
+        return XMVectorReplicate(v.f[2]);
+    };
+
+    inline float XMVectorGetX(FXMVECTOR v) {
+        return v.f[0];
+    };
+
+    inline XMVECTOR XMVectorAdd(FXMVECTOR a, FXMVECTOR b) {
+        return { { a.f[0] + b.f[0], a.f[1] + b.f[1], a.f[2] + b.f[2], a.f[3] + b.f[3] } };
+    };
+
+    inline XMVECTOR XMVectorSubtract(FXMVECTOR a, FXMVECTOR b) {
+        return { { a.f[0] - b.f[0], a.f[1] - b.f[1], a.f[2] - b.f[2], a.f[3] - b.f[3] } };
+    };
+
+    inline XMVECTOR XMVectorMultiply(FXMVECTOR a, FXMVECTOR b) {
+        return { { a.f[0] * b.f[0], a.f[1] * b.f[1], a.f[2] * b.f[2], a.f[3] * b.f[3] } };
+    };
+
+    inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c) {
+        return XMVectorAdd(XMVectorMultiply(a, b), c);
+    };
+
+    inline XMVECTOR XMVectorScale(FXMVECTOR v, float scale) {
+        return XMVectorMultiply(v, XMVectorReplicate(scale));
+    };
+
+    inline XMVECTOR XMVectorAbs(FXMVECTOR v) {
+        return { { std::fabs(v.f[0]), std::fabs(v.f[1]), std::fabs(v.f[2]), std::fabs(v.f[3]) } };
+    };
+
+    // comparisons and masks keep all bits of a lane set or cleared, as the SIMD versions
+    inline XMVECTOR XMVectorTrueInt() {
+        XMVECTOR result;
+        std::memset(result.f, 0xFF, sizeof(result.f));
+        return result;
+    };
+
+    inline XMVECTOR XMVectorGreaterOrEqual(FXMVECTOR a, FXMVECTOR b) {
+        uint32_t lanes[4];
+        for (int i = 0; i < 4; ++i) {
+            lanes[i] = a.f[i] >= b.f[i] ? 0xFFFFFFFFu : 0u;
+        }
+        XMVECTOR result;
+        std::memcpy(result.f, lanes, sizeof(lanes));
+        return result;
+    };
+
+    inline XMVECTOR XMVectorAndInt(FXMVECTOR a, FXMVECTOR b) {
+        uint32_t lanesA[4], lanesB[4];
+        std::memcpy(lanesA, a.f, sizeof(lanesA));
+        std::memcpy(lanesB, b.f, sizeof(lanesB));
+        for (int i = 0; i < 4; ++i) {
+            lanesA[i] &= lanesB[i];
+        }
+        XMVECTOR result;
+        std::memcpy(result.f, lanesA, sizeof(lanesA));
+        return result;
+    };
+
+    inline XMVECTOR XMLoadFloat3(const XMFLOAT3* source) {
+        return { { source->x, source->y, source->z, 0.0f } };
+    };
+
+    inline XMVECTOR XMLoadFloat4(const XMFLOAT4* source) {
+        return { { source->x, source->y, source->z, source->w } };
+    };
+
+    inline void XMStoreFloat3(XMFLOAT3* destination, FXMVECTOR v) {
+        *destination = XMFLOAT3(v.f[0], v.f[1], v.f[2]);
+    };
+
+    inline void XMStoreFloat4(XMFLOAT4* destination, FXMVECTOR v) {
+        *destination = XMFLOAT4(v.f[0], v.f[1], v.f[2], v.f[3]);
+    };
+
+    inline void XMStoreUInt4(XMUINT4* destination, FXMVECTOR v) {
+        std::memcpy(destination, v.f, sizeof(*destination));
+    };
+
+    inline XMVECTOR XMPlaneNormalize(FXMVECTOR plane) {
+        float length = std::sqrt(plane.f[0] * plane.f[0] + plane.f[1] * plane.f[1] + plane.f[2] * plane.f[2]);
+        return length > 0.0f ? XMVectorScale(plane, 1.0f / length) : plane;
+    };
+
+    inline XMVECTOR XMVector3TransformCoord(FXMVECTOR v, const XMMATRIX& m) {
+        XMVECTOR result = XMVectorMultiplyAdd(XMVectorSplatX(v), m.r[0], m.r[3]);
+        result = XMVectorMultiplyAdd(XMVectorSplatY(v), m.r[1], result);
+        result = XMVectorMultiplyAdd(XMVectorSplatZ(v), m.r[2], result);
+        return XMVectorScale(result, 1.0f / result.f[3]);
+    };
+
+    inline XMMATRIX XMMatrixIdentity() {
+        return { { XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f),
+            XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f) } };
+    };
+
+    inline XMMATRIX XMMatrixMultiply(const XMMATRIX& a, const XMMATRIX& b) {
+        XMMATRIX result;
+        for (int i = 0; i < 4; ++i) {
+            XMVECTOR row = XMVectorMultiply(XMVectorReplicate(a.r[i].f[0]), b.r[0]);
+            row = XMVectorMultiplyAdd(XMVectorReplicate(a.r[i].f[1]), b.r[1], row);
+            row = XMVectorMultiplyAdd(XMVectorReplicate(a.r[i].f[2]), b.r[2], row);
+            result.r[i] = XMVectorMultiplyAdd(XMVectorReplicate(a.r[i].f[3]), b.r[3], row);
+        }
+        return result;
+    };
+
+    inline XMMATRIX XMMatrixTranspose(const XMMATRIX& m) {
+        XMMATRIX result;
+        for (int i = 0; i < 4; ++i) {
+            result.r[i] = XMVectorSet(m.r[0].f[i], m.r[1].f[i], m.r[2].f[i], m.r[3].f[i]);
+        }
+        return result;
+    };
+
+    inline XMMATRIX XMMatrixTranslation(float x, float y, float z) {
+        XMMATRIX result = XMMatrixIdentity();
+        result.r[3] = XMVectorSet(x, y, z, 1.0f);
+        return result;
+    };
+
+    inline XMMATRIX XMMatrixRotationY(float angle) {
+        float s = std::sin(angle), c = std::cos(angle);
+        XMMATRIX result = XMMatrixIdentity();
+        result.r[0] = XMVectorSet(c, 0.0f, -s, 0.0f);
+        result.r[2] = XMVectorSet(s, 0.0f, c, 0.0f);
+        return result;
+    };
+
+    inline XMMATRIX XMMatrixPerspectiveFovLH(float fovAngleY, float aspectRatio, float nearZ, float farZ) {
+        float height = 1.0f / std::tan(fovAngleY * 0.5f);
+        float range = farZ / (farZ - nearZ);
+        XMMATRIX result;
+        result.r[0] = XMVectorSet(height / aspectRatio, 0.0f, 0.0f, 0.0f);
+        result.r[1] = XMVectorSet(0.0f, height, 0.0f, 0.0f);
+        result.r[2] = XMVectorSet(0.0f, 0.0f, range, 1.0f);
+        result.r[3] = XMVectorSet(0.0f, 0.0f, -range * nearZ, 0.0f);
+        return result;
+    };
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "Device.hpp"
+#include "RingAllocator.hpp"
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+
+// Per-frame constants are written into one large dynamic buffer with D3D11_MAP_WRITE_NO_OVERWRITE and bound
+// by offset (D3D11.1). Frames are fenced with event queries, so memory is reused only after the GPU has read it.
+// If the ring is full, Upload fails rather than discarding the buffer, which would lose the constants already bound by
+// offset in this frame, and the ring is doubled at the next frame. When constant buffer offsets are not supported,
+// Upload fails too; in both cases the caller uses its own buffer.
+class DynamicConstantBuffer {
+public:
+    struct Binding {
+        ID3D11Buffer* buffer = nullptr;
+        UINT firstConstant = 0;
+        UINT numConstants = 0; // 0 means the whole buffer
+    };
+
+    struct Statistics {
+        size_t uploadedBytes = 0; // in the current frame
+        size_t paddingBytes = 0; // in the current frame
+        size_t usedBytes = 0; // not yet read by the GPU
+        UINT fallbacks = 0; // uploads refused in the current frame because the ring was full
+        UINT framesInFlight = 0;
+        size_t capacity = 0;
+    };
+
+    // offsets and sizes of bound ranges must be multiples of 16 constants
+    static const UINT alignment = 256;
+    static const UINT maxRangeSize = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16;
+    static const UINT maxSize = 16 << 20; // the ring is not grown beyond it
+
+    DynamicConstantBuffer() = default;
+
+    HRESULT Init(const std::shared_ptr<Device>& device, UINT size = 1 << 20) {
+        device_ = device;
+
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        HRESULT result = device_->GetDevice()->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+        if (FAILED(result) || !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer) {
+            return S_OK; // not an error, constants are uploaded by the caller
+        }
+
+        ID3D11DeviceContext1* context1 = nullptr;
+        result = device_->GetD3DDeviceContext()->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1);
+        if (FAILED(result)) {
+            return S_OK;
+        }
+        SAFE_RELEASE(context1);
+        return CreateBuffer(size);
+    };
+
+    bool IsSupported() const {
+        return buffer_ != nullptr;
+    };
+
+    // closes the previous frame with a fence and frees the memory of the frames already finished by the GPU
+    void BeginFrame() {
+        if (!IsSupported()) {
+            return;
+        }
+        if (frameOpen_) {
+            // without a query the allocations stay in the current frame and are fenced with the next one
+            ID3D11Query* query = GetQuery();
+            if (!!query) {
+                device_->GetDeviceContext()->End(query);
+                pendingQueries_.push_back({ query, ++fence_ });
+                ring_.EndFrame(fence_);
+            }
+        }
+        while (!pendingQueries_.empty()) {
+            BOOL done = FALSE;
+            HRESULT result = device_->GetDeviceContext()->GetData(pendingQueries_.front().query, &done, sizeof(done),
+                D3D11_ASYNC_GETDATA_DONOTFLUSH);
+            if (result != S_OK || !done) {
+                break;
+            }
+            completedFence_ = pendingQueries_.front().fence;
+            freeQueries_.push_back(pendingQueries_.front().query);
+            pendingQueries_.pop_front();
+        }
+        ring_.Retire(completedFence_);
+        if (fallbacks_ > 0 && ring_.GetCapacity() < maxSize) {
+            // the commands of the frames in flight keep the old buffer alive until the GPU has read it;
+            // if the new one cannot be created, Upload fails from now on and the callers use their own buffers
+            CreateBuffer((UINT)(std::min)(ring_.GetCapacity() * 2, (size_t)maxSize));
+        }
+        fallbacks_ = 0;
+        frameOpen_ = true;
+    };
+
+    template<typename T>
+    bool Upload(const T& data, Binding& binding) {
+        return Upload(&data, sizeof(T), binding);
+    };
+
+    bool Upload(const void* data, size_t size, Binding& binding) {
+        if (!IsSupported() || size > maxRangeSize) {
+            return false;
+        }
+
+        size_t alignedSize = (size + alignment - 1) / alignment * alignment;
+        bool wrapped = false;
+        size_t offset = ring_.Allocate(alignedSize, alignment, wrapped);
+        if (offset == RingAllocator::invalidOffset) {
+            // all memory is still read by the GPU or bound in this frame
+            ++fallbacks_;
+            return false;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE subresource;
+        HRESULT result = device_->GetDeviceContext()->Map(buffer_, 0, discardNext_ ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+            0, &subresource);
+        if (FAILED(result)) {
+            return false;
+        }
+        memcpy((char*)subresource.pData + offset, data, size);
+        device_->GetDeviceContext()->Unmap(buffer_, 0);
+        discardNext_ = false;
+
+        binding.buffer = buffer_;
+        binding.firstConstant = (UINT)(offset / 16);
+        binding.numConstants = (UINT)(alignedSize / 16);
+        return true;
+    };
+
+    void BindVS(UINT slot, const Binding& binding) {
+        if (binding.numConstants == 0) {
+            device_->GetDeviceContext()->VSSetConstantBuffers(slot, 1, &binding.buffer);
+        }
+        else {
+            device_->GetDeviceContext()->VSSetConstantBuffers1(slot, 1, &binding.buffer, &binding.firstConstant, &binding.numConstants);
+        }
+    };
+
+    void BindPS(UINT slot, const Binding& binding) {
+        if (binding.numConstants == 0) {
+            device_->GetDeviceContext()->PSSetConstantBuffers(slot, 1, &binding.buffer);
+        }
+        else {
+            device_->GetDeviceContext()->PSSetConstantBuffers1(slot, 1, &binding.buffer, &binding.firstConstant, &binding.numConstants);
+        }
+    };
+
+    Statistics GetStatistics() const {
+        RingAllocator::Statistics ringStatistics = ring_.GetStatistics();
+        Statistics statistics;
+        statistics.uploadedBytes = ringStatistics.allocatedBytes;
+        statistics.paddingBytes = ringStatistics.paddingBytes;
+        statistics.usedBytes = ringStatistics.usedBytes;
+        statistics.fallbacks = fallbacks_;
+        statistics.framesInFlight = (UINT)ring_.GetFramesInFlight();
+        statistics.capacity = ring_.GetCapacity();
+        return statistics;
+    };
+
+    void Cleanup() {
+        for (auto& q : pendingQueries_) {
+            SAFE_RELEASE(q.query);
+        }
+        pendingQueries_.clear();
+        for (auto& q : freeQueries_) {
+            SAFE_RELEASE(q);
+        }
+        freeQueries_.clear();
+        SAFE_RELEASE(buffer_);
+        ring_.Reset(0);
+        frameOpen_ = false;
+        device_.reset();
+    };
+
+    ~DynamicConstantBuffer() {
+        Cleanup();
+    };
+
+private:
+    HRESULT CreateBuffer(UINT size) {
+        SAFE_RELEASE(buffer_);
+        ring_.Reset(0);
+
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = size;
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        desc.MiscFlags = 0;
+        desc.StructureByteStride = 0;
+        HRESULT result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &buffer_);
+        if (FAILED(result)) {
+            return result;
+        }
+        ring_.Reset(size);
+        discardNext_ = true;
+        return S_OK;
+    };
+
+    struct PendingQuery {
+        ID3D11Query* query;
+        uint64_t fence;
+    };
+
+    ID3D11Query* GetQuery() {
+        if (!freeQueries_.empty()) {
+            ID3D11Query* query = freeQueries_.back();
+            freeQueries_.pop_back();
+            return query;
+        }
+        D3D11_QUERY_DESC desc = {};
+        desc.Query = D3D11_QUERY_EVENT;
+        desc.MiscFlags = 0;
+        ID3D11Query* query = nullptr;
+        if (FAILED(device_->GetDevice()->CreateQuery(&desc, &query))) {
+            return nullptr;
+        }
+        return query;
+    };
+
+    std::shared_ptr<Device> device_; // provided externally <-
+    ID3D11Buffer* buffer_ = nullptr; // always remains only inside the class #
+    RingAllocator ring_; // always remains only inside the class #
+    std::deque<PendingQuery> pendingQueries_; // always remains only inside the class #
+    std::vector<ID3D11Query*> freeQueries_; // always remains only inside the class #
+    uint64_t fence_ = 0; // always remains only inside the class #
+    uint64_t completedFence_ = 0; // always remains only inside the class #
+    bool frameOpen_ = false; // always remains only inside the class #
+    bool discardNext_ = true; // always remains only inside the class #
+    UINT fallbacks_ = 0; // always remains only inside the class #
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Device.hpp"
+
+
+// Structured buffer for a shader resource view that is rewritten every frame with D3D11_MAP_WRITE_DISCARD.
+// The buffer is recreated with twice the capacity when the data does not fit.
+class DynamicStructuredBuffer {
+public:
+    DynamicStructuredBuffer() = default;
+
+    HRESULT Init(const std::shared_ptr<Device>& device, UINT elementSize, UINT capacity) {
+        device_ = device;
+        elementSize_ = elementSize;
+        return Create(capacity);
+    };
+
+    bool Upload(const void* data, UINT count) {
+        if (count > capacity_ && FAILED(Create((std::max)(count, capacity_ * 2)))) {
+            return false;
+        }
+        if (count == 0) {
+            return true;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE subresource;
+        HRESULT result = device_->GetDeviceContext()->Map(buffer_, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+        if (FAILED(result)) {
+            return false;
+        }
+        memcpy(subresource.pData, data, (size_t)elementSize_ * count);
+        device_->GetDeviceContext()->Unmap(buffer_, 0);
+        return true;
+    };
+
+    ID3D11ShaderResourceView* GetSRV() const {
+        return SRV_;
+    };
+
+    size_t GetSizeInBytes() const {
+        return (size_t)elementSize_ * capacity_;
+    };
+
+    void Cleanup() {
+        SAFE_RELEASE(SRV_);
+        SAFE_RELEASE(buffer_);
+        capacity_ = 0;
+        device_.reset();
+    };
+
+    ~DynamicStructuredBuffer() {
+        Cleanup();
+    };
+
+private:
+    HRESULT Create(UINT capacity) {
+        SAFE_RELEASE(SRV_);
+        SAFE_RELEASE(buffer_);
+        capacity_ = 0;
+
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = elementSize_ * capacity;
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+        desc.StructureByteStride = elementSize_;
+        HRESULT result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &buffer_);
+        if (SUCCEEDED(result)) {
+            D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
+            SRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+            SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+            SRVDesc.Buffer.FirstElement = 0;
+            SRVDesc.Buffer.NumElements = capacity;
+            result = device_->GetDevice()->CreateShaderResourceView(buffer_, &SRVDesc, &SRV_);
+        }
+        if (SUCCEEDED(result)) {
+            capacity_ = capacity;
+        }
+        return result;
+    };
+
+    std::shared_ptr<Device> device_; // provided externally <-
+    ID3D11Buffer* buffer_ = nullptr; // always remains only inside the class #
+    ID3D11ShaderResourceView* SRV_ = nullptr; // always remains only inside the class #
+    UINT elementSize_ = 0; // always remains only inside the class #
+    UINT capacity_ = 0; // always remains only inside the class #
+};
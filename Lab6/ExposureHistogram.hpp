@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EXPOSURE_HISTOGRAM_SSE2
+#endif
+
+
+// log luminance histogram for exposure metering, 4 bins per octave taken from the bits of the float
+// (the same bins as histogramPS.hlsl)
+class ExposureHistogram {
+public:
+    static const uint32_t binCount = 128;
+    static const uint32_t binsPerOctave = 4;
+    static const int32_t minLog2 = -12;
+    static const int32_t centerRadius = 512; // in the coordinates from -1024 to 1024 across the frame
+
+    struct Settings {
+        float lowPercentile = 0.4f; // the darkest pixels that are not metered, mostly shadows and the background
+        float highPercentile = 0.95f; // the brightest ones are not metered too, so that small lights do not darken the frame
+        uint32_t centerWeight = 4;
+    };
+
+    struct Metering {
+        bool valid = false; // false for an empty histogram
+        float averageLuminance = 0.0f;
+        float lowLuminance = 0.0f; // at the percentiles
+        float highLuminance = 0.0f;
+    };
+
+    static uint32_t GetBin(float luminance) {
+        int32_t bits;
+        std::memcpy(&bits, &luminance, sizeof(bits));
+        int32_t bin = (bits >> 21) - firstKey + 1;
+        return (uint32_t)(std::min)((std::max)(bin, 0), (int32_t)binCount - 1);
+    };
+
+    static float GetLuminance(float r, float g, float b) {
+        float rg = r * 0.2126f + g * 0.7151f;
+        return rg + b * 0.0722f;
+    };
+
+    // log2 of the middle of the luminances of the bin
+    static float GetBinLog2(uint32_t bin) {
+        if (bin == 0) {
+            return (float)minLog2 - 1.0f / binsPerOctave;
+        }
+        if (bin >= binCount - 1) {
+            return (float)minLog2 + (float)(binCount - 1) / binsPerOctave;
+        }
+        uint32_t step = bin - 1;
+        int32_t octave = minLog2 + (int32_t)(step / binsPerOctave);
+        return (float)octave + std::log2(1.0f + ((float)(step % binsPerOctave) + 0.5f) / binsPerOctave);
+    };
+
+    static bool IsCenter(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+        int32_t u = ((int32_t)(2 * x + 1) - (int32_t)width) * 1024 / (int32_t)width;
+        int32_t v = ((int32_t)(2 * y + 1) - (int32_t)height) * 1024 / (int32_t)height;
+        return u * u + v * v <= centerRadius * centerRadius;
+    };
+
+    // the pixels of the row inside the central ellipse, [x0, x1), found by binary search on both sides of the middle
+    static void GetCenterSpan(uint32_t y, uint32_t width, uint32_t height, uint32_t& x0, uint32_t& x1) {
+        uint32_t middle = width / 2;
+        x0 = x1 = 0;
+        if (width == 0 || !IsCenter(middle, y, width, height)) {
+            return;
+        }
+        uint32_t lo = 0;
+        uint32_t hi = middle;
+        while (lo < hi) {
+            uint32_t m = (lo + hi) / 2;
+            if (IsCenter(m, y, width, height)) {
+                hi = m;
+            }
+            else {
+                lo = m + 1;
+            }
+        }
+        x0 = lo;
+        lo = middle;
+        hi = width - 1;
+        while (lo < hi) {
+            uint32_t m = (lo + hi + 1) / 2;
+            if (IsCenter(m, y, width, height)) {
+                lo = m;
+            }
+            else {
+                hi = m - 1;
+            }
+        }
+        x1 = lo + 1;
+    };
+
+    // adds the pixels of an RGBA float frame to the bins pixel by pixel; rowPitch is in floats
+    static void AccumulateReference(const float* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t centerWeight,
+        uint32_t* bins) {
+        for (uint32_t y = 0; y < height; ++y) {
+            const float* row = pixels + (size_t)y * rowPitch;
+            for (uint32_t x = 0; x < width; ++x) {
+                const float* p = row + 4 * x;
+                bins[GetBin(GetLuminance(p[0], p[1], p[2]))] += IsCenter(x, y, width, height) ? centerWeight : 1;
+            }
+        }
+    };
+
+    // the same bins as AccumulateReference; with SSE2 four pixels are binned at once and counted in four separate
+    // histograms, so that equal neighbouring bins do not wait for each other's increments
+    static void Accumulate(const float* pixels, uint32_t width, uint32_t height, uint32_t rowPitch, uint32_t centerWeight,
+        uint32_t* bins) {
+#ifdef EXPOSURE_HISTOGRAM_SSE2
+        uint32_t lanes[4][binCount] = {};
+        const __m128 kr = _mm_set1_ps(0.2126f);
+        const __m128 kg = _mm_set1_ps(0.7151f);
+        const __m128 kb = _mm_set1_ps(0.0722f);
+        const __m128i offset = _mm_set1_epi32(firstKey - 1);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i last = _mm_set1_epi32(binCount - 1);
+        for (uint32_t y = 0; y < height; ++y) {
+            const float* row = pixels + (size_t)y * rowPitch;
+            uint32_t x0, x1;
+            GetCenterSpan(y, width, height, x0, x1);
+            uint32_t x = 0;
+            for (; x + 4 <= width; x += 4) {
+                __m128 r = _mm_loadu_ps(row + 4 * x);
+                __m128 g = _mm_loadu_ps(row + 4 * x + 4);
+                __m128 b = _mm_loadu_ps(row + 4 * x + 8);
+                __m128 a = _mm_loadu_ps(row + 4 * x + 12);
+                _MM_TRANSPOSE4_PS(r, g, b, a);
+                __m128 luminance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, kr), _mm_mul_ps(g, kg)), _mm_mul_ps(b, kb));
+                __m128i bin = _mm_sub_epi32(_mm_srai_epi32(_mm_castps_si128(luminance), 21), offset);
+                bin = _mm_andnot_si128(_mm_cmplt_epi32(bin, zero), bin);
+                __m128i above = _mm_cmpgt_epi32(bin, last);
+                bin = _mm_or_si128(_mm_and_si128(above, last), _mm_andnot_si128(above, bin));
+                lanes[0][_mm_cvtsi128_si32(bin)] += x >= x0 && x < x1 ? centerWeight : 1;
+                lanes[1][_mm_cvtsi128_si32(_mm_srli_si128(bin, 4))] += x + 1 >= x0 && x + 1 < x1 ? centerWeight : 1;
+                lanes[2][_mm_cvtsi128_si32(_mm_srli_si128(bin, 8))] += x + 2 >= x0 && x + 2 < x1 ? centerWeight : 1;
+                lanes[3][_mm_cvtsi128_si32(_mm_srli_si128(bin, 12))] += x + 3 >= x0 && x + 3 < x1 ? centerWeight : 1;
+            }
+            for (; x < width; ++x) {
+                const float* p = row + 4 * x;
+                lanes[0][GetBin(GetLuminance(p[0], p[1], p[2]))] += x >= x0 && x < x1 ? centerWeight : 1;
+            }
+        }
+        for (uint32_t i = 0; i < binCount; ++i) {
+            bins[i] += lanes[0][i] + lanes[1][i] + lanes[2][i] + lanes[3][i];
+        }
+#else
+        AccumulateReference(pixels, width, height, rowPitch, centerWeight, bins);
+#endif
+    };
+
+    // the parts of the bins between the percentiles of the total weight are averaged in log2
+    static Metering Evaluate(const uint32_t* bins, float lowPercentile, float highPercentile) {
+        Metering metering;
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < binCount; ++i) {
+            total += bins[i];
+        }
+        if (total == 0) {
+            return metering;
+        }
+
+        double low = (double)total * (std::min)((std::max)(lowPercentile, 0.0f), 1.0f);
+        double high = (double)total * (std::min)((std::max)(highPercentile, 0.0f), 1.0f);
+        if (high - low < 1.0) {
+            // a window narrower than a pixel around the middle of the requested one
+            low = (std::max)((low + high) * 0.5 - 0.5, 0.0);
+            high = (std::min)(low + 1.0, (double)total);
+        }
+
+        double sum = 0.0;
+        double weight = 0.0;
+        double accumulated = 0.0;
+        bool lowFound = false;
+        for (uint32_t i = 0; i < binCount; ++i) {
+            double next = accumulated + bins[i];
+            double part = (std::min)(next, high) - (std::max)(accumulated, low);
+            if (part > 0.0) {
+                if (!lowFound) {
+                    metering.lowLuminance = std::exp2(GetBinLog2(i));
+                    lowFound = true;
+                }
+                metering.highLuminance = std::exp2(GetBinLog2(i));
+                sum += part * GetBinLog2(i);
+                weight += part;
+            }
+            accumulated = next;
+        }
+        metering.valid = weight > 0.0;
+        metering.averageLuminance = metering.valid ? (float)std::exp2(sum / weight) : 0.0f;
+        return metering;
+    };
+
+private:
+    // the upper 11 bits of the float 2^minLog2: the sign, the exponent and two bits of the mantissa
+    static const int32_t firstKey = (127 + minLog2) * (int32_t)binsPerOctave;
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <algorithm>
+
+
+// Linear allocator for data that lives until the end of the frame. Memory is never freed individually,
+// Reset makes all of it available again. When a frame did not fit into one block, the blocks are replaced
+// by a single block of the total size, so after a few frames the arena stops requesting memory from the heap.
+class FrameArena {
+public:
+    struct Statistics {
+        size_t usedBytes = 0;
+        size_t capacity = 0;
+        uint64_t blockAllocations = 0; // heap allocations made by the arena since its creation
+    };
+
+    explicit FrameArena(size_t blockSize = 64 * 1024) : blockSize_(blockSize) {};
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        if (blocks_.empty() || !Fits(size, alignment)) {
+            AddBlock(size + alignment);
+        }
+
+        Block& block = blocks_.back();
+        size_t offset = Align(block.used, alignment);
+        block.used = offset + size;
+        usedBytes_ += size;
+        return block.data.get() + offset;
+    };
+
+    template<typename T>
+    T* Allocate(size_t count) {
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    };
+
+    void Reset() {
+        if (blocks_.size() > 1) {
+            size_t capacity = 0;
+            for (auto& b : blocks_) {
+                capacity += b.size;
+            }
+            blocks_.clear();
+            AddBlock(capacity);
+        }
+        for (auto& b : blocks_) {
+            b.used = 0;
+        }
+        usedBytes_ = 0;
+    };
+
+    Statistics GetStatistics() const {
+        Statistics statistics;
+        statistics.usedBytes = usedBytes_;
+        for (auto& b : blocks_) {
+            statistics.capacity += b.size;
+        }
+        statistics.blockAllocations = blockAllocations_;
+        return statistics;
+    };
+
+    ~FrameArena() = default;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+        size_t used = 0;
+    };
+
+    static size_t Align(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    };
+
+    bool Fits(size_t size, size_t alignment) const {
+        const Block& block = blocks_.back();
+        return Align(block.used, alignment) + size <= block.size;
+    };
+
+    void AddBlock(size_t minSize) {
+        Block block;
+        block.size = (std::max)(blockSize_, minSize);
+        block.data.reset(new char[block.size]);
+        blocks_.push_back(std::move(block));
+        ++blockAllocations_;
+    };
+
+    size_t blockSize_ = 0; // always remains only inside the class #
+    std::vector<Block> blocks_; // always remains only inside the class #
+    size_t usedBytes_ = 0; // always remains only inside the class #
+    uint64_t blockAllocations_ = 0; // always remains only inside the class #
+};
+
+
+// One arena per thread, so that worker threads allocate frame data without locking.
+// Reset must be called when no other thread uses its arena (at the beginning of the frame).
+class ThreadFrameArenas {
+public:
+    explicit ThreadFrameArenas(size_t blockSize = 64 * 1024) : blockSize_(blockSize), id_(NextId()) {};
+
+    ThreadFrameArenas(const ThreadFrameArenas&) = delete;
+    ThreadFrameArenas& operator=(const ThreadFrameArenas&) = delete;
+
+    FrameArena& GetLocal() {
+        // the last used arena is remembered for each thread, the lock is taken only on the first access
+        static thread_local uint64_t cachedId = 0;
+        static thread_local FrameArena* cachedArena = nullptr;
+        if (cachedId == id_) {
+            return *cachedArena;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<FrameArena>& arena = arenas_[std::this_thread::get_id()];
+        if (!arena) {
+            arena.reset(new FrameArena(blockSize_));
+        }
+        cachedId = id_;
+        cachedArena = arena.get();
+        return *arena;
+    };
+
+    void Reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& a : arenas_) {
+            a.second->Reset();
+        }
+    };
+
+    // sum over the arenas of all threads
+    FrameArena::Statistics GetStatistics() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FrameArena::Statistics statistics;
+        for (auto& a : arenas_) {
+            FrameArena::Statistics s = a.second->GetStatistics();
+            statistics.usedBytes += s.usedBytes;
+            statistics.capacity += s.capacity;
+            statistics.blockAllocations += s.blockAllocations;
+        }
+        return statistics;
+    };
+
+    ~ThreadFrameArenas() = default;
+
+private:
+    // ids are never reused, so a stale thread cache of a destroyed instance can not match a new one
+    static uint64_t NextId() {
+        static std::atomic<uint64_t> counter(0);
+        return ++counter;
+    };
+
+    size_t blockSize_ = 0; // always remains only inside the class #
+    uint64_t id_ = 0; // always remains only inside the class #
+    std::mutex mutex_; // always remains only inside the class #
+    std::unordered_map<std::thread::id, std::unique_ptr<FrameArena>> arenas_; // always remains only inside the class #
+};
+
+
+// STL allocator over a frame arena, deallocation does nothing
+template<typename T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+
+    FrameAllocator(FrameArena& arena) : arena_(&arena) {};
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : arena_(other.GetArena()) {};
+
+    T* allocate(size_t count) {
+        return arena_->Allocate<T>(count);
+    };
+
+    void deallocate(T* /*ptr*/, size_t /*count*/) {}; // freed with the whole arena
+
+    FrameArena* GetArena() const {
+        return arena_;
+    };
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const {
+        return arena_ == other.GetArena();
+    };
+
+    template<typename U>
+    bool operator!=(const FrameAllocator<U>& other) const {
+        return arena_ != other.GetArena();
+    };
+
+private:
+    FrameArena* arena_ = nullptr; // provided externally <-
+};
+
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
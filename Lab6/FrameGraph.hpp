@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+// passes of a frame and their transient textures: unused passes are culled, textures of the same description
+// with disjoint lifetimes share a slot
+class FrameGraph {
+public:
+    static const uint32_t invalidIndex = 0xFFFFFFFF;
+
+    struct TextureDesc {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t format = 0; // DXGI_FORMAT, the typeless one for depth
+        uint32_t bytesPerTexel = 0;
+        bool depthStencil = false; // bound as depth instead of a render target
+
+        uint64_t GetBytes() const {
+            return (uint64_t)width * height * bytesPerTexel;
+        };
+
+        bool operator==(const TextureDesc& other) const {
+            return width == other.width && height == other.height && format == other.format && bytesPerTexel == other.bytesPerTexel
+                && depthStencil == other.depthStencil;
+        };
+
+        bool operator!=(const TextureDesc& other) const {
+            return !(*this == other);
+        };
+    };
+
+    struct Statistics {
+        uint32_t passes = 0;
+        uint32_t culledPasses = 0;
+        uint32_t textures = 0; // transient textures used by the live passes
+        uint32_t physicalTextures = 0;
+        uint64_t textureBytes = 0; // of the transient textures without aliasing
+        uint64_t physicalBytes = 0; // of the physical slots
+        uint64_t peakBytes = 0; // the most bytes of the transient textures live in one pass
+    };
+
+    void Reset() {
+        passes_.clear();
+        textures_.clear();
+        accesses_.clear();
+        physical_.clear();
+        statistics_ = Statistics();
+    };
+
+    uint32_t AddPass(const char* name, bool sideEffect = false) {
+        Pass pass;
+        pass.name = name;
+        pass.sideEffect = sideEffect;
+        passes_.push_back(pass);
+        return (uint32_t)passes_.size() - 1;
+    };
+
+    // a transient texture, its contents are written by the pass first
+    uint32_t CreateTexture(uint32_t pass, const char* name, const TextureDesc& desc) {
+        Texture texture;
+        texture.name = name;
+        texture.desc = desc;
+        textures_.push_back(texture);
+        uint32_t index = (uint32_t)textures_.size() - 1;
+        Write(pass, index);
+        return index;
+    };
+
+    uint32_t ImportTexture(const char* name) {
+        Texture texture;
+        texture.name = name;
+        texture.imported = true;
+        textures_.push_back(texture);
+        return (uint32_t)textures_.size() - 1;
+    };
+
+    void Read(uint32_t pass, uint32_t texture) {
+        accesses_.push_back({ pass, texture, false });
+    };
+
+    // the pass changes the contents, a texture written by several passes keeps all of them alive
+    void Write(uint32_t pass, uint32_t texture) {
+        accesses_.push_back({ pass, texture, true });
+    };
+
+    void Compile() {
+        const uint32_t passCount = (uint32_t)passes_.size();
+        statistics_ = Statistics();
+        statistics_.passes = passCount;
+
+        // the accesses grouped by pass, in the order of declaration
+        passAccessOffsets_.assign(passCount + 1, 0);
+        for (const Access& access : accesses_) {
+            ++passAccessOffsets_[access.pass + 1];
+        }
+        for (uint32_t p = 0; p < passCount; ++p) {
+            passAccessOffsets_[p + 1] += passAccessOffsets_[p];
+        }
+        sortedAccesses_.resize(accesses_.size());
+        cursor_.assign(passAccessOffsets_.begin(), passAccessOffsets_.end() - 1);
+        for (const Access& access : accesses_) {
+            sortedAccesses_[cursor_[access.pass]++] = access;
+        }
+
+        // culling from the last pass: a pass is live if it writes a texture needed later; the textures it reads and writes
+        // become needed, the writes change the contents of the earlier passes rather than replace them
+        needed_.resize(textures_.size());
+        for (size_t t = 0; t < textures_.size(); ++t) {
+            needed_[t] = textures_[t].imported ? 1 : 0;
+        }
+        for (uint32_t p = passCount; p-- > 0;) {
+            Pass& pass = passes_[p];
+            pass.live = pass.sideEffect;
+            for (uint32_t a = passAccessOffsets_[p]; a < passAccessOffsets_[p + 1] && !pass.live; ++a) {
+                pass.live = sortedAccesses_[a].write && needed_[sortedAccesses_[a].texture];
+            }
+            if (!pass.live) {
+                ++statistics_.culledPasses;
+                continue;
+            }
+            for (uint32_t a = passAccessOffsets_[p]; a < passAccessOffsets_[p + 1]; ++a) {
+                needed_[sortedAccesses_[a].texture] = 1;
+            }
+        }
+
+        // lifetimes over the live passes
+        for (Texture& texture : textures_) {
+            texture.first = invalidIndex;
+            texture.last = invalidIndex;
+            texture.physical = invalidIndex;
+        }
+        for (uint32_t p = 0; p < passCount; ++p) {
+            if (!passes_[p].live) {
+                continue;
+            }
+            for (uint32_t a = passAccessOffsets_[p]; a < passAccessOffsets_[p + 1]; ++a) {
+                Texture& texture = textures_[sortedAccesses_[a].texture];
+                if (texture.first == invalidIndex) {
+                    texture.first = p;
+                }
+                texture.last = p;
+            }
+        }
+
+        // slots in the order of the first use: a texture takes a slot of its description that is free before its first pass
+        liveBytes_.assign(passCount + 1, 0);
+        for (uint32_t p = 0; p < passCount; ++p) {
+            if (!passes_[p].live) {
+                continue;
+            }
+            for (uint32_t a = passAccessOffsets_[p]; a < passAccessOffsets_[p + 1]; ++a) {
+                uint32_t index = sortedAccesses_[a].texture;
+                Texture& texture = textures_[index];
+                if (texture.imported || texture.first != p || texture.physical != invalidIndex) {
+                    continue;
+                }
+                for (uint32_t s = 0; s < physical_.size(); ++s) {
+                    if (physical_[s].last < p && physical_[s].desc == texture.desc) {
+                        texture.physical = s;
+                        break;
+                    }
+                }
+                if (texture.physical == invalidIndex) {
+                    Physical physical;
+                    physical.desc = texture.desc;
+                    physical_.push_back(physical);
+                    texture.physical = (uint32_t)physical_.size() - 1;
+                    statistics_.physicalBytes += texture.desc.GetBytes();
+                }
+                physical_[texture.physical].last = texture.last;
+
+                ++statistics_.textures;
+                statistics_.textureBytes += texture.desc.GetBytes();
+                liveBytes_[texture.first] += (int64_t)texture.desc.GetBytes();
+                liveBytes_[texture.last + 1] -= (int64_t)texture.desc.GetBytes();
+            }
+        }
+        statistics_.physicalTextures = (uint32_t)physical_.size();
+
+        int64_t bytes = 0;
+        for (uint32_t p = 0; p < passCount; ++p) {
+            bytes += liveBytes_[p];
+            statistics_.peakBytes = (std::max)(statistics_.peakBytes, (uint64_t)bytes);
+        }
+    };
+
+    uint32_t GetPassCount() const {
+        return (uint32_t)passes_.size();
+    };
+
+    const char* GetPassName(uint32_t pass) const {
+        return passes_[pass].name;
+    };
+
+    // valid after Compile
+    bool IsPassLive(uint32_t pass) const {
+        return passes_[pass].live;
+    };
+
+    uint32_t GetTextureCount() const {
+        return (uint32_t)textures_.size();
+    };
+
+    const char* GetTextureName(uint32_t texture) const {
+        return textures_[texture].name;
+    };
+
+    const TextureDesc& GetTextureDesc(uint32_t texture) const {
+        return textures_[texture].desc;
+    };
+
+    bool IsImported(uint32_t texture) const {
+        return textures_[texture].imported;
+    };
+
+    // the first and the last live pass using the texture, false if no live pass uses it
+    bool GetLifetime(uint32_t texture, uint32_t& first, uint32_t& last) const {
+        first = textures_[texture].first;
+        last = textures_[texture].last;
+        return first != invalidIndex;
+    };
+
+    // invalidIndex for the imported textures and the textures of the culled passes
+    uint32_t GetPhysicalIndex(uint32_t texture) const {
+        return textures_[texture].physical;
+    };
+
+    uint32_t GetPhysicalCount() const {
+        return (uint32_t)physical_.size();
+    };
+
+    const TextureDesc& GetPhysicalDesc(uint32_t physical) const {
+        return physical_[physical].desc;
+    };
+
+    const Statistics& GetStatistics() const {
+        return statistics_;
+    };
+
+private:
+    struct Pass {
+        const char* name = nullptr;
+        bool sideEffect = false;
+        bool live = false;
+    };
+
+    struct Texture {
+        const char* name = nullptr;
+        TextureDesc desc;
+        bool imported = false;
+        uint32_t first = invalidIndex;
+        uint32_t last = invalidIndex;
+        uint32_t physical = invalidIndex;
+    };
+
+    struct Access {
+        uint32_t pass;
+        uint32_t texture;
+        bool write;
+    };
+
+    struct Physical {
+        TextureDesc desc;
+        uint32_t last = 0; // the last pass of the texture using the slot
+    };
+
+    std::vector<Pass> passes_;
+    std::vector<Texture> textures_;
+    std::vector<Access> accesses_;
+    std::vector<Physical> physical_;
+    Statistics statistics_;
+
+    // scratch of Compile
+    std::vector<uint32_t> passAccessOffsets_;
+    std::vector<uint32_t> cursor_;
+    std::vector<Access> sortedAccesses_;
+    std::vector<uint8_t> needed_;
+    std::vector<int64_t> liveBytes_;
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+// 32-bit reference into a HandlePool: 20 bits of slot index and 12 bits of generation.
+// The generation of a slot changes when its element is removed, so stale handles are detected.
+// A zero value is never issued and means "no element". Tag separates handles of different pools.
+template<typename Tag>
+struct Handle {
+    static const uint32_t indexBits = 20;
+    static const uint32_t generationBits = 12;
+    static const uint32_t maxIndex = (1u << indexBits) - 1;
+    static const uint32_t maxGeneration = (1u << generationBits) - 1;
+
+    uint32_t value = 0;
+
+    static Handle Make(uint32_t index, uint32_t generation) {
+        Handle handle;
+        handle.value = (generation << indexBits) | index;
+        return handle;
+    };
+
+    uint32_t GetIndex() const {
+        return value & maxIndex;
+    };
+
+    uint32_t GetGeneration() const {
+        return value >> indexBits;
+    };
+
+    bool IsNull() const {
+        return value == 0;
+    };
+
+    friend bool operator==(const Handle& h1, const Handle& h2) {
+        return h1.value == h2.value;
+    };
+
+    friend bool operator!=(const Handle& h1, const Handle& h2) {
+        return h1.value != h2.value;
+    };
+};
+
+
+// Elements are stored contiguously in slots, removed slots are reused through a free list.
+template<typename T, typename Tag = T>
+class HandlePool {
+public:
+    typedef Handle<Tag> HandleType;
+
+    HandlePool() = default;
+
+    HandleType Add(const T& element) {
+        uint32_t index = 0;
+        if (!freeSlots_.empty()) {
+            index = freeSlots_.back();
+            freeSlots_.pop_back();
+            elements_[index] = element;
+        }
+        else {
+            index = (uint32_t)elements_.size();
+            if (index > HandleType::maxIndex) {
+                return HandleType();
+            }
+            elements_.push_back(element);
+            generations_.push_back(1);
+            alive_.push_back(0);
+        }
+        alive_[index] = 1;
+        ++size_;
+        return HandleType::Make(index, generations_[index]);
+    };
+
+    bool Remove(HandleType handle) {
+        if (!IsValid(handle)) {
+            return false;
+        }
+        uint32_t index = handle.GetIndex();
+        elements_[index] = T();
+        alive_[index] = 0;
+        // generation 0 is skipped, so that the handle of slot 0 is never null
+        generations_[index] = generations_[index] == HandleType::maxGeneration ? 1 : generations_[index] + 1;
+        freeSlots_.push_back(index);
+        --size_;
+        return true;
+    };
+
+    bool IsValid(HandleType handle) const {
+        uint32_t index = handle.GetIndex();
+        return !handle.IsNull() && index < elements_.size() && alive_[index] && generations_[index] == handle.GetGeneration();
+    };
+
+    // nullptr for stale and null handles
+    T* Get(HandleType handle) {
+        return IsValid(handle) ? &elements_[handle.GetIndex()] : nullptr;
+    };
+
+    const T* Get(HandleType handle) const {
+        return IsValid(handle) ? &elements_[handle.GetIndex()] : nullptr;
+    };
+
+    // for handles known to be valid, e.g. stored in data owned by the same object as the pool
+    T& operator[](HandleType handle) {
+        return elements_[handle.GetIndex()];
+    };
+
+    const T& operator[](HandleType handle) const {
+        return elements_[handle.GetIndex()];
+    };
+
+    uint32_t Size() const {
+        return size_;
+    };
+
+    // the slots are kept with new generations, so handles issued before remain invalid
+    void Clear() {
+        freeSlots_.clear();
+        for (uint32_t i = (uint32_t)elements_.size(); i > 0; --i) {
+            Remove(HandleType::Make(i - 1, generations_[i - 1]));
+            if (freeSlots_.empty() || freeSlots_.back() != i - 1) {
+                freeSlots_.push_back(i - 1);
+            }
+        }
+        size_ = 0;
+    };
+
+    ~HandlePool() = default;
+
+private:
+    std::vector<T> elements_; // always remains only inside the class #
+    std::vector<uint16_t> generations_; // always remains only inside the class #
+    std::vector<uint8_t> alive_; // always remains only inside the class #
+    std::vector<uint32_t> freeSlots_; // always remains only inside the class #
+    uint32_t size_ = 0; // always remains only inside the class #
+};
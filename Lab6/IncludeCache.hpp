@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <unordered_map>
+
+
+// Shared cache of shader include files. Every file is read only once, the returned pointers
+// remain valid until the entry is invalidated, so the include handler does not allocate on open.
+class IncludeCache {
+public:
+    using Reader = std::function<bool(const std::string& name, std::string& content)>;
+
+    struct Statistics {
+        size_t reads = 0;
+        size_t hits = 0;
+        size_t failures = 0;
+    };
+
+    IncludeCache() : reader_(ReadFile) {};
+
+    IncludeCache(const Reader& reader) : reader_(reader) {};
+
+    bool Get(const std::string& name, const char*& data, size_t& size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto result = files_.find(name);
+        if (result != files_.end()) {
+            ++statistics_.hits;
+        }
+        else {
+            std::unique_ptr<std::string> content = std::make_unique<std::string>();
+            if (!reader_(name, *content)) {
+                ++statistics_.failures;
+                return false;
+            }
+            ++statistics_.reads;
+            result = files_.emplace(name, std::move(content)).first;
+        }
+        data = result->second->data();
+        size = result->second->size();
+        return true;
+    };
+
+    bool Contains(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return files_.find(name) != files_.end();
+    };
+
+    // must not be called while shaders that use the file are being compiled
+    void Invalidate(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_.erase(name);
+    };
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        files_.clear();
+    };
+
+    Statistics GetStatistics() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return statistics_;
+    };
+
+    ~IncludeCache() = default;
+
+private:
+    static bool ReadFile(const std::string& name, std::string& content) {
+        std::ifstream file(name, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    };
+
+    mutable std::mutex mutex_; // always remains only inside the class #
+    Reader reader_; // always remains only inside the class #
+    std::unordered_map<std::string, std::unique_ptr<std::string>> files_; // always remains only inside the class #
+    Statistics statistics_; // transmitted outward ->
+};
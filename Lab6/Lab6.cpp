@@ -1,6 +1,7 @@
 ﻿#include "Lab6.h"
 #include "Renderer.h"
 #include <windowsx.h>
+#include <fstream>
 
 #define MAX_LOADSTRING 100
 
@@ -12,13 +13,17 @@ ATOM                 MyRegisterClass(HINSTANCE hInstance);
 BOOL                 InitInstance(HINSTANCE, int);
 LRESULT CALLBACK     WndProc(HWND, UINT, WPARAM, LPARAM);
 void keyPressProc();
+int RunHeadless();
 
 int APIENTRY wWinMain(_In_ HINSTANCE     hInstance,
                       _In_opt_ HINSTANCE hPrevInstance,
                       _In_ LPWSTR        lpCmdLine,
                       _In_ int           nCmdShow) {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
+
+    // -profile records the CPU scopes from the start, so the loading and the bakes are in cpu_trace.json written on exit
+    bool profile = wcsstr(lpCmdLine, L"-profile") != nullptr;
+    CpuProfiler::Get().SetEnabled(profile);
 
     LoadStringW(hInstance, IDS_APP_TITLE, szTitle, MAX_LOADSTRING);
     LoadStringW(hInstance, IDI_LAB6, szWindowClass, MAX_LOADSTRING);
@@ -34,6 +39,15 @@ int APIENTRY wWinMain(_In_ HINSTANCE     hInstance,
         SetCurrentDirectory(dir.c_str());
     }
 
+    // -headless renders frames without a window on the null device and checks their commands, see RunHeadless
+    if (wcsstr(lpCmdLine, L"-headless") != nullptr) {
+        int result = RunHeadless();
+        if (profile) {
+            CpuProfiler::Get().WriteChromeTrace("cpu_trace.json");
+        }
+        return result;
+    }
+
     if (!InitInstance(hInstance, nCmdShow)) {
         return FALSE;
     }
@@ -59,9 +73,64 @@ int APIENTRY wWinMain(_In_ HINSTANCE     hInstance,
             return FALSE;
     }
 
+    if (profile) {
+        CpuProfiler::Get().WriteChromeTrace("cpu_trace.json");
+    }
+
     return (int) msg.wParam;
 }
 
+// Renders the scene from the initial camera through the recording null backend. After the warm-up frames (shadow
+// caches, readback rings) every frame must issue the same draws and state changes, and not more of them than
+// headless_baseline.txt, which the first run writes. The counts of every frame go to headless_commands.txt.
+// Returns 0 if the checks pass, 1 if one fails, 2 if the frames cannot be rendered.
+int RunHeadless() {
+    const UINT frameCount = 16;
+    const UINT warmUpFrames = 4;
+    Renderer& renderer = Renderer::GetInstance();
+    if (!renderer.InitHeadless(Renderer::defaultWidth, Renderer::defaultHeight) || !renderer.GetCommandRecorder()) {
+        return 2;
+    }
+    renderer.GetCommandRecorder()->SetLogging(true);
+
+    std::ofstream report("headless_commands.txt");
+    UINT failures = 0;
+    CommandRecorder::Statistics reference;
+    for (UINT i = 0; i < frameCount; ++i) {
+        if (!renderer.Render()) {
+            return 2;
+        }
+        const CommandRecorder* recorder = renderer.GetCommandRecorder();
+        const CommandRecorder::Statistics& statistics = recorder->GetStatistics();
+        report << "frame " << i << ": " << statistics.draws << " draws, " << statistics.stateChanges << " state changes, "
+            << statistics.redundantBinds << " redundant binds, " << statistics.uploadBytes << " bytes uploaded, log hash "
+            << std::hex << recorder->GetLogHash() << std::dec << "\n";
+        if (i == warmUpFrames) {
+            reference = statistics;
+        }
+        else if (i > warmUpFrames && (statistics.draws != reference.draws || statistics.stateChanges != reference.stateChanges)) {
+            report << "the commands changed without a change of the scene\n";
+            ++failures;
+        }
+    }
+
+    UINT baselineDraws = 0;
+    UINT baselineStateChanges = 0;
+    std::ifstream baseline("headless_baseline.txt");
+    if (baseline >> baselineDraws >> baselineStateChanges) {
+        if (reference.draws > baselineDraws || reference.stateChanges > baselineStateChanges) {
+            report << "regression: " << reference.draws << " draws and " << reference.stateChanges << " state changes, the baseline has "
+                << baselineDraws << " and " << baselineStateChanges << "\n";
+            ++failures;
+        }
+    }
+    else {
+        std::ofstream("headless_baseline.txt") << reference.draws << " " << reference.stateChanges << "\n";
+    }
+    renderer.Cleanup();
+    return failures == 0 ? 0 : 1;
+}
+
 void keyPressProc()
 {
     int upDown = 0, rightLeft = 0, forwardBack = 0;
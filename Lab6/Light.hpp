@@ -1,8 +1,10 @@
 #pragma once
 
 #include "framework.h"
+#include "ShadowCascades.hpp"
 
-#define MAX_LIGHT 64
+#define MAX_LIGHT 64 // per constant buffer of deferred light volumes
+#define MAX_POINT_LIGHT 4096
 #define CSM_SPLIT_COUNT 4
 
 
@@ -16,84 +18,84 @@ struct DirectionalLight {
     struct DirectionalLightInfo {
         XMFLOAT4 direction;
         XMFLOAT4 color;
-        XMMATRIX viewProjectionMatrix;
-        XMUINT4 splitSizeRatio;
+        XMMATRIX viewProjectionMatrix; // of the first cascade
+        XMFLOAT4 cascadeSplits; // view depths where the cascades end
+        XMFLOAT4 cascadeScales[CSM_SPLIT_COUNT]; // clip space of a cascade = clip space of the first one * scale + offset
+        XMFLOAT4 cascadeOffsets[CSM_SPLIT_COUNT];
+        XMFLOAT4 cascadeAtlasRects[CSM_SPLIT_COUNT]; // uv offset and scale of the tile in the shadow atlas, half of its texel
     };
 
-    float r = 250.0f;
     float theta = 0.595f;
     float phi = 1.3f;
 
     XMFLOAT4 direction;
     XMFLOAT4 color;
+    XMMATRIX viewMatrix; // shared by the cascades
     XMMATRIX projectionMatrices[CSM_SPLIT_COUNT];
     XMMATRIX viewProjectionMatrices[CSM_SPLIT_COUNT];
-    UINT splitSizeRatio[CSM_SPLIT_COUNT];
+    ShadowCascades::Settings cascadeSettings;
+    ShadowCascades cascades;
+    XMFLOAT4 atlasRects[CSM_SPLIT_COUNT]; // set by the owner of the shadow atlas
 
     DirectionalLight() {
-        for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
-            splitSizeRatio[i] = i + 1;
-        }
-        
         color = XMFLOAT4(1.0f, 1.0f, 1.0f, 5.0f);
-        XMFLOAT4 pos = XMFLOAT4(
-            r * cosf(theta) * cosf(phi),
-            r * sinf(theta),
-            r * cosf(theta) * sinf(phi),
-            0.0f
-        );
-        direction = XMFLOAT4(cosf(theta) * cosf(phi), sinf(theta), cosf(theta) * sinf(phi), 0.0f);
-
-        float upTheta = theta + XM_PIDIV2;
-        XMMATRIX viewMatrix = XMMatrixLookAtRH(
-            XMVectorSet(pos.x, pos.y, pos.z, 0.0f),
-            XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f),
-            XMVectorSet(cosf(upTheta) * cosf(phi), sinf(upTheta), cosf(upTheta) * sinf(phi), 0.0f)
-        );
-
+        cascadeSettings.cascadeCount = CSM_SPLIT_COUNT;
+        Update();
+        viewMatrix = XMMatrixIdentity();
         for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
-            float ratio = splitSizeRatio[i];
-            projectionMatrices[i] = XMMatrixOrthographicRH(baseWidth_ * ratio, baseHeight_ * ratio, baseNear_, baseFar_);
-            viewProjectionMatrices[i] = XMMatrixMultiply(viewMatrix, projectionMatrices[i]);
+            projectionMatrices[i] = XMMatrixIdentity();
+            viewProjectionMatrices[i] = XMMatrixIdentity();
+            atlasRects[i] = XMFLOAT4(0.0f, 0.0f, 1.0f, 0.0f);
         }
     };
 
     DirectionalLightInfo GetInfo() {
+        XMFLOAT4X4 first;
+        XMStoreFloat4x4(&first, projectionMatrices[0]);
+
         DirectionalLightInfo info;
         info.color = color;
         info.direction = direction;
         info.viewProjectionMatrix = viewProjectionMatrices[0];
-        info.splitSizeRatio.x = splitSizeRatio[0];
-        info.splitSizeRatio.y = splitSizeRatio[1];
-        info.splitSizeRatio.z = splitSizeRatio[2];
-        info.splitSizeRatio.w = splitSizeRatio[3];
+        info.cascadeSplits = XMFLOAT4(cascades.GetCascade(0).farDistance, cascades.GetCascade(1).farDistance,
+            cascades.GetCascade(2).farDistance, cascades.GetCascade(3).farDistance);
+        // the cascades share the view matrix and their orthographic projections differ only by scales and offsets
+        for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+            XMFLOAT4X4 m;
+            XMStoreFloat4x4(&m, projectionMatrices[i]);
+            XMFLOAT3 scale(m._11 / first._11, m._22 / first._22, m._33 / first._33);
+            info.cascadeScales[i] = XMFLOAT4(scale.x, scale.y, scale.z, 1.0f);
+            info.cascadeOffsets[i] = XMFLOAT4(m._41 - first._41 * scale.x, m._42 - first._42 * scale.y, m._43 - first._43 * scale.z, 0.0f);
+            info.cascadeAtlasRects[i] = atlasRects[i];
+        }
         return info;
     };
 
-    void Update(const XMFLOAT3& focus) {
-        XMFLOAT4 pos = XMFLOAT4(
-            r * cosf(theta) * cosf(phi) + focus.x,
-            r * sinf(theta) + focus.y,
-            r * cosf(theta) * sinf(phi) + focus.z,
-            0.0f
-        );
+    void Update() {
         direction = XMFLOAT4(cosf(theta) * cosf(phi), sinf(theta), cosf(theta) * sinf(phi), 0.0f);
+    };
 
-        float upTheta = theta + XM_PIDIV2;
-        XMMATRIX viewMatrix = XMMatrixLookAtRH(
-            XMVectorSet(pos.x, pos.y, pos.z, 0.0f),
-            XMVectorSet(focus.x, focus.y, focus.z, 0.0f),
-            XMVectorSet(cosf(upTheta) * cosf(phi), sinf(upTheta), cosf(upTheta) * sinf(phi), 0.0f)
+    // fits the cascades to the camera frustum and the scene bounds in world space
+    void UpdateCascades(const ShadowCascades::View& view, const ShadowCascades::Vector3& sceneMin, const ShadowCascades::Vector3& sceneMax) {
+        Update();
+        cascades.Build(cascadeSettings, view, { direction.x, direction.y, direction.z }, sceneMin, sceneMax);
+
+        // light space coordinates are the dot products with the axes, so the axes are the columns of the view matrix
+        const ShadowCascades::Vector3& r = cascades.GetLightRight();
+        const ShadowCascades::Vector3& u = cascades.GetLightUp();
+        const ShadowCascades::Vector3& d = cascades.GetLightDirection();
+        viewMatrix = XMMATRIX(
+            r.x, u.x, d.x, 0.0f,
+            r.y, u.y, d.y, 0.0f,
+            r.z, u.z, d.z, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f
         );
-
         for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+            const ShadowCascades::Cascade& cascade = cascades.GetCascade(i);
+            // the view looks along -z, the nearest depth to the light is max.z
+            projectionMatrices[i] = XMMatrixOrthographicOffCenterRH(cascade.min.x, cascade.max.x, cascade.min.y, cascade.max.y,
+                -cascade.max.z, -cascade.min.z);
             viewProjectionMatrices[i] = XMMatrixMultiply(viewMatrix, projectionMatrices[i]);
         }
     };
-
-private:
-    float baseWidth_ = 100.0f;
-    float baseHeight_ = 100.0f;
-    float baseNear_ = 0.01f;
-    float baseFar_ = 1000.0f;
-};
\ No newline at end of file
+};
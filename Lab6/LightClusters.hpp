@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// point lights assigned to the cells of a view space grid (screen tiles x exponential depth slices)
+class LightClusters {
+public:
+    struct Settings {
+        uint32_t tilesX = 16;
+        uint32_t tilesY = 9;
+        uint32_t slices = 24;
+        float projectionScaleX = 1.0f; // 1 / tan of the half horizontal field of view
+        float projectionScaleY = 1.0f; // 1 / tan of the half vertical field of view
+        float nearPlane = 0.1f;
+        float farPlane = 1000.0f;
+    };
+
+    struct Light {
+        float x = 0.0f; // view space position, the camera looks along -z
+        float y = 0.0f;
+        float z = 0.0f;
+        float radius = 0.0f;
+    };
+
+    struct Cluster {
+        uint32_t offset = 0; // in the light index list
+        uint32_t count = 0;
+    };
+
+    LightClusters() = default;
+
+    void Build(const Settings& settings, const Light* lights, uint32_t count) {
+        settings_ = settings;
+        clusters_.assign(settings_.tilesX * settings_.tilesY * settings_.slices, Cluster());
+        maxLightsPerCluster_ = 0;
+
+        float logRange = std::log(settings_.farPlane / settings_.nearPlane);
+        sliceScale_ = (float)settings_.slices / logRange;
+        sliceBias_ = -sliceScale_ * std::log(settings_.nearPlane);
+        sliceDepths_.resize(settings_.slices + 1);
+        for (uint32_t i = 0; i <= settings_.slices; ++i) {
+            sliceDepths_[i] = settings_.nearPlane * std::pow(settings_.farPlane / settings_.nearPlane, (float)i / settings_.slices);
+        }
+        ComputeTileSides(settings_.tilesX, settings_.projectionScaleX, sidesX_);
+        ComputeTileSides(settings_.tilesY, settings_.projectionScaleY, sidesY_);
+
+        // the lights are visited twice: the counts give the offsets of the lists, then the lists are written in place,
+        // which is cheaper than storing and scattering the pairs
+        for (uint32_t i = 0; i < count; ++i) {
+            AddLight<false>(lights[i], i);
+        }
+        uint32_t offset = 0;
+        for (auto& c : clusters_) {
+            c.offset = offset;
+            offset += c.count;
+            maxLightsPerCluster_ = (std::max)(maxLightsPerCluster_, c.count);
+            c.count = 0;
+        }
+        lightIndices_.resize(offset);
+        for (uint32_t i = 0; i < count; ++i) {
+            AddLight<true>(lights[i], i);
+        }
+    };
+
+    const Settings& GetSettings() const {
+        return settings_;
+    };
+
+    const std::vector<Cluster>& GetClusters() const {
+        return clusters_;
+    };
+
+    const std::vector<uint32_t>& GetLightIndices() const {
+        return lightIndices_;
+    };
+
+    uint32_t GetClusterIndex(uint32_t tileX, uint32_t tileY, uint32_t slice) const {
+        return (slice * settings_.tilesY + tileY) * settings_.tilesX + tileX;
+    };
+
+    // slice = floor(log(depth) * scale + bias), the same formula is used by the shaders
+    float GetSliceScale() const {
+        return sliceScale_;
+    };
+
+    float GetSliceBias() const {
+        return sliceBias_;
+    };
+
+    float GetSliceDepth(uint32_t slice) const {
+        return sliceDepths_[slice];
+    };
+
+    uint32_t GetMaxLightsPerCluster() const {
+        return maxLightsPerCluster_;
+    };
+
+    // sphere against the view space box of a cell; the box is larger than the cell, so the test is conservative
+    bool Intersects(const Light& light, uint32_t tileX, uint32_t tileY, uint32_t slice) const {
+        const TileSide* sidesX = &sidesX_[slice * (settings_.tilesX + 1)];
+        const TileSide* sidesY = &sidesY_[slice * (settings_.tilesY + 1)];
+        uint32_t rowY = settings_.tilesY - tileY - 1;
+        float distance = GetDistanceSq(light.z, -sliceDepths_[slice + 1], -sliceDepths_[slice]);
+        distance += GetDistanceSq(light.x, sidesX[tileX].low, sidesX[tileX + 1].high);
+        distance += GetDistanceSq(light.y, sidesY[rowY].low, sidesY[rowY + 1].high);
+        return distance <= light.radius * light.radius;
+    };
+
+    ~LightClusters() = default;
+
+private:
+    // view space coordinate of a side between two tiles, as the lower and as the upper bound of the box of a tile;
+    // the side is a plane through the camera, so the coordinate is taken at the depth of the slice that widens the box
+    struct TileSide {
+        float low;
+        float high;
+    };
+
+    template<bool write>
+    void AddLight(const Light& light, uint32_t index) {
+        float depth = -light.z;
+        if (light.radius <= 0.0f || depth + light.radius < settings_.nearPlane || depth - light.radius > settings_.farPlane) {
+            return;
+        }
+
+        uint32_t firstSlice = GetSlice(depth - light.radius);
+        uint32_t lastSlice = GetSlice(depth + light.radius);
+        for (uint32_t s = firstSlice; s <= lastSlice; ++s) {
+            // the part of the sphere inside the slice is bounded by the depths of both, x / depth is monotonic in depth
+            float minDepth = (std::max)(GetSliceDepth(s), depth - light.radius);
+            float maxDepth = (std::min)(GetSliceDepth(s + 1), depth + light.radius);
+            uint32_t firstX, lastX, firstY, lastY;
+            if (!GetTileRange(light.x, light.radius, minDepth, maxDepth, settings_.projectionScaleX, settings_.tilesX, false, firstX, lastX)
+                || !GetTileRange(light.y, light.radius, minDepth, maxDepth, settings_.projectionScaleY, settings_.tilesY, true, firstY, lastY)) {
+                continue;
+            }
+
+            // the boxes are axis aligned, so the squared distance to a box is a sum of separate terms for the axes
+            const TileSide* sidesX = &sidesX_[s * (settings_.tilesX + 1)];
+            const TileSide* sidesY = &sidesY_[s * (settings_.tilesY + 1)];
+            float radiusSq = light.radius * light.radius;
+            float distanceZ = GetDistanceSq(light.z, -sliceDepths_[s + 1], -sliceDepths_[s]);
+            for (uint32_t y = firstY; y <= lastY; ++y) {
+                uint32_t rowY = settings_.tilesY - y - 1; // rows go from the top, sides from the bottom
+                float distanceYZ = distanceZ + GetDistanceSq(light.y, sidesY[rowY].low, sidesY[rowY + 1].high);
+                if (distanceYZ > radiusSq) {
+                    continue;
+                }
+                for (uint32_t x = firstX; x <= lastX; ++x) {
+                    float distance = distanceYZ + GetDistanceSq(light.x, sidesX[x].low, sidesX[x + 1].high);
+                    if (distance <= radiusSq) {
+                        Cluster& cluster = clusters_[GetClusterIndex(x, y, s)];
+                        if (write) {
+                            lightIndices_[cluster.offset + cluster.count] = index;
+                        }
+                        ++cluster.count;
+                    }
+                }
+            }
+        }
+    };
+
+    static float GetDistanceSq(float value, float low, float high) {
+        float d = value - (std::max)(low, (std::min)(value, high));
+        return d * d;
+    };
+
+    // sides along one axis for every slice, counted from the negative end of the axis
+    void ComputeTileSides(uint32_t tiles, float projectionScale, std::vector<TileSide>& sides) const {
+        sides.resize(settings_.slices * (tiles + 1));
+        for (uint32_t s = 0; s < settings_.slices; ++s) {
+            for (uint32_t i = 0; i <= tiles; ++i) {
+                float ndc = 2.0f * i / tiles - 1.0f;
+                float nearSide = ndc * sliceDepths_[s] / projectionScale;
+                float farSide = ndc * sliceDepths_[s + 1] / projectionScale;
+                sides[s * (tiles + 1) + i] = { (std::min)(nearSide, farSide), (std::max)(nearSide, farSide) };
+            }
+        }
+    };
+
+    uint32_t GetSlice(float depth) const {
+        if (depth <= settings_.nearPlane) {
+            return 0;
+        }
+        float slice = std::floor(std::log(depth) * sliceScale_ + sliceBias_);
+        return (uint32_t)(std::min)((std::max)(slice, 0.0f), (float)(settings_.slices - 1));
+    };
+
+    // tiles covered by [center - radius, center + radius] projected at the depths in [minDepth, maxDepth],
+    // rows of tiles go from the top of the screen
+    static bool GetTileRange(float center, float radius, float minDepth, float maxDepth, float projectionScale, uint32_t tiles,
+        bool flip, uint32_t& first, uint32_t& last) {
+        float low = (std::min)((center - radius) / minDepth, (center - radius) / maxDepth) * projectionScale;
+        float high = (std::max)((center + radius) / minDepth, (center + radius) / maxDepth) * projectionScale;
+        if (high < -1.0f || low > 1.0f) {
+            return false;
+        }
+        if (flip) {
+            std::swap(low, high);
+            low = -low;
+            high = -high;
+        }
+        first = ToTile(low, tiles);
+        last = ToTile(high, tiles);
+        return true;
+    };
+
+    static uint32_t ToTile(float ndc, uint32_t tiles) {
+        float tile = std::floor((ndc * 0.5f + 0.5f) * tiles);
+        return (uint32_t)(std::min)((std::max)(tile, 0.0f), (float)(tiles - 1));
+    };
+
+    Settings settings_; // always remains only inside the class #
+    std::vector<Cluster> clusters_; // always remains only inside the class #
+    std::vector<uint32_t> lightIndices_; // always remains only inside the class #
+    std::vector<float> sliceDepths_; // always remains only inside the class #
+    std::vector<TileSide> sidesX_; // always remains only inside the class #
+    std::vector<TileSide> sidesY_; // always remains only inside the class #
+    float sliceScale_ = 0.0f; // always remains only inside the class #
+    float sliceBias_ = 0.0f; // always remains only inside the class #
+    uint32_t maxLightsPerCluster_ = 0; // always remains only inside the class #
+};
@@ -13,8 +13,9 @@ public:
         if (!device->IsInit()) {
             return E_FAIL;
         }
-        VSManager_ = std::make_shared<VSManager>(device);
-        PSManager_ = std::make_shared<PSManager>(device);
+        includeCache_ = std::make_shared<IncludeCache>();
+        VSManager_ = std::make_shared<VSManager>(device, includeCache_);
+        PSManager_ = std::make_shared<PSManager>(device, includeCache_);
         textureManager_ = std::make_shared<TextureManager>(device);
         stateManager_ = std::make_shared<StateManager>(device);
         return S_OK;
@@ -32,6 +33,10 @@ public:
         return PSManager_;
     };
 
+    std::shared_ptr<IncludeCache> GetIncludeCache() const {
+        return includeCache_;
+    };
+
     std::shared_ptr<TextureManager> GetTextureManager() const {
         return textureManager_;
     };
@@ -40,16 +45,25 @@ public:
         return stateManager_;
     };
 
+    // the include cache is shared by both managers, so the file is reread once and the shaders of both are dropped
+    void InvalidateInclude(const std::string& includeName) {
+        includeCache_->Invalidate(includeName);
+        VSManager_->DropDependents(includeName);
+        PSManager_->DropDependents(includeName);
+    };
+
     void Cleanup() {
         VSManager_->Cleanup();
         PSManager_->Cleanup();
         textureManager_->Cleanup();
         stateManager_->Cleanup();
+        includeCache_->Clear();
     };
 
     ~ManagerStorage() = default;
 
 private:
+    std::shared_ptr<IncludeCache> includeCache_; // transmitted outward ->
     std::shared_ptr<VSManager> VSManager_; // transmitted outward ->
     std::shared_ptr<PSManager> PSManager_; // transmitted outward ->
     std::shared_ptr<TextureManager> textureManager_; // transmitted outward ->
@@ -0,0 +1,591 @@
+#pragma once
+
+#include "framework.h"
+#include "CommandRecorder.hpp"
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+// The part of ID3D11DeviceContext used by the renderer, with the same names and arguments. D3D11RenderContext passes
+// the commands to a context; RecordingRenderContext counts them and passes them on if it has a context, without one
+// it is a null backend: nothing is drawn, Map gives CPU memory, the queries are finished at once. So the CPU side of
+// whole frames (traversal, state lookups, constant packing, sorting) can be measured without GPU work, and the commands
+// of a frame can be compared between versions.
+class RenderContext {
+public:
+    virtual ~RenderContext() = default;
+
+    virtual void ClearState() = 0;
+    virtual void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT classInstanceCount) = 0;
+    virtual void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT classInstanceCount) = 0;
+    virtual void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) = 0;
+    virtual void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) = 0;
+    virtual void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) = 0;
+    virtual void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) = 0;
+    // D3D11.1, only when the device supports constant buffer offsets
+    virtual void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants,
+        const UINT* constantCounts) = 0;
+    virtual void PSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants,
+        const UINT* constantCounts) = 0;
+    virtual void IASetInputLayout(ID3D11InputLayout* inputLayout) = 0;
+    virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+    virtual void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) = 0;
+    virtual void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) = 0;
+    virtual void RSSetState(ID3D11RasterizerState* state) = 0;
+    virtual void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) = 0;
+    virtual void RSSetScissorRects(UINT count, const D3D11_RECT* rects) = 0;
+    virtual void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) = 0;
+    virtual void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) = 0;
+    virtual void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) = 0;
+    virtual void OMSetRenderTargetsAndUnorderedAccessViews(UINT count, ID3D11RenderTargetView* const* views,
+        ID3D11DepthStencilView* depthStencilView, UINT UAVStartSlot, UINT UAVCount, ID3D11UnorderedAccessView* const* UAVs,
+        const UINT* UAVInitialCounts) = 0;
+    virtual void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) = 0;
+    virtual void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) = 0;
+    virtual void ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* view, const UINT values[4]) = 0;
+    virtual void Draw(UINT vertexCount, UINT startVertex) = 0;
+    virtual void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) = 0;
+    virtual void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance) = 0;
+    virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) = 0;
+    virtual void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch,
+        UINT depthPitch) = 0;
+    virtual HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) = 0;
+    virtual void Unmap(ID3D11Resource* resource, UINT subresource) = 0;
+    virtual void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) = 0;
+    virtual void CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+        ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) = 0;
+    virtual void GenerateMips(ID3D11ShaderResourceView* view) = 0;
+    virtual void End(ID3D11Asynchronous* async) = 0;
+    virtual HRESULT GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT flags) = 0;
+
+    // null unless the commands are recorded
+    virtual CommandRecorder* GetRecorder() {
+        return nullptr;
+    };
+};
+
+
+class D3D11RenderContext : public RenderContext {
+public:
+    explicit D3D11RenderContext(const std::shared_ptr<ID3D11DeviceContext>& context) : context_(context) {
+        if (FAILED(context_->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&context1_))) {
+            context1_ = nullptr;
+        }
+    };
+
+    ~D3D11RenderContext() {
+        SAFE_RELEASE(context1_);
+    };
+
+    void ClearState() override {
+        context_->ClearState();
+    };
+
+    void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT classInstanceCount) override {
+        context_->VSSetShader(shader, classInstances, classInstanceCount);
+    };
+
+    void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT classInstanceCount) override {
+        context_->PSSetShader(shader, classInstances, classInstanceCount);
+    };
+
+    void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) override {
+        context_->PSSetShaderResources(startSlot, count, views);
+    };
+
+    void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) override {
+        context_->PSSetSamplers(startSlot, count, samplers);
+    };
+
+    void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override {
+        context_->VSSetConstantBuffers(startSlot, count, buffers);
+    };
+
+    void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override {
+        context_->PSSetConstantBuffers(startSlot, count, buffers);
+    };
+
+    void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants,
+        const UINT* constantCounts) override {
+        context1_->VSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+    };
+
+    void PSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants,
+        const UINT* constantCounts) override {
+        context1_->PSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+    };
+
+    void IASetInputLayout(ID3D11InputLayout* inputLayout) override {
+        context_->IASetInputLayout(inputLayout);
+    };
+
+    void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override {
+        context_->IASetPrimitiveTopology(topology);
+    };
+
+    void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override {
+        context_->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+    };
+
+    void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override {
+        context_->IASetIndexBuffer(buffer, format, offset);
+    };
+
+    void RSSetState(ID3D11RasterizerState* state) override {
+        context_->RSSetState(state);
+    };
+
+    void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) override {
+        context_->RSSetViewports(count, viewports);
+    };
+
+    void RSSetScissorRects(UINT count, const D3D11_RECT* rects) override {
+        context_->RSSetScissorRects(count, rects);
+    };
+
+    void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override {
+        context_->OMSetBlendState(state, blendFactor, sampleMask);
+    };
+
+    void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override {
+        context_->OMSetDepthStencilState(state, stencilRef);
+    };
+
+    void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) override {
+        context_->OMSetRenderTargets(count, views, depthStencilView);
+    };
+
+    void OMSetRenderTargetsAndUnorderedAccessViews(UINT count, ID3D11RenderTargetView* const* views,
+        ID3D11DepthStencilView* depthStencilView, UINT UAVStartSlot, UINT UAVCount, ID3D11UnorderedAccessView* const* UAVs,
+        const UINT* UAVInitialCounts) override {
+        context_->OMSetRenderTargetsAndUnorderedAccessViews(count, views, depthStencilView, UAVStartSlot, UAVCount, UAVs, UAVInitialCounts);
+    };
+
+    void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) override {
+        context_->ClearRenderTargetView(view, color);
+    };
+
+    void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) override {
+        context_->ClearDepthStencilView(view, flags, depth, stencil);
+    };
+
+    void ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* view, const UINT values[4]) override {
+        context_->ClearUnorderedAccessViewUint(view, values);
+    };
+
+    void Draw(UINT vertexCount, UINT startVertex) override {
+        context_->Draw(vertexCount, startVertex);
+    };
+
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override {
+        context_->DrawIndexed(indexCount, startIndex, baseVertex);
+    };
+
+    void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance) override {
+        context_->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+    };
+
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override {
+        context_->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    };
+
+    void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch,
+        UINT depthPitch) override {
+        context_->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+    };
+
+    HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override {
+        return context_->Map(resource, subresource, mapType, mapFlags, mapped);
+    };
+
+    void Unmap(ID3D11Resource* resource, UINT subresource) override {
+        context_->Unmap(resource, subresource);
+    };
+
+    void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override {
+        context_->CopyResource(destination, source);
+    };
+
+    void CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+        ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) override {
+        context_->CopySubresourceRegion(destination, destinationSubresource, x, y, z, source, sourceSubresource, sourceBox);
+    };
+
+    void GenerateMips(ID3D11ShaderResourceView* view) override {
+        context_->GenerateMips(view);
+    };
+
+    void End(ID3D11Asynchronous* async) override {
+        context_->End(async);
+    };
+
+    HRESULT GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT flags) override {
+        return context_->GetData(async, data, dataSize, flags);
+    };
+
+private:
+    std::shared_ptr<ID3D11DeviceContext> context_; // provided externally <-
+    ID3D11DeviceContext1* context1_ = nullptr; // always remains only inside the class #
+};
+
+
+class RecordingRenderContext : public RenderContext {
+    using Command = CommandRecorder::Command;
+    using Stage = CommandRecorder::Stage;
+
+public:
+    // without a context the commands are only recorded
+    explicit RecordingRenderContext(const std::shared_ptr<RenderContext>& context = nullptr) : context_(context) {};
+
+    void ClearState() override {
+        recorder_.RecordCommand(Command::clearState);
+        if (context_) {
+            context_->ClearState();
+        }
+    };
+
+    void VSSetShader(ID3D11VertexShader* shader, ID3D11ClassInstance* const* classInstances, UINT classInstanceCount) override {
+        recorder_.RecordState(Command::setShader, Stage::vertex, shader);
+        if (context_) {
+            context_->VSSetShader(shader, classInstances, classInstanceCount);
+        }
+    };
+
+    void PSSetShader(ID3D11PixelShader* shader, ID3D11ClassInstance* const* classInstances, UINT classInstanceCount) override {
+        recorder_.RecordState(Command::setShader, Stage::pixel, shader);
+        if (context_) {
+            context_->PSSetShader(shader, classInstances, classInstanceCount);
+        }
+    };
+
+    void PSSetShaderResources(UINT startSlot, UINT count, ID3D11ShaderResourceView* const* views) override {
+        recorder_.RecordBind(Command::setShaderResources, Stage::pixel, startSlot, count, (const void* const*)views);
+        if (context_) {
+            context_->PSSetShaderResources(startSlot, count, views);
+        }
+    };
+
+    void PSSetSamplers(UINT startSlot, UINT count, ID3D11SamplerState* const* samplers) override {
+        recorder_.RecordBind(Command::setSamplers, Stage::pixel, startSlot, count, (const void* const*)samplers);
+        if (context_) {
+            context_->PSSetSamplers(startSlot, count, samplers);
+        }
+    };
+
+    void VSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override {
+        recorder_.RecordBind(Command::setConstantBuffers, Stage::vertex, startSlot, count, (const void* const*)buffers);
+        if (context_) {
+            context_->VSSetConstantBuffers(startSlot, count, buffers);
+        }
+    };
+
+    void PSSetConstantBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers) override {
+        recorder_.RecordBind(Command::setConstantBuffers, Stage::pixel, startSlot, count, (const void* const*)buffers);
+        if (context_) {
+            context_->PSSetConstantBuffers(startSlot, count, buffers);
+        }
+    };
+
+    void VSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants,
+        const UINT* constantCounts) override {
+        recorder_.RecordBind(Command::setConstantBuffers, Stage::vertex, startSlot, count, (const void* const*)buffers,
+            (const uint32_t*)firstConstants);
+        if (context_) {
+            context_->VSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+        }
+    };
+
+    void PSSetConstantBuffers1(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* firstConstants,
+        const UINT* constantCounts) override {
+        recorder_.RecordBind(Command::setConstantBuffers, Stage::pixel, startSlot, count, (const void* const*)buffers,
+            (const uint32_t*)firstConstants);
+        if (context_) {
+            context_->PSSetConstantBuffers1(startSlot, count, buffers, firstConstants, constantCounts);
+        }
+    };
+
+    void IASetInputLayout(ID3D11InputLayout* inputLayout) override {
+        recorder_.RecordState(Command::setInputLayout, Stage::inputAssembler, inputLayout);
+        if (context_) {
+            context_->IASetInputLayout(inputLayout);
+        }
+    };
+
+    void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override {
+        recorder_.RecordState(Command::setTopology, Stage::inputAssembler, (const void*)(uintptr_t)topology);
+        if (context_) {
+            context_->IASetPrimitiveTopology(topology);
+        }
+    };
+
+    void IASetVertexBuffers(UINT startSlot, UINT count, ID3D11Buffer* const* buffers, const UINT* strides, const UINT* offsets) override {
+        recorder_.RecordBind(Command::setVertexBuffers, Stage::inputAssembler, startSlot, count, (const void* const*)buffers,
+            (const uint32_t*)offsets);
+        if (context_) {
+            context_->IASetVertexBuffers(startSlot, count, buffers, strides, offsets);
+        }
+    };
+
+    void IASetIndexBuffer(ID3D11Buffer* buffer, DXGI_FORMAT format, UINT offset) override {
+        const void* object = buffer;
+        uint32_t indexOffset = offset;
+        recorder_.RecordBind(Command::setIndexBuffer, Stage::inputAssembler, 0, 1, &object, &indexOffset);
+        if (context_) {
+            context_->IASetIndexBuffer(buffer, format, offset);
+        }
+    };
+
+    void RSSetState(ID3D11RasterizerState* state) override {
+        recorder_.RecordState(Command::setRasterizerState, Stage::rasterizer, state);
+        if (context_) {
+            context_->RSSetState(state);
+        }
+    };
+
+    // the viewports and the scissor rectangles are values, every call counts as a change
+    void RSSetViewports(UINT count, const D3D11_VIEWPORT* viewports) override {
+        recorder_.RecordValues(Command::setViewports, Stage::rasterizer, count);
+        if (context_) {
+            context_->RSSetViewports(count, viewports);
+        }
+    };
+
+    void RSSetScissorRects(UINT count, const D3D11_RECT* rects) override {
+        recorder_.RecordValues(Command::setScissorRects, Stage::rasterizer, count);
+        if (context_) {
+            context_->RSSetScissorRects(count, rects);
+        }
+    };
+
+    void OMSetBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask) override {
+        recorder_.RecordState(Command::setBlendState, Stage::outputMerger, state);
+        if (context_) {
+            context_->OMSetBlendState(state, blendFactor, sampleMask);
+        }
+    };
+
+    void OMSetDepthStencilState(ID3D11DepthStencilState* state, UINT stencilRef) override {
+        recorder_.RecordState(Command::setDepthStencilState, Stage::outputMerger, state);
+        if (context_) {
+            context_->OMSetDepthStencilState(state, stencilRef);
+        }
+    };
+
+    void OMSetRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) override {
+        RecordRenderTargets(count, views, depthStencilView);
+        if (context_) {
+            context_->OMSetRenderTargets(count, views, depthStencilView);
+        }
+    };
+
+    void OMSetRenderTargetsAndUnorderedAccessViews(UINT count, ID3D11RenderTargetView* const* views,
+        ID3D11DepthStencilView* depthStencilView, UINT UAVStartSlot, UINT UAVCount, ID3D11UnorderedAccessView* const* UAVs,
+        const UINT* UAVInitialCounts) override {
+        RecordRenderTargets(count, views, depthStencilView);
+        recorder_.RecordBind(Command::setRenderTargets, Stage::pixel, UAVStartSlot, UAVCount, (const void* const*)UAVs);
+        if (context_) {
+            context_->OMSetRenderTargetsAndUnorderedAccessViews(count, views, depthStencilView, UAVStartSlot, UAVCount, UAVs, UAVInitialCounts);
+        }
+    };
+
+    void ClearRenderTargetView(ID3D11RenderTargetView* view, const FLOAT color[4]) override {
+        recorder_.RecordCommand(Command::clear);
+        if (context_) {
+            context_->ClearRenderTargetView(view, color);
+        }
+    };
+
+    void ClearDepthStencilView(ID3D11DepthStencilView* view, UINT flags, FLOAT depth, UINT8 stencil) override {
+        recorder_.RecordCommand(Command::clear);
+        if (context_) {
+            context_->ClearDepthStencilView(view, flags, depth, stencil);
+        }
+    };
+
+    void ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView* view, const UINT values[4]) override {
+        recorder_.RecordCommand(Command::clear);
+        if (context_) {
+            context_->ClearUnorderedAccessViewUint(view, values);
+        }
+    };
+
+    void Draw(UINT vertexCount, UINT startVertex) override {
+        recorder_.RecordDraw(Command::draw, vertexCount, 1);
+        if (context_) {
+            context_->Draw(vertexCount, startVertex);
+        }
+    };
+
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex) override {
+        recorder_.RecordDraw(Command::drawIndexed, indexCount, 1);
+        if (context_) {
+            context_->DrawIndexed(indexCount, startIndex, baseVertex);
+        }
+    };
+
+    void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance) override {
+        recorder_.RecordDraw(Command::drawInstanced, vertexCount, instanceCount);
+        if (context_) {
+            context_->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+        }
+    };
+
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance) override {
+        recorder_.RecordDraw(Command::drawIndexedInstanced, indexCount, instanceCount);
+        if (context_) {
+            context_->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+        }
+    };
+
+    void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch,
+        UINT depthPitch) override {
+        recorder_.RecordUpload(Command::upload, GetUploadSize(resource, subresource, box, rowPitch, depthPitch));
+        if (context_) {
+            context_->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+        }
+    };
+
+    HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP mapType, UINT mapFlags, D3D11_MAPPED_SUBRESOURCE* mapped) override {
+        UINT rowPitch, depthPitch;
+        size_t size = GetSize(resource, rowPitch, depthPitch);
+        if (mapType == D3D11_MAP_READ) {
+            recorder_.RecordCommand(Command::map);
+        }
+        else {
+            // the whole mapped range, the renderer writes only a part of the ring buffers
+            recorder_.RecordUpload(Command::map, size);
+        }
+        if (context_) {
+            return context_->Map(resource, subresource, mapType, mapFlags, mapped);
+        }
+
+        std::vector<uint8_t>& memory = memory_[resource];
+        if (memory.size() < size) {
+            memory.resize(size);
+        }
+        mapped->pData = memory.data();
+        mapped->RowPitch = rowPitch;
+        mapped->DepthPitch = depthPitch;
+        return S_OK;
+    };
+
+    void Unmap(ID3D11Resource* resource, UINT subresource) override {
+        if (context_) {
+            context_->Unmap(resource, subresource);
+        }
+    };
+
+    void CopyResource(ID3D11Resource* destination, ID3D11Resource* source) override {
+        recorder_.RecordCommand(Command::copy);
+        if (context_) {
+            context_->CopyResource(destination, source);
+        }
+    };
+
+    void CopySubresourceRegion(ID3D11Resource* destination, UINT destinationSubresource, UINT x, UINT y, UINT z,
+        ID3D11Resource* source, UINT sourceSubresource, const D3D11_BOX* sourceBox) override {
+        recorder_.RecordCommand(Command::copy);
+        if (context_) {
+            context_->CopySubresourceRegion(destination, destinationSubresource, x, y, z, source, sourceSubresource, sourceBox);
+        }
+    };
+
+    void GenerateMips(ID3D11ShaderResourceView* view) override {
+        recorder_.RecordCommand(Command::generateMips);
+        if (context_) {
+            context_->GenerateMips(view);
+        }
+    };
+
+    void End(ID3D11Asynchronous* async) override {
+        recorder_.RecordCommand(Command::query);
+        if (context_) {
+            context_->End(async);
+        }
+    };
+
+    // without a context every query is finished, an event query returns TRUE and the others zeros
+    HRESULT GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT flags) override {
+        if (context_) {
+            return context_->GetData(async, data, dataSize, flags);
+        }
+        if (!!data && dataSize > 0) {
+            memset(data, 0, dataSize);
+            if (dataSize == sizeof(BOOL)) {
+                *(BOOL*)data = TRUE;
+            }
+        }
+        return S_OK;
+    };
+
+    CommandRecorder* GetRecorder() override {
+        return &recorder_;
+    };
+
+private:
+    void RecordRenderTargets(UINT count, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthStencilView) {
+        recorder_.RecordBind(Command::setRenderTargets, Stage::outputMerger, 0, count, (const void* const*)views);
+        const void* depth = depthStencilView;
+        recorder_.RecordBind(Command::setRenderTargets, Stage::outputMerger, D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, 1, &depth);
+    };
+
+    // bytes of the buffers and of the first mip of the textures, with 16 bytes per texel (the widest format used),
+    // enough for the memory the null backend maps
+    static size_t GetSize(ID3D11Resource* resource, UINT& rowPitch, UINT& depthPitch) {
+        D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+        resource->GetType(&dimension);
+        rowPitch = 0;
+        depthPitch = 0;
+        if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER) {
+            D3D11_BUFFER_DESC desc;
+            static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+            rowPitch = depthPitch = desc.ByteWidth;
+        }
+        else if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D) {
+            D3D11_TEXTURE2D_DESC desc;
+            static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+            rowPitch = desc.Width * 16;
+            depthPitch = rowPitch * desc.Height;
+        }
+        else if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE3D) {
+            D3D11_TEXTURE3D_DESC desc;
+            static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+            rowPitch = desc.Width * 16;
+            depthPitch = rowPitch * desc.Height;
+            return (size_t)depthPitch * desc.Depth;
+        }
+        return depthPitch;
+    };
+
+    // a box of a buffer is in bytes, rows and slices of a texture are rowPitch and depthPitch bytes long as given by the
+    // caller; without a box the whole mip level of the subresource is written
+    static uint64_t GetUploadSize(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, UINT rowPitch, UINT depthPitch) {
+        D3D11_RESOURCE_DIMENSION dimension = D3D11_RESOURCE_DIMENSION_UNKNOWN;
+        resource->GetType(&dimension);
+        if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER) {
+            UINT bufferRowPitch, bufferDepthPitch;
+            return !!box ? box->right - box->left : GetSize(resource, bufferRowPitch, bufferDepthPitch);
+        }
+        if (!!box) {
+            return (uint64_t)rowPitch * (box->bottom - box->top) * (box->back - box->front);
+        }
+        if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D) {
+            D3D11_TEXTURE2D_DESC desc;
+            static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+            UINT mip = subresource % desc.MipLevels; // the mip levels of each array slice follow each other
+            return (uint64_t)rowPitch * (std::max)(desc.Height >> mip, 1u);
+        }
+        if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE3D) {
+            D3D11_TEXTURE3D_DESC desc;
+            static_cast<ID3D11Texture3D*>(resource)->GetDesc(&desc);
+            return (uint64_t)depthPitch * (std::max)(desc.Depth >> subresource, 1u); // a volume texture has no array slices
+        }
+        return 0;
+    };
+
+    std::shared_ptr<RenderContext> context_; // provided externally <-
+    CommandRecorder recorder_;
+    std::unordered_map<ID3D11Resource*, std::vector<uint8_t>> memory_; // the mapped memory of the null backend
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+
+// List of draw packets sorted by 64-bit keys. The key is composed from high to low bits of
+// pass | shader permutation | material | state | depth, so sorted packets are grouped by
+// the most expensive bindings.
+class RenderQueue {
+public:
+    struct DrawPacket {
+        uint64_t key = 0;
+        uint32_t index = 0; // index of the draw item in the array of the caller
+    };
+
+    static const uint32_t passBits = 4;
+    static const uint32_t permutationBits = 12;
+    static const uint32_t materialBits = 16;
+    static const uint32_t stateBits = 8;
+    static const uint32_t depthBits = 24;
+
+    // depth is expected in [0, 1], smaller values are drawn first
+    static uint64_t MakeKey(uint32_t pass, uint32_t permutation, uint32_t material, uint32_t state, float depth) {
+        uint64_t key = Field(pass, passBits);
+        key = (key << permutationBits) | Field(permutation, permutationBits);
+        key = (key << materialBits) | Field(material, materialBits);
+        key = (key << stateBits) | Field(state, stateBits);
+        key = (key << depthBits) | QuantizeDepth(depth);
+        return key;
+    };
+
+    // for passes where the order is defined by depth only (blending)
+    static uint64_t MakeDepthKey(uint32_t pass, float depth) {
+        return (Field(pass, passBits) << (64 - passBits)) | (QuantizeDepth(depth) << (64 - passBits - depthBits));
+    };
+
+    void Clear() {
+        packets_.clear();
+    };
+
+    void Push(uint64_t key, uint32_t index) {
+        packets_.push_back({ key, index });
+    };
+
+    // stable LSD radix sort by bytes, the bytes that are equal for all keys are skipped
+    void Sort() {
+        if (packets_.size() < 2) {
+            return;
+        }
+
+        scratch_.resize(packets_.size());
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            size_t counts[256] = {};
+            for (auto& p : packets_) {
+                ++counts[(p.key >> shift) & 0xFF];
+            }
+            if (counts[(packets_[0].key >> shift) & 0xFF] == packets_.size()) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (auto& c : counts) {
+                size_t count = c;
+                c = offset;
+                offset += count;
+            }
+            for (auto& p : packets_) {
+                scratch_[counts[(p.key >> shift) & 0xFF]++] = p;
+            }
+            packets_.swap(scratch_);
+        }
+    };
+
+    const std::vector<DrawPacket>& GetPackets() const {
+        return packets_;
+    };
+
+    size_t Size() const {
+        return packets_.size();
+    };
+
+    bool Empty() const {
+        return packets_.empty();
+    };
+
+    ~RenderQueue() = default;
+
+private:
+    static uint64_t Field(uint32_t value, uint32_t bits) {
+        return (uint64_t)value & ((1ull << bits) - 1);
+    };
+
+    static uint64_t QuantizeDepth(float depth) {
+        const float maxValue = (float)((1u << depthBits) - 1);
+        return (uint64_t)((std::min)((std::max)(depth, 0.0f), 1.0f) * maxValue);
+    };
+
+    std::vector<DrawPacket> packets_; // always remains only inside the class #
+    std::vector<DrawPacket> scratch_; // always remains only inside the class #
+};
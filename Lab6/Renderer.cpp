@@ -6,6 +6,7 @@ Renderer& Renderer::GetInstance() {
 }
 
 bool Renderer::Init(HINSTANCE hInstance, HWND hWnd) {
+    CPU_PROFILE_SCOPE("Renderer::Init");
     IDXGIFactory* factory = nullptr;
     IDXGIAdapter* adapter = nullptr;
     HRESULT result = CreateDXGIFactory(__uuidof(IDXGIFactory), (void**)&factory);
@@ -30,12 +31,16 @@ bool Renderer::Init(HINSTANCE hInstance, HWND hWnd) {
         factory_ = std::shared_ptr<IDXGIFactory>(factory, utilities::DXPtrDeleter<IDXGIFactory*>);
         selectedAdapter_ = std::shared_ptr<IDXGIAdapter>(adapter, utilities::DXPtrDeleter<IDXGIAdapter*>);
         device_ = std::shared_ptr<Device>(new Device());
+#ifdef _DEBUG
+        result = device_->Init(selectedAdapter_, true);
+#else
         result = device_->Init(selectedAdapter_);
+#endif
     }
 #ifdef _DEBUG 
     if (SUCCEEDED(result)) {
         ID3DUserDefinedAnnotation* annotationPtr = nullptr;
-        result = device_->GetDeviceContext()->QueryInterface(__uuidof(annotationPtr), reinterpret_cast<void**>(&annotationPtr));
+        result = device_->GetD3DDeviceContext()->QueryInterface(__uuidof(annotationPtr), reinterpret_cast<void**>(&annotationPtr));
         if (SUCCEEDED(result)) {
             annotation_ = std::shared_ptr<ID3DUserDefinedAnnotation>(annotationPtr, utilities::DXPtrDeleter<ID3DUserDefinedAnnotation*>);
         }
@@ -45,9 +50,46 @@ bool Renderer::Init(HINSTANCE hInstance, HWND hWnd) {
         result = swapChain_.Init(factory_, device_, hWnd, width_, height_);
     }
     if (SUCCEEDED(result)) {
-        managerStorage_ = std::shared_ptr<ManagerStorage>(new ManagerStorage());
-        result = managerStorage_->Init(device_);
+        result = InitResources();
+    }
+    if (SUCCEEDED(result)) {
+        result = InitImgui(hWnd);
+    }
+
+    if (FAILED(result)) {
+        Cleanup();
+    }
+
+    return SUCCEEDED(result);
+}
+
+bool Renderer::InitHeadless(UINT width, UINT height) {
+    CPU_PROFILE_SCOPE("Renderer::InitHeadless");
+    headless_ = true;
+    width_ = width;
+    height_ = height;
+    viewport_.Width = (FLOAT)width_;
+    viewport_.Height = (FLOAT)height_;
+
+    device_ = std::shared_ptr<Device>(new Device());
+    HRESULT result = device_->InitHeadless();
+    if (SUCCEEDED(result)) {
+        result = swapChain_.InitHeadless(device_, width_, height_);
     }
+    if (SUCCEEDED(result)) {
+        result = InitResources();
+    }
+
+    if (FAILED(result)) {
+        Cleanup();
+    }
+
+    return SUCCEEDED(result);
+}
+
+HRESULT Renderer::InitResources() {
+    managerStorage_ = std::shared_ptr<ManagerStorage>(new ManagerStorage());
+    HRESULT result = managerStorage_->Init(device_);
     if (SUCCEEDED(result)) {
         result = GenerateTextures();
     }
@@ -79,17 +121,13 @@ bool Renderer::Init(HINSTANCE hInstance, HWND hWnd) {
         result = toneMapping_.Init(device_, managerStorage_, width_, height_);
     }
     if (SUCCEEDED(result)) {
-        result = InitImgui(hWnd);
+        result = transientTextures_.Init(device_);
     }
-
-    if (FAILED(result)) {
-        Cleanup();
-    }
-
-    return SUCCEEDED(result);
+    return result;
 }
 
 HRESULT Renderer::GenerateTextures() {
+    CPU_PROFILE_SCOPE("Renderer::GenerateTextures");
     CubemapGenerator cubeMapGen(device_, managerStorage_);
     HRESULT result = cubeMapGen.Init();
     if (SUCCEEDED(result)) {
@@ -114,12 +152,13 @@ HRESULT Renderer::InitImgui(HWND hWnd) {
     ImGui::StyleColorsDark();
     bool result = ImGui_ImplWin32_Init(hWnd);
     if (result) {
-        result = ImGui_ImplDX11_Init(device_->GetDevice().get(), device_->GetDeviceContext().get());
+        result = ImGui_ImplDX11_Init(device_->GetDevice().get(), device_->GetD3DDeviceContext().get());
     }
     return result ? S_OK : E_FAIL;
 }
 
 void Renderer::UpdateImgui() {
+    CPU_PROFILE_SCOPE("Renderer::UpdateImgui");
     ImGui_ImplDX11_NewFrame();
     ImGui_ImplWin32_NewFrame();
     ImGui::NewFrame();
@@ -183,6 +222,13 @@ void Renderer::UpdateImgui() {
 
         ImGui::Checkbox("Deferred render", &sceneManager_.deferredRender);
         ImGui::Checkbox("Exclude transparent", &sceneManager_.excludeTransparent);
+        ImGui::Checkbox("Instancing", &sceneManager_.instancing);
+        if (!sceneManager_.excludeTransparent) {
+            int sortMode = (int)sceneManager_.transparentSortMode;
+            if (ImGui::Combo("Transparent sorting", &sortMode, "closest point\0farthest point\0centroid\0gpu readback (debug)\0")) {
+                sceneManager_.transparentSortMode = (SceneManager::TransparentSortMode)sortMode;
+            }
+        }
 
         if (default_) {
             static float factor;
@@ -190,6 +236,26 @@ void Renderer::UpdateImgui() {
             ImGui::DragFloat("Exposure factor", &factor, 0.01f, 0.0f, 10.0f);
             toneMapping_.SetFactor(factor);
 
+            int meteringMode = (int)toneMapping_.GetMeteringMode();
+            if (ImGui::Combo("Exposure metering", &meteringMode, "brightness chain\0histogram\0")) {
+                toneMapping_.SetMeteringMode((ToneMapping::MeteringMode)meteringMode);
+            }
+            if (toneMapping_.GetMeteringMode() == ToneMapping::MeteringMode::histogram) {
+                ExposureHistogram::Settings histogramSettings = toneMapping_.GetHistogramSettings();
+                ImGui::DragFloatRange2("Metered percentiles", &histogramSettings.lowPercentile, &histogramSettings.highPercentile, 0.01f,
+                    0.0f, 1.0f);
+                int centerWeight = (int)histogramSettings.centerWeight;
+                ImGui::DragInt("Center weight", &centerWeight, 0.1f, 1, 16);
+                histogramSettings.centerWeight = (uint32_t)centerWeight;
+                toneMapping_.SetHistogramSettings(histogramSettings);
+            }
+
+            ToneCurveLut::Settings toneCurveSettings = toneMapping_.GetToneCurveSettings();
+            ImGui::DragFloat("White point", &toneCurveSettings.whitePoint, 0.1f, 1.0f, 64.0f);
+            ImGui::DragFloat("Saturation", &toneCurveSettings.saturation, 0.01f, 0.0f, 2.0f);
+            ImGui::ColorEdit3("Color filter", &toneCurveSettings.colorFilter.r);
+            toneMapping_.SetToneCurveSettings(toneCurveSettings);
+
             ImGui::Checkbox("With SSAO", &sceneManager_.withSSAO);
         }
 
@@ -218,26 +284,117 @@ void Renderer::UpdateImgui() {
 
             ImGui::DragFloat("Theta", &dirLight_->theta, 0.01f, -XM_PIDIV2, XM_PIDIV2);
 
-            ImGui::DragFloat("Distance", &dirLight_->r, 1.0f, 100.0f, 300.0f);
+            ImGui::DragFloat("Cascade split lambda", &dirLight_->cascadeSettings.splitLambda, 0.01f, 0.0f, 1.0f);
+
+            ImGui::DragFloat("Shadow distance", &dirLight_->cascadeSettings.shadowDistance, 1.0f, 10.0f, 800.0f);
+
+            ImGui::Checkbox("Stable cascades", &dirLight_->cascadeSettings.stabilize);
+
+            ImGui::Checkbox("Cache static shadows", &sceneManager_.cacheShadows);
 
-            static float focus[3];
-            focus[0] = dirLightFocus.x;
-            focus[1] = dirLightFocus.y;
-            focus[2] = dirLightFocus.z;
-            ImGui::DragFloat3("Directional light focus position", focus, 1.0f, -115.0f, 115.0f);
-            dirLightFocus = XMFLOAT3(focus[0], focus[1], focus[2]);
-            dirLight_->Update(dirLightFocus);
+            ImGui::DragInt("Shadow memory budget (MB)", &sceneManager_.shadowMemoryBudgetMB, 1, 16, 512);
 
             ImGui::DragInt("Shadow depth bias", &sceneManager_.depthBias, 1, 0, 32);
 
             ImGui::DragFloat("Shadow slope scale bias", &sceneManager_.slopeScaleBias, 0.1f, 0.0f, 10.0f);
         }
 
+        const StateManager::Statistics& stateStatistics = managerStorage_->GetStateManager()->GetFrameStatistics();
+        ImGui::Text("State cache per frame: %u hits, %u misses", stateStatistics.hits, stateStatistics.misses);
+        const SceneManager::RenderStatistics& renderStatistics = sceneManager_.GetRenderStatistics();
+        ImGui::Text("Scene draws: %u, binds: %u, skipped binds: %u", renderStatistics.draws, renderStatistics.binds, renderStatistics.skippedBinds);
+        ImGui::Text("Instanced draws saved: %u, EXT_mesh_gpu_instancing instances: %u, drawn in all passes: %u",
+            renderStatistics.instancedDrawsSaved, renderStatistics.meshInstances, renderStatistics.drawnMeshInstances);
+        ImGui::Text("Scene nodes: %u, updated transformations: %u (%.1f us)", renderStatistics.nodes, renderStatistics.updatedTransformations,
+            renderStatistics.transformationTime);
+        ImGui::Text("Scene primitives visible: %u, culled: %u (%.1f us)", renderStatistics.visiblePrimitives, renderStatistics.culledPrimitives,
+            renderStatistics.cullingTime);
+        ImGui::Text("Shadow casters per cascade: %u, %u, %u, %u of %u", renderStatistics.shadowCasters[0], renderStatistics.shadowCasters[1],
+            renderStatistics.shadowCasters[2], renderStatistics.shadowCasters[3], renderStatistics.shadowCasterCandidates);
+        ImGui::Text("Shadow texels inside the view per cascade: %.2f, %.2f, %.2f, %.2f", renderStatistics.shadowCoverage[0],
+            renderStatistics.shadowCoverage[1], renderStatistics.shadowCoverage[2], renderStatistics.shadowCoverage[3]);
+        ImGui::Text("Shadow cascades redrawn: %u, scrolled: %u, with dynamic casters: %u", renderStatistics.shadowCascadesRedrawn,
+            renderStatistics.shadowCascadesScrolled, renderStatistics.shadowCascadesComposited);
+        ImGui::Text("Shadow atlas %ux%u: tiles %u, %u, %u, %u (%.0f%% used), screen shares %.2f, %.2f, %.2f, %.2f",
+            renderStatistics.shadowAtlasSize, renderStatistics.shadowAtlasSize, renderStatistics.shadowTileSizes[0],
+            renderStatistics.shadowTileSizes[1], renderStatistics.shadowTileSizes[2], renderStatistics.shadowTileSizes[3],
+            renderStatistics.shadowAtlasUsage * 100.0f, renderStatistics.shadowScreenCoverage[0], renderStatistics.shadowScreenCoverage[1],
+            renderStatistics.shadowScreenCoverage[2], renderStatistics.shadowScreenCoverage[3]);
+        ImGui::Text("Shadow VRAM: %.1f MB (%u separate 4096x4096 maps would take %.1f MB)",
+            renderStatistics.shadowMemoryBytes / (1024.0f * 1024.0f), CSM_SPLIT_COUNT, CSM_SPLIT_COUNT * 4096.0f * 4096.0f * 4 / (1024.0f * 1024.0f));
+        ImGui::Text("Heap allocations per frame: %llu, frame arena: %zu bytes", frameHeapAllocations_, renderStatistics.frameArenaBytes);
+        ImGui::Text("Scene constant buffer uploads per frame: %zu bytes", renderStatistics.constantBufferBytes);
+        if (renderStatistics.dynamicConstantsSupported) {
+            ImGui::Text("Constant ring: %zu of %zu bytes in use, %zu padding bytes, %u uploads outside the ring",
+                renderStatistics.dynamicConstantsUsedBytes, renderStatistics.dynamicConstantsCapacity,
+                renderStatistics.dynamicConstantsPaddingBytes, renderStatistics.dynamicConstantsFallbacks);
+        }
+        else {
+            ImGui::Text("Constant ring: not supported, UpdateSubresource is used");
+        }
+        if (!sceneManager_.excludeTransparent) {
+            ImGui::Text("Transparent primitives: %u, order mismatches with GPU readback: %u", renderStatistics.transparentPrimitives,
+                renderStatistics.transparentOrderMismatches);
+        }
+        ImGui::Text("Point lights: %u, clustered light references: %u, max per cluster: %u (%.1f us)", renderStatistics.pointLights,
+            renderStatistics.clusteredLightIndices, renderStatistics.maxLightsPerCluster, renderStatistics.lightBinningTime);
+        if (sceneManager_.deferredRender) {
+            ImGui::Text("Light volumes shaded: %u (%u with the camera inside), culled: %u, too small: %u", renderStatistics.shadedPointLights,
+                renderStatistics.insidePointLights, renderStatistics.culledPointLights, renderStatistics.smallPointLights);
+        }
+        if (default_) {
+            const ReadbackRing::Statistics& readbackStatistics = toneMapping_.GetReadback().GetStatistics();
+            ImGui::Text("Exposure readback: %u frames late, %llu maps would wait, %llu values dropped", readbackStatistics.lastLatency,
+                readbackStatistics.misses, readbackStatistics.drops);
+            if (toneMapping_.GetMeteringMode() == ToneMapping::MeteringMode::histogram) {
+                const ExposureHistogram::Metering& metering = toneMapping_.GetMetering();
+                ImGui::Text("Metered luminance: %.3f, percentiles at %.3f..%.3f", metering.averageLuminance, metering.lowLuminance,
+                    metering.highLuminance);
+            }
+            ImGui::Text("Tone LUT %ux%ux%u baked %u times", ToneCurveLut::size, ToneCurveLut::size, ToneCurveLut::size,
+                toneMapping_.GetToneLutBakeCount());
+        }
+        const FrameGraph::Statistics& graphStatistics = frameGraph_.GetStatistics();
+        ImGui::Text("Frame graph: %u passes (%u culled), %u transient textures in %u", graphStatistics.passes,
+            graphStatistics.culledPasses, graphStatistics.textures, graphStatistics.physicalTextures);
+        ImGui::Text("Transient memory: %.1f MB (%.1f MB without aliasing, peak live %.1f MB), pool %.1f MB, %u textures created",
+            graphStatistics.physicalBytes / (1024.0f * 1024.0f), graphStatistics.textureBytes / (1024.0f * 1024.0f),
+            graphStatistics.peakBytes / (1024.0f * 1024.0f), transientTextures_.GetStatistics().bytes / (1024.0f * 1024.0f),
+            transientTextures_.GetStatistics().created);
+        CommandRecorder* recorder = device_->GetDeviceContext()->GetRecorder();
+        if (!!recorder) {
+            const CommandRecorder::Statistics& commandStatistics = recorder->GetStatistics();
+            ImGui::Text("Commands per frame: %u, draws: %u, binds: %u, state changes: %u, redundant binds: %u", commandStatistics.commands,
+                commandStatistics.draws, commandStatistics.binds, commandStatistics.stateChanges, commandStatistics.redundantBinds);
+            ImGui::Text("Uploads per frame: %u, %llu bytes, copies: %u, clears: %u", commandStatistics.uploads,
+                commandStatistics.uploadBytes, commandStatistics.copies, commandStatistics.clears);
+        }
+
+        if (ImGui::TreeNode("CPU profiler")) {
+            CpuProfiler& profiler = CpuProfiler::Get();
+            bool profiling = profiler.IsEnabled();
+            if (ImGui::Checkbox("Enabled", &profiling)) {
+                profiler.SetEnabled(profiling);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Write Chrome trace")) {
+                profiler.WriteChromeTrace("cpu_trace.json");
+            }
+            uint64_t frameBegin, frameEnd;
+            profiler.GetLastFrame(frameBegin, frameEnd);
+            profiler.GetEvents(profilerEvents_, frameBegin, frameEnd);
+            ImGui::Text("Last frame: %.3f ms", (frameEnd - frameBegin) / 1e6);
+            for (const CpuProfiler::Event& event : profilerEvents_) {
+                ImGui::Text("%*s%s: %.3f ms", (int)event.depth * 2, "", event.name, (event.end - event.begin) / 1e6);
+            }
+            ImGui::TreePop();
+        }
+
         if (!shadowSplits_ && (default_ || !sceneManager_.withSSAO)) {
             ImGui::Text("Point lights");
             ImGui::SameLine();
             if (ImGui::Button("+")) {
-                if (lights_.size() < MAX_LIGHT)
+                if (lights_.size() < MAX_POINT_LIGHT)
                     lights_.push_back({ XMFLOAT4(15.0f, 15.0f, 15.0f, 0.0f), XMFLOAT4(1.0f, 1.0f, 1.0f, 3000.0f) });
             }
             ImGui::SameLine();
@@ -245,37 +402,41 @@ void Renderer::UpdateImgui() {
                 if (lights_.size() > 0)
                     lights_.pop_back();
             }
+            ImGui::SameLine();
+            if (ImGui::Button("+256 scattered")) {
+                for (int i = 0; i < 256 && lights_.size() < MAX_POINT_LIGHT; ++i) {
+                    lights_.push_back({
+                        XMFLOAT4(-115.0f + rand() / (RAND_MAX / 230.0f), 1.0f + rand() / (RAND_MAX / 30.0f), -115.0f + rand() / (RAND_MAX / 230.0f), 1.0f),
+                        XMFLOAT4(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, 50.0f)
+                    });
+                }
+            }
 
+            ImGui::DragFloat("Smooth clamp point light radiance limit", &sceneManager_.smoothClampRadianceLimit, 0.01f, 0.2f, 10.0f);
+            ImGui::DragFloat("Clamp point light radiance limit", &sceneManager_.clampRadianceLimit, 0.01f, 0.1f, 10.0f);
             if (sceneManager_.deferredRender) {
-                ImGui::DragFloat("Smooth clamp point light radiance limit", &sceneManager_.smoothClampRadianceLimit, 0.01f, 0.2f, 10.0f);
-                ImGui::DragFloat("Clamp point light radiance limit", &sceneManager_.clampRadianceLimit, 0.01f, 0.1f, 10.0f);
+                ImGui::DragFloat("Min point light screen radius", &sceneManager_.minPointLightScreenRadius, 0.1f, 0.0f, 16.0f);
             }
 
-            static float col[MAX_LIGHT][3];
-            static float pos[MAX_LIGHT][3];
-            static float brightness[MAX_LIGHT];
-            for (int i = 0; i < lights_.size(); i++) {
-                std::string str = "Light " + std::to_string(i);
-                ImGui::Text(str.c_str());
-
-                pos[i][0] = lights_[i].pos.x;
-                pos[i][1] = lights_[i].pos.y;
-                pos[i][2] = lights_[i].pos.z;
-                str = "Pos " + std::to_string(i);
-                ImGui::DragFloat3(str.c_str(), pos[i], 1.0f, -115.0f, 115.0f);
-                lights_[i].pos = XMFLOAT4(pos[i][0], pos[i][1], pos[i][2], 1.0f);
-
-                col[i][0] = lights_[i].color.x;
-                col[i][1] = lights_[i].color.y;
-                col[i][2] = lights_[i].color.z;
-                str = "Color " + std::to_string(i);
-                ImGui::ColorEdit3(str.c_str(), col[i]);
-                lights_[i].color = XMFLOAT4(col[i][0], col[i][1], col[i][2], lights_[i].color.w);
-
-                brightness[i] = lights_[i].color.w;
-                str = "Brightness " + std::to_string(i);
-                ImGui::DragFloat(str.c_str(), &brightness[i], 10.0f, 1.0f, 10000.0f);
-                lights_[i].color.w = brightness[i];
+            if (ImGui::TreeNode("Light list")) {
+                for (int i = 0; i < lights_.size(); i++) {
+                    std::string str = "Light " + std::to_string(i);
+                    ImGui::Text(str.c_str());
+
+                    float pos[3] = { lights_[i].pos.x, lights_[i].pos.y, lights_[i].pos.z };
+                    str = "Pos " + std::to_string(i);
+                    ImGui::DragFloat3(str.c_str(), pos, 1.0f, -115.0f, 115.0f);
+                    lights_[i].pos = XMFLOAT4(pos[0], pos[1], pos[2], 1.0f);
+
+                    float col[3] = { lights_[i].color.x, lights_[i].color.y, lights_[i].color.z };
+                    str = "Color " + std::to_string(i);
+                    ImGui::ColorEdit3(str.c_str(), col);
+                    lights_[i].color = XMFLOAT4(col[0], col[1], col[2], lights_[i].color.w);
+
+                    str = "Brightness " + std::to_string(i);
+                    ImGui::DragFloat(str.c_str(), &lights_[i].color.w, 10.0f, 1.0f, 10000.0f);
+                }
+                ImGui::TreePop();
             }
         }
 
@@ -285,10 +446,22 @@ void Renderer::UpdateImgui() {
 }
 
 bool Renderer::Render() {
-    UpdateImgui();
+    CpuProfiler::Get().BeginFrame();
+    CPU_PROFILE_SCOPE("Renderer::Render");
+    if (!headless_) {
+        UpdateImgui();
+    }
+    managerStorage_->GetStateManager()->ResetFrameStatistics();
+    uint64_t heapAllocations = utilities::GetHeapAllocationCount();
+    CommandRecorder* recorder = device_->GetDeviceContext()->GetRecorder();
+    if (!!recorder) {
+        recorder->BeginFrame();
+    }
 
 #ifdef _DEBUG
-    annotation_->BeginEvent(L"Render_scene");
+    if (!!annotation_) {
+        annotation_->BeginEvent(L"Render_scene");
+    }
 #endif
 
     device_->GetDeviceContext()->ClearState();
@@ -311,13 +484,35 @@ bool Renderer::Render() {
     }
     sceneManager_.SetViewport(viewport_);
 
-    if (!sceneManager_.Render(irradianceMap_, prefilteredMap_, BRDF_, skybox_, lights_, { 0 })) {
+    // the transient textures of the passes enabled by the current settings
+    {
+        CPU_PROFILE_SCOPE("Frame graph");
+        frameGraph_.Reset();
+        UINT backBuffer = frameGraph_.ImportTexture("Back buffer");
+        UINT sceneTarget = default_ ? frameGraph_.ImportTexture("HDR frame") : backBuffer;
+        sceneManager_.DeclarePasses(frameGraph_, sceneTarget);
+        if (default_) {
+            toneMapping_.DeclarePasses(frameGraph_, sceneTarget, backBuffer);
+        }
+        frameGraph_.Compile();
+        if (FAILED(transientTextures_.Realize(frameGraph_))) {
+            return false;
+        }
+        sceneManager_.BindTransientTextures(frameGraph_, transientTextures_);
+        if (default_) {
+            toneMapping_.BindTransientTextures(frameGraph_, transientTextures_);
+        }
+    }
+
+    if (!sceneManager_.Render(irradianceMap_, prefilteredMap_, BRDF_, skybox_, lights_, sceneIndices_)) {
         return false;
     }
 
     if (default_) {
 #ifdef _DEBUG
-        annotation_->BeginEvent(L"Tone_mapping");
+        if (!!annotation_) {
+            annotation_->BeginEvent(L"Tone_mapping");
+        }
 #endif
 
         toneMapping_.CalculateBrightness();
@@ -332,15 +527,24 @@ bool Renderer::Render() {
     }
 
 #ifdef _DEBUG
-    annotation_->EndEvent();
+    if (!!annotation_) {
+        annotation_->EndEvent();
+    }
 #endif
 
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    frameHeapAllocations_ = utilities::GetHeapAllocationCount() - heapAllocations;
+
+    if (!headless_) {
+        CPU_PROFILE_SCOPE("ImGui_ImplDX11_RenderDrawData");
+        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    }
 
     HRESULT result = swapChain_.Present();
 
 #ifdef _DEBUG
-    annotation_->EndEvent();
+    if (!!annotation_) {
+        annotation_->EndEvent();
+    }
 #endif
 
     return SUCCEEDED(result);
@@ -416,12 +620,15 @@ void Renderer::OnMouseRButtonUp() {
 }
 
 void Renderer::Cleanup() {
-    ImGui_ImplDX11_Shutdown();
-    ImGui_ImplWin32_Shutdown();
-    ImGui::DestroyContext();
+    if (!!ImGui::GetCurrentContext()) {
+        ImGui_ImplDX11_Shutdown();
+        ImGui_ImplWin32_Shutdown();
+        ImGui::DestroyContext();
+    }
 
     toneMapping_.Cleanup();
     sceneManager_.Cleanup();
+    transientTextures_.Cleanup();
     swapChain_.Cleanup();
 
     factory_.reset();
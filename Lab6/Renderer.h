@@ -9,6 +9,10 @@
 #include "SkyBox.h"
 #include "Light.hpp"
 #include "Scene.h"
+#include "FrameGraph.hpp"
+#include "TransientTexturePool.hpp"
+#include "AllocationCounter.h"
+#include "CpuProfiler.hpp"
 #include <vector>
 #include <string>
 
@@ -23,6 +27,8 @@ public:
 
     static Renderer& GetInstance();
     bool Init(HINSTANCE hInstance, HWND hWnd);
+    // renders into an offscreen target on Device::InitHeadless, without a window and ImGui
+    bool InitHeadless(UINT width, UINT height);
     bool Render();
     bool Resize(UINT width, UINT height);
     void MoveCamera(int upDown, int rightLeft, int forwardBack);
@@ -32,6 +38,11 @@ public:
     void OnMouseRButtonUp();
     void Cleanup();
 
+    // the commands of the last frame, nullptr if they are not recorded
+    CommandRecorder* GetCommandRecorder() const {
+        return !!device_ ? device_->GetDeviceContext()->GetRecorder() : nullptr;
+    };
+
     ~Renderer() {
         Cleanup();
     };
@@ -46,6 +57,7 @@ private:
         viewport_.MaxDepth = 1.0f;
     };
 
+    HRESULT InitResources();
     HRESULT InitImgui(HWND hWnd);
     HRESULT GenerateTextures();
     void UpdateImgui();
@@ -64,6 +76,8 @@ private:
     SwapChain swapChain_;
     ToneMapping toneMapping_;
     SceneManager sceneManager_;
+    FrameGraph frameGraph_; // declared and compiled every frame
+    TransientTexturePool transientTextures_;
 
     std::shared_ptr<ID3D11ShaderResourceView> environmentMap_; // transmitted outward ->
     std::shared_ptr<ID3D11ShaderResourceView> irradianceMap_; // transmitted outward ->
@@ -71,17 +85,20 @@ private:
     std::shared_ptr<ID3D11ShaderResourceView> BRDF_; // transmitted outward ->
 
     std::vector<PointLight> lights_;
+    std::vector<int> sceneIndices_ = { 0 };
     std::shared_ptr<DirectionalLight> dirLight_; // transmitted outward ->
 
     D3D11_VIEWPORT viewport_;
     int width_ = defaultWidth;
     int height_ = defaultHeight;
 
+    bool headless_ = false;
     bool default_ = true;
     bool shadowSplits_ = false;
+
+    uint64_t frameHeapAllocations_ = 0; // during the scene rendering of the previous frame
+    std::vector<CpuProfiler::Event> profilerEvents_; // of the previous frame, kept to reuse the memory
     
     int mousePrevX_ = -1;
     int mousePrevY_ = -1;
-
-    XMFLOAT3 dirLightFocus = { 0.0f, 0.0f, 0.0f };
 };
\ No newline at end of file
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+
+// Suballocates offsets from a ring of capacity bytes that is written by the CPU and read by the GPU.
+// Allocations of a frame are tagged with a fence value in EndFrame, their memory is reused only after Retire
+// is called with a completed fence not less than that value. Does not own memory and does not depend on D3D.
+class RingAllocator {
+public:
+    static const size_t invalidOffset = SIZE_MAX;
+
+    struct Statistics {
+        size_t allocatedBytes = 0; // requested by the allocations of the current frame
+        size_t paddingBytes = 0; // lost to alignment and wrapping in the current frame
+        size_t usedBytes = 0; // not yet retired, including the current frame
+        uint64_t wraps = 0; // since the creation
+    };
+
+    explicit RingAllocator(size_t capacity = 0) {
+        Reset(capacity);
+    };
+
+    void Reset(size_t capacity) {
+        capacity_ = capacity;
+        Discard();
+    };
+
+    // returns the offset of the allocation or invalidOffset when the free part of the ring is too small;
+    // wrapped is set when the allocation starts again from the beginning of the ring
+    size_t Allocate(size_t size, size_t alignment, bool& wrapped) {
+        wrapped = false;
+        if (size == 0 || size > capacity_ || used_ == capacity_) {
+            return invalidOffset;
+        }
+        if (used_ == 0) {
+            // nothing is in use, so the allocation starts from the beginning; the frames in flight are empty
+            head_ = 0;
+            tail_ = 0;
+            for (auto& f : frames_) {
+                f.end = 0;
+            }
+        }
+
+        size_t start = Align(head_, alignment);
+        size_t padding = start - head_;
+        if (head_ >= tail_) {
+            if (start + size > capacity_) {
+                // the rest of the ring is skipped, the allocation is placed before the oldest frame in use
+                if (size > tail_ && used_ != 0) {
+                    return invalidOffset;
+                }
+                padding = capacity_ - head_;
+                start = 0;
+                wrapped = true;
+                ++wraps_;
+            }
+        }
+        else if (start + size > tail_) {
+            return invalidOffset;
+        }
+
+        head_ = start + size;
+        used_ += padding + size;
+        frameBytes_ += padding + size;
+        statistics_.allocatedBytes += size;
+        statistics_.paddingBytes += padding;
+        return start;
+    };
+
+    // allocations made since the previous call become the frame identified by fence
+    void EndFrame(uint64_t fence) {
+        Frame frame;
+        frame.fence = fence;
+        frame.end = head_;
+        frame.bytes = frameBytes_;
+        frames_.push_back(frame);
+        frameBytes_ = 0;
+        statistics_.allocatedBytes = 0;
+        statistics_.paddingBytes = 0;
+    };
+
+    // frees the frames whose fences are not greater than completedFence
+    void Retire(uint64_t completedFence) {
+        while (!frames_.empty() && frames_.front().fence <= completedFence) {
+            tail_ = frames_.front().end;
+            used_ -= frames_.front().bytes;
+            frames_.pop_front();
+        }
+    };
+
+    // forgets all allocations, for the case when the memory behind the ring was replaced (D3D11_MAP_WRITE_DISCARD)
+    void Discard() {
+        frames_.clear();
+        head_ = 0;
+        tail_ = 0;
+        used_ = 0;
+        frameBytes_ = 0;
+    };
+
+    size_t GetCapacity() const {
+        return capacity_;
+    };
+
+    size_t GetFramesInFlight() const {
+        return frames_.size();
+    };
+
+    Statistics GetStatistics() const {
+        Statistics statistics = statistics_;
+        statistics.usedBytes = used_;
+        statistics.wraps = wraps_;
+        return statistics;
+    };
+
+    ~RingAllocator() = default;
+
+private:
+    struct Frame {
+        uint64_t fence = 0;
+        size_t end = 0;
+        size_t bytes = 0;
+    };
+
+    static size_t Align(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    };
+
+    size_t capacity_ = 0; // always remains only inside the class #
+    size_t head_ = 0; // always remains only inside the class #
+    size_t tail_ = 0; // always remains only inside the class #
+    size_t used_ = 0; // always remains only inside the class #
+    size_t frameBytes_ = 0; // always remains only inside the class #
+    uint64_t wraps_ = 0; // always remains only inside the class #
+    std::deque<Frame> frames_; // always remains only inside the class #
+    Statistics statistics_; // always remains only inside the class #
+};
@@ -9,8 +9,8 @@
 SceneManager::SceneManager() {
     viewport_.TopLeftX = 0;
     viewport_.TopLeftY = 0;
-    viewport_.Width = shadowMapSize;
-    viewport_.Height = shadowMapSize;
+    viewport_.Width = 1.0f;
+    viewport_.Height = 1.0f;
     viewport_.MinDepth = 0.0f;
     viewport_.MaxDepth = 1.0f;
 
@@ -62,21 +62,9 @@ HRESULT SceneManager::Init(const std::shared_ptr<Device>& device, const std::sha
     if (SUCCEEDED(result)) {
         result = managerStorage_->GetStateManager()->CreateDepthStencilState(generalDepthStencilState_, D3D11_COMPARISON_ALWAYS, D3D11_DEPTH_WRITE_MASK_ZERO);
     }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(normals_, width_, height_);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(features_, width_, height_);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(color_, width_, height_);
-    }
     if (SUCCEEDED(result)) {
         result = CreateDepthStencilView(width_, height_, depth_);
     }
-    if (SUCCEEDED(result)) {
-        result = CreateDepthStencilView(width_, height_, depthCopy_);
-    }
     if (SUCCEEDED(result)) {
         result = managerStorage_->GetPSManager()->LoadShader(ambientLightPS_, L"shaders/ambientLightPS.hlsl");
     }
@@ -239,7 +227,12 @@ HRESULT SceneManager::CreateAuxiliaryForDeferredRender() {
         result = managerStorage_->GetStateManager()->CreateDepthStencilState(pointLightDepthStencilState_, D3D11_COMPARISON_LESS_EQUAL, D3D11_DEPTH_WRITE_MASK_ZERO);
     }
     if (SUCCEEDED(result)) {
-        result = CreateTexture(emissive_, width_, height_);
+        // a volume seen from outside is drawn with its outer side where it is in front of the geometry (reversed depth)
+        result = managerStorage_->GetStateManager()->CreateRasterizerState(pointLightOutsideRasterizerState_, D3D11_FILL_SOLID, D3D11_CULL_FRONT);
+    }
+    if (SUCCEEDED(result)) {
+        result = managerStorage_->GetStateManager()->CreateDepthStencilState(pointLightOutsideDepthStencilState_, D3D11_COMPARISON_GREATER_EQUAL,
+            D3D11_DEPTH_WRITE_MASK_ZERO);
     }
     if (SUCCEEDED(result)) {
         result = managerStorage_->GetVSManager()->LoadShader(pointLightVS_, L"shaders/VS.hlsl", { "HAS_UV_OUT", "INSTANCING"}, sphereVertexDesc_);
@@ -300,13 +293,13 @@ HRESULT SceneManager::CreateDepthStencilView(int width, int height, RawPtrDepthB
 }
 
 HRESULT SceneManager::CreateAuxiliaryForShadowMaps() {
-    HRESULT result = S_OK;
-    for (UINT i = 0; i < CSM_SPLIT_COUNT && SUCCEEDED(result); ++i) {
-        RawPtrDepthBuffer depthBuffer;
-        result = CreateDepthStencilView(shadowMapSize, shadowMapSize, depthBuffer);
-        if (SUCCEEDED(result)) {
-            shadowSplits_.push_back(depthBuffer);
-        }
+    // the atlas itself is created by CreateShadowAtlas, its size depends on the memory budget
+    for (auto& cache : shadowCaches_) {
+        cache = ShadowCache();
+    }
+    HRESULT result = managerStorage_->GetStateManager()->CreateDepthStencilState(shadowScrollDepthStencilState_, D3D11_COMPARISON_ALWAYS);
+    if (SUCCEEDED(result)) {
+        result = managerStorage_->GetPSManager()->LoadShader(shadowScrollPS_, L"shaders/shadowScrollPS.hlsl");
     }
     if (SUCCEEDED(result)) {
         result = managerStorage_->GetStateManager()->CreateDepthStencilState(shadowDepthStencilState_, D3D11_COMPARISON_LESS);
@@ -346,67 +339,12 @@ HRESULT SceneManager::CreateAuxiliaryForTransparent() {
         textureDesc.MiscFlags = 0;
         result = device_->GetDevice()->CreateTexture2D(&textureDesc, nullptr, &readMaxTexture_);
     }
-    if (SUCCEEDED(result)) {
-        result = CreateDepthStencilView(width_, height_, transparentDepth_);
-    }
-    for (int i = 0; i < n_ + 1 && SUCCEEDED(result); ++i) {
-        RawPtrTexture texture;
-        result = CreateTexture(texture, i);
-        if (SUCCEEDED(result)) {
-            scaledFrames_.push_back(texture);
-        }
-    }
-
-    return result;
-}
-
-HRESULT SceneManager::CreateTexture(RawPtrTexture& texture, int width, int height, DXGI_FORMAT format) {
-    D3D11_TEXTURE2D_DESC textureDesc = {};
-    textureDesc.Width = width;
-    textureDesc.Height = height;
-    textureDesc.MipLevels = 1;
-    textureDesc.ArraySize = 1;
-    textureDesc.Format = format;
-    textureDesc.SampleDesc.Count = 1;
-    textureDesc.Usage = D3D11_USAGE_DEFAULT;
-    textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-    textureDesc.CPUAccessFlags = 0;
-    textureDesc.MiscFlags = 0;
-    HRESULT result = device_->GetDevice()->CreateTexture2D(&textureDesc, nullptr, &texture.texture);
-    if (SUCCEEDED(result)) {
-        D3D11_RENDER_TARGET_VIEW_DESC renderTargetViewDesc;
-        renderTargetViewDesc.Format = format;
-        renderTargetViewDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-        renderTargetViewDesc.Texture2D.MipSlice = 0;
-
-        result = device_->GetDevice()->CreateRenderTargetView(texture.texture, &renderTargetViewDesc, &texture.RTV);
-    }
-    if (SUCCEEDED(result)) {
-        D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc;
-        shaderResourceViewDesc.Format = format;
-        shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-        shaderResourceViewDesc.Texture2D.MostDetailedMip = 0;
-        shaderResourceViewDesc.Texture2D.MipLevels = 1;
-
-        result = device_->GetDevice()->CreateShaderResourceView(texture.texture, &shaderResourceViewDesc, &texture.SRV);
-    }
 
     return result;
 }
 
-HRESULT SceneManager::CreateTexture(RawPtrTexture& texture, int i) {
-    return CreateTexture(texture, pow(2, i), pow(2, i), DXGI_FORMAT_R32_FLOAT);
-}
-
 HRESULT SceneManager::CreateBuffers() {
-    D3D11_BUFFER_DESC desc = {};
-    desc.ByteWidth = sizeof(WorldMatrixBuffer);
-    desc.Usage = D3D11_USAGE_DEFAULT;
-    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = 0;
-    desc.StructureByteStride = 0;
-    HRESULT result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &worldMatrixBuffer_);
+    HRESULT result = CreateInstanceBuffer(initialInstanceCapacity);
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
         desc.ByteWidth = sizeof(InstancingWorldMatrixBuffer);
@@ -419,23 +357,37 @@ HRESULT SceneManager::CreateBuffers() {
     }
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
-        desc.ByteWidth = sizeof(ViewMatrixBuffer);
+        desc.ByteWidth = sizeof(InstanceParentBuffer);
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
         desc.CPUAccessFlags = 0;
         desc.MiscFlags = 0;
         desc.StructureByteStride = 0;
-        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &viewMatrixBuffer_);
+        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &instanceParentBuffer_);
+    }
+    if (SUCCEEDED(result)) {
+        InstanceParentBuffer identity;
+        identity.worldMatrix = XMMatrixIdentity();
+        D3D11_SUBRESOURCE_DATA data = { &identity, sizeof(identity), 0 };
+
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = sizeof(InstanceParentBuffer);
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        desc.CPUAccessFlags = 0;
+        desc.MiscFlags = 0;
+        desc.StructureByteStride = 0;
+        result = device_->GetDevice()->CreateBuffer(&desc, &data, &instanceParentIdentityBuffer_);
     }
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
-        desc.ByteWidth = sizeof(ShadowMapAlphaCutoffBuffer);
+        desc.ByteWidth = sizeof(ViewMatrixBuffer);
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
         desc.CPUAccessFlags = 0;
         desc.MiscFlags = 0;
         desc.StructureByteStride = 0;
-        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &shadowMapAlphaCutoffBuffer_);
+        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &viewMatrixBuffer_);
     }
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
@@ -459,13 +411,13 @@ HRESULT SceneManager::CreateBuffers() {
     }
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
-        desc.ByteWidth = sizeof(MaterialParamsBuffer);
+        desc.ByteWidth = sizeof(ShadowScrollBuffer);
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
         desc.CPUAccessFlags = 0;
         desc.MiscFlags = 0;
         desc.StructureByteStride = 0;
-        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &materialParamsBuffer_);
+        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &shadowScrollBuffer_);
     }
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
@@ -497,6 +449,19 @@ HRESULT SceneManager::CreateBuffers() {
         desc.StructureByteStride = 0;
         result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &SSAOParamsBuffer_);
     }
+    if (SUCCEEDED(result)) {
+        result = dynamicConstants_.Init(device_);
+    }
+    if (SUCCEEDED(result)) {
+        result = pointLightBuffer_.Init(device_, sizeof(PointLight), MAX_LIGHT);
+    }
+    if (SUCCEEDED(result)) {
+        LightClusters::Settings settings;
+        result = lightClusterBuffer_.Init(device_, sizeof(LightClusters::Cluster), settings.tilesX * settings.tilesY * settings.slices);
+    }
+    if (SUCCEEDED(result)) {
+        result = lightIndexBuffer_.Init(device_, sizeof(UINT), 4096);
+    }
     if (SUCCEEDED(result)) {
         for (int i = 0; i < MAX_SSAO_SAMPLE_COUNT; ++i) {
             XMFLOAT4 s = XMFLOAT4(
@@ -533,11 +498,17 @@ HRESULT SceneManager::CreateBuffers() {
 }
 
 HRESULT SceneManager::LoadScene(const std::string& name, UINT& index, UINT& count, const XMMATRIX& transformation) {
+    CPU_PROFILE_SCOPE("SceneManager::LoadScene");
     tinygltf::TinyGLTF context;
     tinygltf::Model model;
     std::string error;
     std::string warning;
-    if (!context.LoadASCIIFromFile(&model, &error, &warning, name)) {
+    bool loaded = false;
+    {
+        CPU_PROFILE_SCOPE("tinygltf::LoadASCIIFromFile");
+        loaded = context.LoadASCIIFromFile(&model, &error, &warning, name);
+    }
+    if (!loaded) {
         if (!error.empty()) {
             OutputDebugStringA(error.c_str());
         }
@@ -578,6 +549,14 @@ HRESULT SceneManager::LoadScene(const std::string& name, UINT& index, UINT& coun
         Cleanup();
     }
     else {
+        for (UINT i = index; i < scenes_.size(); ++i) {
+            Scene& scene = scenes_[i];
+            scene.hierarchyIndices.assign(arrays.nodes.size(), -1);
+            for (auto node : scene.rootNodes) {
+                FlattenNodes(scene, arrays, node, -1);
+            }
+            scene.transformations.SetRootTransformation(scene.transformation);
+        }
         sceneArrays_.push_back(arrays);
     }
 
@@ -912,6 +891,7 @@ D3D11_TEXTURE_ADDRESS_MODE SceneManager::GetSamplerMode(int m) {
 }
 
 HRESULT SceneManager::CreateTextures(const tinygltf::Model& model, SceneArrays& arrays, const std::string& gltfFileName) {
+    CPU_PROFILE_SCOPE("SceneManager::CreateTextures");
     HRESULT result = S_OK;
     auto pos = gltfFileName.rfind('/');
     std::string imagesFolder = gltfFileName.substr(0, pos + 1);
@@ -922,31 +902,39 @@ HRESULT SceneManager::CreateTextures(const tinygltf::Model& model, SceneArrays&
         if (FAILED(result)) {
             break;
         }
-        arrays.textures.push_back(texture);
+        TextureViews views;
+        views.SRV = texture->GetSRV(false).get();
+        views.SRVSRGB = texture->GetSRV(true).get();
+        arrays.textures.push_back(textures_.Add(views));
+        resourceReferences_.push_back(texture);
     }
     return result;
 }
 
 HRESULT SceneManager::CreateMaterials(const tinygltf::Model& model, SceneArrays& arrays) {
+    CPU_PROFILE_SCOPE("SceneManager::CreateMaterials");
     HRESULT result = S_OK;
     for (auto& gm : model.materials) {
         Material material;
+        std::shared_ptr<ID3D11BlendState> blendState;
+        std::shared_ptr<ID3D11DepthStencilState> depthStencilState;
+        std::shared_ptr<ID3D11RasterizerState> rasterizerState;
         if (gm.alphaMode == "BLEND") {
             material.mode = AlphaMode::BLEND_MODE;
-            result = managerStorage_->GetStateManager()->CreateBlendState(material.blendState);
+            result = managerStorage_->GetStateManager()->CreateBlendState(blendState);
             if (SUCCEEDED(result)) {
-                result = managerStorage_->GetStateManager()->CreateDepthStencilState(material.depthStencilState,
+                result = managerStorage_->GetStateManager()->CreateDepthStencilState(depthStencilState,
                     D3D11_COMPARISON_GREATER_EQUAL, D3D11_DEPTH_WRITE_MASK_ZERO);
             }
         }
         else if (gm.alphaMode == "MASK") {
             material.mode = AlphaMode::ALPHA_CUTOFF_MODE;
             material.alphaCutoff = gm.alphaCutoff;
-            result = managerStorage_->GetStateManager()->CreateDepthStencilState(material.depthStencilState);
+            result = managerStorage_->GetStateManager()->CreateDepthStencilState(depthStencilState);
         }
         else {
             material.mode = AlphaMode::OPAQUE_MODE;
-            result = managerStorage_->GetStateManager()->CreateDepthStencilState(material.depthStencilState);
+            result = managerStorage_->GetStateManager()->CreateDepthStencilState(depthStencilState);
         }
 
         if (FAILED(result)) {
@@ -956,11 +944,18 @@ HRESULT SceneManager::CreateMaterials(const tinygltf::Model& model, SceneArrays&
         if (!gm.doubleSided) {
             material.cullMode = D3D11_CULL_BACK;
         }
-        result = managerStorage_->GetStateManager()->CreateRasterizerState(material.rasterizerState, D3D11_FILL_SOLID, material.cullMode);
+        result = managerStorage_->GetStateManager()->CreateRasterizerState(rasterizerState, D3D11_FILL_SOLID, material.cullMode);
         if (FAILED(result)) {
             break;
         }
 
+        material.blendState = blendState.get();
+        material.depthStencilState = depthStencilState.get();
+        material.rasterizerState = rasterizerState.get();
+        resourceReferences_.push_back(blendState);
+        resourceReferences_.push_back(depthStencilState);
+        resourceReferences_.push_back(rasterizerState);
+
         material.baseColorFactor = XMFLOAT4(
             gm.pbrMetallicRoughness.baseColorFactor[0],
             gm.pbrMetallicRoughness.baseColorFactor[1],
@@ -1002,12 +997,85 @@ HRESULT SceneManager::CreateMaterials(const tinygltf::Model& model, SceneArrays&
             material.occlusionTA = { gm.occlusionTexture.texCoord, model.textures[index].source, model.textures[index].sampler, false };
         }
 
-        arrays.materials.push_back(material);
+        ResolveTextureAccessor(arrays, material.baseColorTA);
+        ResolveTextureAccessor(arrays, material.roughMetallicTA);
+        ResolveTextureAccessor(arrays, material.normalTA);
+        ResolveTextureAccessor(arrays, material.emissiveTA);
+        ResolveTextureAccessor(arrays, material.occlusionTA);
+
+        result = CreateMaterialBuffers(material);
+        if (FAILED(result)) {
+            break;
+        }
+
+        arrays.materials.push_back(materials_.Add(material));
+    }
+    return result;
+}
+
+HRESULT SceneManager::CreateMaterialBuffers(Material& material) {
+    // material parameters do not change after loading, so they are uploaded once
+    MaterialParamsBuffer params;
+    params.baseColorFactor = material.baseColorFactor;
+    params.baseColorTA = XMINT4(material.baseColorTA.textureId, material.baseColorTA.texCoordId, material.baseColorTA.samplerId, material.baseColorTA.isSRGB);
+    params.emissiveFactorAlphaCutoff = XMFLOAT4(material.emissiveFactor.x, material.emissiveFactor.y, material.emissiveFactor.z, material.alphaCutoff);
+    params.emissiveTA = XMINT4(material.emissiveTA.textureId, material.emissiveTA.texCoordId, material.emissiveTA.samplerId, material.emissiveTA.isSRGB);
+    params.MRONFactors = XMFLOAT4(material.metallicFactor, material.roughnessFactor, material.occlusionStrength, material.normalScale);
+    params.normalTA = XMINT4(material.normalTA.textureId, material.normalTA.texCoordId, material.normalTA.samplerId, material.normalTA.isSRGB);
+    params.roughMetallicTA = XMINT4(material.roughMetallicTA.textureId, material.roughMetallicTA.texCoordId, material.roughMetallicTA.samplerId,
+        material.roughMetallicTA.isSRGB);
+    params.occlusionTA = XMINT4(material.occlusionTA.textureId, material.occlusionTA.texCoordId, material.occlusionTA.samplerId, material.occlusionTA.isSRGB);
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = sizeof(MaterialParamsBuffer);
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = 0;
+    desc.StructureByteStride = 0;
+
+    D3D11_SUBRESOURCE_DATA data = {};
+    data.pSysMem = &params;
+
+    ID3D11Buffer* buffer = nullptr;
+    HRESULT result = device_->GetDevice()->CreateBuffer(&desc, &data, &buffer);
+    if (FAILED(result)) {
+        return result;
+    }
+    material.paramsBuffer = buffer;
+    resourceReferences_.push_back(std::shared_ptr<ID3D11Buffer>(buffer, utilities::DXPtrDeleter<ID3D11Buffer*>));
+
+    if (material.mode == AlphaMode::OPAQUE_MODE) { // opaque without pixel shader for shadow map
+        return result;
+    }
+
+    ShadowMapAlphaCutoffBuffer alphaCutoff;
+    alphaCutoff.baseColorFactor = material.baseColorFactor;
+    alphaCutoff.alphaCutoffTexCoord = XMFLOAT4(material.alphaCutoff, material.baseColorTA.texCoordId, 0.0f, 0.0f);
+
+    desc.ByteWidth = sizeof(ShadowMapAlphaCutoffBuffer);
+    data.pSysMem = &alphaCutoff;
+    buffer = nullptr;
+    result = device_->GetDevice()->CreateBuffer(&desc, &data, &buffer);
+    if (FAILED(result)) {
+        return result;
     }
+    material.shadowParamsBuffer = buffer;
+    resourceReferences_.push_back(std::shared_ptr<ID3D11Buffer>(buffer, utilities::DXPtrDeleter<ID3D11Buffer*>));
     return result;
 }
 
+void SceneManager::ResolveTextureAccessor(const SceneArrays& arrays, TextureAccessor& accessor) {
+    if (accessor.textureId >= 0) {
+        accessor.texture = arrays.textures[accessor.textureId];
+    }
+    if (accessor.samplerId >= 0 && accessor.samplerId < arrays.samplers.size()) {
+        accessor.sampler = arrays.samplers[accessor.samplerId].get();
+    }
+}
+
 HRESULT SceneManager::CreateMeshes(const tinygltf::Model& model, SceneArrays& arrays) {
+    CPU_PROFILE_SCOPE("SceneManager::CreateMeshes");
     HRESULT result = S_OK;
     for (auto& gm : model.meshes) {
         Mesh mesh;
@@ -1033,27 +1101,48 @@ HRESULT SceneManager::CreateMeshes(const tinygltf::Model& model, SceneArrays& ar
                 primitive.mode = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
                 break;
             }
-            primitive.materialId = gp.material;
-            primitive.indicesAccessorId = gp.indices;
+            primitive.material = arrays.materials[gp.material];
+            primitive.bounds = GetPositionBounds(model, gp);
+            AlphaMode mode = materials_[primitive.material].mode;
 
+            std::vector<Attribute> attributes;
             std::vector<std::string> defines;
             std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc;
-            ParseAttributes(arrays, gp, primitive.attributes, defines, inputElementDesc);
+            ParseAttributes(arrays, gp, attributes, defines, inputElementDesc);
+
+            for (auto& a : attributes) {
+                const BufferAccessor& accessor = arrays.accessors[a.verticesAccessorId];
+                primitive.vertexBuffers[primitive.vertexBufferCount] = accessor.buffer.get();
+                primitive.strides[primitive.vertexBufferCount] = accessor.byteStride;
+                primitive.offsets[primitive.vertexBufferCount] = accessor.byteOffset;
+                ++primitive.vertexBufferCount;
+            }
+            if (gp.indices >= 0) {
+                const BufferAccessor& accessor = arrays.accessors[gp.indices];
+                primitive.indexBuffer = accessor.buffer.get();
+                primitive.indexFormat = accessor.format;
+                primitive.indexOffset = accessor.byteOffset;
+                primitive.count = accessor.count;
+            }
+            else if (!attributes.empty()) {
+                primitive.count = arrays.accessors[attributes[0].verticesAccessorId].count;
+            }
 
-            result = CreateShaders(primitive, arrays, defines, inputElementDesc);
+            result = CreateShaders(primitive, mode, defines, inputElementDesc);
             if (FAILED(result)) {
                 break;
             }
 
-            switch (arrays.materials[primitive.materialId].mode) {
+            PrimitiveHandle handle = primitives_.Add(primitive);
+            switch (mode) {
             case AlphaMode::BLEND_MODE:
-                mesh.transparentPrimitives.push_back(primitive);
+                mesh.transparentPrimitives.push_back(handle);
                 break;
             case AlphaMode::ALPHA_CUTOFF_MODE:
-                mesh.primitivesWithAlphaCutoff.push_back(primitive);
+                mesh.primitivesWithAlphaCutoff.push_back(handle);
                 break;
             default:
-                mesh.opaquePrimitives.push_back(primitive);
+                mesh.opaquePrimitives.push_back(handle);
                 break;
             }
         }
@@ -1065,6 +1154,34 @@ HRESULT SceneManager::CreateMeshes(const tinygltf::Model& model, SceneArrays& ar
     return result;
 }
 
+AABB SceneManager::GetPositionBounds(const tinygltf::Model& model, const tinygltf::Primitive& primitive) {
+    AABB bounds;
+    auto position = primitive.attributes.find("POSITION");
+    if (position == primitive.attributes.end()) {
+        return bounds;
+    }
+
+    if (position->second < 0 || position->second >= (int)model.accessors.size()) {
+        return bounds;
+    }
+    const tinygltf::Accessor& ga = model.accessors[position->second];
+    if (ga.minValues.size() >= 3 && ga.maxValues.size() >= 3) {
+        bounds.min = XMFLOAT3((float)ga.minValues[0], (float)ga.minValues[1], (float)ga.minValues[2]);
+        bounds.max = XMFLOAT3((float)ga.maxValues[0], (float)ga.maxValues[1], (float)ga.maxValues[2]);
+        return bounds;
+    }
+
+    // min and max are required by the specification for positions, but not all exporters write them;
+    // the bounds stay empty for sparse accessors and accessors without a buffer view, which ReadAccessor does not read
+    std::vector<XMFLOAT4> positions;
+    if (ReadAccessor(model, position->second, TINYGLTF_TYPE_VEC3, positions)) {
+        for (const XMFLOAT4& p : positions) {
+            bounds.Extend(XMFLOAT3(p.x, p.y, p.z));
+        }
+    }
+    return bounds;
+}
+
 void SceneManager::ParseAttributes(const SceneArrays& arrays, const tinygltf::Primitive& primitive,
     std::vector<Attribute>& attributes, std::vector<std::string>& baseDefines, std::vector<D3D11_INPUT_ELEMENT_DESC>& desc) {
     std::vector<Attribute> tmp;
@@ -1121,7 +1238,7 @@ void SceneManager::ParseAttributes(const SceneArrays& arrays, const tinygltf::Pr
             ; // ignore others attributes
         }
     }
-    const Material& material = arrays.materials[primitive.material];
+    const Material& material = materials_[arrays.materials[primitive.material]];
     if (material.baseColorTA.textureId >= 0) {
         baseDefines.push_back("HAS_COLOR_TEXTURE");
     }
@@ -1177,8 +1294,22 @@ void SceneManager::ParseAttributes(const SceneArrays& arrays, const tinygltf::Pr
     }
 }
 
-HRESULT SceneManager::CreateShaders(Primitive& primitive, const SceneArrays& arrays,
+HRESULT SceneManager::CreateShaders(Primitive& primitive, AlphaMode mode,
     const std::vector<std::string>& baseDefines, const std::vector<D3D11_INPUT_ELEMENT_DESC>& desc) {
+    // primitives with the same defines and vertex layout share one set of shaders
+    std::string key = std::to_string((int)mode);
+    for (auto& d : baseDefines) {
+        key += " " + d;
+    }
+    for (auto& d : desc) {
+        key += " " + std::string(d.SemanticName) + std::to_string(d.SemanticIndex) + ":" + std::to_string((int)d.Format);
+    }
+    auto shaderSetId = shaderSetIds_.find(key);
+    if (shaderSetId != shaderSetIds_.end()) {
+        primitive.shaders = shaderSetId->second;
+        return S_OK;
+    }
+
     std::vector<std::string> defaulMacros = baseDefines;
     defaulMacros.push_back("DEFAULT");
 
@@ -1202,7 +1333,7 @@ HRESULT SceneManager::CreateShaders(Primitive& primitive, const SceneArrays& arr
 
     std::vector<std::string> OpaqueSSAOMaskMacros = SSAOMaskMacros;
 
-    if (arrays.materials[primitive.materialId].mode == AlphaMode::BLEND_MODE) {
+    if (mode == AlphaMode::BLEND_MODE) {
         defaulMacros.push_back("TRANSPARENT");
         fresnelMacros.push_back("TRANSPARENT");
         ndfMacros.push_back("TRANSPARENT");
@@ -1212,7 +1343,14 @@ HRESULT SceneManager::CreateShaders(Primitive& primitive, const SceneArrays& arr
         SSAOMaskMacros.push_back("TRANSPARENT");
     }
 
+    // world matrices are read per instance from a separate slot
+    std::vector<D3D11_INPUT_ELEMENT_DESC> instanceDesc = desc;
+    for (UINT i = 0; i < 4; ++i) {
+        instanceDesc.push_back({ "WORLD", i, DXGI_FORMAT_R32G32B32A32_FLOAT, instanceSlot, i * 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 });
+    }
+
     std::vector<std::string> shadowVSMacros = baseDefines;
+    shadowVSMacros.push_back("INSTANCE_TRANSFORM");
     shadowVSMacros.push_back("HAS_COLOR_OUT");
     shadowVSMacros.push_back("HAS_TEXCOORD_OUT");
 
@@ -1221,45 +1359,82 @@ HRESULT SceneManager::CreateShaders(Primitive& primitive, const SceneArrays& arr
     VSMacros.push_back("HAS_NORMAL_OUT");
     VSMacros.push_back("HAS_TANGENT_OUT");
 
-    HRESULT result = managerStorage_->GetVSManager()->LoadShader(primitive.VS, L"shaders/VS.hlsl", VSMacros, desc);
+    std::shared_ptr<VertexShader> VS, shadowVS;
+    std::shared_ptr<PixelShader> gBufferPS, PSDefault, PSFresnel, PSNdf, PSGeometry, PSShadowSplits, PSSSAOMask,
+        transparentPSSSAO, transparentPSSSAOMask, shadowPS;
+    HRESULT result = managerStorage_->GetVSManager()->LoadShader(VS, L"shaders/VS.hlsl", VSMacros, instanceDesc);
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetVSManager()->LoadShader(primitive.shadowVS, L"shaders/VS.hlsl", shadowVSMacros, desc);
+        result = managerStorage_->GetVSManager()->LoadShader(shadowVS, L"shaders/VS.hlsl", shadowVSMacros, instanceDesc);
     }
-    if (SUCCEEDED(result) && arrays.materials[primitive.materialId].mode != AlphaMode::BLEND_MODE) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.gBufferPS, L"shaders/gBufferPS.hlsl", baseDefines);
+    if (SUCCEEDED(result) && mode != AlphaMode::BLEND_MODE) {
+        result = managerStorage_->GetPSManager()->LoadShader(gBufferPS, L"shaders/gBufferPS.hlsl", baseDefines);
     }
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.PSDefault, L"shaders/forwardRenderPS.hlsl", defaulMacros);
+        result = managerStorage_->GetPSManager()->LoadShader(PSDefault, L"shaders/forwardRenderPS.hlsl", defaulMacros);
     }
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.PSFresnel, L"shaders/forwardRenderPS.hlsl", fresnelMacros);
+        result = managerStorage_->GetPSManager()->LoadShader(PSFresnel, L"shaders/forwardRenderPS.hlsl", fresnelMacros);
     }
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.PSNdf, L"shaders/forwardRenderPS.hlsl", ndfMacros);
+        result = managerStorage_->GetPSManager()->LoadShader(PSNdf, L"shaders/forwardRenderPS.hlsl", ndfMacros);
     }
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.PSGeometry, L"shaders/forwardRenderPS.hlsl", geometryMacros);
+        result = managerStorage_->GetPSManager()->LoadShader(PSGeometry, L"shaders/forwardRenderPS.hlsl", geometryMacros);
     }
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.PSShadowSplits, L"shaders/forwardRenderPS.hlsl", shadowSplitsMacros);
+        result = managerStorage_->GetPSManager()->LoadShader(PSShadowSplits, L"shaders/forwardRenderPS.hlsl", shadowSplitsMacros);
     }
     if (SUCCEEDED(result)) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.PSSSAOMask, L"shaders/forwardRenderPS.hlsl", OpaqueSSAOMaskMacros);
+        result = managerStorage_->GetPSManager()->LoadShader(PSSSAOMask, L"shaders/forwardRenderPS.hlsl", OpaqueSSAOMaskMacros);
     }
-    if (SUCCEEDED(result) && arrays.materials[primitive.materialId].mode == AlphaMode::BLEND_MODE) {
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.transparentPSSSAO, L"shaders/forwardRenderPS.hlsl", SSAOMacros);
+    if (SUCCEEDED(result) && mode == AlphaMode::BLEND_MODE) {
+        result = managerStorage_->GetPSManager()->LoadShader(transparentPSSSAO, L"shaders/forwardRenderPS.hlsl", SSAOMacros);
         if (SUCCEEDED(result)) {
-            result = managerStorage_->GetPSManager()->LoadShader(primitive.transparentPSSSAOMask, L"shaders/forwardRenderPS.hlsl", SSAOMaskMacros);
+            result = managerStorage_->GetPSManager()->LoadShader(transparentPSSSAOMask, L"shaders/forwardRenderPS.hlsl", SSAOMaskMacros);
         }
     }
-    if (SUCCEEDED(result) && arrays.materials[primitive.materialId].mode != AlphaMode::OPAQUE_MODE) { // opaque without pixel shader for shadow map
-        result = managerStorage_->GetPSManager()->LoadShader(primitive.shadowPS, L"shaders/shadowPS.hlsl", baseDefines);
+    if (SUCCEEDED(result) && mode != AlphaMode::OPAQUE_MODE) { // opaque without pixel shader for shadow map
+        result = managerStorage_->GetPSManager()->LoadShader(shadowPS, L"shaders/shadowPS.hlsl", baseDefines);
     }
+    if (FAILED(result)) {
+        return result;
+    }
+
+    ShaderSet shaderSet;
+    shaderSet.inputLayout = VS->GetInputLayout().get();
+    shaderSet.VS = VS->GetShader().get();
+    shaderSet.shadowInputLayout = shadowVS->GetInputLayout().get();
+    shaderSet.shadowVS = shadowVS->GetShader().get();
+    resourceReferences_.push_back(VS);
+    resourceReferences_.push_back(shadowVS);
+
+    std::pair<ID3D11PixelShader**, std::shared_ptr<PixelShader>*> pixelShaders[] = {
+        { &shaderSet.gBufferPS, &gBufferPS },
+        { &shaderSet.PSDefault, &PSDefault },
+        { &shaderSet.PSFresnel, &PSFresnel },
+        { &shaderSet.PSNdf, &PSNdf },
+        { &shaderSet.PSGeometry, &PSGeometry },
+        { &shaderSet.PSShadowSplits, &PSShadowSplits },
+        { &shaderSet.PSSSAOMask, &PSSSAOMask },
+        { &shaderSet.transparentPSSSAO, &transparentPSSSAO },
+        { &shaderSet.transparentPSSSAOMask, &transparentPSSSAOMask },
+        { &shaderSet.shadowPS, &shadowPS }
+    };
+    for (auto& ps : pixelShaders) {
+        if (!!*ps.second) {
+            *ps.first = (*ps.second)->GetShader().get();
+            resourceReferences_.push_back(*ps.second);
+        }
+    }
+
+    primitive.shaders = shaderSets_.Add(shaderSet);
+    shaderSetIds_.emplace(key, primitive.shaders);
 
     return result;
 }
 
 HRESULT SceneManager::CreateNodes(const tinygltf::Model& model, SceneArrays& arrays) {
+    CPU_PROFILE_SCOPE("SceneManager::CreateNodes");
     HRESULT result = S_OK;
     for (auto& gn : model.nodes) {
         Node node;
@@ -1289,248 +1464,836 @@ HRESULT SceneManager::CreateNodes(const tinygltf::Model& model, SceneArrays& arr
                 XMVECTOR{(float)gn.matrix[12], (float)gn.matrix[13], (float)gn.matrix[14], (float)gn.matrix[15]}
             };
         }
+        if (node.meshId >= 0) {
+            ReadInstances(model, gn, node.instances);
+            CreateInstanceBounds(arrays, node);
+        }
 
         arrays.nodes.push_back(node);
     }
     return result;
 }
 
-bool SceneManager::CreateShadowMaps(const std::vector<int>& sceneIndices) {
-    if (!!annotation_) {
-        annotation_->BeginEvent(L"Create_shadow_maps");
+void SceneManager::CreateInstanceBounds(const SceneArrays& arrays, Node& node) {
+    if (node.instances.empty() || node.meshId >= (int)arrays.meshes.size()) {
+        return;
     }
-    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
-        device_->GetDeviceContext()->ClearDepthStencilView(shadowSplits_[i].DSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
-        device_->GetDeviceContext()->OMSetRenderTargets(0, nullptr, shadowSplits_[i].DSV);
-        device_->GetDeviceContext()->OMSetDepthStencilState(shadowDepthStencilState_.get(), 0);
-        viewport_.Width = shadowMapSize;
-        viewport_.Height = shadowMapSize;
-        device_->GetDeviceContext()->RSSetViewports(1, &viewport_);
-        device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
 
-        ViewMatrixBuffer viewMatrix;
-        viewMatrix.viewProjectionMatrix = directionalLight_->viewProjectionMatrices[i];
-        device_->GetDeviceContext()->UpdateSubresource(viewMatrixBuffer_, 0, nullptr, &viewMatrix, 0, 0);
-
-        for (auto j : sceneIndices) {
-            if (j < 0 || j >= scenes_.size()) {
-                continue;
-            }
-            for (auto node : scenes_[j].rootNodes) {
-                if (!CreateShadowMapForNode(scenes_[j].arraysId, node, scenes_[j].transformation)) {
-                    if (!!annotation_) {
-                        annotation_->EndEvent();
-                    }
-                    return false;
-                }
-            }
+    // the instances are culled with the bounds of the whole mesh, so that all primitives share one test
+    const Mesh& mesh = arrays.meshes[node.meshId];
+    AABB meshBounds;
+    for (auto primitives : { &mesh.opaquePrimitives, &mesh.transparentPrimitives, &mesh.primitivesWithAlphaCutoff }) {
+        for (auto p : *primitives) {
+            const AABB& bounds = primitives_[p].bounds;
+            meshBounds.Extend(bounds.min);
+            meshBounds.Extend(bounds.max);
         }
     }
-    if (!!annotation_) {
-        annotation_->EndEvent();
+    node.instanceBounds.Clear();
+    node.bounds = AABB();
+    for (const XMMATRIX& instance : node.instances) {
+        AABB bounds = meshBounds.IsEmpty() ? meshBounds : meshBounds.Transform(instance);
+        node.instanceBounds.Add(bounds);
+        node.bounds.Extend(bounds.min);
+        node.bounds.Extend(bounds.max);
     }
-    return true;
 }
 
-bool SceneManager::CreateShadowMapForNode(int arrayId, int nodeId, const XMMATRIX& transformation) {
-    const Node& node = sceneArrays_[arrayId].nodes[nodeId];
-    XMMATRIX currentTransformation = XMMatrixMultiply(node.transformation, transformation);
+void SceneManager::ReadInstances(const tinygltf::Model& model, const tinygltf::Node& node, std::vector<XMMATRIX>& instances) {
+    auto extension = node.extensions.find("EXT_mesh_gpu_instancing");
+    if (extension == node.extensions.end() || !extension->second.Has("attributes")) {
+        return;
+    }
 
-    if (node.meshId >= 0) {
-        const Mesh& mesh = sceneArrays_[arrayId].meshes[node.meshId];
-        for (auto& p : mesh.opaquePrimitives) {
-            if (!CreateShadowMapForPrimitive(arrayId, p, AlphaMode::OPAQUE_MODE, currentTransformation)) {
-                return false;
-            }
-        }
-        if (!excludeTransparent) {
-            for (auto& p : mesh.transparentPrimitives) {
-                if (!CreateShadowMapForPrimitive(arrayId, p, AlphaMode::ALPHA_CUTOFF_MODE, currentTransformation)) {
-                    return false;
-                }
-            }
+    // every attribute is optional, missing ones keep the identity values
+    const tinygltf::Value& attributes = extension->second.Get("attributes");
+    const char* names[] = { "TRANSLATION", "ROTATION", "SCALE" };
+    const int types[] = { TINYGLTF_TYPE_VEC3, TINYGLTF_TYPE_VEC4, TINYGLTF_TYPE_VEC3 };
+    std::vector<XMFLOAT4> values[_countof(names)];
+    size_t count = 0;
+    for (UINT i = 0; i < _countof(names); ++i) {
+        if (!attributes.Has(names[i]) || !ReadAccessor(model, attributes.Get(names[i]).GetNumberAsInt(), types[i], values[i])) {
+            continue;
         }
-        for (auto& p : mesh.primitivesWithAlphaCutoff) {
-            if (!CreateShadowMapForPrimitive(arrayId, p, AlphaMode::ALPHA_CUTOFF_MODE, currentTransformation)) {
-                return false;
-            }
+        if (count != 0 && values[i].size() != count) {
+            return; // all attributes must have the same count
         }
+        count = values[i].size();
     }
 
-    for (auto c : node.children) {
-        if (!CreateShadowMapForNode(arrayId, c, currentTransformation)) {
-            return false;
+    instances.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        XMMATRIX transformation = XMMatrixIdentity();
+        if (!values[2].empty()) {
+            transformation = XMMatrixScaling(values[2][i].x, values[2][i].y, values[2][i].z);
+        }
+        if (!values[1].empty()) {
+            transformation = XMMatrixMultiply(transformation, XMMatrixRotationQuaternion(XMQuaternionNormalize(XMLoadFloat4(&values[1][i]))));
         }
+        if (!values[0].empty()) {
+            transformation = XMMatrixMultiply(transformation, XMMatrixTranslation(values[0][i].x, values[0][i].y, values[0][i].z));
+        }
+        instances[i] = transformation;
     }
-
-    return true;
 }
 
-bool SceneManager::CreateShadowMapForPrimitive(int arrayId, const Primitive& primitive, AlphaMode mode, const XMMATRIX& transformation) {
-    const Material& material = sceneArrays_[arrayId].materials[primitive.materialId];
-
-    WorldMatrixBuffer worldMatrix;
-    worldMatrix.worldMatrix = transformation;
-    device_->GetDeviceContext()->UpdateSubresource(worldMatrixBuffer_, 0, nullptr, &worldMatrix, 0, 0);
-
-    std::shared_ptr<ID3D11RasterizerState> rasterizerState;
-    HRESULT result = managerStorage_->GetStateManager()->CreateRasterizerState(rasterizerState, D3D11_FILL_SOLID, material.cullMode, depthBias, slopeScaleBias);
-    if (FAILED(result)) {
+bool SceneManager::ReadAccessor(const tinygltf::Model& model, int accessorId, int type, std::vector<XMFLOAT4>& values) {
+    if (accessorId < 0 || accessorId >= (int)model.accessors.size()) {
+        return false;
+    }
+    const tinygltf::Accessor& ga = model.accessors[accessorId];
+    if (ga.type != type || ga.bufferView < 0 || ga.sparse.isSparse) {
         return false;
     }
 
-    if (mode == AlphaMode::ALPHA_CUTOFF_MODE) {
-        ShadowMapAlphaCutoffBuffer alphaCutoff;
-        alphaCutoff.baseColorFactor = material.baseColorFactor;
-        alphaCutoff.alphaCutoffTexCoord = XMFLOAT4(material.alphaCutoff, material.baseColorTA.texCoordId, 0.0f, 0.0f);
-        device_->GetDeviceContext()->UpdateSubresource(shadowMapAlphaCutoffBuffer_, 0, nullptr, &alphaCutoff, 0, 0);
+    int components = tinygltf::GetNumComponentsInType(ga.type);
+    int componentSize = tinygltf::GetComponentSizeInBytes(ga.componentType);
+    if (components <= 0 || components > 4 || componentSize <= 0) {
+        return false;
+    }
 
-        if (material.baseColorTA.textureId >= 0) {
-            ID3D11ShaderResourceView* resources[] = { sceneArrays_[arrayId].textures[material.baseColorTA.textureId]->GetSRV(material.baseColorTA.isSRGB).get() };
-            device_->GetDeviceContext()->PSSetShaderResources(0, 1, resources);
+    const tinygltf::BufferView& gbv = model.bufferViews[ga.bufferView];
+    size_t stride = gbv.byteStride != 0 ? gbv.byteStride : components * componentSize;
+    size_t offset = gbv.byteOffset + ga.byteOffset;
+    if (ga.count != 0 && offset + (ga.count - 1) * stride + components * componentSize > model.buffers[gbv.buffer].data.size()) {
+        return false;
+    }
 
-            ID3D11SamplerState* samplers[] = { sceneArrays_[arrayId].samplers[material.baseColorTA.samplerId].get() };
-            device_->GetDeviceContext()->PSSetSamplers(0, 1, samplers);
+    // rotations and scales may be stored as normalized integers, as the vertex attributes
+    const unsigned char* data = model.buffers[gbv.buffer].data.data() + offset;
+    float scales[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    if (ga.normalized) {
+        scales[0] = 1.0f / 127.0f;
+        scales[1] = 1.0f / 255.0f;
+        scales[2] = 1.0f / 32767.0f;
+        scales[3] = 1.0f / 65535.0f;
+    }
+    values.assign(ga.count, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+    for (size_t i = 0; i < ga.count; ++i) {
+        float* value = &values[i].x;
+        const unsigned char* element = data + i * stride;
+        for (int c = 0; c < components; ++c) {
+            switch (ga.componentType) {
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                value[c] = reinterpret_cast<const float*>(element)[c];
+                break;
+            case TINYGLTF_COMPONENT_TYPE_BYTE:
+                value[c] = reinterpret_cast<const int8_t*>(element)[c] * scales[0];
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                value[c] = element[c] * scales[1];
+                break;
+            case TINYGLTF_COMPONENT_TYPE_SHORT:
+                value[c] = reinterpret_cast<const int16_t*>(element)[c] * scales[2];
+                break;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                value[c] = reinterpret_cast<const uint16_t*>(element)[c] * scales[3];
+                break;
+            default:
+                return false;
+            }
+            if (ga.normalized) {
+                value[c] = (std::max)(value[c], -1.0f); // -128 and -32768 map to -1 as well
+            }
         }
     }
+    return true;
+}
 
-    device_->GetDeviceContext()->IASetInputLayout(primitive.shadowVS->GetInputLayout().get());
-    UINT numBuffers = primitive.attributes.size();
-    std::vector<ID3D11Buffer*> vertexBuffers;
-    std::vector<UINT> strides;
-    std::vector<UINT> offsets;
-    for (auto& a : primitive.attributes) {
-        const BufferAccessor& accessor = sceneArrays_[arrayId].accessors[a.verticesAccessorId];
-        vertexBuffers.push_back(accessor.buffer.get());
-        strides.push_back(accessor.byteStride);
-        offsets.push_back(accessor.byteOffset);
+void SceneManager::FlattenNodes(Scene& scene, const SceneArrays& arrays, int nodeId, int parent) {
+    const Node& node = arrays.nodes[nodeId];
+    int index = scene.transformations.AddNode(parent, node.transformation);
+    scene.nodes.push_back(nodeId);
+    scene.hierarchyIndices[nodeId] = index;
+    for (auto c : node.children) {
+        FlattenNodes(scene, arrays, c, index);
     }
-    device_->GetDeviceContext()->IASetVertexBuffers(0, numBuffers, vertexBuffers.data(), strides.data(), offsets.data());
-    device_->GetDeviceContext()->RSSetState(rasterizerState.get());
-    device_->GetDeviceContext()->IASetPrimitiveTopology(primitive.mode);
-    device_->GetDeviceContext()->VSSetShader(primitive.shadowVS->GetShader().get(), nullptr, 0);
-    device_->GetDeviceContext()->VSSetConstantBuffers(0, 1, &worldMatrixBuffer_);
-    device_->GetDeviceContext()->VSSetConstantBuffers(1, 1, &viewMatrixBuffer_);
+}
 
-    if (mode == AlphaMode::ALPHA_CUTOFF_MODE) {
-        device_->GetDeviceContext()->PSSetShader(primitive.shadowPS->GetShader().get(), nullptr, 0);
-        device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &shadowMapAlphaCutoffBuffer_);
-    }
-    else {
-        device_->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
+bool SceneManager::SetNodeTransformation(UINT sceneIndex, int nodeId, const XMMATRIX& transformation) {
+    if (sceneIndex >= scenes_.size() || nodeId < 0 || nodeId >= scenes_[sceneIndex].hierarchyIndices.size()
+        || scenes_[sceneIndex].hierarchyIndices[nodeId] < 0) {
+        return false;
     }
+    Scene& scene = scenes_[sceneIndex];
+    sceneArrays_[scene.arraysId].nodes[nodeId].transformation = transformation;
+    scene.transformations.SetLocalTransformation(scene.hierarchyIndices[nodeId], transformation);
+    return true;
+}
 
-    if (primitive.indicesAccessorId >= 0) {
-        const BufferAccessor& accessor = sceneArrays_[arrayId].accessors[primitive.indicesAccessorId];
-        device_->GetDeviceContext()->IASetIndexBuffer(accessor.buffer.get(), accessor.format, accessor.byteOffset);
-        device_->GetDeviceContext()->DrawIndexed(accessor.count, 0, 0);
-    }
-    else {
-        device_->GetDeviceContext()->Draw(sceneArrays_[arrayId].accessors[primitive.attributes[0].verticesAccessorId].count, 0);
+bool SceneManager::SetSceneTransformation(UINT sceneIndex, const XMMATRIX& transformation) {
+    if (sceneIndex >= scenes_.size()) {
+        return false;
     }
+    scenes_[sceneIndex].transformation = transformation;
+    scenes_[sceneIndex].transformations.SetRootTransformation(transformation);
     return true;
 }
 
-bool SceneManager::PrepareTransparent(const std::vector<int>& sceneIndices) {
-    if (excludeTransparent) {
-        return true;
-    }
-    
-    if (!!annotation_) {
-        annotation_->BeginEvent(L"Prepare_transparent");
+void SceneManager::UpdateTransformations(const std::vector<int>& sceneIndices) {
+    CPU_PROFILE_SCOPE("SceneManager::UpdateTransformations");
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto j : sceneIndices) {
+        if (j < 0 || j >= scenes_.size()) {
+            continue;
+        }
+        renderStatistics_.nodes += scenes_[j].transformations.Size();
+        renderStatistics_.updatedTransformations += scenes_[j].transformations.Update();
     }
+    renderStatistics_.transformationTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
 
-    transparentPrimitives_.clear();
-
-    ViewMatrixBuffer viewMatrix;
-    viewMatrix.viewProjectionMatrix = camera_->GetViewProjectionMatrix();
-    device_->GetDeviceContext()->UpdateSubresource(viewMatrixBuffer_, 0, nullptr, &viewMatrix, 0, 0);
-
+void SceneManager::CollectDrawItems(const std::vector<int>& sceneIndices) {
+    CPU_PROFILE_SCOPE("SceneManager::CollectDrawItems");
+    drawItems_.clear();
+    drawItemBounds_.Clear();
+    // FNV-1a over the static nodes, the cached shadow maps are valid while it does not change
+    staticCasterKey_ = 14695981039346656037ull;
+    auto hash = [this](uint64_t value) {
+        staticCasterKey_ = (staticCasterKey_ ^ value) * 1099511628211ull;
+    };
     for (auto j : sceneIndices) {
         if (j < 0 || j >= scenes_.size()) {
             continue;
         }
-        for (auto node : scenes_[j].rootNodes) {
-            if (!PrepareTransparentForNode(scenes_[j].arraysId, node, scenes_[j].transformation)) {
-                if (!!annotation_) {
-                    annotation_->EndEvent();
+        const Scene& scene = scenes_[j];
+        const SceneArrays& arrays = sceneArrays_[scene.arraysId];
+        for (UINT k = 0; k < scene.nodes.size(); ++k) {
+            const Node& node = arrays.nodes[scene.nodes[k]];
+            if (node.meshId < 0) {
+                continue;
+            }
+
+            const Mesh& mesh = arrays.meshes[node.meshId];
+            const std::vector<PrimitiveHandle>* primitives[] = { &mesh.opaquePrimitives, &mesh.transparentPrimitives, &mesh.primitivesWithAlphaCutoff };
+            const AlphaMode modes[] = { AlphaMode::OPAQUE_MODE, AlphaMode::BLEND_MODE, AlphaMode::ALPHA_CUTOFF_MODE };
+            const XMMATRIX& world = scene.transformations.GetWorldTransformation(k);
+            bool dynamic = scene.transformations.GetUpdatesSinceChange(k) < staticUpdateCount;
+
+            if (!dynamic) {
+                hash(j);
+                hash(k);
+            }
+            // a node with EXT_mesh_gpu_instancing is one item per primitive, bounded by all its instances; the instances
+            // themselves are culled for each pass by BuildInstanceBatches
+            bool instanced = !node.instances.empty();
+            for (UINT m = 0; m < _countof(primitives); ++m) {
+                for (auto p : *primitives[m]) {
+                    DrawItem item;
+                    item.transformation = world;
+                    item.primitive = p;
+                    item.mode = modes[m];
+                    item.dynamic = dynamic;
+                    item.instancedNode = instanced ? &node : nullptr;
+                    drawItems_.push_back(item);
+                    drawItemBounds_.Add((instanced ? node.bounds : primitives_[p].bounds).Transform(world));
                 }
-                return false;
             }
+            renderStatistics_.meshInstances += (UINT)node.instances.size();
         }
     }
-    if (!!annotation_) {
-        annotation_->EndEvent();
+}
+
+void SceneManager::CullDrawItems() {
+    CPU_PROFILE_SCOPE("SceneManager::CullDrawItems");
+    auto start = std::chrono::high_resolution_clock::now();
+    Frustum frustum = Frustum::FromMatrix(camera_->GetViewProjectionMatrix());
+    renderStatistics_.visiblePrimitives = drawItemBounds_.Cull(frustum, cameraVisibility_);
+    renderStatistics_.culledPrimitives = drawItemBounds_.Size() - renderStatistics_.visiblePrimitives;
+    renderStatistics_.cullingTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void SceneManager::FitShadowCascades() {
+    CPU_PROFILE_SCOPE("SceneManager::FitShadowCascades");
+    XMMATRIX invViewMatrix = XMMatrixInverse(nullptr, camera_->GetViewMatrix());
+    XMMATRIX projection = camera_->GetProjectionMatrix();
+    XMFLOAT3 right, up, back, position;
+    XMStoreFloat3(&right, invViewMatrix.r[0]);
+    XMStoreFloat3(&up, invViewMatrix.r[1]);
+    XMStoreFloat3(&back, invViewMatrix.r[2]);
+    XMStoreFloat3(&position, invViewMatrix.r[3]);
+
+    ShadowCascades::View view;
+    view.position = { position.x, position.y, position.z };
+    view.right = { right.x, right.y, right.z };
+    view.up = { up.x, up.y, up.z };
+    view.forward = { -back.x, -back.y, -back.z };
+    view.projectionScaleX = XMVectorGetX(projection.r[0]);
+    view.projectionScaleY = XMVectorGetY(projection.r[1]);
+    view.nearPlane = camera_->GetNearPlane();
+    view.farPlane = camera_->GetFarPlane();
+
+    AABB sceneBounds;
+    for (UINT i = 0; i < drawItemBounds_.Size(); ++i) {
+        AABB bounds = drawItemBounds_.Get(i);
+        sceneBounds.Extend(bounds.min);
+        sceneBounds.Extend(bounds.max);
+    }
+    // the bounds give the depth range of the cascades, rounded outwards they do not change with every small movement,
+    // which would invalidate the cached maps
+    if (!sceneBounds.IsEmpty()) {
+        sceneBounds.min = { std::floor(sceneBounds.min.x / 16.0f) * 16.0f, std::floor(sceneBounds.min.y / 16.0f) * 16.0f,
+            std::floor(sceneBounds.min.z / 16.0f) * 16.0f };
+        sceneBounds.max = { std::ceil(sceneBounds.max.x / 16.0f) * 16.0f, std::ceil(sceneBounds.max.y / 16.0f) * 16.0f,
+            std::ceil(sceneBounds.max.z / 16.0f) * 16.0f };
+    }
+    ShadowCascades::Vector3 sceneMin = { sceneBounds.min.x, sceneBounds.min.y, sceneBounds.min.z };
+    ShadowCascades::Vector3 sceneMax = { sceneBounds.max.x, sceneBounds.max.y, sceneBounds.max.z };
+    directionalLight_->cascadeSettings.snapTexels = cacheShadows ? shadowCacheBand : 1;
+    directionalLight_->UpdateCascades(view, sceneMin, sceneMax);
+    // the boxes hardly depend on the resolutions, so they are fitted again only to snap them to the new texels
+    if (ChooseShadowTiles(view)) {
+        directionalLight_->UpdateCascades(view, sceneMin, sceneMax);
+    }
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        renderStatistics_.shadowCoverage[i] = ShadowCascades::ComputeCoverage(directionalLight_->cascades.GetCascade(i), 16);
     }
-    return true;
 }
 
-bool SceneManager::PrepareTransparentForNode(int arrayId, int nodeId, const XMMATRIX& transformation) {
-    const Node& node = sceneArrays_[arrayId].nodes[nodeId];
-    XMMATRIX currentTransformation = XMMatrixMultiply(node.transformation, transformation);
+// sizes of the tiles from the screen resolution the cascades would need and their shares of the screen,
+// returns true if the tiles were allocated again
+bool SceneManager::ChooseShadowTiles(const ShadowCascades::View& view) {
+    // the largest power of two atlas within the budget, with caching the budget also holds the copy of the atlas
+    double budgetTexels = (double)(std::max)(shadowMemoryBudgetMB, 1) * 1024.0 * 1024.0 / (sizeof(float) * (cacheShadows ? 2 : 1));
+    UINT atlasSize = ShadowAtlas::FloorPowerOfTwo((UINT)std::sqrt(budgetTexels));
+    atlasSize = (std::min)((std::max)(atlasSize, 2 * minShadowTileSize), maxShadowAtlasSize);
+
+    ShadowAtlas::Request requests[CSM_SPLIT_COUNT];
+    float coverage[CSM_SPLIT_COUNT] = {};
+    EstimateCascadeScreenCoverage(view, coverage);
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        requests[i].desiredSize = ShadowCascades::GetMatchingResolution(directionalLight_->cascades.GetCascade(i), view, (float)height_);
+        requests[i].screenCoverage = coverage[i];
+        renderStatistics_.shadowScreenCoverage[i] = coverage[i];
+    }
+    UINT sizes[CSM_SPLIT_COUNT];
+    ShadowAtlas::ChooseSizes(requests, CSM_SPLIT_COUNT, atlasSize, minShadowTileSize, atlasSize, sizes);
 
-    if (node.meshId >= 0) {
-        for (auto& p : sceneArrays_[arrayId].meshes[node.meshId].transparentPrimitives) {
-            if (!AddPrimitiveToTransparentPrimitives(arrayId, p, currentTransformation)) {
-                return false;
-            }
-        }
+    bool resized = atlasSize != shadowAtlas_.GetSize();
+    bool changed = resized;
+    bool pendingChanged = false;
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        changed = changed || sizes[i] != shadowTiles_[i].size;
+        pendingChanged = pendingChanged || sizes[i] != pendingShadowTileSizes_[i];
+        pendingShadowTileSizes_[i] = sizes[i];
+    }
+    // the coverage changes with every camera movement, a new choice is taken only when it persists,
+    // otherwise the cached maps would be redrawn all the time
+    pendingShadowTileFrames_ = pendingChanged ? 0 : pendingShadowTileFrames_ + 1;
+    if (!changed || (!resized && pendingShadowTileFrames_ < shadowTileDelay)) {
+        return false;
     }
+    pendingShadowTileFrames_ = 0;
 
-    for (auto c : node.children) {
-        if (!PrepareTransparentForNode(arrayId, c, currentTransformation)) {
-            return false;
+    // from the largest tile to the smallest, then the tiles always fit
+    UINT order[CSM_SPLIT_COUNT];
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order, order + CSM_SPLIT_COUNT, [&sizes](UINT a, UINT b) {
+        return sizes[a] > sizes[b];
+    });
+    shadowAtlas_.Reset(atlasSize, minShadowTileSize);
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        UINT k = order[i];
+        if (!shadowAtlas_.Allocate(sizes[k], shadowTiles_[k])) {
+            shadowTiles_[k] = ShadowAtlas::Tile();
+            shadowTiles_[k].size = minShadowTileSize; // cannot happen with the sizes chosen for this atlas
         }
+        directionalLight_->cascadeSettings.resolutions[k] = shadowTiles_[k].size;
+        const ShadowAtlas::Tile& tile = shadowTiles_[k];
+        directionalLight_->atlasRects[k] = XMFLOAT4((float)tile.x / atlasSize, (float)tile.y / atlasSize, (float)tile.size / atlasSize,
+            0.5f / tile.size);
     }
-
     return true;
 }
 
-bool SceneManager::AddPrimitiveToTransparentPrimitives(int arrayId, const Primitive& primitive, const XMMATRIX& transformation) {
-    TransparentPrimitive transparentPrimitive(primitive);
-    transparentPrimitive.transformation = transformation;
-    transparentPrimitive.arrayId = arrayId;
+// share of the screen in each cascade, from the projected bounding spheres of the visible draw items
+// split between the cascades by the depth ranges of the spheres
+void SceneManager::EstimateCascadeScreenCoverage(const ShadowCascades::View& view, float* coverage) {
+    const ShadowCascades& cascades = directionalLight_->cascades;
+    float total = 0.0f;
+    for (UINT k = 0; k < drawItems_.size(); ++k) {
+        if (!cameraVisibility_[k]) {
+            continue;
+        }
+        AABB bounds = drawItemBounds_.Get(k);
+        XMFLOAT3 center = { (bounds.min.x + bounds.max.x) * 0.5f, (bounds.min.y + bounds.max.y) * 0.5f, (bounds.min.z + bounds.max.z) * 0.5f };
+        XMFLOAT3 extents = { bounds.max.x - center.x, bounds.max.y - center.y, bounds.max.z - center.z };
+        float radius = std::sqrt(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+        float depth = (center.x - view.position.x) * view.forward.x + (center.y - view.position.y) * view.forward.y
+            + (center.z - view.position.z) * view.forward.z;
+        // the screen spans 2 / scale units at the depth 1 along each axis
+        float area = depth > radius
+            ? (std::min)(XM_PI * radius * radius * view.projectionScaleX * view.projectionScaleY / (4.0f * depth * depth), 1.0f)
+            : 1.0f;
+        float nearDepth = depth - radius;
+        float farDepth = depth + radius;
+        for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+            const ShadowCascades::Cascade& cascade = cascades.GetCascade(i);
+            float overlap = (std::min)(farDepth, cascade.farDistance) - (std::max)(nearDepth, cascade.nearDistance);
+            if (overlap > 0.0f) {
+                float share = radius > 0.0f ? area * overlap / (farDepth - nearDepth) : area;
+                coverage[i] += share;
+                total += share;
+            }
+        }
+    }
+    for (UINT i = 0; i < CSM_SPLIT_COUNT && total > 0.0f; ++i) {
+        coverage[i] /= total;
+    }
+}
 
-    device_->GetDeviceContext()->ClearDepthStencilView(transparentDepth_.DSV, D3D11_CLEAR_DEPTH, 0.0f, 0);
-    device_->GetDeviceContext()->OMSetRenderTargets(0, nullptr, transparentDepth_.DSV);
-    device_->GetDeviceContext()->OMSetDepthStencilState(transparentDepthStencilState_.get(), 0);
-    viewport_.Width = width_;
-    viewport_.Height = height_;
-    device_->GetDeviceContext()->RSSetViewports(1, &viewport_);
-    device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+// recreates the atlas after its size was changed by ChooseShadowTiles, the cached maps are lost
+HRESULT SceneManager::CreateShadowAtlas() {
+    // without caching the copy is not needed and the budget is given to the atlas alone
+    if (!cacheShadows) {
+        SAFE_RELEASE(shadowAtlasCopy_.texture);
+        SAFE_RELEASE(shadowAtlasCopy_.DSV);
+        SAFE_RELEASE(shadowAtlasCopy_.SRV);
+    }
+    UINT size = shadowAtlas_.GetSize();
+    if (size == shadowAtlasDepthSize_ && shadowAtlasDepth_.texture) {
+        return S_OK;
+    }
+    for (auto buffer : { &shadowAtlasDepth_, &shadowAtlasCopy_ }) {
+        SAFE_RELEASE(buffer->texture);
+        SAFE_RELEASE(buffer->DSV);
+        SAFE_RELEASE(buffer->SRV);
+    }
+    for (auto& cache : shadowCaches_) {
+        cache.valid = false;
+    }
+    shadowAtlasDepthSize_ = 0;
+    HRESULT result = CreateDepthStencilView(size, size, shadowAtlasDepth_);
+    if (SUCCEEDED(result)) {
+        shadowAtlasDepthSize_ = size;
+    }
+    return result;
+}
 
-    WorldMatrixBuffer worldMatrix;
-    worldMatrix.worldMatrix = transformation;
-    device_->GetDeviceContext()->UpdateSubresource(worldMatrixBuffer_, 0, nullptr, &worldMatrix, 0, 0);
-
-    device_->GetDeviceContext()->IASetInputLayout(primitive.shadowVS->GetInputLayout().get());
-    UINT numBuffers = primitive.attributes.size();
-    std::vector<ID3D11Buffer*> vertexBuffers;
-    std::vector<UINT> strides;
-    std::vector<UINT> offsets;
-    for (auto& a : primitive.attributes) {
-        const BufferAccessor& accessor = sceneArrays_[arrayId].accessors[a.verticesAccessorId];
-        vertexBuffers.push_back(accessor.buffer.get());
-        strides.push_back(accessor.byteStride);
-        offsets.push_back(accessor.byteOffset);
-    }
-    device_->GetDeviceContext()->IASetVertexBuffers(0, numBuffers, vertexBuffers.data(), strides.data(), offsets.data());
-    device_->GetDeviceContext()->RSSetState(sceneArrays_[arrayId].materials[primitive.materialId].rasterizerState.get());
-    device_->GetDeviceContext()->IASetPrimitiveTopology(primitive.mode);
-    device_->GetDeviceContext()->VSSetShader(primitive.shadowVS->GetShader().get(), nullptr, 0);
-    device_->GetDeviceContext()->VSSetConstantBuffers(0, 1, &worldMatrixBuffer_);
-    device_->GetDeviceContext()->VSSetConstantBuffers(1, 1, &viewMatrixBuffer_);
-    device_->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
-    if (primitive.indicesAccessorId >= 0) {
-        const BufferAccessor& accessor = sceneArrays_[arrayId].accessors[primitive.indicesAccessorId];
-        device_->GetDeviceContext()->IASetIndexBuffer(accessor.buffer.get(), accessor.format, accessor.byteOffset);
-        device_->GetDeviceContext()->DrawIndexed(accessor.count, 0, 0);
+bool SceneManager::CreateShadowMaps() {
+    CPU_PROFILE_SCOPE("SceneManager::CreateShadowMaps");
+    // the bias settings are the same for all primitives, so states are requested once per frame for each cull mode
+    for (UINT i = 0; i < _countof(shadowRasterizerStates_); ++i) {
+        HRESULT result = managerStorage_->GetStateManager()->CreateRasterizerState(shadowRasterizerStates_[i], D3D11_FILL_SOLID,
+            (D3D11_CULL_MODE)(D3D11_CULL_NONE + i), depthBias, slopeScaleBias);
+        if (FAILED(result)) {
+            return false;
+        }
     }
-    else {
-        device_->GetDeviceContext()->Draw(sceneArrays_[arrayId].accessors[primitive.attributes[0].verticesAccessorId].count, 0);
+    if (FAILED(CreateShadowAtlas())) {
+        return false;
     }
 
-    static float color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    if (!!annotation_) {
+        annotation_->BeginEvent(L"Create_shadow_maps");
+    }
+    renderStatistics_.shadowCasterCandidates = (UINT)drawItems_.size();
+    bool succeeded = UpdateShadowCaches();
+    shadowAtlasSRV_ = shadowAtlasDepth_.SRV;
+
+    // moving objects are drawn over a copy, so the cached atlas stays clean for the next frames
+    bool copied = false;
+    for (UINT i = 0; succeeded && cacheShadows && i < CSM_SPLIT_COUNT; ++i) {
+        FrameVector<UINT> dynamicCasters(frameArenas_.GetLocal());
+        CollectShadowCasters(directionalLight_->viewProjectionMatrices[i], CasterSet::DYNAMIC, dynamicCasters);
+        if (dynamicCasters.empty()) {
+            continue;
+        }
+        if (!copied) {
+            if (!shadowAtlasCopy_.texture) {
+                succeeded = SUCCEEDED(CreateDepthStencilView(shadowAtlasDepthSize_, shadowAtlasDepthSize_, shadowAtlasCopy_));
+            }
+            if (succeeded) {
+                device_->GetDeviceContext()->CopyResource(shadowAtlasCopy_.texture, shadowAtlasDepth_.texture);
+                device_->GetDeviceContext()->OMSetRenderTargets(0, nullptr, shadowAtlasCopy_.DSV);
+                shadowAtlasSRV_ = shadowAtlasCopy_.SRV;
+                copied = true;
+            }
+        }
+        if (succeeded) {
+            succeeded = DrawShadowCasters(i, directionalLight_->projectionMatrices[i], GetShadowTileViewport(i), CasterSet::DYNAMIC);
+            ++renderStatistics_.shadowCascadesComposited;
+        }
+    }
+
+    renderStatistics_.shadowAtlasSize = shadowAtlasDepthSize_;
+    renderStatistics_.shadowAtlasUsage = shadowAtlas_.GetUsage();
+    renderStatistics_.shadowMemoryBytes = (size_t)shadowAtlasDepthSize_ * shadowAtlasDepthSize_ * sizeof(float)
+        * (shadowAtlasCopy_.texture ? 2 : 1);
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        renderStatistics_.shadowTileSizes[i] = shadowTiles_[i].size;
+    }
+    if (!!annotation_) {
+        annotation_->EndEvent();
+    }
+    return succeeded;
+}
+
+// brings the tile of every cascade to the current position of the cascade with the static casters
+// (all casters without caching): moved tiles are scrolled, invalid ones are drawn again
+bool SceneManager::UpdateShadowCaches() {
+    XMINT2 offsets[CSM_SPLIT_COUNT];
+    bool scrolled[CSM_SPLIT_COUNT] = {};
+    bool redrawn[CSM_SPLIT_COUNT] = {};
+    bool anyScrolled = false;
+    bool allRedrawn = true;
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        redrawn[i] = !CheckShadowCache(i, offsets[i].x, offsets[i].y);
+        scrolled[i] = !redrawn[i] && (offsets[i].x != 0 || offsets[i].y != 0);
+        anyScrolled = anyScrolled || scrolled[i];
+        allRedrawn = allRedrawn && redrawn[i];
+    }
+    if (anyScrolled && !ScrollShadowTiles(offsets, scrolled)) {
+        return false;
+    }
+
+    device_->GetDeviceContext()->OMSetRenderTargets(0, nullptr, shadowAtlasDepth_.DSV);
+    if (allRedrawn) {
+        device_->GetDeviceContext()->ClearDepthStencilView(shadowAtlasDepth_.DSV, D3D11_CLEAR_DEPTH, 1.0f, 0);
+    }
+    CasterSet set = cacheShadows ? CasterSet::STATIC : CasterSet::ALL;
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        const ShadowCascades::Cascade& box = directionalLight_->cascades.GetCascade(i);
+        if (redrawn[i]) {
+            ++renderStatistics_.shadowCascadesRedrawn;
+            if (!allRedrawn) {
+                ClearShadowTile(i);
+            }
+            if (!DrawShadowCasters(i, directionalLight_->projectionMatrices[i], GetShadowTileViewport(i), set)) {
+                return false;
+            }
+            continue;
+        }
+        if (!scrolled[i]) {
+            continue;
+        }
+
+        // the uncovered bands are drawn with projections of their own parts of the box, the depth mapping is the same
+        ++renderStatistics_.shadowCascadesScrolled;
+        int size = (int)shadowTiles_[i].size;
+        int offsetX = offsets[i].x;
+        int offsetY = offsets[i].y;
+        if (offsetX != 0) {
+            int first = offsetX > 0 ? size - offsetX : 0;
+            int last = offsetX > 0 ? size : -offsetX;
+            XMMATRIX projection = XMMatrixOrthographicOffCenterRH(box.min.x + first * box.texelSize, box.min.x + last * box.texelSize,
+                box.min.y, box.max.y, -box.max.z, -box.min.z);
+            if (!DrawShadowCasters(i, projection, GetShadowTileViewport(i, first, 0, last - first, size), CasterSet::STATIC)) {
+                return false;
+            }
+        }
+        if (offsetY != 0) {
+            int first = offsetY > 0 ? size - offsetY : 0;
+            int last = offsetY > 0 ? size : -offsetY;
+            XMMATRIX projection = XMMatrixOrthographicOffCenterRH(box.min.x, box.max.x, box.max.y - last * box.texelSize,
+                box.max.y - first * box.texelSize, -box.max.z, -box.min.z);
+            if (!DrawShadowCasters(i, projection, GetShadowTileViewport(i, 0, first, size, last - first), CasterSet::STATIC)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// false if the tile must be drawn again, otherwise the offset in texels from the new texels to the cached ones;
+// the cache state is updated to the current cascade in both cases
+bool SceneManager::CheckShadowCache(UINT cascade, int& offsetX, int& offsetY) {
+    const ShadowCascades::Cascade& box = directionalLight_->cascades.GetCascade(cascade);
+    const ShadowAtlas::Tile& tile = shadowTiles_[cascade];
+    ShadowCache& cache = shadowCaches_[cascade];
+
+    bool reusable = cacheShadows && cache.valid && cache.staticCasters == staticCasterKey_ && cache.texelSize == box.texelSize
+        && cache.minZ == box.min.z && cache.maxZ == box.max.z && cache.depthBias == depthBias && cache.slopeScaleBias == slopeScaleBias
+        && cache.excludeTransparent == excludeTransparent && cache.lightDirection.x == directionalLight_->direction.x
+        && cache.lightDirection.y == directionalLight_->direction.y && cache.lightDirection.z == directionalLight_->direction.z
+        && cache.tileX == tile.x && cache.tileY == tile.y && cache.tileSize == tile.size;
+    // texels of the new map are taken from the old one shifted by the offset, rows go from the top
+    offsetX = reusable ? (int)std::round((box.min.x - cache.minX) / box.texelSize) : 0;
+    offsetY = reusable ? (int)std::round((cache.maxY - box.max.y) / box.texelSize) : 0;
+    reusable = reusable && std::abs(offsetX) < (int)tile.size && std::abs(offsetY) < (int)tile.size;
+
+    cache.valid = cacheShadows;
+    cache.lightDirection = directionalLight_->direction;
+    cache.texelSize = box.texelSize;
+    cache.minZ = box.min.z;
+    cache.maxZ = box.max.z;
+    cache.minX = box.min.x;
+    cache.maxY = box.max.y;
+    cache.tileX = tile.x;
+    cache.tileY = tile.y;
+    cache.tileSize = tile.size;
+    cache.staticCasters = staticCasterKey_;
+    cache.depthBias = depthBias;
+    cache.slopeScaleBias = slopeScaleBias;
+    cache.excludeTransparent = excludeTransparent;
+    return reusable;
+}
+
+// depth buffers can be copied only as a whole: the atlas is copied, the moved tiles are drawn into the copy
+// by a shader from the atlas, and the two are swapped
+bool SceneManager::ScrollShadowTiles(const XMINT2* offsets, const bool* scrolled) {
+    if (!shadowAtlasCopy_.texture && FAILED(CreateDepthStencilView(shadowAtlasDepthSize_, shadowAtlasDepthSize_, shadowAtlasCopy_))) {
+        return false;
+    }
+    device_->GetDeviceContext()->CopyResource(shadowAtlasCopy_.texture, shadowAtlasDepth_.texture);
+
+    BindShadowScroll(shadowAtlasDepth_.SRV, shadowAtlasCopy_.DSV);
+    for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
+        if (!scrolled[i]) {
+            continue;
+        }
+        const ShadowAtlas::Tile& tile = shadowTiles_[i];
+        ShadowScrollBuffer scrollBuffer;
+        scrollBuffer.offset = XMINT4(offsets[i].x, offsets[i].y, 0, 0);
+        scrollBuffer.bounds = XMINT4(tile.x, tile.y, tile.x + tile.size, tile.y + tile.size);
+        UploadConstants(shadowScrollConstants_, shadowScrollBuffer_, scrollBuffer);
+        dynamicConstants_.BindPS(0, shadowScrollConstants_);
+        D3D11_VIEWPORT viewport = GetShadowTileViewport(i);
+        device_->GetDeviceContext()->RSSetViewports(1, &viewport);
+        device_->GetDeviceContext()->Draw(6, 0);
+    }
+
+    ID3D11ShaderResourceView* nullResources[] = { nullptr };
+    device_->GetDeviceContext()->PSSetShaderResources(0, 1, nullResources);
+    std::swap(shadowAtlasDepth_, shadowAtlasCopy_);
+    return true;
+}
+
+// the tile is filled with the far depth by the scroll shader with empty source bounds, D3D11 cannot clear a part of a depth buffer
+void SceneManager::ClearShadowTile(UINT cascade) {
+    BindShadowScroll(nullptr, shadowAtlasDepth_.DSV);
+    ShadowScrollBuffer scrollBuffer;
+    scrollBuffer.offset = XMINT4(0, 0, 0, 0);
+    scrollBuffer.bounds = XMINT4(0, 0, 0, 0);
+    UploadConstants(shadowScrollConstants_, shadowScrollBuffer_, scrollBuffer);
+    dynamicConstants_.BindPS(0, shadowScrollConstants_);
+    D3D11_VIEWPORT viewport = GetShadowTileViewport(cascade);
+    device_->GetDeviceContext()->RSSetViewports(1, &viewport);
+    device_->GetDeviceContext()->Draw(6, 0);
+}
+
+void SceneManager::BindShadowScroll(ID3D11ShaderResourceView* source, ID3D11DepthStencilView* target) {
+    device_->GetDeviceContext()->OMSetRenderTargets(0, nullptr, target);
+    device_->GetDeviceContext()->OMSetDepthStencilState(shadowScrollDepthStencilState_.get(), 0);
+    device_->GetDeviceContext()->RSSetState(generalRasterizerState_.get());
+    device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+    ID3D11ShaderResourceView* resources[] = { source };
+    device_->GetDeviceContext()->PSSetShaderResources(0, 1, resources);
+    device_->GetDeviceContext()->IASetInputLayout(mappingVS_->GetInputLayout().get());
+    device_->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    device_->GetDeviceContext()->VSSetShader(mappingVS_->GetShader().get(), nullptr, 0);
+    device_->GetDeviceContext()->PSSetShader(shadowScrollPS_->GetShader().get(), nullptr, 0);
+}
+
+// a part of the tile of the cascade, the whole tile if the width is 0
+D3D11_VIEWPORT SceneManager::GetShadowTileViewport(UINT cascade, UINT x, UINT y, UINT width, UINT height) const {
+    const ShadowAtlas::Tile& tile = shadowTiles_[cascade];
+    if (width == 0) {
+        width = tile.size;
+        height = tile.size;
+    }
+    return { (FLOAT)(tile.x + x), (FLOAT)(tile.y + y), (FLOAT)width, (FLOAT)height, 0.0f, 1.0f };
+}
+
+bool SceneManager::DrawShadowCasters(UINT cascade, const XMMATRIX& projection, const D3D11_VIEWPORT& viewport, CasterSet set) {
+    device_->GetDeviceContext()->OMSetDepthStencilState(shadowDepthStencilState_.get(), 0);
+    device_->GetDeviceContext()->RSSetViewports(1, &viewport);
+    device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+
+    ViewMatrixBuffer viewMatrix;
+    viewMatrix.viewProjectionMatrix = XMMatrixMultiply(directionalLight_->viewMatrix, projection);
+    UploadConstants(viewMatrixConstants_, viewMatrixBuffer_, viewMatrix);
+
+    FrameVector<UINT> casters(frameArenas_.GetLocal());
+    CollectShadowCasters(viewMatrix.viewProjectionMatrix, set, casters);
+    renderStatistics_.shadowCasters[cascade] += (UINT)casters.size();
+
+    bool succeeded = BuildInstanceBatches(casters, instancing, viewMatrix.viewProjectionMatrix, false);
+    for (UINT k = 0; succeeded && k < instanceBatches_.size(); ++k) {
+        succeeded = CreateShadowMapForPrimitive(instanceBatches_[k]);
+    }
+    return succeeded;
+}
+
+void SceneManager::CollectShadowCasters(const XMMATRIX& viewProjection, CasterSet set, FrameVector<UINT>& casters) {
+    // casters between the light and the near plane still cast shadows into the cascade
+    drawItemBounds_.Cull(Frustum::FromMatrix(viewProjection, false), shadowVisibility_);
+    for (UINT k = 0; k < drawItems_.size(); ++k) {
+        if ((drawItems_[k].mode == AlphaMode::BLEND_MODE && excludeTransparent) || !shadowVisibility_[k]
+            || (set == CasterSet::STATIC && drawItems_[k].dynamic) || (set == CasterSet::DYNAMIC && !drawItems_[k].dynamic)) {
+            continue;
+        }
+        casters.push_back(k);
+    }
+}
+
+bool SceneManager::CreateShadowMapForPrimitive(const InstanceBatch& batch) {
+    const DrawItem& item = drawItems_[batch.drawItemId];
+    const Primitive& primitive = primitives_[item.primitive];
+    const Material& material = materials_[primitive.material];
+    const ShaderSet& shaders = shaderSets_[primitive.shaders];
+    AlphaMode mode = item.mode == AlphaMode::OPAQUE_MODE ? AlphaMode::OPAQUE_MODE : AlphaMode::ALPHA_CUTOFF_MODE;
+
+    if (mode == AlphaMode::ALPHA_CUTOFF_MODE) {
+        if (material.baseColorTA.textureId >= 0) {
+            const TextureViews& views = textures_[material.baseColorTA.texture];
+            ID3D11ShaderResourceView* resources[] = { material.baseColorTA.isSRGB ? views.SRVSRGB : views.SRV };
+            device_->GetDeviceContext()->PSSetShaderResources(0, 1, resources);
+
+            ID3D11SamplerState* samplers[] = { material.baseColorTA.sampler };
+            device_->GetDeviceContext()->PSSetSamplers(0, 1, samplers);
+        }
+    }
+
+    device_->GetDeviceContext()->IASetInputLayout(shaders.shadowInputLayout);
+    device_->GetDeviceContext()->IASetVertexBuffers(0, primitive.vertexBufferCount, primitive.vertexBuffers, primitive.strides, primitive.offsets);
+    device_->GetDeviceContext()->RSSetState(shadowRasterizerStates_[material.cullMode - D3D11_CULL_NONE].get());
+    device_->GetDeviceContext()->IASetPrimitiveTopology(primitive.mode);
+    device_->GetDeviceContext()->VSSetShader(shaders.shadowVS, nullptr, 0);
+    dynamicConstants_.BindVS(1, viewMatrixConstants_);
+
+    if (mode == AlphaMode::ALPHA_CUTOFF_MODE) {
+        device_->GetDeviceContext()->PSSetShader(shaders.shadowPS, nullptr, 0);
+        device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &material.shadowParamsBuffer);
+    }
+    else {
+        device_->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
+    }
+
+    if (!!primitive.indexBuffer) {
+        device_->GetDeviceContext()->IASetIndexBuffer(primitive.indexBuffer, primitive.indexFormat, primitive.indexOffset);
+    }
+    DrawInstances(primitive, batch);
+    return true;
+}
+
+bool SceneManager::PrepareTransparent() {
+    CPU_PROFILE_SCOPE("SceneManager::PrepareTransparent");
+    FrameArena& frameArena = frameArenas_.GetLocal();
+    if (excludeTransparent) {
+        return true;
+    }
+
+    transparentPrimitives_.clear();
+
+    if (transparentSortMode != TransparentSortMode::GPU_READBACK) {
+        for (UINT i = 0; i < drawItems_.size(); ++i) {
+            if (drawItems_[i].mode != AlphaMode::BLEND_MODE || !cameraVisibility_[i]) {
+                continue;
+            }
+            TransparentPrimitive transparentPrimitive;
+            transparentPrimitive.drawItemId = i;
+            transparentPrimitive.depth = GetTransparentSortDepth(i, transparentSortMode);
+            transparentPrimitives_.push_back(transparentPrimitive);
+        }
+        renderStatistics_.transparentPrimitives = (UINT)transparentPrimitives_.size();
+        return true;
+    }
+
+    if (!!annotation_) {
+        annotation_->BeginEvent(L"Prepare_transparent");
+    }
+
+    ViewMatrixBuffer viewMatrix;
+    viewMatrix.viewProjectionMatrix = camera_->GetViewProjectionMatrix();
+    UploadConstants(viewMatrixConstants_, viewMatrixBuffer_, viewMatrix);
+
+    // the depth of every item is read back separately, so instances are not merged here
+    FrameVector<UINT> items(frameArena);
+    for (UINT i = 0; i < drawItems_.size(); ++i) {
+        if (drawItems_[i].mode == AlphaMode::BLEND_MODE && cameraVisibility_[i]) {
+            items.push_back(i);
+        }
+    }
+    bool succeeded = BuildInstanceBatches(items, false, viewMatrix.viewProjectionMatrix);
+    for (UINT i = 0; succeeded && i < instanceBatches_.size(); ++i) {
+        succeeded = AddPrimitiveToTransparentPrimitives(instanceBatches_[i]);
+    }
+    if (!succeeded) {
+        if (!!annotation_) {
+            annotation_->EndEvent();
+        }
+        return false;
+    }
+    renderStatistics_.transparentPrimitives = (UINT)transparentPrimitives_.size();
+
+    // the read back depth is the closest visible point, so it is compared with the same CPU mode
+    FrameVector<float> depths(frameArena);
+    for (auto& tp : transparentPrimitives_) {
+        depths.push_back(GetTransparentSortDepth(tp.drawItemId, TransparentSortMode::CLOSEST_POINT));
+    }
+    for (UINT i = 0; i < transparentPrimitives_.size(); ++i) {
+        for (UINT j = i + 1; j < transparentPrimitives_.size(); ++j) {
+            float gpuOrder = transparentPrimitives_[i].depth - transparentPrimitives_[j].depth;
+            float cpuOrder = depths[i] - depths[j];
+            if (gpuOrder * cpuOrder < 0.0f) {
+                ++renderStatistics_.transparentOrderMismatches;
+            }
+        }
+    }
+
+    if (!!annotation_) {
+        annotation_->EndEvent();
+    }
+    return true;
+}
+
+float SceneManager::GetTransparentSortDepth(UINT drawItemId, TransparentSortMode mode) const {
+    AABB bounds = drawItemBounds_.Get(drawItemId);
+    XMVECTOR boxMin = XMLoadFloat3(&bounds.min);
+    XMVECTOR boxMax = XMLoadFloat3(&bounds.max);
+    XMVECTOR cameraPos = XMLoadFloat3(&camera_->GetPosition());
+
+    XMVECTOR point;
+    switch (mode) {
+    case TransparentSortMode::FARTHEST_POINT:
+        point = XMVectorSelect(boxMin, boxMax, XMVectorLess(XMVectorAbs(cameraPos - boxMin), XMVectorAbs(cameraPos - boxMax)));
+        break;
+    case TransparentSortMode::CENTROID:
+        point = (boxMin + boxMax) * 0.5f;
+        break;
+    default:
+        point = XMVectorClamp(cameraPos, boxMin, boxMax);
+        break;
+    }
+
+    // far primitives are drawn first, as with the reversed depth read back from the GPU
+    float distance = XMVectorGetX(XMVector3Length(point - cameraPos));
+    return 1.0f - (std::min)(distance / camera_->GetFarPlane(), 1.0f);
+}
+
+bool SceneManager::AddPrimitiveToTransparentPrimitives(const InstanceBatch& batch) {
+    const DrawItem& item = drawItems_[batch.drawItemId];
+    const Primitive& primitive = primitives_[item.primitive];
+    const ShaderSet& shaders = shaderSets_[primitive.shaders];
+
+    TransparentPrimitive transparentPrimitive;
+    transparentPrimitive.drawItemId = batch.drawItemId;
+
+    device_->GetDeviceContext()->ClearDepthStencilView(transparentDepth_.DSV, D3D11_CLEAR_DEPTH, 0.0f, 0);
+    device_->GetDeviceContext()->OMSetRenderTargets(0, nullptr, transparentDepth_.DSV);
+    device_->GetDeviceContext()->OMSetDepthStencilState(transparentDepthStencilState_.get(), 0);
+    viewport_.Width = width_;
+    viewport_.Height = height_;
+    device_->GetDeviceContext()->RSSetViewports(1, &viewport_);
+    device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+
+    device_->GetDeviceContext()->IASetInputLayout(shaders.shadowInputLayout);
+    device_->GetDeviceContext()->IASetVertexBuffers(0, primitive.vertexBufferCount, primitive.vertexBuffers, primitive.strides, primitive.offsets);
+    device_->GetDeviceContext()->RSSetState(materials_[primitive.material].rasterizerState);
+    device_->GetDeviceContext()->IASetPrimitiveTopology(primitive.mode);
+    device_->GetDeviceContext()->VSSetShader(shaders.shadowVS, nullptr, 0);
+    dynamicConstants_.BindVS(1, viewMatrixConstants_);
+    device_->GetDeviceContext()->PSSetShader(nullptr, nullptr, 0);
+    if (!!primitive.indexBuffer) {
+        device_->GetDeviceContext()->IASetIndexBuffer(primitive.indexBuffer, primitive.indexFormat, primitive.indexOffset);
+    }
+    bindCache_ = {}; // the downsampling of the previous item used other constants
+    DrawInstances(primitive, batch);
+
+    static float color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
     for (int i = n_; i >= 0; --i) {
         ID3D11RenderTargetView* views[] = { scaledFrames_[i].RTV };
         device_->GetDeviceContext()->OMSetRenderTargets(1, views, nullptr);
@@ -1563,7 +2326,7 @@ bool SceneManager::AddPrimitiveToTransparentPrimitives(int arrayId, const Primit
 
     if (ResourceDesc.pData) {
         float* pData = reinterpret_cast<float*>(ResourceDesc.pData);
-        transparentPrimitive.distance = pData[0];
+        transparentPrimitive.depth = pData[0];
     }
     device_->GetDeviceContext()->Unmap(readMaxTexture_, 0);
 
@@ -1572,6 +2335,114 @@ bool SceneManager::AddPrimitiveToTransparentPrimitives(int arrayId, const Primit
     return true;
 }
 
+void SceneManager::DeclarePasses(FrameGraph& graph, UINT renderTarget) {
+    FrameGraph::TextureDesc depthDesc;
+    depthDesc.width = width_;
+    depthDesc.height = height_;
+    depthDesc.format = DXGI_FORMAT_R32_TYPELESS;
+    depthDesc.bytesPerTexel = 4;
+    depthDesc.depthStencil = true;
+    FrameGraph::TextureDesc targetDesc;
+    targetDesc.width = width_;
+    targetDesc.height = height_;
+    targetDesc.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    targetDesc.bytesPerTexel = 4;
+
+    // the ids of the optional textures are reset, the vector keeps its capacity
+    transientIds_.transparentDepth = FrameGraph::invalidIndex;
+    transientIds_.scaledFrames.clear();
+    transientIds_.emissive = FrameGraph::invalidIndex;
+    UINT depth = graph.ImportTexture("Scene depth");
+
+    // the depths are read back to the CPU, nothing in the graph reads them
+    if (!excludeTransparent && transparentSortMode == TransparentSortMode::GPU_READBACK) {
+        UINT pass = graph.AddPass("Transparent sort readback", true);
+        transientIds_.transparentDepth = graph.CreateTexture(pass, "Transparent depth", depthDesc);
+        for (int i = 0; i < n_ + 1; ++i) {
+            FrameGraph::TextureDesc desc;
+            desc.width = 1 << i;
+            desc.height = 1 << i;
+            desc.format = DXGI_FORMAT_R32_FLOAT;
+            desc.bytesPerTexel = 4;
+            transientIds_.scaledFrames.push_back(graph.CreateTexture(pass, "Transparent depth max", desc));
+        }
+    }
+
+    UINT pass = graph.AddPass("G-buffer");
+    transientIds_.color = graph.CreateTexture(pass, "G-buffer color", targetDesc);
+    transientIds_.features = graph.CreateTexture(pass, "G-buffer features", targetDesc);
+    transientIds_.normals = graph.CreateTexture(pass, "G-buffer normals", targetDesc);
+    if (deferredRender) {
+        transientIds_.emissive = graph.CreateTexture(pass, "G-buffer emissive", targetDesc);
+    }
+    graph.Write(pass, depth);
+    graph.Write(pass, renderTarget);
+
+    transientIds_.depthCopyPass = graph.AddPass("Depth copy");
+    graph.Read(transientIds_.depthCopyPass, depth);
+    transientIds_.depthCopy = graph.CreateTexture(transientIds_.depthCopyPass, "Depth copy", depthDesc);
+
+    bool ambient = currentMode_ == Mode::DEFAULT || currentMode_ == Mode::SSAO_MASK;
+    bool directional = deferredRender && (currentMode_ == Mode::DEFAULT || currentMode_ == Mode::SHADOW_SPLITS);
+    bool point = deferredRender && currentMode_ != Mode::SHADOW_SPLITS && currentMode_ != Mode::SSAO_MASK;
+    pass = graph.AddPass("Lighting");
+    if (ambient || directional || point) {
+        graph.Read(pass, transientIds_.color);
+        graph.Read(pass, transientIds_.features);
+        graph.Read(pass, transientIds_.normals);
+        graph.Read(pass, transientIds_.depthCopy);
+    }
+    if (directional) {
+        graph.Read(pass, transientIds_.emissive);
+    }
+    graph.Read(pass, depth);
+    graph.Write(pass, renderTarget);
+
+    if (!excludeTransparent) {
+        pass = graph.AddPass("Transparent");
+        if ((withSSAO && currentMode_ == Mode::DEFAULT) || currentMode_ == Mode::SSAO_MASK) {
+            graph.Read(pass, transientIds_.depthCopy);
+        }
+        graph.Read(pass, depth);
+        graph.Write(pass, renderTarget);
+    }
+}
+
+void SceneManager::BindTransientTextures(const FrameGraph& graph, const TransientTexturePool& pool) {
+    auto getTexture = [&](UINT id) {
+        RawPtrTexture texture;
+        if (id != FrameGraph::invalidIndex) {
+            const TransientTexturePool::Views& views = pool.GetViews(graph, id);
+            texture.texture = views.texture;
+            texture.RTV = views.RTV;
+            texture.SRV = views.SRV;
+        }
+        return texture;
+    };
+    auto getDepthBuffer = [&](UINT id) {
+        RawPtrDepthBuffer buffer;
+        if (id != FrameGraph::invalidIndex) {
+            const TransientTexturePool::Views& views = pool.GetViews(graph, id);
+            buffer.texture = views.texture;
+            buffer.DSV = views.DSV;
+            buffer.SRV = views.SRV;
+        }
+        return buffer;
+    };
+
+    transparentDepth_ = getDepthBuffer(transientIds_.transparentDepth);
+    scaledFrames_.resize(transientIds_.scaledFrames.size());
+    for (size_t i = 0; i < scaledFrames_.size(); ++i) {
+        scaledFrames_[i] = getTexture(transientIds_.scaledFrames[i]);
+    }
+    color_ = getTexture(transientIds_.color);
+    features_ = getTexture(transientIds_.features);
+    normals_ = getTexture(transientIds_.normals);
+    emissive_ = getTexture(transientIds_.emissive);
+    depthCopy_ = getDepthBuffer(transientIds_.depthCopy);
+    copyDepth_ = transientIds_.depthCopyPass != FrameGraph::invalidIndex && graph.IsPassLive(transientIds_.depthCopyPass);
+}
+
 bool SceneManager::Render(
     const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
     const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
@@ -1580,16 +2451,26 @@ bool SceneManager::Render(
     const std::vector<PointLight>& lights,
     const std::vector<int>& sceneIndices
 ) {
-    if (!IsInit() || !renderTarget_) {
+    CPU_PROFILE_SCOPE("SceneManager::Render");
+    if (!IsInit() || !renderTarget_ || !color_.RTV) {
         return false;
     }
 
+    renderStatistics_ = {};
+    frameArenas_.Reset();
+    dynamicConstants_.BeginFrame();
+    instanceBufferUsed_ = instanceBufferCapacity_; // the first upload of the frame discards the previous contents
+    UpdateTransformations(sceneIndices);
+    CollectDrawItems(sceneIndices);
+    CullDrawItems();
+
     if (!!annotation_) {
         annotation_->BeginEvent(L"Preliminary_preparations");
     }
 
     if (currentMode_ == Mode::DEFAULT || currentMode_ == Mode::SHADOW_SPLITS) {
-        if (!CreateShadowMaps(sceneIndices)) {
+        FitShadowCascades();
+        if (!CreateShadowMaps()) {
             if (!!annotation_) {
                 annotation_->EndEvent();
             }
@@ -1597,7 +2478,7 @@ bool SceneManager::Render(
         }
     }
 
-    if (!PrepareTransparent(sceneIndices)) {
+    if (!PrepareTransparent()) {
         if (!!annotation_) {
             annotation_->EndEvent();
         }
@@ -1631,7 +2512,7 @@ bool SceneManager::Render(
 
     ViewMatrixBuffer viewBuffer;
     viewBuffer.viewProjectionMatrix = camera_->GetViewProjectionMatrix();
-    device_->GetDeviceContext()->UpdateSubresource(viewMatrixBuffer_, 0, nullptr, &viewBuffer, 0, 0);
+    UploadConstants(viewMatrixConstants_, viewMatrixBuffer_, viewBuffer);
 
     XMFLOAT3 cameraPos = camera_->GetPosition();
     MatricesBuffer matricesBuffer;
@@ -1640,18 +2521,20 @@ bool SceneManager::Render(
     matricesBuffer.viewMatrix = camera_->GetViewMatrix();
     matricesBuffer.invProjectionMatrix = XMMatrixInverse(nullptr, matricesBuffer.projectionMatrix);
     matricesBuffer.invViewMatrix = XMMatrixInverse(nullptr, matricesBuffer.viewMatrix);
-    device_->GetDeviceContext()->UpdateSubresource(matricesBuffer_, 0, nullptr, &matricesBuffer, 0, 0);
+    UploadConstants(matricesConstants_, matricesBuffer_, matricesBuffer);
 
+    renderStatistics_.pointLights = (UINT)lights.size();
     if ((!excludeTransparent && !transparentPrimitives_.empty()) || !deferredRender) {
         ForwardRenderViewMatrixBuffer sceneBuffer;
         sceneBuffer.viewProjectionMatrix = camera_->GetViewProjectionMatrix();
-        sceneBuffer.lightParams = XMINT4(int(lights.size()), 0, 0, 0);
         sceneBuffer.directionalLight = directionalLight_->GetInfo();
-        for (int i = 0; i < lights.size() && i < MAX_LIGHT; ++i) {
-            sceneBuffer.lights[i].pos = lights[i].pos;
-            sceneBuffer.lights[i].color = lights[i].color;
+        if (!BuildLightClusters(lights, sceneBuffer)) {
+            if (!!annotation_) {
+                annotation_->EndEvent();
+            }
+            return false;
         }
-        device_->GetDeviceContext()->UpdateSubresource(forwardRenderViewMatrixBuffer_, 0, nullptr, &sceneBuffer, 0, 0);
+        UploadConstants(forwardRenderViewMatrixConstants_, forwardRenderViewMatrixBuffer_, sceneBuffer);
     }
 
     if ((withSSAO && currentMode_ == Mode::DEFAULT) || currentMode_ == Mode::SSAO_MASK) {
@@ -1664,19 +2547,29 @@ bool SceneManager::Render(
         for (int i = 0; i < NOISE_BUFFER_SIZE; ++i) {
             buffer.noise[i] = SSAONoise_[i];
         }
-        device_->GetDeviceContext()->UpdateSubresource(SSAOParamsBuffer_, 0, nullptr, &buffer, 0, 0);
+        UploadConstants(SSAOParamsConstants_, SSAOParamsBuffer_, buffer);
     }
 
-    for (auto j : sceneIndices) {
-        if (j < 0 || j >= scenes_.size()) {
-            continue;
+    FrameVector<UINT> items(frameArenas_.GetLocal());
+    for (UINT i = 0; i < drawItems_.size(); ++i) {
+        if (cameraVisibility_[i] && drawItems_[i].mode != AlphaMode::BLEND_MODE) {
+            items.push_back(i);
         }
-        for (auto node : scenes_[j].rootNodes) {
-            RenderNode(scenes_[j].arraysId, node, irradianceMap, prefilteredMap, BRDF, scenes_[j].transformation);
+    }
+    if (!BuildInstanceBatches(items, instancing, camera_->GetViewProjectionMatrix())) {
+        if (!!annotation_) {
+            annotation_->EndEvent();
         }
+        return false;
+    }
+    for (UINT i = 0; i < instanceBatches_.size(); ++i) {
+        AddPrimitiveToRenderQueue(i, drawItems_[instanceBatches_[i].drawItemId].mode == AlphaMode::OPAQUE_MODE ? 0 : 1);
     }
+    SubmitRenderQueue(irradianceMap, prefilteredMap, BRDF);
 
-    device_->GetDeviceContext()->CopyResource(depthCopy_.texture, depth_.texture);
+    if (copyDepth_) {
+        device_->GetDeviceContext()->CopyResource(depthCopy_.texture, depth_.texture);
+    }
     ID3D11RenderTargetView* rtv[] = { renderTarget_.get() };
     device_->GetDeviceContext()->OMSetRenderTargets(1, rtv, depth_.DSV);
 
@@ -1703,6 +2596,13 @@ bool SceneManager::Render(
     if (!excludeTransparent) {
         RenderTransparent(irradianceMap, prefilteredMap, BRDF);
     }
+    renderStatistics_.frameArenaBytes = frameArenas_.GetStatistics().usedBytes;
+    DynamicConstantBuffer::Statistics constantStatistics = dynamicConstants_.GetStatistics();
+    renderStatistics_.dynamicConstantsSupported = dynamicConstants_.IsSupported();
+    renderStatistics_.dynamicConstantsPaddingBytes = constantStatistics.paddingBytes;
+    renderStatistics_.dynamicConstantsUsedBytes = constantStatistics.usedBytes;
+    renderStatistics_.dynamicConstantsCapacity = constantStatistics.capacity;
+    renderStatistics_.dynamicConstantsFallbacks = constantStatistics.fallbacks;
 
     if (!!annotation_) {
         annotation_->EndEvent();
@@ -1711,61 +2611,187 @@ bool SceneManager::Render(
     return true;
 }
 
-void SceneManager::RenderNode(
-    int arrayId,
-    int nodeId,
-    const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
-    const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
-    const std::shared_ptr<ID3D11ShaderResourceView>& BRDF,
-    const XMMATRIX& transformation
-) {
-    const Node& node = sceneArrays_[arrayId].nodes[nodeId];
-    XMMATRIX currentTransformation = XMMatrixMultiply(node.transformation, transformation);
+bool SceneManager::BuildInstanceBatches(FrameVector<UINT>& drawItemIds, bool merge, const XMMATRIX& viewProjection, bool withNearPlane) {
+    CPU_PROFILE_SCOPE("SceneManager::BuildInstanceBatches");
+    instanceBatches_.clear();
+    if (drawItemIds.empty()) {
+        return true;
+    }
 
-    if (node.meshId >= 0) {
-        const Mesh& mesh = sceneArrays_[arrayId].meshes[node.meshId];
-        for (auto& p : mesh.opaquePrimitives) {
-            RenderPrimitive(arrayId, p, irradianceMap, prefilteredMap, BRDF, currentTransformation);
+    if (merge) {
+        // items of one primitive become neighbours, the order of items stays deterministic
+        std::sort(drawItemIds.begin(), drawItemIds.end(), [this](UINT a, UINT b) {
+            UINT primitiveA = drawItems_[a].primitive.GetIndex();
+            UINT primitiveB = drawItems_[b].primitive.GetIndex();
+            return primitiveA < primitiveB || (primitiveA == primitiveB && a < b);
+        });
+    }
+
+    XMFLOAT3 cameraPos = camera_->GetPosition();
+    XMVECTOR cameraPosition = XMVectorSet(cameraPos.x, cameraPos.y, cameraPos.z, 1.0f);
+    FrameVector<XMMATRIX> transformations(frameArenas_.GetLocal());
+    transformations.reserve(drawItemIds.size());
+    for (auto id : drawItemIds) {
+        const DrawItem& item = drawItems_[id];
+        float distance = XMVectorGetX(XMVector3Length(item.transformation.r[3] - cameraPosition));
+        // the instances of a node are culled in its space and drawn alone, relative to the node's transformation
+        if (!!item.instancedNode) {
+            const Node& node = *item.instancedNode;
+            Frustum frustum = Frustum::FromMatrix(XMMatrixMultiply(item.transformation, viewProjection), withNearPlane);
+            UINT visibleCount = node.instanceBounds.Cull(frustum, instanceVisibility_);
+            renderStatistics_.drawnMeshInstances += visibleCount;
+            if (visibleCount == 0) {
+                continue;
+            }
+            InstanceBatch batch;
+            batch.drawItemId = id;
+            batch.firstInstance = (UINT)transformations.size();
+            batch.instanceCount = visibleCount;
+            batch.distance = distance;
+            instanceBatches_.push_back(batch);
+            for (UINT i = 0; i < node.instances.size(); ++i) {
+                if (instanceVisibility_[i]) {
+                    transformations.push_back(node.instances[i]);
+                }
+            }
+            continue;
         }
-        for (auto& p : mesh.primitivesWithAlphaCutoff) {
-            RenderPrimitive(arrayId, p, irradianceMap, prefilteredMap, BRDF, currentTransformation);
+        if (!merge || instanceBatches_.empty() || !!drawItems_[instanceBatches_.back().drawItemId].instancedNode
+            || drawItems_[instanceBatches_.back().drawItemId].primitive != item.primitive) {
+            InstanceBatch batch;
+            batch.drawItemId = id;
+            batch.firstInstance = (UINT)transformations.size();
+            batch.distance = distance;
+            instanceBatches_.push_back(batch);
         }
+        InstanceBatch& batch = instanceBatches_.back();
+        ++batch.instanceCount;
+        batch.distance = (std::min)(batch.distance, distance);
+        transformations.push_back(item.transformation);
     }
+    renderStatistics_.instancedDrawsSaved += (UINT)(transformations.size() - instanceBatches_.size());
 
-    for (auto c : node.children) {
-        RenderNode(arrayId, c, irradianceMap, prefilteredMap, BRDF, currentTransformation);
+    // the instance buffer and the parent transformation are bound again by the first draw of the pass
+    bindCache_ = {};
+    if (transformations.empty()) {
+        return true;
+    }
+    UINT firstInstance = 0;
+    if (!UploadInstances(transformations.data(), (UINT)transformations.size(), firstInstance)) {
+        return false;
     }
+    for (auto& b : instanceBatches_) {
+        b.firstInstance += firstInstance;
+    }
+    return true;
 }
 
-void SceneManager::RenderPrimitive(
-    int arrayId,
-    const Primitive& primitive,
+HRESULT SceneManager::CreateInstanceBuffer(UINT capacity) {
+    SAFE_RELEASE(instanceBuffer_);
+    instanceBufferCapacity_ = 0;
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = sizeof(XMMATRIX) * capacity;
+    desc.Usage = D3D11_USAGE_DYNAMIC;
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    desc.MiscFlags = 0;
+    desc.StructureByteStride = 0;
+    HRESULT result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &instanceBuffer_);
+    if (SUCCEEDED(result)) {
+        instanceBufferCapacity_ = capacity;
+    }
+    return result;
+}
+
+bool SceneManager::UploadInstances(const XMMATRIX* transformations, UINT count, UINT& firstInstance) {
+    // instances of all passes of the frame are appended, the buffer is renamed only when it is full
+    D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+    if (instanceBufferUsed_ + count > instanceBufferCapacity_) {
+        if (count > instanceBufferCapacity_ && FAILED(CreateInstanceBuffer((std::max)(count, instanceBufferCapacity_ * 2)))) {
+            return false;
+        }
+        mapType = D3D11_MAP_WRITE_DISCARD;
+        instanceBufferUsed_ = 0;
+    }
+
+    D3D11_MAPPED_SUBRESOURCE subresource;
+    HRESULT result = device_->GetDeviceContext()->Map(instanceBuffer_, 0, mapType, 0, &subresource);
+    if (FAILED(result)) {
+        return false;
+    }
+    memcpy((XMMATRIX*)subresource.pData + instanceBufferUsed_, transformations, sizeof(XMMATRIX) * count);
+    device_->GetDeviceContext()->Unmap(instanceBuffer_, 0);
+
+    firstInstance = instanceBufferUsed_;
+    instanceBufferUsed_ += count;
+    return true;
+}
+
+void SceneManager::DrawInstances(const Primitive& primitive, const InstanceBatch& batch) {
+    const DrawItem& item = drawItems_[batch.drawItemId];
+    if (UpdateBinding(bindCache_.instanceBuffer, instanceBuffer_)) {
+        UINT stride = sizeof(XMMATRIX);
+        UINT offset = 0;
+        device_->GetDeviceContext()->IASetVertexBuffers(instanceSlot, 1, &instanceBuffer_, &stride, &offset);
+    }
+    // instances of EXT_mesh_gpu_instancing are relative to their node, the others carry their world matrices
+    if (UpdateBinding(bindCache_.instanceParent, !!item.instancedNode ? batch.drawItemId : identityInstanceParent)) {
+        if (!!item.instancedNode) {
+            InstanceParentBuffer parent;
+            parent.worldMatrix = item.transformation;
+            UploadConstants(instanceParentConstants_, instanceParentBuffer_, parent);
+            dynamicConstants_.BindVS(0, instanceParentConstants_);
+        }
+        else {
+            device_->GetDeviceContext()->VSSetConstantBuffers(0, 1, &instanceParentIdentityBuffer_);
+        }
+    }
+
+    if (!!primitive.indexBuffer) {
+        device_->GetDeviceContext()->DrawIndexedInstanced(primitive.count, batch.instanceCount, 0, 0, batch.firstInstance);
+    }
+    else {
+        device_->GetDeviceContext()->DrawInstanced(primitive.count, batch.instanceCount, 0, batch.firstInstance);
+    }
+}
+
+void SceneManager::AddPrimitiveToRenderQueue(UINT batchId, UINT pass) {
+    const InstanceBatch& batch = instanceBatches_[batchId];
+    const Primitive& primitive = primitives_[drawItems_[batch.drawItemId].primitive];
+    const Material& material = materials_[primitive.material];
+
+    renderQueue_.Push(RenderQueue::MakeKey(pass, primitive.shaders.GetIndex(), primitive.material.GetIndex(), material.cullMode,
+        batch.distance / camera_->GetFarPlane()), batchId);
+}
+
+void SceneManager::SubmitRenderQueue(
     const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
     const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
     const std::shared_ptr<ID3D11ShaderResourceView>& BRDF,
-    const XMMATRIX& transformation,
     bool transparent
 ) {
-    const Material& material = sceneArrays_[arrayId].materials[primitive.materialId];
-
-    WorldMatrixBuffer worldMatrix;
-    worldMatrix.worldMatrix = transformation;
-    device_->GetDeviceContext()->UpdateSubresource(worldMatrixBuffer_, 0, nullptr, &worldMatrix, 0, 0);
-
-    MaterialParamsBuffer materialBuffer;
-    materialBuffer.baseColorFactor = material.baseColorFactor;
-    materialBuffer.baseColorTA = XMINT4(material.baseColorTA.textureId, material.baseColorTA.texCoordId, material.baseColorTA.samplerId, material.baseColorTA.isSRGB);
-    materialBuffer.emissiveFactorAlphaCutoff = XMFLOAT4(material.emissiveFactor.x, material.emissiveFactor.y, material.emissiveFactor.z, material.alphaCutoff);
-    materialBuffer.emissiveTA = XMINT4(material.emissiveTA.textureId, material.emissiveTA.texCoordId, material.emissiveTA.samplerId, material.emissiveTA.isSRGB);
-    materialBuffer.MRONFactors = XMFLOAT4(material.metallicFactor, material.roughnessFactor, material.occlusionStrength, material.normalScale);
-    materialBuffer.normalTA = XMINT4(material.normalTA.textureId, material.normalTA.texCoordId, material.normalTA.samplerId, material.normalTA.isSRGB);
-    materialBuffer.roughMetallicTA = XMINT4(material.roughMetallicTA.textureId, material.roughMetallicTA.texCoordId, material.roughMetallicTA.samplerId,
-        material.roughMetallicTA.isSRGB);
-    materialBuffer.occlusionTA = XMINT4(material.occlusionTA.textureId, material.occlusionTA.texCoordId, material.occlusionTA.samplerId, material.occlusionTA.isSRGB);
-    device_->GetDeviceContext()->UpdateSubresource(materialParamsBuffer_, 0, nullptr, &materialBuffer, 0, 0);
+    CPU_PROFILE_SCOPE("SceneManager::SubmitRenderQueue");
+    renderQueue_.Sort();
+
+    bindCache_ = {};
+    BindPassResources(irradianceMap, prefilteredMap, BRDF, transparent);
+    for (auto& p : renderQueue_.GetPackets()) {
+        RenderPrimitive(instanceBatches_[p.index], transparent);
+    }
+
+    renderQueue_.Clear();
+}
 
+void SceneManager::BindPassResources(
+    const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
+    const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
+    const std::shared_ptr<ID3D11ShaderResourceView>& BRDF,
+    bool transparent
+) {
+    FrameArena& frameArena = frameArenas_.GetLocal();
     if ((transparent || !deferredRender) && (currentMode_ == Mode::DEFAULT || currentMode_ == Mode::SHADOW_SPLITS || currentMode_ == Mode::SSAO_MASK)) {
-        std::vector<ID3D11SamplerState*> samplers = { };
+        FrameVector<ID3D11SamplerState*> samplers(frameArena);
         if (transparent) {
             samplers.push_back(samplerAvg_.get());
         }
@@ -1775,154 +2801,132 @@ void SceneManager::RenderPrimitive(
         }
         device_->GetDeviceContext()->PSSetSamplers(transparent ? 0 : 1, samplers.size(), samplers.data());
 
-        std::vector<ID3D11ShaderResourceView*> resources = { };
+        FrameVector<ID3D11ShaderResourceView*> resources(frameArena);
         if (transparent) {
             resources.push_back(irradianceMap.get());
             resources.push_back(prefilteredMap.get());
             resources.push_back(BRDF.get());
         }
-        for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
-            resources.push_back(shadowSplits_[i].SRV);
-        }
+        resources.push_back(shadowAtlasSRV_);
         if (transparent && ((withSSAO && currentMode_ == Mode::DEFAULT) || currentMode_ == Mode::SSAO_MASK)) {
             resources.push_back(depthCopy_.SRV);
         }
         device_->GetDeviceContext()->PSSetShaderResources(transparent ? 0 : 3, resources.size(), resources.data());
     }
-    int m = deferredRender && !transparent ? 0 : 3;
-    int k = deferredRender && !transparent ? 0 : CSM_SPLIT_COUNT + 4;
-    if (material.baseColorTA.textureId >= 0) {
-        std::vector<ID3D11SamplerState*> samplers = { sceneArrays_[arrayId].samplers[material.baseColorTA.samplerId].get() };
-        device_->GetDeviceContext()->PSSetSamplers(m++, samplers.size(), samplers.data());
 
-        std::vector<ID3D11ShaderResourceView*> resources = { 
-            sceneArrays_[arrayId].textures[material.baseColorTA.textureId]->GetSRV(material.baseColorTA.isSRGB).get()
-        };
-        device_->GetDeviceContext()->PSSetShaderResources(k++, resources.size(), resources.data());
+    dynamicConstants_.BindVS(1, viewMatrixConstants_);
+    if (!deferredRender || transparent) {
+        dynamicConstants_.BindPS(1, forwardRenderViewMatrixConstants_);
+        dynamicConstants_.BindPS(2, matricesConstants_);
+        ID3D11ShaderResourceView* lightResources[] = { pointLightBuffer_.GetSRV(), lightClusterBuffer_.GetSRV(), lightIndexBuffer_.GetSRV() };
+        device_->GetDeviceContext()->PSSetShaderResources(clusteredLightsSlot, _countof(lightResources), lightResources);
+        if (transparent && ((withSSAO && currentMode_ == Mode::DEFAULT) || currentMode_ == Mode::SSAO_MASK)) {
+            dynamicConstants_.BindPS(3, SSAOParamsConstants_);
+        }
     }
-    else {
-        device_->GetDeviceContext()->PSSetShaderResources(k++, 0, nullptr);
+}
+
+void SceneManager::BindMaterial(const Material& material, bool transparent) {
+    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &material.paramsBuffer);
+
+    int m = deferredRender && !transparent ? 0 : 3;
+    int k = deferredRender && !transparent ? 0 : 5; // after the IBL maps, the shadow atlas and the depth
+    const TextureAccessor* accessors[] = {
+        &material.baseColorTA, &material.roughMetallicTA, &material.normalTA, &material.occlusionTA, &material.emissiveTA
+    };
+    for (auto ta : accessors) {
+        if (ta->textureId >= 0) {
+            device_->GetDeviceContext()->PSSetSamplers(m++, 1, &ta->sampler);
+
+            const TextureViews& views = textures_[ta->texture];
+            ID3D11ShaderResourceView* resources[] = { ta->isSRGB ? views.SRVSRGB : views.SRV };
+            device_->GetDeviceContext()->PSSetShaderResources(k++, 1, resources);
+        }
+        else {
+            device_->GetDeviceContext()->PSSetShaderResources(k++, 0, nullptr);
+        }
     }
-    if (material.roughMetallicTA.textureId >= 0) {
-        std::vector<ID3D11SamplerState*> samplers = { sceneArrays_[arrayId].samplers[material.roughMetallicTA.samplerId].get() };
-        device_->GetDeviceContext()->PSSetSamplers(m++, samplers.size(), samplers.data());
+}
+
+void SceneManager::RenderPrimitive(const InstanceBatch& batch, bool transparent) {
+    const DrawItem& item = drawItems_[batch.drawItemId];
+    const Primitive& primitive = primitives_[item.primitive];
+    const Material& material = materials_[primitive.material];
+    const ShaderSet& shaders = shaderSets_[primitive.shaders];
 
-        std::vector<ID3D11ShaderResourceView*> resources = {
-            sceneArrays_[arrayId].textures[material.roughMetallicTA.textureId]->GetSRV(material.roughMetallicTA.isSRGB).get()
-        };
-        device_->GetDeviceContext()->PSSetShaderResources(k++, resources.size(), resources.data());
+    if (UpdateBinding(bindCache_.material, primitive.material)) {
+        BindMaterial(material, transparent);
     }
-    else {
-        device_->GetDeviceContext()->PSSetShaderResources(k++, 0, nullptr);
+    if (UpdateBinding(bindCache_.depthStencilState, material.depthStencilState)) {
+        device_->GetDeviceContext()->OMSetDepthStencilState(bindCache_.depthStencilState, 0);
     }
-    if (material.normalTA.textureId >= 0) {
-        std::vector<ID3D11SamplerState*> samplers = { sceneArrays_[arrayId].samplers[material.normalTA.samplerId].get() };
-        device_->GetDeviceContext()->PSSetSamplers(m++, samplers.size(), samplers.data());
-
-        std::vector<ID3D11ShaderResourceView*> resources = {
-            sceneArrays_[arrayId].textures[material.normalTA.textureId]->GetSRV(material.normalTA.isSRGB).get()
-        };
-        device_->GetDeviceContext()->PSSetShaderResources(k++, resources.size(), resources.data());
+    if (UpdateBinding(bindCache_.rasterizerState, material.rasterizerState)) {
+        device_->GetDeviceContext()->RSSetState(bindCache_.rasterizerState);
     }
-    else {
-        device_->GetDeviceContext()->PSSetShaderResources(k++, 0, nullptr);
+    if (UpdateBinding(bindCache_.blendState, material.blendState)) {
+        device_->GetDeviceContext()->OMSetBlendState(bindCache_.blendState, nullptr, 0xFFFFFFFF);
     }
-    if (material.occlusionTA.textureId >= 0) {
-        std::vector<ID3D11SamplerState*> samplers = { sceneArrays_[arrayId].samplers[material.occlusionTA.samplerId].get() };
-        device_->GetDeviceContext()->PSSetSamplers(m++, samplers.size(), samplers.data());
 
-        std::vector<ID3D11ShaderResourceView*> resources = {
-            sceneArrays_[arrayId].textures[material.occlusionTA.textureId]->GetSRV(material.occlusionTA.isSRGB).get()
-        };
-        device_->GetDeviceContext()->PSSetShaderResources(k++, resources.size(), resources.data());
+    if (UpdateBinding(bindCache_.inputLayout, shaders.inputLayout)) {
+        device_->GetDeviceContext()->IASetInputLayout(bindCache_.inputLayout);
     }
-    else {
-        device_->GetDeviceContext()->PSSetShaderResources(k++, 0, nullptr);
+    if (UpdateBinding(bindCache_.vertexBuffers, item.primitive)) {
+        device_->GetDeviceContext()->IASetVertexBuffers(0, primitive.vertexBufferCount, primitive.vertexBuffers, primitive.strides, primitive.offsets);
     }
-    if (material.emissiveTA.textureId >= 0) {
-        std::vector<ID3D11SamplerState*> samplers = { sceneArrays_[arrayId].samplers[material.emissiveTA.samplerId].get() };
-        device_->GetDeviceContext()->PSSetSamplers(m++, samplers.size(), samplers.data());
-
-        std::vector<ID3D11ShaderResourceView*> resources = {
-            sceneArrays_[arrayId].textures[material.emissiveTA.textureId]->GetSRV(material.emissiveTA.isSRGB).get()
-        };
-        device_->GetDeviceContext()->PSSetShaderResources(k++, resources.size(), resources.data());
+    if (UpdateBinding(bindCache_.topology, primitive.mode)) {
+        device_->GetDeviceContext()->IASetPrimitiveTopology(bindCache_.topology);
     }
-    else {
-        device_->GetDeviceContext()->PSSetShaderResources(k++, 0, nullptr);
+    if (UpdateBinding(bindCache_.VS, shaders.VS)) {
+        device_->GetDeviceContext()->VSSetShader(bindCache_.VS, nullptr, 0);
     }
 
-    device_->GetDeviceContext()->OMSetDepthStencilState(material.depthStencilState.get(), 0);
-    device_->GetDeviceContext()->RSSetState(material.rasterizerState.get());
-
-    device_->GetDeviceContext()->IASetInputLayout(primitive.VS->GetInputLayout().get());
-    UINT numBuffers = primitive.attributes.size();
-    std::vector<ID3D11Buffer*> vertexBuffers;
-    std::vector<UINT> strides;
-    std::vector<UINT> offsets;
-    for (auto& a : primitive.attributes) {
-        const BufferAccessor& accessor = sceneArrays_[arrayId].accessors[a.verticesAccessorId];
-        vertexBuffers.push_back(accessor.buffer.get());
-        strides.push_back(accessor.byteStride);
-        offsets.push_back(accessor.byteOffset);
-    }
-    device_->GetDeviceContext()->IASetVertexBuffers(0, numBuffers, vertexBuffers.data(), strides.data(), offsets.data());
-    device_->GetDeviceContext()->IASetPrimitiveTopology(primitive.mode);
-    device_->GetDeviceContext()->VSSetShader(primitive.VS->GetShader().get(), nullptr, 0);
-    device_->GetDeviceContext()->VSSetConstantBuffers(0, 1, &worldMatrixBuffer_);
-    device_->GetDeviceContext()->VSSetConstantBuffers(1, 1, &viewMatrixBuffer_);
+    ID3D11PixelShader* PS = nullptr;
     if (deferredRender && !transparent) {
-        device_->GetDeviceContext()->PSSetShader(primitive.gBufferPS->GetShader().get(), nullptr, 0);
-        device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &materialParamsBuffer_);
+        PS = shaders.gBufferPS;
     }
     else {
         switch (currentMode_) {
         case Mode::FRESNEL:
-            device_->GetDeviceContext()->PSSetShader(primitive.PSFresnel->GetShader().get(), nullptr, 0);
+            PS = shaders.PSFresnel;
             break;
         case Mode::NDF:
-            device_->GetDeviceContext()->PSSetShader(primitive.PSNdf->GetShader().get(), nullptr, 0);
+            PS = shaders.PSNdf;
             break;
         case Mode::GEOMETRY:
-            device_->GetDeviceContext()->PSSetShader(primitive.PSGeometry->GetShader().get(), nullptr, 0);
+            PS = shaders.PSGeometry;
             break;
         case Mode::SHADOW_SPLITS:
-            device_->GetDeviceContext()->PSSetShader(primitive.PSShadowSplits->GetShader().get(), nullptr, 0);
+            PS = shaders.PSShadowSplits;
             break;
         case Mode::SSAO_MASK:
             if (transparent) {
-                device_->GetDeviceContext()->PSSetShader(primitive.transparentPSSSAOMask->GetShader().get(), nullptr, 0);
+                PS = shaders.transparentPSSSAOMask;
             }
             else {
-                device_->GetDeviceContext()->PSSetShader(primitive.PSSSAOMask->GetShader().get(), nullptr, 0);
+                PS = shaders.PSSSAOMask;
             }
             break;
         default:
             if (withSSAO && transparent) {
-                device_->GetDeviceContext()->PSSetShader(primitive.transparentPSSSAO->GetShader().get(), nullptr, 0);
+                PS = shaders.transparentPSSSAO;
             }
             else {
-                device_->GetDeviceContext()->PSSetShader(primitive.PSDefault->GetShader().get(), nullptr, 0);
+                PS = shaders.PSDefault;
             }
             break;
         }
-        device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &materialParamsBuffer_);
-        device_->GetDeviceContext()->PSSetConstantBuffers(1, 1, &forwardRenderViewMatrixBuffer_);
-        device_->GetDeviceContext()->PSSetConstantBuffers(2, 1, &matricesBuffer_);
-        if (transparent && ((withSSAO && currentMode_ == Mode::DEFAULT) || currentMode_ == Mode::SSAO_MASK)) {
-            device_->GetDeviceContext()->PSSetConstantBuffers(3, 1, &SSAOParamsBuffer_);
-        }
     }
-    device_->GetDeviceContext()->OMSetBlendState(material.blendState.get(), nullptr, 0xFFFFFFFF);
-
-    if (primitive.indicesAccessorId >= 0) {
-        const BufferAccessor& accessor = sceneArrays_[arrayId].accessors[primitive.indicesAccessorId];
-        device_->GetDeviceContext()->IASetIndexBuffer(accessor.buffer.get(), accessor.format, accessor.byteOffset);
-        device_->GetDeviceContext()->DrawIndexed(accessor.count, 0, 0);
+    if (UpdateBinding(bindCache_.PS, PS)) {
+        device_->GetDeviceContext()->PSSetShader(bindCache_.PS, nullptr, 0);
     }
-    else {
-        device_->GetDeviceContext()->Draw(sceneArrays_[arrayId].accessors[primitive.attributes[0].verticesAccessorId].count, 0);
+
+    ++renderStatistics_.draws;
+    if (!!primitive.indexBuffer) {
+        if (UpdateBinding(bindCache_.indexBuffer, std::make_pair(primitive.indexBuffer, primitive.indexOffset))) {
+            device_->GetDeviceContext()->IASetIndexBuffer(primitive.indexBuffer, primitive.indexFormat, primitive.indexOffset);
+        }
     }
+    DrawInstances(primitive, batch);
 }
 
 void SceneManager::RenderTransparent(
@@ -1930,6 +2934,7 @@ void SceneManager::RenderTransparent(
     const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
     const std::shared_ptr<ID3D11ShaderResourceView>& BRDF
 ) {
+    CPU_PROFILE_SCOPE("SceneManager::RenderTransparent");
     if (transparentPrimitives_.empty()) {
         return;
     }
@@ -1938,10 +2943,21 @@ void SceneManager::RenderTransparent(
         annotation_->BeginEvent(L"Render_transparent");
     }
 
-    std::sort(transparentPrimitives_.begin(), transparentPrimitives_.end());
-
+    // blending depends on the order of items, so every item keeps its own draw
+    FrameVector<UINT> items(frameArenas_.GetLocal());
     for (auto& tp : transparentPrimitives_) {
-        RenderPrimitive(tp.arrayId, tp.primitive, irradianceMap, prefilteredMap, BRDF, tp.transformation, true);
+        items.push_back(tp.drawItemId);
+    }
+    if (BuildInstanceBatches(items, false, camera_->GetViewProjectionMatrix())) {
+        // the batches keep the order of the items, items whose instances are all culled have none
+        UINT j = 0;
+        for (UINT i = 0; i < instanceBatches_.size(); ++i) {
+            while (transparentPrimitives_[j].drawItemId != instanceBatches_[i].drawItemId) {
+                ++j;
+            }
+            renderQueue_.Push(RenderQueue::MakeDepthKey(2, transparentPrimitives_[j].depth), i);
+        }
+        SubmitRenderQueue(irradianceMap, prefilteredMap, BRDF, true);
     }
 
     if (!!annotation_) {
@@ -1954,12 +2970,14 @@ void SceneManager::RenderAmbientLight(
     const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
     const std::shared_ptr<ID3D11ShaderResourceView>& BRDF
 ) {
+    CPU_PROFILE_SCOPE("SceneManager::RenderAmbientLight");
+    FrameArena& frameArena = frameArenas_.GetLocal();
     if (!!annotation_) {
         annotation_->BeginEvent(L"Render_ambient_light");
     }
 
-    std::vector<ID3D11SamplerState*> samplers = { generalSampler_.get() };
-    std::vector<ID3D11ShaderResourceView*> resources = { color_.SRV, features_.SRV, normals_.SRV, depthCopy_.SRV };
+    FrameVector<ID3D11SamplerState*> samplers({ generalSampler_.get() }, frameArena);
+    FrameVector<ID3D11ShaderResourceView*> resources({ color_.SRV, features_.SRV, normals_.SRV, depthCopy_.SRV }, frameArena);
     if (currentMode_ != Mode::SSAO_MASK) {
         samplers.push_back(samplerAvg_.get());
 
@@ -1975,9 +2993,9 @@ void SceneManager::RenderAmbientLight(
     device_->GetDeviceContext()->OMSetBlendState(generalBlendState_.get(), nullptr, 0xFFFFFFFF);
     device_->GetDeviceContext()->IASetInputLayout(mappingVS_->GetInputLayout().get());
     device_->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &matricesBuffer_);
+    dynamicConstants_.BindPS(0, matricesConstants_);
     if (currentMode_ == Mode::SSAO_MASK || withSSAO) {
-        device_->GetDeviceContext()->PSSetConstantBuffers(1, 1, &SSAOParamsBuffer_);
+        dynamicConstants_.BindPS(1, SSAOParamsConstants_);
     }
     device_->GetDeviceContext()->VSSetShader(mappingVS_->GetShader().get(), nullptr, 0);
     if (currentMode_ == Mode::SSAO_MASK) {
@@ -1997,6 +3015,8 @@ void SceneManager::RenderAmbientLight(
 }
 
 void SceneManager::RenderDirectionalLight() {
+    CPU_PROFILE_SCOPE("SceneManager::RenderDirectionalLight");
+    FrameArena& frameArena = frameArenas_.GetLocal();
     if (!!annotation_) {
         annotation_->BeginEvent(L"Render_directional_light");
     }
@@ -2006,14 +3026,17 @@ void SceneManager::RenderDirectionalLight() {
     lightBuffer.color = dirLightInfo.color;
     lightBuffer.direction = dirLightInfo.direction;
     lightBuffer.viewProjectionMatrix = dirLightInfo.viewProjectionMatrix;
-    lightBuffer.splitSizeRatio = dirLightInfo.splitSizeRatio;
-    device_->GetDeviceContext()->UpdateSubresource(directionalLightBuffer_, 0, nullptr, &lightBuffer, 0, 0);
-
-    std::vector<ID3D11SamplerState*> samplers = { generalSampler_.get(), samplerPCF_.get() };
-    std::vector<ID3D11ShaderResourceView*> resources = { color_.SRV, features_.SRV, normals_.SRV, emissive_.SRV, depthCopy_.SRV };
+    lightBuffer.cascadeSplits = dirLightInfo.cascadeSplits;
     for (UINT i = 0; i < CSM_SPLIT_COUNT; ++i) {
-        resources.push_back(shadowSplits_[i].SRV);
+        lightBuffer.cascadeScales[i] = dirLightInfo.cascadeScales[i];
+        lightBuffer.cascadeOffsets[i] = dirLightInfo.cascadeOffsets[i];
+        lightBuffer.cascadeAtlasRects[i] = dirLightInfo.cascadeAtlasRects[i];
     }
+    UploadConstants(directionalLightConstants_, directionalLightBuffer_, lightBuffer);
+
+    FrameVector<ID3D11SamplerState*> samplers({ generalSampler_.get(), samplerPCF_.get() }, frameArena);
+    FrameVector<ID3D11ShaderResourceView*> resources({ color_.SRV, features_.SRV, normals_.SRV, emissive_.SRV, depthCopy_.SRV }, frameArena);
+    resources.push_back(shadowAtlasSRV_);
     device_->GetDeviceContext()->PSSetSamplers(0, samplers.size(), samplers.data());
     device_->GetDeviceContext()->PSSetShaderResources(0, resources.size(), resources.data());
 
@@ -2022,8 +3045,8 @@ void SceneManager::RenderDirectionalLight() {
     device_->GetDeviceContext()->OMSetBlendState(generalBlendState_.get(), nullptr, 0xFFFFFFFF);
     device_->GetDeviceContext()->IASetInputLayout(mappingVS_->GetInputLayout().get());
     device_->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &directionalLightBuffer_);
-    device_->GetDeviceContext()->PSSetConstantBuffers(1, 1, &matricesBuffer_);
+    dynamicConstants_.BindPS(0, directionalLightConstants_);
+    dynamicConstants_.BindPS(1, matricesConstants_);
     device_->GetDeviceContext()->VSSetShader(mappingVS_->GetShader().get(), nullptr, 0);
     if (currentMode_ == Mode::SHADOW_SPLITS) {
         device_->GetDeviceContext()->PSSetShader(directionalLightPSShadowSplits_->GetShader().get(), nullptr, 0);
@@ -2038,11 +3061,104 @@ void SceneManager::RenderDirectionalLight() {
     }
 }
 
+bool SceneManager::BuildLightClusters(const std::vector<PointLight>& lights, ForwardRenderViewMatrixBuffer& sceneBuffer) {
+    CPU_PROFILE_SCOPE("SceneManager::BuildLightClusters");
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // the radius is where the radiance falls to the clamp limit, as for the deferred light volumes
+    XMMATRIX viewMatrix = camera_->GetViewMatrix();
+    FrameVector<LightClusters::Light> clusterLights(frameArenas_.GetLocal());
+    clusterLights.reserve(lights.size());
+    for (auto& l : lights) {
+        XMFLOAT3 pos;
+        XMStoreFloat3(&pos, XMVector3TransformCoord(XMVectorSet(l.pos.x, l.pos.y, l.pos.z, 1.0f), viewMatrix));
+        LightClusters::Light light;
+        light.x = pos.x;
+        light.y = pos.y;
+        light.z = pos.z;
+        light.radius = sqrt(l.color.w / clampRadianceLimit);
+        clusterLights.push_back(light);
+    }
+
+    LightClusters::Settings settings;
+    settings.projectionScaleX = XMVectorGetX(camera_->GetProjectionMatrix().r[0]);
+    settings.projectionScaleY = XMVectorGetY(camera_->GetProjectionMatrix().r[1]);
+    settings.nearPlane = camera_->GetNearPlane();
+    settings.farPlane = camera_->GetFarPlane();
+    lightClusters_.Build(settings, clusterLights.data(), (uint32_t)clusterLights.size());
+
+    const std::vector<LightClusters::Cluster>& clusters = lightClusters_.GetClusters();
+    const std::vector<uint32_t>& indices = lightClusters_.GetLightIndices();
+    if (!pointLightBuffer_.Upload(lights.data(), (UINT)lights.size())
+        || !lightClusterBuffer_.Upload(clusters.data(), (UINT)clusters.size())
+        || !lightIndexBuffer_.Upload(indices.data(), (UINT)indices.size())) {
+        return false;
+    }
+
+    sceneBuffer.lightParams = XMINT4((int)lights.size(), settings.tilesX, settings.tilesY, settings.slices);
+    sceneBuffer.clusterParams = XMFLOAT4(lightClusters_.GetSliceScale(), lightClusters_.GetSliceBias(), smoothClampRadianceLimit,
+        clampRadianceLimit);
+
+    renderStatistics_.clusteredLightIndices = (UINT)indices.size();
+    renderStatistics_.maxLightsPerCluster = lightClusters_.GetMaxLightsPerCluster();
+    renderStatistics_.lightBinningTime = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+    return true;
+}
+
 void SceneManager::RenderPointLights(const std::vector<PointLight>& lights) {
+    CPU_PROFILE_SCOPE("SceneManager::RenderPointLights");
+    renderStatistics_.shadedPointLights = 0;
+    renderStatistics_.culledPointLights = 0;
+    renderStatistics_.smallPointLights = 0;
+    renderStatistics_.insidePointLights = 0;
     if (lights.empty()) {
         return;
     }
 
+    // volumes outside the frustum or smaller than a few pixels on the screen are skipped; a volume that contains
+    // the camera or is cut by the near plane has no visible outer side, so such volumes go last with other states
+    Frustum frustum = Frustum::FromMatrix(camera_->GetViewProjectionMatrix());
+    XMFLOAT3 cameraPosition = camera_->GetPosition();
+    XMMATRIX projection = camera_->GetProjectionMatrix();
+    float pixelScale = XMVectorGetY(projection.r[1]) * height_ * 0.5f;
+    float nearPlane = camera_->GetNearPlane();
+    float nearCorner = nearPlane * sqrt(1.0f + 1.0f / (XMVectorGetX(projection.r[0]) * XMVectorGetX(projection.r[0]))
+        + 1.0f / (XMVectorGetY(projection.r[1]) * XMVectorGetY(projection.r[1])));
+    FrameVector<UINT> ids(frameArenas_.GetLocal());
+    FrameVector<UINT> insideIds(frameArenas_.GetLocal());
+    ids.reserve(lights.size());
+    for (UINT i = 0; i < lights.size(); ++i) {
+        const PointLight& l = lights[i];
+        float radius = sqrt(l.color.w / clampRadianceLimit);
+        XMFLOAT3 center(l.pos.x, l.pos.y, l.pos.z);
+        if (!frustum.IntersectsSphere(center, radius)) {
+            ++renderStatistics_.culledPointLights;
+            continue;
+        }
+        float dx = center.x - cameraPosition.x, dy = center.y - cameraPosition.y, dz = center.z - cameraPosition.z;
+        float distanceSq = dx * dx + dy * dy + dz * dz;
+        float insideRadius = radius + nearCorner;
+        if (distanceSq < insideRadius * insideRadius) {
+            insideIds.push_back(i);
+            continue;
+        }
+        // tangent of the angular radius of the sphere, the camera is outside
+        float screenRadius = radius / sqrt(distanceSq - radius * radius) * pixelScale;
+        if (screenRadius < minPointLightScreenRadius) {
+            ++renderStatistics_.smallPointLights;
+            continue;
+        }
+        ids.push_back(i);
+    }
+    UINT outsideCount = (UINT)ids.size();
+    UINT insideCount = (UINT)insideIds.size();
+    ids.insert(ids.end(), insideIds.begin(), insideIds.end());
+    renderStatistics_.shadedPointLights = (UINT)ids.size();
+    renderStatistics_.insidePointLights = insideCount;
+    if (ids.empty()) {
+        return;
+    }
+
     if (!!annotation_) {
         annotation_->BeginEvent(L"Render_point_lights");
     }
@@ -2052,8 +3168,6 @@ void SceneManager::RenderPointLights(const std::vector<PointLight>& lights) {
 
     ID3D11ShaderResourceView* resources[] = { color_.SRV, features_.SRV, normals_.SRV, depthCopy_.SRV };
     device_->GetDeviceContext()->PSSetShaderResources(0, 4, resources);
-    device_->GetDeviceContext()->OMSetDepthStencilState(pointLightDepthStencilState_.get(), 0);
-    device_->GetDeviceContext()->RSSetState(pointLightRasterizerState_.get());
     device_->GetDeviceContext()->OMSetBlendState(generalBlendState_.get(), nullptr, 0xFFFFFFFF);
 
     device_->GetDeviceContext()->IASetIndexBuffer(sphereIndexBuffer_, DXGI_FORMAT_R32_UINT, 0);
@@ -2080,34 +3194,49 @@ void SceneManager::RenderPointLights(const std::vector<PointLight>& lights) {
     default:
         break;
     }
-    device_->GetDeviceContext()->VSSetConstantBuffers(1, 1, &viewMatrixBuffer_);
-    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &matricesBuffer_);
+    dynamicConstants_.BindVS(1, viewMatrixConstants_);
+    dynamicConstants_.BindPS(0, matricesConstants_);
 
-    InstancingWorldMatrixBuffer worldMatrix;
-    LightBuffer lightBuffer;
-    int i = 0;
-    for (auto& l : lights) {
-        float radius = sqrt(l.color.w / clampRadianceLimit);
-        XMMATRIX transformation = XMMatrixIdentity();
-        transformation = XMMatrixMultiply(XMMatrixTranslation(l.pos.x, l.pos.y, l.pos.z), transformation);
-        transformation = XMMatrixMultiply(XMMatrixScaling(radius, radius, radius), transformation);
+    if (outsideCount > 0) {
+        device_->GetDeviceContext()->OMSetDepthStencilState(pointLightOutsideDepthStencilState_.get(), 0);
+        device_->GetDeviceContext()->RSSetState(pointLightOutsideRasterizerState_.get());
+        DrawPointLightVolumes(lights, ids.data(), outsideCount);
+    }
+    if (insideCount > 0) {
+        device_->GetDeviceContext()->OMSetDepthStencilState(pointLightDepthStencilState_.get(), 0);
+        device_->GetDeviceContext()->RSSetState(pointLightRasterizerState_.get());
+        DrawPointLightVolumes(lights, ids.data() + outsideCount, insideCount);
+    }
+    if (!!annotation_) {
+        annotation_->EndEvent();
+    }
+}
 
-        worldMatrix.worldMatrix[i] = transformation;
+void SceneManager::DrawPointLightVolumes(const std::vector<PointLight>& lights, const UINT* ids, UINT count) {
+    // the constant buffers hold MAX_LIGHT volumes, more lights are drawn in several instanced calls
+    for (UINT first = 0; first < count; first += MAX_LIGHT) {
+        UINT chunk = (std::min)(count - first, (UINT)MAX_LIGHT);
+        InstancingWorldMatrixBuffer worldMatrix;
+        LightBuffer lightBuffer;
+        for (UINT i = 0; i < chunk; ++i) {
+            const PointLight& l = lights[ids[first + i]];
+            float radius = sqrt(l.color.w / clampRadianceLimit);
+            XMMATRIX transformation = XMMatrixIdentity();
+            transformation = XMMatrixMultiply(XMMatrixTranslation(l.pos.x, l.pos.y, l.pos.z), transformation);
+            transformation = XMMatrixMultiply(XMMatrixScaling(radius, radius, radius), transformation);
 
-        lightBuffer.color[i] = l.color;
-        lightBuffer.pos[i] = l.pos;
-        lightBuffer.parameters[i] = XMFLOAT4(radius, smoothClampRadianceLimit, clampRadianceLimit, 0.0f);
+            worldMatrix.worldMatrix[i] = transformation;
 
-        ++i;
-    }
-    device_->GetDeviceContext()->UpdateSubresource(instancingWorldMatrixBuffer_, 0, nullptr, &worldMatrix, 0, 0);
-    device_->GetDeviceContext()->UpdateSubresource(lightBuffer_, 0, nullptr, &lightBuffer, 0, 0);
-    device_->GetDeviceContext()->VSSetConstantBuffers(0, 1, &instancingWorldMatrixBuffer_);
-    device_->GetDeviceContext()->PSSetConstantBuffers(1, 1, &lightBuffer_);
+            lightBuffer.color[i] = l.color;
+            lightBuffer.pos[i] = l.pos;
+            lightBuffer.parameters[i] = XMFLOAT4(radius, smoothClampRadianceLimit, clampRadianceLimit, 0.0f);
+        }
+        UploadConstants(instancingWorldMatrixConstants_, instancingWorldMatrixBuffer_, worldMatrix);
+        UploadConstants(lightConstants_, lightBuffer_, lightBuffer);
+        dynamicConstants_.BindVS(0, instancingWorldMatrixConstants_);
+        dynamicConstants_.BindPS(1, lightConstants_);
 
-    device_->GetDeviceContext()->DrawIndexedInstanced(sphereNumIndices_, (UINT)lights.size(), 0, 0, 0);
-    if (!!annotation_) {
-        annotation_->EndEvent();
+        device_->GetDeviceContext()->DrawIndexedInstanced(sphereNumIndices_, chunk, 0, 0, 0);
     }
 }
 
@@ -2125,69 +3254,12 @@ bool SceneManager::Resize(int width, int height) {
         ++n_;
     }
 
-    SAFE_RELEASE(depthCopy_.texture);
-    SAFE_RELEASE(depthCopy_.DSV);
-    SAFE_RELEASE(depthCopy_.SRV);
-
-    SAFE_RELEASE(transparentDepth_.texture);
-    SAFE_RELEASE(transparentDepth_.DSV);
-    SAFE_RELEASE(transparentDepth_.SRV);
-
     SAFE_RELEASE(depth_.texture);
     SAFE_RELEASE(depth_.DSV);
     SAFE_RELEASE(depth_.SRV);
 
-    SAFE_RELEASE(normals_.texture);
-    SAFE_RELEASE(normals_.SRV);
-    SAFE_RELEASE(normals_.RTV);
-
-    SAFE_RELEASE(features_.texture);
-    SAFE_RELEASE(features_.SRV);
-    SAFE_RELEASE(features_.RTV);
-
-    SAFE_RELEASE(color_.texture);
-    SAFE_RELEASE(color_.SRV);
-    SAFE_RELEASE(color_.RTV);
-
-    SAFE_RELEASE(emissive_.texture);
-    SAFE_RELEASE(emissive_.SRV);
-    SAFE_RELEASE(emissive_.RTV);
-
-    for (int i = 0; i < scaledFrames_.size(); ++i) {
-        SAFE_RELEASE(scaledFrames_[i].texture);
-        SAFE_RELEASE(scaledFrames_[i].SRV);
-        SAFE_RELEASE(scaledFrames_[i].RTV);
-    }
-    scaledFrames_.clear();
-
-    HRESULT result = CreateDepthStencilView(width, height, depth_);
-    if (SUCCEEDED(result)) {
-        result = CreateDepthStencilView(width, height, depthCopy_);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateDepthStencilView(width, height, transparentDepth_);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(normals_, width, height);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(features_, width, height);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(color_, width, height);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(emissive_, width, height);
-    }
-    for (int i = 0; i < n_ + 1 && SUCCEEDED(result); ++i) {
-        RawPtrTexture texture;
-        result = CreateTexture(texture, i);
-        if (SUCCEEDED(result)) {
-            scaledFrames_.push_back(texture);
-        }
-    }
-
-    return SUCCEEDED(result);
+    // the transient textures of the new size are declared with the passes of the next frame
+    return SUCCEEDED(CreateDepthStencilView(width, height, depth_));
 }
 
 void SceneManager::Cleanup() {
@@ -2197,6 +3269,7 @@ void SceneManager::Cleanup() {
     directionalLight_.reset();
     samplerAvg_.reset();
     shadowDepthStencilState_.reset();
+    shadowScrollDepthStencilState_.reset();
     samplerPCF_.reset();
     mappingVS_.reset();
     downsamplePS_.reset();
@@ -2210,40 +3283,32 @@ void SceneManager::Cleanup() {
     pointLightPSNDF_.reset();
     pointLightPSGeometry_.reset();
     pointLightDepthStencilState_.reset();
+    pointLightOutsideDepthStencilState_.reset();
     generalDepthStencilState_.reset();
     pointLightRasterizerState_.reset();
+    pointLightOutsideRasterizerState_.reset();
     generalRasterizerState_.reset();
+    for (auto& state : shadowRasterizerStates_) {
+        state.reset();
+    }
     generalSampler_.reset();
     generalBlendState_.reset();
     directionalLightPS_.reset();
     directionalLightPSShadowSplits_.reset();
+    shadowScrollPS_.reset();
     ambientLightPS_.reset();
     ambientLightPSSSAO_.reset();
     ambientLightPSSSAOMask_.reset();
 
-    SAFE_RELEASE(normals_.texture);
-    SAFE_RELEASE(normals_.SRV);
-    SAFE_RELEASE(normals_.RTV);
-
-    SAFE_RELEASE(features_.texture);
-    SAFE_RELEASE(features_.SRV);
-    SAFE_RELEASE(features_.RTV);
-
-    SAFE_RELEASE(color_.texture);
-    SAFE_RELEASE(color_.SRV);
-    SAFE_RELEASE(color_.RTV);
-
-    SAFE_RELEASE(emissive_.texture);
-    SAFE_RELEASE(emissive_.SRV);
-    SAFE_RELEASE(emissive_.RTV);
-
-    SAFE_RELEASE(depthCopy_.texture);
-    SAFE_RELEASE(depthCopy_.DSV);
-    SAFE_RELEASE(depthCopy_.SRV);
-
-    SAFE_RELEASE(transparentDepth_.texture);
-    SAFE_RELEASE(transparentDepth_.DSV);
-    SAFE_RELEASE(transparentDepth_.SRV);
+    normals_ = RawPtrTexture();
+    features_ = RawPtrTexture();
+    color_ = RawPtrTexture();
+    emissive_ = RawPtrTexture();
+    depthCopy_ = RawPtrDepthBuffer();
+    transparentDepth_ = RawPtrDepthBuffer();
+    scaledFrames_.clear();
+    transientIds_ = TransientIds();
+    copyDepth_ = false;
 
     SAFE_RELEASE(depth_.texture);
     SAFE_RELEASE(depth_.DSV);
@@ -2252,36 +3317,54 @@ void SceneManager::Cleanup() {
     SAFE_RELEASE(sphereVertexBuffer_);
     SAFE_RELEASE(sphereIndexBuffer_);
 
-    SAFE_RELEASE(worldMatrixBuffer_);
+    SAFE_RELEASE(instanceBuffer_);
+    instanceBufferCapacity_ = 0;
+    instanceBufferUsed_ = 0;
     SAFE_RELEASE(instancingWorldMatrixBuffer_);
+    SAFE_RELEASE(instanceParentBuffer_);
+    SAFE_RELEASE(instanceParentIdentityBuffer_);
     SAFE_RELEASE(viewMatrixBuffer_);
-    SAFE_RELEASE(shadowMapAlphaCutoffBuffer_);
     SAFE_RELEASE(lightBuffer_);
     SAFE_RELEASE(directionalLightBuffer_);
-    SAFE_RELEASE(materialParamsBuffer_);
     SAFE_RELEASE(forwardRenderViewMatrixBuffer_);
     SAFE_RELEASE(matricesBuffer_);
     SAFE_RELEASE(SSAOParamsBuffer_);
+    SAFE_RELEASE(shadowScrollBuffer_);
+    dynamicConstants_.Cleanup();
+    pointLightBuffer_.Cleanup();
+    lightClusterBuffer_.Cleanup();
+    lightIndexBuffer_.Cleanup();
 
     SAFE_RELEASE(readMaxTexture_);
 
-    for (int i = 0; i < shadowSplits_.size(); ++i) {
-        SAFE_RELEASE(shadowSplits_[i].texture);
-        SAFE_RELEASE(shadowSplits_[i].DSV);
-        SAFE_RELEASE(shadowSplits_[i].SRV);
+    for (auto buffer : { &shadowAtlasDepth_, &shadowAtlasCopy_ }) {
+        SAFE_RELEASE(buffer->texture);
+        SAFE_RELEASE(buffer->DSV);
+        SAFE_RELEASE(buffer->SRV);
     }
-    shadowSplits_.clear();
-
-    for (int i = 0; i < scaledFrames_.size(); ++i) {
-        SAFE_RELEASE(scaledFrames_[i].texture);
-        SAFE_RELEASE(scaledFrames_[i].SRV);
-        SAFE_RELEASE(scaledFrames_[i].RTV);
+    shadowAtlasDepthSize_ = 0;
+    shadowAtlasSRV_ = nullptr;
+    shadowAtlas_ = ShadowAtlas();
+    for (auto& tile : shadowTiles_) {
+        tile = ShadowAtlas::Tile();
     }
-    scaledFrames_.clear();
 
     scenes_.clear();
     sceneArrays_.clear();
     transparentPrimitives_.clear();
+    drawItems_.clear();
+    drawItemBounds_.Clear();
+    cameraVisibility_.clear();
+    shadowVisibility_.clear();
+    instanceVisibility_.clear();
+    renderQueue_.Clear();
+    bindCache_ = {};
+    primitives_.Clear();
+    materials_.Clear();
+    shaderSets_.Clear();
+    textures_.Clear();
+    shaderSetIds_.clear();
+    resourceReferences_.clear();
 
     isInit_ = false;
 }
\ No newline at end of file
@@ -4,7 +4,20 @@
 #include "Light.hpp"
 #include "Camera.hpp"
 #include "SkyBox.h"
+#include "RenderQueue.hpp"
+#include "TransformHierarchy.hpp"
+#include "Culling.hpp"
+#include "CpuProfiler.hpp"
+#include "FrameArena.hpp"
+#include "HandlePool.hpp"
+#include "DynamicConstantBuffer.hpp"
+#include "DynamicStructuredBuffer.hpp"
+#include "LightClusters.hpp"
+#include "ShadowAtlas.hpp"
+#include "TransientTexturePool.hpp"
 #include "tinygltf/tiny_gltf.h"
+#include <unordered_map>
+#include <chrono>
 
 #define MAX_SSAO_SAMPLE_COUNT 64
 #define NOISE_BUFFER_SIZE 16
@@ -16,6 +29,9 @@ class SceneManager {
         int meshId = 0;
         std::vector<int> children;
         XMMATRIX transformation = XMMatrixIdentity();
+        std::vector<XMMATRIX> instances; // EXT_mesh_gpu_instancing, relative to the node; empty for one mesh instance
+        BoundsList instanceBounds; // of the mesh for each instance, relative to the node
+        AABB bounds; // of the mesh with all instances, relative to the node, rejects the node before its instances are culled
     };
 
     struct BufferAccessor {
@@ -31,30 +47,40 @@ class SceneManager {
         int verticesAccessorId = 0;
     };
 
-    struct Primitive {
-        int materialId = 0;
-        D3D_PRIMITIVE_TOPOLOGY mode = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-        std::vector<Attribute> attributes;
-        int indicesAccessorId = 0;
-        std::shared_ptr<VertexShader> VS;
-        std::shared_ptr<PixelShader> gBufferPS; // only for deferred render
-        std::shared_ptr<PixelShader> PSDefault; // only for forward render
-        std::shared_ptr<PixelShader> PSFresnel; // only for forward render
-        std::shared_ptr<PixelShader> PSNdf; // only for forward render
-        std::shared_ptr<PixelShader> PSGeometry; // only for forward render
-        std::shared_ptr<PixelShader> PSShadowSplits; // only for forward render
-        std::shared_ptr<PixelShader> PSSSAOMask; // only for forward render
-        std::shared_ptr<PixelShader> transparentPSSSAO; // only for transparent
-        std::shared_ptr<PixelShader> transparentPSSSAOMask; // only for transparent
-        std::shared_ptr<VertexShader> shadowVS;
-        std::shared_ptr<PixelShader> shadowPS; // only for alpha cutoff
+    // The pooled tables below hold raw pointers, the objects behind them are kept alive by resourceReferences_.
+    // Primitives with equal shader defines share one shader set, its index identifies the permutation for sorting.
+    struct ShaderSet {
+        ID3D11InputLayout* inputLayout = nullptr;
+        ID3D11VertexShader* VS = nullptr;
+        ID3D11PixelShader* gBufferPS = nullptr; // only for deferred render
+        ID3D11PixelShader* PSDefault = nullptr; // only for forward render
+        ID3D11PixelShader* PSFresnel = nullptr; // only for forward render
+        ID3D11PixelShader* PSNdf = nullptr; // only for forward render
+        ID3D11PixelShader* PSGeometry = nullptr; // only for forward render
+        ID3D11PixelShader* PSShadowSplits = nullptr; // only for forward render
+        ID3D11PixelShader* PSSSAOMask = nullptr; // only for forward render
+        ID3D11PixelShader* transparentPSSSAO = nullptr; // only for transparent
+        ID3D11PixelShader* transparentPSSSAOMask = nullptr; // only for transparent
+        ID3D11InputLayout* shadowInputLayout = nullptr;
+        ID3D11VertexShader* shadowVS = nullptr;
+        ID3D11PixelShader* shadowPS = nullptr; // only for alpha cutoff
+    };
+
+    struct TextureViews {
+        ID3D11ShaderResourceView* SRV = nullptr;
+        ID3D11ShaderResourceView* SRVSRGB = nullptr;
     };
 
+    typedef Handle<ShaderSet> ShaderSetHandle;
+    typedef Handle<TextureViews> TextureHandle;
+
     struct TextureAccessor {
         int texCoordId = 0;
         int textureId = -1;
         int samplerId = 0;
         bool isSRGB = false;
+        TextureHandle texture;
+        ID3D11SamplerState* sampler = nullptr;
     };
 
     enum class AlphaMode {
@@ -78,55 +104,109 @@ class SceneManager {
         TextureAccessor emissiveTA;
         TextureAccessor occlusionTA;
         D3D11_CULL_MODE cullMode = D3D11_CULL_NONE;
-        std::shared_ptr<ID3D11RasterizerState> rasterizerState;
-        std::shared_ptr<ID3D11DepthStencilState> depthStencilState;
-        std::shared_ptr<ID3D11BlendState> blendState;
+        ID3D11RasterizerState* rasterizerState = nullptr;
+        ID3D11DepthStencilState* depthStencilState = nullptr;
+        ID3D11BlendState* blendState = nullptr;
+        ID3D11Buffer* paramsBuffer = nullptr; // immutable, created with the material
+        ID3D11Buffer* shadowParamsBuffer = nullptr; // immutable, only for materials drawn into shadow maps with alpha cutoff
+    };
+
+    typedef Handle<Material> MaterialHandle;
+
+    static const UINT maxVertexBuffers = 9;
+    static const UINT instanceSlot = maxVertexBuffers; // input slot of the per-instance world matrices
+    static const UINT initialInstanceCapacity = 4096;
+    static const UINT clusteredLightsSlot = 13; // t13-t15 of the forward render shaders
+    static const UINT identityInstanceParent = UINT_MAX; // the instances carry their world matrices
+    static const UINT unboundInstanceParent = UINT_MAX - 1; // b0 of the instanced vertex shader is not bound yet
+
+    struct Primitive {
+        MaterialHandle material;
+        ShaderSetHandle shaders;
+        D3D_PRIMITIVE_TOPOLOGY mode = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+        UINT vertexBufferCount = 0;
+        ID3D11Buffer* vertexBuffers[maxVertexBuffers] = {};
+        UINT strides[maxVertexBuffers] = {};
+        UINT offsets[maxVertexBuffers] = {};
+        ID3D11Buffer* indexBuffer = nullptr; // nullptr for non-indexed primitives
+        DXGI_FORMAT indexFormat = DXGI_FORMAT_UNKNOWN;
+        UINT indexOffset = 0;
+        UINT count = 0; // number of indices or vertices
+        AABB bounds; // in the space of the mesh
     };
 
+    typedef Handle<Primitive> PrimitiveHandle;
+
     struct Mesh {
-        std::vector<Primitive> opaquePrimitives;
-        std::vector<Primitive> transparentPrimitives;
-        std::vector<Primitive> primitivesWithAlphaCutoff;
+        std::vector<PrimitiveHandle> opaquePrimitives;
+        std::vector<PrimitiveHandle> transparentPrimitives;
+        std::vector<PrimitiveHandle> primitivesWithAlphaCutoff;
     };
 
     struct TransparentPrimitive {
-        Primitive primitive;
-        XMMATRIX transformation = XMMatrixIdentity();
-        float distance = 0.0f;
-        int arrayId = 0;
+        UINT drawItemId = 0;
+        float depth = 0.0f; // in [0, 1], smaller values are drawn first
+    };
 
-        TransparentPrimitive(Primitive p) : primitive(p) {};
+    // every primitive of the rendered scenes, collected once per frame after the transformations are updated
+    struct DrawItem {
+        XMMATRIX transformation = XMMatrixIdentity();
+        PrimitiveHandle primitive;
+        AlphaMode mode = AlphaMode::OPAQUE_MODE;
+        bool dynamic = false; // moved during the last staticUpdateCount frames, not kept in the cached shadow maps
+        const Node* instancedNode = nullptr; // with EXT_mesh_gpu_instancing, then the transformation is the node's
+    };
 
-        ~TransparentPrimitive() = default;
+    // draw items with the same primitive, drawn by one instanced call
+    struct InstanceBatch {
+        UINT drawItemId = 0; // the first instance, defines the primitive
+        UINT firstInstance = 0; // in the instance buffer
+        UINT instanceCount = 0;
+        float distance = 0.0f; // from the camera to the closest instance
+    };
 
-        friend bool operator<(const TransparentPrimitive& p1, const TransparentPrimitive& p2) {
-            return p1.distance < p2.distance;
-        };
+    // last values bound by RenderPrimitive and DrawInstances, reset at the beginning of each pass
+    struct BindCache {
+        ID3D11InputLayout* inputLayout = nullptr;
+        ID3D11VertexShader* VS = nullptr;
+        ID3D11PixelShader* PS = nullptr;
+        ID3D11RasterizerState* rasterizerState = nullptr;
+        ID3D11DepthStencilState* depthStencilState = nullptr;
+        ID3D11BlendState* blendState = nullptr;
+        D3D_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+        PrimitiveHandle vertexBuffers;
+        std::pair<ID3D11Buffer*, UINT> indexBuffer = { nullptr, 0 }; // buffer and offset
+        MaterialHandle material;
+        ID3D11Buffer* instanceBuffer = nullptr;
+        UINT instanceParent = unboundInstanceParent; // draw item whose transformation is bound for its instances
     };
 
     struct Scene {
         std::vector<int> rootNodes;
         XMMATRIX transformation = XMMatrixIdentity();
         int arraysId = 0;
+        std::vector<int> nodes; // node ids in the order of the transform hierarchy
+        std::vector<int> hierarchyIndices; // position of each node in the hierarchy, -1 if the node is not in the scene
+        TransformHierarchy transformations;
     };
 
     struct SceneArrays {
         std::vector<Node> nodes;
         std::vector<Mesh> meshes;
-        std::vector<Material> materials;
-        std::vector<std::shared_ptr<Texture>> textures;
+        std::vector<MaterialHandle> materials;
+        std::vector<TextureHandle> textures;
         std::vector<std::shared_ptr<ID3D11SamplerState>> samplers;
         std::vector<BufferAccessor> accessors;
     };
 
-    struct WorldMatrixBuffer {
-        XMMATRIX worldMatrix;
-    };
-
     struct InstancingWorldMatrixBuffer {
         XMMATRIX worldMatrix[MAX_LIGHT];
     };
 
+    struct InstanceParentBuffer {
+        XMMATRIX worldMatrix;
+    };
+
     struct ViewMatrixBuffer {
         XMMATRIX viewProjectionMatrix;
     };
@@ -146,7 +226,10 @@ class SceneManager {
         XMFLOAT4 direction;
         XMFLOAT4 color;
         XMMATRIX viewProjectionMatrix;
-        XMUINT4 splitSizeRatio;
+        XMFLOAT4 cascadeSplits;
+        XMFLOAT4 cascadeScales[CSM_SPLIT_COUNT];
+        XMFLOAT4 cascadeOffsets[CSM_SPLIT_COUNT];
+        XMFLOAT4 cascadeAtlasRects[CSM_SPLIT_COUNT];
     };
 
     struct MaterialParamsBuffer {
@@ -162,9 +245,9 @@ class SceneManager {
 
     struct ForwardRenderViewMatrixBuffer {
         XMMATRIX viewProjectionMatrix;
-        XMINT4 lightParams;
+        XMINT4 lightParams; // point light count, size of the cluster grid
+        XMFLOAT4 clusterParams; // slice scale and bias, smooth clamp and clamp radiance limits
         DirectionalLight::DirectionalLightInfo directionalLight;
-        PointLight lights[MAX_LIGHT];
     };
 
     struct MatricesBuffer {
@@ -198,6 +281,35 @@ class SceneManager {
         XMFLOAT3 pos;
     };
 
+    // what a cached shadow map was rendered for, the static casters are redrawn when anything but the position changes
+    struct ShadowCache {
+        bool valid = false;
+        XMFLOAT4 lightDirection = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float texelSize = 0.0f;
+        float minZ = 0.0f;
+        float maxZ = 0.0f;
+        float minX = 0.0f; // light space position of the map
+        float maxY = 0.0f;
+        UINT tileX = 0; // place of the map in the atlas
+        UINT tileY = 0;
+        UINT tileSize = 0;
+        uint64_t staticCasters = 0; // key of the set of static draw items
+        int depthBias = 0;
+        float slopeScaleBias = 0.0f;
+        bool excludeTransparent = true;
+    };
+
+    struct ShadowScrollBuffer {
+        XMINT4 offset; // from the target texel to the source one
+        XMINT4 bounds; // the source texels are taken from [x, z) x [y, w), the others are cleared
+    };
+
+    enum class CasterSet {
+        ALL,
+        STATIC,
+        DYNAMIC
+    };
+
 public:
     enum class Mode {
         DEFAULT,
@@ -208,9 +320,20 @@ public:
         SSAO_MASK
     };
 
+    // point of the bounding box by which transparent primitives are ordered,
+    // GPU_READBACK renders and reads back the depth of each primitive and is kept only for comparison
+    enum class TransparentSortMode {
+        CLOSEST_POINT,
+        FARTHEST_POINT,
+        CENTROID,
+        GPU_READBACK
+    };
+
     // general settings
     bool excludeTransparent = true;
+    bool instancing = true; // draw items with the same primitive are merged into instanced draws
     bool deferredRender = true;
+    TransparentSortMode transparentSortMode = TransparentSortMode::CLOSEST_POINT;
 
     // default mode settings
     bool withSSAO = true;
@@ -218,14 +341,60 @@ public:
     // shadows settings
     int depthBias = 4;
     float slopeScaleBias = 2 * sqrt(2);
+    bool cacheShadows = true; // static casters are kept in the shadow maps between frames
+    int shadowMemoryBudgetMB = 128; // for the shadow atlas and, with caching, its copy
 
     // SSAO settings
     float SSAODepthLimit = 0.000001f;
     float SSAORadius = 2.1f;
 
-    // deferred render point light settings
+    // point light settings, the clamp limit defines the radius of a light
     float smoothClampRadianceLimit = 1.0f;
     float clampRadianceLimit = 0.5f;
+    float minPointLightScreenRadius = 1.0f; // pixels, smaller deferred light volumes are not drawn
+
+    struct RenderStatistics {
+        UINT draws = 0;
+        UINT instancedDrawsSaved = 0; // draws that would be issued without instancing minus the actual ones
+        UINT binds = 0;
+        UINT skippedBinds = 0;
+        UINT nodes = 0;
+        UINT meshInstances = 0; // instances of EXT_mesh_gpu_instancing in the rendered scenes
+        UINT drawnMeshInstances = 0; // of them left after culling, summed over the passes
+        UINT updatedTransformations = 0;
+        float transformationTime = 0.0f; // microseconds
+        UINT visiblePrimitives = 0;
+        UINT culledPrimitives = 0;
+        float cullingTime = 0.0f; // microseconds
+        UINT shadowCasterCandidates = 0;
+        UINT shadowCasters[CSM_SPLIT_COUNT] = {}; // drawn into each cascade
+        float shadowCoverage[CSM_SPLIT_COUNT] = {}; // fraction of the texels of each cascade inside its frustum slice
+        UINT shadowCascadesRedrawn = 0; // static casters drawn into the whole map
+        UINT shadowCascadesScrolled = 0; // the cached map moved, static casters drawn only into the uncovered bands
+        UINT shadowCascadesComposited = 0; // dynamic casters drawn over a copy of the cached map
+        UINT shadowAtlasSize = 0;
+        UINT shadowTileSizes[CSM_SPLIT_COUNT] = {};
+        float shadowScreenCoverage[CSM_SPLIT_COUNT] = {}; // estimated share of the screen in each cascade
+        float shadowAtlasUsage = 0.0f; // fraction of the atlas in the tiles
+        size_t shadowMemoryBytes = 0; // the atlas and its copy if it exists
+        UINT transparentPrimitives = 0;
+        UINT transparentOrderMismatches = 0; // pairs ordered differently by the CPU and the GPU, only in GPU_READBACK mode
+        UINT pointLights = 0;
+        UINT clusteredLightIndices = 0; // light references in all clusters, only for forward render
+        UINT maxLightsPerCluster = 0;
+        float lightBinningTime = 0.0f; // microseconds
+        UINT shadedPointLights = 0; // light volumes drawn, only for deferred render
+        UINT culledPointLights = 0; // outside the frustum
+        UINT smallPointLights = 0; // below minPointLightScreenRadius
+        UINT insidePointLights = 0; // volumes containing the camera, drawn with their back faces
+        size_t frameArenaBytes = 0;
+        size_t constantBufferBytes = 0; // uploaded by the scene manager
+        bool dynamicConstantsSupported = false;
+        size_t dynamicConstantsPaddingBytes = 0;
+        size_t dynamicConstantsUsedBytes = 0; // including the previous frames not yet finished by the GPU
+        size_t dynamicConstantsCapacity = 0;
+        UINT dynamicConstantsFallbacks = 0; // constants uploaded into their own buffers because the ring was full
+    };
 
     SceneManager();
 
@@ -244,6 +413,15 @@ public:
     bool Resize(int width, int height);
     void Cleanup();
 
+    // the passes of the scene and their transient textures (the G-buffer, the depth copy, the depth chain of the sort
+    // readback) for the current settings; the textures are taken from the pool after the graph is compiled
+    void DeclarePasses(FrameGraph& graph, UINT renderTarget);
+    void BindTransientTextures(const FrameGraph& graph, const TransientTexturePool& pool);
+
+    // world matrices of the changed nodes and their subtrees are recomputed on the next render
+    bool SetNodeTransformation(UINT sceneIndex, int nodeId, const XMMATRIX& transformation);
+    bool SetSceneTransformation(UINT sceneIndex, const XMMATRIX& transformation);
+
     void SetMode(Mode mode) {
         currentMode_ = mode;
     };
@@ -260,6 +438,10 @@ public:
         return isInit_;
     };
 
+    const RenderStatistics& GetRenderStatistics() const {
+        return renderStatistics_;
+    };
+
     ~SceneManager() {
         Cleanup();
     };
@@ -270,8 +452,6 @@ private:
     HRESULT CreateAuxiliaryForDeferredRender();
     HRESULT CreateAuxiliaryForShadowMaps();
     HRESULT CreateAuxiliaryForTransparent();
-    HRESULT CreateTexture(RawPtrTexture& texture, int width, int height, DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM);
-    HRESULT CreateTexture(RawPtrTexture& texture, int i);
     HRESULT CreateBuffers();
 
     HRESULT CreateBufferAccessors(const tinygltf::Model& model, SceneArrays& arrays);
@@ -280,6 +460,11 @@ private:
     HRESULT CreateMaterials(const tinygltf::Model& model, SceneArrays& arrays);
     HRESULT CreateMeshes(const tinygltf::Model& model, SceneArrays& arrays);
     HRESULT CreateNodes(const tinygltf::Model& model, SceneArrays& arrays);
+    void FlattenNodes(Scene& scene, const SceneArrays& arrays, int nodeId, int parent);
+    void ReadInstances(const tinygltf::Model& model, const tinygltf::Node& node, std::vector<XMMATRIX>& instances);
+    void CreateInstanceBounds(const SceneArrays& arrays, Node& node);
+    bool ReadAccessor(const tinygltf::Model& model, int accessorId, int type, std::vector<XMFLOAT4>& values);
+    AABB GetPositionBounds(const tinygltf::Model& model, const tinygltf::Primitive& primitive);
     DXGI_FORMAT GetFormat(const tinygltf::Accessor& accessor, UINT& size);
     DXGI_FORMAT GetFormatScalar(const tinygltf::Accessor& accessor, UINT& size);
     DXGI_FORMAT GetFormatVec2(const tinygltf::Accessor& accessor, UINT& size);
@@ -288,32 +473,50 @@ private:
     D3D11_TEXTURE_ADDRESS_MODE GetSamplerMode(int m);
     void ParseAttributes(const SceneArrays& arrays, const tinygltf::Primitive& primitive,
         std::vector<Attribute>& attributes, std::vector<std::string>& baseDefines, std::vector<D3D11_INPUT_ELEMENT_DESC>& desc);
-    HRESULT CreateShaders(Primitive& primitive, const SceneArrays& arrays,
+    HRESULT CreateMaterialBuffers(Material& material);
+    void ResolveTextureAccessor(const SceneArrays& arrays, TextureAccessor& accessor);
+    HRESULT CreateShaders(Primitive& primitive, AlphaMode mode,
         const std::vector<std::string>& baseDefines, const std::vector<D3D11_INPUT_ELEMENT_DESC>& desc);
 
-    bool CreateShadowMaps(const std::vector<int>& sceneIndices);
-    bool CreateShadowMapForNode(int arrayId, int nodeId, const XMMATRIX& transformation = XMMatrixIdentity());
-    bool CreateShadowMapForPrimitive(int arrayId, const Primitive& primitive, AlphaMode mode, const XMMATRIX& transformation);
-    bool PrepareTransparent(const std::vector<int>& sceneIndices);
-    bool PrepareTransparentForNode(int arrayId, int nodeId, const XMMATRIX& transformation = XMMatrixIdentity());
-    bool AddPrimitiveToTransparentPrimitives(int arrayId, const Primitive& primitive, const XMMATRIX& transformation);
-    void RenderNode(
-        int arrayId,
-        int nodeId,
+    void UpdateTransformations(const std::vector<int>& sceneIndices);
+    void CollectDrawItems(const std::vector<int>& sceneIndices);
+    void CullDrawItems();
+    void FitShadowCascades();
+    bool ChooseShadowTiles(const ShadowCascades::View& view);
+    void EstimateCascadeScreenCoverage(const ShadowCascades::View& view, float* coverage);
+    HRESULT CreateShadowAtlas();
+    bool CreateShadowMaps();
+    bool UpdateShadowCaches();
+    bool CheckShadowCache(UINT cascade, int& offsetX, int& offsetY);
+    bool ScrollShadowTiles(const XMINT2* offsets, const bool* scrolled);
+    void ClearShadowTile(UINT cascade);
+    void BindShadowScroll(ID3D11ShaderResourceView* source, ID3D11DepthStencilView* target);
+    bool DrawShadowCasters(UINT cascade, const XMMATRIX& projection, const D3D11_VIEWPORT& viewport, CasterSet set);
+    void CollectShadowCasters(const XMMATRIX& viewProjection, CasterSet set, FrameVector<UINT>& casters);
+    D3D11_VIEWPORT GetShadowTileViewport(UINT cascade, UINT x = 0, UINT y = 0, UINT width = 0, UINT height = 0) const;
+    bool CreateShadowMapForPrimitive(const InstanceBatch& batch);
+    bool PrepareTransparent();
+    float GetTransparentSortDepth(UINT drawItemId, TransparentSortMode mode) const;
+    bool AddPrimitiveToTransparentPrimitives(const InstanceBatch& batch);
+    bool BuildInstanceBatches(FrameVector<UINT>& drawItemIds, bool merge, const XMMATRIX& viewProjection, bool withNearPlane = true);
+    HRESULT CreateInstanceBuffer(UINT capacity);
+    bool UploadInstances(const XMMATRIX* transformations, UINT count, UINT& firstInstance);
+    void DrawInstances(const Primitive& primitive, const InstanceBatch& batch);
+    void AddPrimitiveToRenderQueue(UINT batchId, UINT pass);
+    void SubmitRenderQueue(
         const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
         const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
         const std::shared_ptr<ID3D11ShaderResourceView>& BRDF,
-        const XMMATRIX& transformation = XMMatrixIdentity()
+        bool transparent = false
     );
-    void RenderPrimitive(
-        int arrayId,
-        const Primitive& primitive,
+    void BindPassResources(
         const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
         const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
         const std::shared_ptr<ID3D11ShaderResourceView>& BRDF,
-        const XMMATRIX& transformation,
-        bool transparent = false
+        bool transparent
     );
+    void RenderPrimitive(const InstanceBatch& batch, bool transparent);
+    void BindMaterial(const Material& material, bool transparent);
     void RenderTransparent(
         const std::shared_ptr<ID3D11ShaderResourceView>& irradianceMap,
         const std::shared_ptr<ID3D11ShaderResourceView>& prefilteredMap,
@@ -326,6 +529,30 @@ private:
     );
     void RenderDirectionalLight();
     void RenderPointLights(const std::vector<PointLight>& lights);
+    void DrawPointLightVolumes(const std::vector<PointLight>& lights, const UINT* ids, UINT count);
+    bool BuildLightClusters(const std::vector<PointLight>& lights, ForwardRenderViewMatrixBuffer& sceneBuffer);
+
+    // the data goes to the dynamic ring if it is supported, otherwise into the buffer of this kind of constants
+    template<typename T>
+    void UploadConstants(DynamicConstantBuffer::Binding& binding, ID3D11Buffer* buffer, const T& data) {
+        if (!dynamicConstants_.Upload(data, binding)) {
+            device_->GetDeviceContext()->UpdateSubresource(buffer, 0, nullptr, &data, 0, 0);
+            binding = DynamicConstantBuffer::Binding();
+            binding.buffer = buffer;
+        }
+        renderStatistics_.constantBufferBytes += sizeof(T);
+    };
+
+    template<typename T>
+    bool UpdateBinding(T& current, T value) {
+        if (current == value) {
+            ++renderStatistics_.skippedBinds;
+            return false;
+        }
+        current = value;
+        ++renderStatistics_.binds;
+        return true;
+    };
 
     std::shared_ptr<Device> device_; // provided externally <-
     std::shared_ptr<ManagerStorage> managerStorage_; // provided externally <-
@@ -335,24 +562,50 @@ private:
 
     std::shared_ptr<ID3D11RenderTargetView> renderTarget_; // provided externally <-
 
-    ID3D11Buffer* worldMatrixBuffer_ = nullptr; // always remains only inside the class #
+    // dynamic vertex buffer with the transformations of the instances drawn in the current frame
+    ID3D11Buffer* instanceBuffer_ = nullptr; // always remains only inside the class #
+    UINT instanceBufferCapacity_ = 0; // always remains only inside the class #
+    UINT instanceBufferUsed_ = 0; // always remains only inside the class #
     ID3D11Buffer* instancingWorldMatrixBuffer_ = nullptr; // always remains only inside the class #
+    ID3D11Buffer* instanceParentBuffer_ = nullptr; // always remains only inside the class #
+    // bound as the parent transformation of the instances that carry their world matrices
+    ID3D11Buffer* instanceParentIdentityBuffer_ = nullptr; // always remains only inside the class #
     ID3D11Buffer* viewMatrixBuffer_ = nullptr; // always remains only inside the class #
-    ID3D11Buffer* shadowMapAlphaCutoffBuffer_ = nullptr; // always remains only inside the class #
     ID3D11Buffer* directionalLightBuffer_ = nullptr; // always remains only inside the class #
     ID3D11Buffer* lightBuffer_ = nullptr; // always remains only inside the class #
-    ID3D11Buffer* materialParamsBuffer_ = nullptr; // always remains only inside the class #
     ID3D11Buffer* forwardRenderViewMatrixBuffer_ = nullptr; // always remains only inside the class #
     ID3D11Buffer* matricesBuffer_ = nullptr; // always remains only inside the class #
     ID3D11Buffer* SSAOParamsBuffer_ = nullptr; // always remains only inside the class #
+    ID3D11Buffer* shadowScrollBuffer_ = nullptr; // always remains only inside the class #
+
+    DynamicConstantBuffer dynamicConstants_; // always remains only inside the class #
+    // where the last uploaded constants of each kind are, bound by offset when they are in the dynamic ring
+    DynamicConstantBuffer::Binding instancingWorldMatrixConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding instanceParentConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding viewMatrixConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding directionalLightConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding lightConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding forwardRenderViewMatrixConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding matricesConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding SSAOParamsConstants_; // always remains only inside the class #
+    DynamicConstantBuffer::Binding shadowScrollConstants_; // always remains only inside the class #
+
+    LightClusters lightClusters_; // always remains only inside the class #
+    DynamicStructuredBuffer pointLightBuffer_; // always remains only inside the class #
+    DynamicStructuredBuffer lightClusterBuffer_; // always remains only inside the class #
+    DynamicStructuredBuffer lightIndexBuffer_; // always remains only inside the class #
 
     std::shared_ptr<ID3D11DepthStencilState> shadowDepthStencilState_; // provided externally <-
+    std::shared_ptr<ID3D11DepthStencilState> shadowScrollDepthStencilState_; // provided externally <-
     std::shared_ptr<ID3D11DepthStencilState> transparentDepthStencilState_; // provided externally <-
     std::shared_ptr<ID3D11DepthStencilState> pointLightDepthStencilState_; // provided externally <-
+    std::shared_ptr<ID3D11DepthStencilState> pointLightOutsideDepthStencilState_; // provided externally <-
     std::shared_ptr<ID3D11DepthStencilState> generalDepthStencilState_; // provided externally <-
 
     std::shared_ptr<ID3D11RasterizerState> pointLightRasterizerState_; // provided externally <-
+    std::shared_ptr<ID3D11RasterizerState> pointLightOutsideRasterizerState_; // provided externally <-
     std::shared_ptr<ID3D11RasterizerState> generalRasterizerState_; // provided externally <-
+    std::shared_ptr<ID3D11RasterizerState> shadowRasterizerStates_[3]; // provided externally <- (indexed by cull mode)
 
     std::shared_ptr<ID3D11BlendState> generalBlendState_; // provided externally <-
 
@@ -364,13 +617,27 @@ private:
     ID3D11Texture2D* readMaxTexture_ = nullptr; // always remains only inside the class #
 
     RawPtrDepthBuffer depth_; // always remains only inside the class #
-    RawPtrDepthBuffer depthCopy_; // always remains only inside the class #
-    RawPtrDepthBuffer transparentDepth_; // always remains only inside the class #
-
-    RawPtrTexture normals_; // always remains only inside the class #
-    RawPtrTexture features_; // always remains only inside the class #
-    RawPtrTexture color_; // always remains only inside the class #
-    RawPtrTexture emissive_; // always remains only inside the class #
+    // transient, taken from the pool of the frame graph every frame, empty when the pass using them is culled
+    RawPtrDepthBuffer depthCopy_; // provided externally <-
+    RawPtrDepthBuffer transparentDepth_; // provided externally <-
+
+    RawPtrTexture normals_; // provided externally <-
+    RawPtrTexture features_; // provided externally <-
+    RawPtrTexture color_; // provided externally <-
+    RawPtrTexture emissive_; // provided externally <-
+
+    struct TransientIds {
+        UINT transparentDepth = FrameGraph::invalidIndex;
+        std::vector<UINT> scaledFrames;
+        UINT normals = FrameGraph::invalidIndex;
+        UINT features = FrameGraph::invalidIndex;
+        UINT color = FrameGraph::invalidIndex;
+        UINT emissive = FrameGraph::invalidIndex;
+        UINT depthCopy = FrameGraph::invalidIndex;
+        UINT depthCopyPass = FrameGraph::invalidIndex;
+    };
+    TransientIds transientIds_; // the textures of the current frame in the frame graph
+    bool copyDepth_ = false; // the depth copy is read in the current frame
 
     std::vector<D3D11_INPUT_ELEMENT_DESC> sphereVertexDesc_ = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0}
@@ -390,6 +657,7 @@ private:
 
     std::shared_ptr<PixelShader> directionalLightPS_; // provided externally <-
     std::shared_ptr<PixelShader> directionalLightPSShadowSplits_; // provided externally <-
+    std::shared_ptr<PixelShader> shadowScrollPS_; // provided externally <-
 
     std::shared_ptr<PixelShader> ambientLightPS_; // provided externally <-
     std::shared_ptr<PixelShader> ambientLightPSSSAO_; // provided externally <-
@@ -398,8 +666,34 @@ private:
     std::vector<Scene> scenes_;
     std::vector<SceneArrays> sceneArrays_;
     std::vector<TransparentPrimitive> transparentPrimitives_;
-    std::vector<RawPtrDepthBuffer> shadowSplits_;  // always remains only inside the class #
-    std::vector<RawPtrTexture> scaledFrames_;  // always remains only inside the class #
+    std::vector<DrawItem> drawItems_; // always remains only inside the class #
+    BoundsList drawItemBounds_; // always remains only inside the class # (world space bounds of the draw items)
+    std::vector<uint8_t> cameraVisibility_; // always remains only inside the class # (per draw item)
+    std::vector<uint8_t> shadowVisibility_; // always remains only inside the class # (per draw item, for the current cascade)
+    // per instance of the node whose draw item is batched, in the space of the node
+    std::vector<uint8_t> instanceVisibility_; // always remains only inside the class #
+    std::vector<InstanceBatch> instanceBatches_; // always remains only inside the class # (of the current pass)
+    RenderQueue renderQueue_; // always remains only inside the class #
+    ThreadFrameArenas frameArenas_; // always remains only inside the class # (transient containers of the current frame)
+    BindCache bindCache_; // always remains only inside the class #
+    RenderStatistics renderStatistics_; // transmitted outward ->
+    HandlePool<Primitive> primitives_; // always remains only inside the class #
+    HandlePool<Material> materials_; // always remains only inside the class #
+    HandlePool<ShaderSet> shaderSets_; // always remains only inside the class #
+    HandlePool<TextureViews> textures_; // always remains only inside the class #
+    std::unordered_map<std::string, ShaderSetHandle> shaderSetIds_; // always remains only inside the class # (by shader defines and input layout)
+    std::vector<std::shared_ptr<void>> resourceReferences_; // always remains only inside the class # (keep alive the objects behind the raw pointers of the tables)
+    RawPtrDepthBuffer shadowAtlasDepth_; // always remains only inside the class # (static casters when cached)
+    RawPtrDepthBuffer shadowAtlasCopy_; // always remains only inside the class # (created on demand)
+    UINT shadowAtlasDepthSize_ = 0; // of the textures, the allocator may already use another size
+    ShadowAtlas shadowAtlas_; // tiles of the cascades
+    ShadowAtlas::Tile shadowTiles_[CSM_SPLIT_COUNT];
+    UINT pendingShadowTileSizes_[CSM_SPLIT_COUNT] = {}; // the last choice different from the current tiles
+    UINT pendingShadowTileFrames_ = 0; // for how many frames the pending choice did not change
+    ShadowCache shadowCaches_[CSM_SPLIT_COUNT]; // always remains only inside the class #
+    ID3D11ShaderResourceView* shadowAtlasSRV_ = nullptr; // the atlas sampled in the current frame
+    uint64_t staticCasterKey_ = 0; // always remains only inside the class #
+    std::vector<RawPtrTexture> scaledFrames_;  // provided externally <- (transient)
 
     XMFLOAT4 SSAOSamples_[MAX_SSAO_SAMPLE_COUNT];
     XMFLOAT4 SSAONoise_[NOISE_BUFFER_SIZE];
@@ -407,7 +701,11 @@ private:
     Mode currentMode_ = Mode::DEFAULT;
 
     D3D11_VIEWPORT viewport_;
-    static const UINT shadowMapSize = 4096;
+    static const UINT maxShadowAtlasSize = 8192;
+    static const UINT minShadowTileSize = 256;
+    static const UINT shadowTileDelay = 30; // frames a new choice of tile sizes must persist before the tiles change
+    static const UINT shadowCacheBand = 64; // texels by which a cached cascade moves at once
+    static const UINT staticUpdateCount = 8; // frames without movement after which a node is cached in the shadow maps
     D3D11_VIEWPORT renderTargetViewport_;
     int width_ = 0;
     int height_ = 0;
@@ -45,22 +45,51 @@ public:
         }
     };
 
+    HRESULT GetDependencies(std::vector<std::string>& dependencies, const std::wstring& name, const std::vector<std::string>& macros) const {
+        auto result = dependencies_.find(GenerateKey(name, macros));
+        if (result == dependencies_.end()) {
+            return E_FAIL;
+        }
+        else {
+            dependencies = result->second;
+            return S_OK;
+        }
+    };
+
+    // drops every shader compiled with the include, they are recompiled on the next load
+    void DropDependents(const std::string& includeName) {
+        for (auto it = dependencies_.begin(); it != dependencies_.end();) {
+            if (std::find(it->second.begin(), it->second.end(), includeName) != it->second.end()) {
+                objects_.erase(it->first);
+                it = dependencies_.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    };
+
     void ClearShaders() {
         objects_.clear();
+        dependencies_.clear();
     }
 
     void Cleanup() {
         device_.reset();
+        includeCache_.reset();
         ClearShaders();
     };
 
     virtual ~ShaderManagerBase() = default;
 
 protected:
-    ShaderManagerBase(const std::shared_ptr<Device>& device) : device_(device) {};
+    ShaderManagerBase(const std::shared_ptr<Device>& device, const std::shared_ptr<IncludeCache>& includeCache) :
+        device_(device), includeCache_(includeCache) {};
 
     std::shared_ptr<Device> device_; // provided externally <-
+    std::shared_ptr<IncludeCache> includeCache_; // provided externally <-
     std::map<std::wstring, std::shared_ptr<ST>> objects_; // shaders are transmitted outward ->
+    std::map<std::wstring, std::vector<std::string>> dependencies_; // always remains only inside the class #
 };
 
 
@@ -94,7 +123,8 @@ private:
 
 class VSManager : public ShaderManagerBase<VertexShader> {
 public:
-    VSManager(const std::shared_ptr<Device>& devicePtr) : ShaderManagerBase(devicePtr) {};
+    VSManager(const std::shared_ptr<Device>& devicePtr, const std::shared_ptr<IncludeCache>& includeCache) :
+        ShaderManagerBase(devicePtr, includeCache) {};
 
     HRESULT LoadShader(std::shared_ptr<VertexShader>& object, const std::wstring& name,
         const std::vector<std::string>& macros = {}, const std::vector<D3D11_INPUT_ELEMENT_DESC>& ILDesc = {}) {
@@ -108,7 +138,7 @@ public:
         }
         d3dmacros.push_back({ nullptr, nullptr });
 
-        D3DInclude includeObj;
+        D3DInclude includeObj(includeCache_);
         ID3D11VertexShader* vertexShader = nullptr;
         ID3D10Blob* vertexShaderBuffer = nullptr;
         ID3D11InputLayout* inputLayout = nullptr;
@@ -133,6 +163,7 @@ public:
         if (SUCCEEDED(result)) {
             object = std::make_shared<VertexShader>(vertexShader, vertexShaderBuffer, inputLayout);
             objects_.emplace(GenerateKey(name, macros), object);
+            dependencies_.emplace(GenerateKey(name, macros), includeObj.GetDependencies());
         }
         return result;
     };
@@ -165,7 +196,8 @@ private:
 
 class PSManager : public ShaderManagerBase<PixelShader> {
 public:
-    PSManager(const std::shared_ptr<Device>& devicePtr) : ShaderManagerBase(devicePtr) {};
+    PSManager(const std::shared_ptr<Device>& devicePtr, const std::shared_ptr<IncludeCache>& includeCache) :
+        ShaderManagerBase(devicePtr, includeCache) {};
 
     HRESULT LoadShader(std::shared_ptr<PixelShader>& object, const std::wstring& name,
         const std::vector<std::string>& macros = {}) {
@@ -179,7 +211,7 @@ public:
         }
         d3dmacros.push_back({ nullptr, nullptr });
 
-        D3DInclude includeObj;
+        D3DInclude includeObj(includeCache_);
         ID3D11PixelShader* pixelShader = nullptr;
         ID3D10Blob* pixelShaderBuffer = nullptr;
         int flags = 0;
@@ -199,6 +231,7 @@ public:
         if (SUCCEEDED(result)) {
             object = std::make_shared<PixelShader>(pixelShader, pixelShaderBuffer);
             objects_.emplace(GenerateKey(name, macros), object);
+            dependencies_.emplace(GenerateKey(name, macros), includeObj.GetDependencies());
         }
         return result;
     };
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+// quadtree shadow atlas: power of two tiles, freed siblings are merged back
+class ShadowAtlas {
+public:
+    static const uint32_t invalidNode = 0xFFFFFFFF;
+
+    struct Tile {
+        uint32_t x = 0; // texels from the top left corner of the atlas
+        uint32_t y = 0;
+        uint32_t size = 0; // 0 if the tile is not allocated
+        uint32_t node = invalidNode;
+
+        bool IsValid() const {
+            return size > 0;
+        };
+    };
+
+    // a shadow map asking for a tile: the size that would match the screen resolution and its share of the screen
+    struct Request {
+        float desiredSize = 0.0f;
+        float screenCoverage = 0.0f;
+    };
+
+    ShadowAtlas() = default;
+
+    void Reset(uint32_t size, uint32_t minTileSize) {
+        size_ = FloorPowerOfTwo((std::max)(size, 1u));
+        minTileSize_ = (std::min)(FloorPowerOfTwo((std::max)(minTileSize, 1u)), size_);
+        nodes_.clear();
+        freeQuads_.clear();
+        nodes_.push_back(Node{ 0, 0, size_, invalidNode, invalidNode, false });
+        allocatedTexels_ = 0;
+        tileCount_ = 0;
+    };
+
+    // the size is rounded up to a power of two not less than the minimal tile size, false if no free node fits
+    bool Allocate(uint32_t size, Tile& tile) {
+        uint32_t tileSize = (std::max)(CeilPowerOfTwo(size), minTileSize_);
+        uint32_t best = invalidNode;
+        for (uint32_t i = 0; i < nodes_.size(); ++i) {
+            const Node& node = nodes_[i];
+            if (!node.IsFreeLeaf() || node.size < tileSize) {
+                continue;
+            }
+            if (best == invalidNode || node.size < nodes_[best].size
+                || (node.size == nodes_[best].size && (node.y < nodes_[best].y || (node.y == nodes_[best].y && node.x < nodes_[best].x)))) {
+                best = i;
+            }
+        }
+        if (best == invalidNode) {
+            return false;
+        }
+
+        while (nodes_[best].size > tileSize) {
+            best = Split(best);
+        }
+        nodes_[best].used = true;
+        allocatedTexels_ += (uint64_t)tileSize * tileSize;
+        ++tileCount_;
+        tile.x = nodes_[best].x;
+        tile.y = nodes_[best].y;
+        tile.size = tileSize;
+        tile.node = best;
+        return true;
+    };
+
+    void Free(Tile& tile) {
+        if (!tile.IsValid() || tile.node >= nodes_.size() || !nodes_[tile.node].used) {
+            tile = Tile();
+            return;
+        }
+        uint32_t index = tile.node;
+        nodes_[index].used = false;
+        allocatedTexels_ -= (uint64_t)tile.size * tile.size;
+        --tileCount_;
+        tile = Tile();
+
+        // the quarters of a parent are merged while all of them are free leaves
+        uint32_t parent = nodes_[index].parent;
+        while (parent != invalidNode) {
+            uint32_t first = nodes_[parent].firstChild;
+            bool merge = true;
+            for (uint32_t k = 0; k < 4; ++k) {
+                merge = merge && nodes_[first + k].IsFreeLeaf();
+            }
+            if (!merge) {
+                break;
+            }
+            for (uint32_t k = 0; k < 4; ++k) {
+                nodes_[first + k].size = 0;
+            }
+            nodes_[parent].firstChild = invalidNode;
+            freeQuads_.push_back(first);
+            parent = nodes_[parent].parent;
+        }
+    };
+
+    uint32_t GetSize() const {
+        return size_;
+    };
+
+    uint32_t GetMinTileSize() const {
+        return minTileSize_;
+    };
+
+    uint64_t GetAllocatedTexels() const {
+        return allocatedTexels_;
+    };
+
+    uint32_t GetTileCount() const {
+        return tileCount_;
+    };
+
+    // fraction of the atlas taken by the tiles
+    float GetUsage() const {
+        return size_ > 0 ? (float)((double)allocatedTexels_ / ((double)size_ * size_)) : 0.0f;
+    };
+
+    // sizes for the requests that fit into an atlas of the given size together: the desired sizes are rounded down
+    // to powers of two within [minTileSize, maxTileSize], then while the total area is too large the tile with
+    // the least screen coverage per texel is halved
+    static void ChooseSizes(const Request* requests, uint32_t count, uint32_t atlasSize, uint32_t minTileSize, uint32_t maxTileSize,
+        uint32_t* sizes) {
+        atlasSize = FloorPowerOfTwo((std::max)(atlasSize, 1u));
+        maxTileSize = (std::min)(FloorPowerOfTwo((std::max)(maxTileSize, 1u)), atlasSize);
+        minTileSize = (std::min)(FloorPowerOfTwo((std::max)(minTileSize, 1u)), maxTileSize);
+        uint64_t area = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            float desired = (std::min)((std::max)(requests[i].desiredSize, (float)minTileSize), (float)maxTileSize);
+            sizes[i] = (std::max)(FloorPowerOfTwo((uint32_t)desired), minTileSize);
+            area += (uint64_t)sizes[i] * sizes[i];
+        }
+
+        uint64_t atlasArea = (uint64_t)atlasSize * atlasSize;
+        while (area > atlasArea) {
+            uint32_t cheapest = invalidNode;
+            double cheapestValue = 0.0;
+            for (uint32_t i = 0; i < count; ++i) {
+                if (sizes[i] <= minTileSize) {
+                    continue;
+                }
+                double value = (double)requests[i].screenCoverage / ((double)sizes[i] * sizes[i]);
+                if (cheapest == invalidNode || value < cheapestValue) {
+                    cheapest = i;
+                    cheapestValue = value;
+                }
+            }
+            if (cheapest == invalidNode) {
+                break; // even the minimal tiles do not fit
+            }
+            area -= (uint64_t)sizes[cheapest] * sizes[cheapest] * 3 / 4;
+            sizes[cheapest] /= 2;
+        }
+    };
+
+    static uint32_t FloorPowerOfTwo(uint32_t value) {
+        uint32_t result = 1;
+        while (result <= value / 2) {
+            result *= 2;
+        }
+        return result;
+    };
+
+    static uint32_t CeilPowerOfTwo(uint32_t value) {
+        uint32_t result = 1;
+        while (result < value && result < 0x80000000u) {
+            result *= 2;
+        }
+        return result;
+    };
+
+    ~ShadowAtlas() = default;
+
+private:
+    struct Node {
+        uint32_t x;
+        uint32_t y;
+        uint32_t size; // 0 for the released quarters of merged nodes
+        uint32_t parent;
+        uint32_t firstChild; // the four quarters are stored together, invalidNode for leaves
+        bool used;
+
+        bool IsFreeLeaf() const {
+            return size > 0 && firstChild == invalidNode && !used;
+        };
+    };
+
+    // returns the top left quarter; the quarters of merged nodes are reused, so the nodes do not grow without bound
+    uint32_t Split(uint32_t index) {
+        uint32_t first = 0;
+        if (!freeQuads_.empty()) {
+            first = freeQuads_.back();
+            freeQuads_.pop_back();
+        }
+        else {
+            first = (uint32_t)nodes_.size();
+            nodes_.resize(nodes_.size() + 4);
+        }
+        Node node = nodes_[index];
+        uint32_t half = node.size / 2;
+        for (uint32_t k = 0; k < 4; ++k) {
+            nodes_[first + k] = Node{ node.x + (k & 1) * half, node.y + (k >> 1) * half, half, index, invalidNode, false };
+        }
+        nodes_[index].firstChild = first;
+        return first;
+    };
+
+    std::vector<Node> nodes_; // always remains only inside the class #
+    std::vector<uint32_t> freeQuads_; // always remains only inside the class #
+    uint32_t size_ = 0; // always remains only inside the class #
+    uint32_t minTileSize_ = 1; // always remains only inside the class #
+    uint64_t allocatedTexels_ = 0; // always remains only inside the class #
+    uint32_t tileCount_ = 0; // always remains only inside the class #
+};
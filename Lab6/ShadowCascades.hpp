@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+
+// cascades of a directional light fitted to the camera frustum, stabilized ones are snapped to texels
+class ShadowCascades {
+public:
+    static const uint32_t maxCascades = 4;
+
+    struct Vector3 {
+        float x;
+        float y;
+        float z;
+    };
+
+    struct Settings {
+        uint32_t cascadeCount = maxCascades;
+        float splitLambda = 0.75f; // 0 gives uniform splits, 1 gives logarithmic ones
+        float shadowDistance = 300.0f; // the last cascade ends here or at the far plane
+        uint32_t resolutions[maxCascades] = { 4096, 4096, 4096, 4096 }; // texels along a side of each cascade
+        uint32_t snapTexels = 1; // the box moves by multiples of this number of texels, it is widened by as many
+        bool stabilize = true;
+    };
+
+    struct View {
+        Vector3 position;
+        Vector3 right; // world space axes of the camera
+        Vector3 up;
+        Vector3 forward; // the direction of view
+        float projectionScaleX = 1.0f; // 1 / tan of the half horizontal field of view
+        float projectionScaleY = 1.0f; // 1 / tan of the half vertical field of view
+        float nearPlane = 0.1f;
+        float farPlane = 1000.0f;
+    };
+
+    struct Cascade {
+        float nearDistance; // view depths of the frustum slice
+        float farDistance;
+        Vector3 min; // light space box: x and y along the right and up axes of the light, z towards the light
+        Vector3 max;
+        float texelSize;
+        Vector3 corners[8]; // of the frustum slice, in light space
+    };
+
+    ShadowCascades() = default;
+
+    // lightDirection points towards the light, the scene bounds are in world space (an empty box if min > max)
+    void Build(const Settings& settings, const View& view, const Vector3& lightDirection, const Vector3& sceneMin, const Vector3& sceneMax) {
+        settings_ = settings;
+        settings_.cascadeCount = (std::min)((std::max)(settings_.cascadeCount, 1u), (uint32_t)maxCascades);
+        ComputeLightBasis(lightDirection);
+
+        bool emptyScene = sceneMin.x > sceneMax.x || sceneMin.y > sceneMax.y || sceneMin.z > sceneMax.z;
+        float sceneMinZ = FLT_MAX;
+        float sceneMaxZ = -FLT_MAX;
+        for (uint32_t i = 0; i < 8 && !emptyScene; ++i) {
+            Vector3 corner = { (i & 1) ? sceneMax.x : sceneMin.x, (i & 2) ? sceneMax.y : sceneMin.y, (i & 4) ? sceneMax.z : sceneMin.z };
+            float z = Dot(corner, lightDirection_);
+            sceneMinZ = (std::min)(sceneMinZ, z);
+            sceneMaxZ = (std::max)(sceneMaxZ, z);
+        }
+
+        float nearPlane = view.nearPlane;
+        float farPlane = (std::min)(view.farPlane, settings_.shadowDistance);
+        for (uint32_t i = 0; i < settings_.cascadeCount; ++i) {
+            Cascade& cascade = cascades_[i];
+            cascade.nearDistance = i == 0 ? nearPlane : cascades_[i - 1].farDistance;
+            cascade.farDistance = GetSplitDistance(nearPlane, farPlane, i + 1);
+            FitCascade(view, settings_.resolutions[i], cascade);
+
+            // receivers and casters lie in the scene, the range does not depend on the camera
+            if (!emptyScene) {
+                cascade.min.z = sceneMinZ;
+                cascade.max.z = sceneMaxZ;
+            }
+            float padding = (cascade.max.z - cascade.min.z) * 0.01f + 0.01f;
+            cascade.min.z -= padding;
+            cascade.max.z += padding;
+        }
+    };
+
+    const Settings& GetSettings() const {
+        return settings_;
+    };
+
+    uint32_t GetCascadeCount() const {
+        return settings_.cascadeCount;
+    };
+
+    const Cascade& GetCascade(uint32_t index) const {
+        return cascades_[index];
+    };
+
+    // axes of the light space in world space, the view matrix of the light has them as columns
+    const Vector3& GetLightRight() const {
+        return lightRight_;
+    };
+
+    const Vector3& GetLightUp() const {
+        return lightUp_;
+    };
+
+    const Vector3& GetLightDirection() const {
+        return lightDirection_;
+    };
+
+    Vector3 ToLightSpace(const Vector3& point) const {
+        return { Dot(point, lightRight_), Dot(point, lightUp_), Dot(point, lightDirection_) };
+    };
+
+    // resolution at which a texel of the cascade is as large as a screen pixel at the near end of its slice
+    static float GetMatchingResolution(const Cascade& cascade, const View& view, float screenHeight) {
+        float pixelSize = 2.0f * (std::max)(cascade.nearDistance, view.nearPlane) / (view.projectionScaleY * screenHeight);
+        return (cascade.max.x - cascade.min.x) / pixelSize;
+    };
+
+    // fraction of the texels of the cascade whose columns along the light pass through its frustum slice,
+    // estimated on a grid of samples x samples texel centers
+    static float ComputeCoverage(const Cascade& cascade, uint32_t samples = 64) {
+        Vector3 hull[8];
+        uint32_t hullSize = ComputeHull(cascade.corners, hull);
+        uint32_t inside = 0;
+        for (uint32_t j = 0; j < samples; ++j) {
+            float y = cascade.min.y + (cascade.max.y - cascade.min.y) * (j + 0.5f) / samples;
+            for (uint32_t i = 0; i < samples; ++i) {
+                float x = cascade.min.x + (cascade.max.x - cascade.min.x) * (i + 0.5f) / samples;
+                inside += IsInsideHull(hull, hullSize, x, y) ? 1 : 0;
+            }
+        }
+        return (float)inside / ((float)samples * samples);
+    };
+
+    ~ShadowCascades() = default;
+
+private:
+    static float Dot(const Vector3& a, const Vector3& b) {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    };
+
+    static Vector3 Cross(const Vector3& a, const Vector3& b) {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    };
+
+    static Vector3 Normalize(const Vector3& v) {
+        float length = std::sqrt(Dot(v, v));
+        return { v.x / length, v.y / length, v.z / length };
+    };
+
+    // the basis depends only on the direction, so the texel grid does not turn while the light is still
+    void ComputeLightBasis(const Vector3& lightDirection) {
+        lightDirection_ = Normalize(lightDirection);
+        Vector3 reference = std::abs(lightDirection_.y) > 0.99f ? Vector3{ 0.0f, 0.0f, 1.0f } : Vector3{ 0.0f, 1.0f, 0.0f };
+        lightRight_ = Normalize(Cross(reference, lightDirection_));
+        lightUp_ = Cross(lightDirection_, lightRight_);
+    };
+
+    float GetSplitDistance(float nearPlane, float farPlane, uint32_t split) const {
+        float fraction = (float)split / settings_.cascadeCount;
+        float logarithmic = nearPlane * std::pow(farPlane / nearPlane, fraction);
+        float uniform = nearPlane + (farPlane - nearPlane) * fraction;
+        return settings_.splitLambda * logarithmic + (1.0f - settings_.splitLambda) * uniform;
+    };
+
+    void FitCascade(const View& view, uint32_t resolution, Cascade& cascade) const {
+        Vector3 center = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t i = 0; i < 8; ++i) {
+            float depth = (i & 4) ? cascade.farDistance : cascade.nearDistance;
+            float x = ((i & 1) ? 1.0f : -1.0f) * depth / view.projectionScaleX;
+            float y = ((i & 2) ? 1.0f : -1.0f) * depth / view.projectionScaleY;
+            Vector3 world = {
+                view.position.x + view.forward.x * depth + view.right.x * x + view.up.x * y,
+                view.position.y + view.forward.y * depth + view.right.y * x + view.up.y * y,
+                view.position.z + view.forward.z * depth + view.right.z * x + view.up.z * y
+            };
+            cascade.corners[i] = ToLightSpace(world);
+            center = { center.x + cascade.corners[i].x / 8, center.y + cascade.corners[i].y / 8, center.z + cascade.corners[i].z / 8 };
+        }
+
+        cascade.min = cascade.corners[0];
+        cascade.max = cascade.corners[0];
+        for (uint32_t i = 1; i < 8; ++i) {
+            const Vector3& c = cascade.corners[i];
+            cascade.min = { (std::min)(cascade.min.x, c.x), (std::min)(cascade.min.y, c.y), (std::min)(cascade.min.z, c.z) };
+            cascade.max = { (std::max)(cascade.max.x, c.x), (std::max)(cascade.max.y, c.y), (std::max)(cascade.max.z, c.z) };
+        }
+
+        float size = 0.0f;
+        if (settings_.stabilize) {
+            // the corners keep their distances to the centroid under rotation, the radius is rounded against
+            // the drift of floating point errors
+            float radius = 0.0f;
+            for (uint32_t i = 0; i < 8; ++i) {
+                Vector3 d = { cascade.corners[i].x - center.x, cascade.corners[i].y - center.y, cascade.corners[i].z - center.z };
+                radius = (std::max)(radius, std::sqrt(Dot(d, d)));
+            }
+            size = std::ceil(radius * 2.0f * 16.0f) / 16.0f;
+            cascade.min.x = center.x - size * 0.5f;
+            cascade.min.y = center.y - size * 0.5f;
+        }
+        else {
+            size = (std::max)(cascade.max.x - cascade.min.x, cascade.max.y - cascade.min.y);
+        }
+
+        // the origin of the box is moved to a whole snap step, so the texels cover the same world positions in every frame;
+        // one step is reserved for the part of the box lost by the rounding down
+        resolution = (std::max)(resolution, 2u);
+        uint32_t snapTexels = (std::min)((std::max)(settings_.snapTexels, 1u), resolution / 2);
+        cascade.texelSize = size / (resolution - snapTexels);
+        float step = cascade.texelSize * snapTexels;
+        cascade.min.x = std::floor(cascade.min.x / step) * step;
+        cascade.min.y = std::floor(cascade.min.y / step) * step;
+        cascade.max.x = cascade.min.x + cascade.texelSize * resolution;
+        cascade.max.y = cascade.min.y + cascade.texelSize * resolution;
+    };
+
+    // convex hull of the corners projected along the light, counterclockwise (monotone chain)
+    static uint32_t ComputeHull(const Vector3* corners, Vector3* hull) {
+        Vector3 points[8];
+        std::copy(corners, corners + 8, points);
+        std::sort(points, points + 8, [](const Vector3& a, const Vector3& b) {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        });
+        Vector3 chain[16];
+        uint32_t size = 0;
+        for (uint32_t k = 0; k < 8; ++k) {
+            while (size >= 2 && Turn(chain[size - 2], chain[size - 1], points[k]) <= 0.0f) {
+                --size;
+            }
+            chain[size++] = points[k];
+        }
+        uint32_t lowerSize = size + 1;
+        for (int k = 6; k >= 0; --k) {
+            while (size >= lowerSize && Turn(chain[size - 2], chain[size - 1], points[k]) <= 0.0f) {
+                --size;
+            }
+            chain[size++] = points[k];
+        }
+        --size; // the last point is the first one
+        std::copy(chain, chain + size, hull);
+        return size;
+    };
+
+    static float Turn(const Vector3& a, const Vector3& b, const Vector3& c) {
+        return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    };
+
+    static bool IsInsideHull(const Vector3* hull, uint32_t size, float x, float y) {
+        Vector3 point = { x, y, 0.0f };
+        for (uint32_t i = 0; i < size; ++i) {
+            if (Turn(hull[i], hull[(i + 1) % size], point) < 0.0f) {
+                return false;
+            }
+        }
+        return size >= 3;
+    };
+
+    Settings settings_; // always remains only inside the class #
+    Cascade cascades_[maxCascades] = {}; // always remains only inside the class #
+    Vector3 lightRight_ = { 1.0f, 0.0f, 0.0f }; // always remains only inside the class #
+    Vector3 lightUp_ = { 0.0f, 1.0f, 0.0f }; // always remains only inside the class #
+    Vector3 lightDirection_ = { 0.0f, 0.0f, 1.0f }; // always remains only inside the class #
+};
@@ -70,6 +70,7 @@ bool Skybox::Resize(UINT width, UINT height) {
 }
 
 bool Skybox::Render() const {
+    CPU_PROFILE_SCOPE("Skybox::Render");
     if (!IsInit()) {
         return false;
     }
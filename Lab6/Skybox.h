@@ -2,6 +2,7 @@
 
 #include "ManagerStorage.hpp"
 #include "Camera.hpp"
+#include "CpuProfiler.hpp"
 
 
 class Skybox {
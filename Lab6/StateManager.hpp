@@ -1,38 +1,103 @@
 #pragma once
 
 #include "Device.hpp"
-#include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <cstring>
 
 
 namespace {
-    std::string GenerateKey(D3D11_BLEND srcBlend, D3D11_BLEND destBlend, D3D11_BLEND_OP op) {
-        return std::to_string(srcBlend) + "_" + std::to_string(destBlend) + "_" + std::to_string(op);
+    inline size_t HashCombine(size_t seed, UINT value) {
+        return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
     };
 
-    std::string GenerateKey(D3D11_FILTER filter, D3D11_TEXTURE_ADDRESS_MODE modeU,
-        D3D11_TEXTURE_ADDRESS_MODE modeV, D3D11_TEXTURE_ADDRESS_MODE modeW, D3D11_COMPARISON_FUNC compFunc) {
-        return std::to_string(filter) + "_" + std::to_string(modeU) + "_" + std::to_string(modeV) + "_" + std::to_string(modeW) + "_" + std::to_string(compFunc);
+    struct BlendStateKey {
+        D3D11_BLEND srcBlend;
+        D3D11_BLEND destBlend;
+        D3D11_BLEND_OP op;
+
+        bool operator==(const BlendStateKey& other) const {
+            return srcBlend == other.srcBlend && destBlend == other.destBlend && op == other.op;
+        };
+    };
+
+    struct SamplerStateKey {
+        D3D11_FILTER filter;
+        D3D11_TEXTURE_ADDRESS_MODE modeU;
+        D3D11_TEXTURE_ADDRESS_MODE modeV;
+        D3D11_TEXTURE_ADDRESS_MODE modeW;
+        D3D11_COMPARISON_FUNC compFunc;
+
+        bool operator==(const SamplerStateKey& other) const {
+            return filter == other.filter && modeU == other.modeU && modeV == other.modeV && modeW == other.modeW && compFunc == other.compFunc;
+        };
+    };
+
+    struct DepthStencilStateKey {
+        D3D11_COMPARISON_FUNC compFunc;
+        D3D11_DEPTH_WRITE_MASK mask;
+
+        bool operator==(const DepthStencilStateKey& other) const {
+            return compFunc == other.compFunc && mask == other.mask;
+        };
     };
 
-    std::string GenerateKey(D3D11_COMPARISON_FUNC compFunc, D3D11_DEPTH_WRITE_MASK mask) {
-        return std::to_string(compFunc) + "_" + std::to_string(mask);
+    struct RasterizerStateKey {
+        D3D11_FILL_MODE fillMode;
+        D3D11_CULL_MODE cullMode;
+        INT depthBias;
+        FLOAT slopeScaleDepthBias;
+
+        bool operator==(const RasterizerStateKey& other) const {
+            return fillMode == other.fillMode && cullMode == other.cullMode && depthBias == other.depthBias
+                && slopeScaleDepthBias == other.slopeScaleDepthBias;
+        };
     };
 
-    std::string GenerateKey(D3D11_FILL_MODE fillMode, D3D11_CULL_MODE cullMode, INT depthBias, FLOAT slopeScaleDepthBias) {
-        return std::to_string(fillMode) + "_" + std::to_string(cullMode) + "_" + std::to_string(depthBias) + "_"
-            + std::to_string(slopeScaleDepthBias);
+    struct StateKeyHash {
+        size_t operator()(const BlendStateKey& key) const {
+            size_t seed = HashCombine(0, key.srcBlend);
+            seed = HashCombine(seed, key.destBlend);
+            return HashCombine(seed, key.op);
+        };
+
+        size_t operator()(const SamplerStateKey& key) const {
+            size_t seed = HashCombine(0, key.filter);
+            seed = HashCombine(seed, key.modeU);
+            seed = HashCombine(seed, key.modeV);
+            seed = HashCombine(seed, key.modeW);
+            return HashCombine(seed, key.compFunc);
+        };
+
+        size_t operator()(const DepthStencilStateKey& key) const {
+            return HashCombine(HashCombine(0, key.compFunc), key.mask);
+        };
+
+        size_t operator()(const RasterizerStateKey& key) const {
+            FLOAT slopeScaleDepthBias = key.slopeScaleDepthBias + 0.0f; // -0.0f and 0.0f must give the same hash
+            UINT slopeScaleDepthBiasBits;
+            memcpy(&slopeScaleDepthBiasBits, &slopeScaleDepthBias, sizeof(UINT));
+            size_t seed = HashCombine(0, key.fillMode);
+            seed = HashCombine(seed, key.cullMode);
+            seed = HashCombine(seed, (UINT)key.depthBias);
+            return HashCombine(seed, slopeScaleDepthBiasBits);
+        };
     };
 }; // anonymous namespace
 
 
 class StateManager {
 public:
+    struct Statistics {
+        UINT hits = 0;
+        UINT misses = 0;
+    };
+
     StateManager(const std::shared_ptr<Device>& devicePtr) : device_(devicePtr) {};
 
     bool CheckBlendState(D3D11_BLEND srcBlend = D3D11_BLEND_SRC_ALPHA, D3D11_BLEND destBlend = D3D11_BLEND_INV_SRC_ALPHA, D3D11_BLEND_OP op = D3D11_BLEND_OP_ADD) const {
-        return blendStates_.find(GenerateKey(srcBlend, destBlend, op)) != blendStates_.end();
+        return blendStates_.find(BlendStateKey{ srcBlend, destBlend, op }) != blendStates_.end();
     };
 
     HRESULT CreateBlendState(std::shared_ptr<ID3D11BlendState>& object, D3D11_BLEND srcBlend = D3D11_BLEND_SRC_ALPHA, D3D11_BLEND destBlend = D3D11_BLEND_INV_SRC_ALPHA,
@@ -58,7 +123,7 @@ public:
         HRESULT result = device_->GetDevice()->CreateBlendState(&desc, &blendState);
         if (SUCCEEDED(result)) {
             object = std::shared_ptr<ID3D11BlendState>(blendState, utilities::DXPtrDeleter<ID3D11BlendState*>);
-            blendStates_.emplace(GenerateKey(srcBlend, destBlend, op), object);
+            blendStates_.emplace(BlendStateKey{ srcBlend, destBlend, op }, object);
         }
         return result;
     };
@@ -70,11 +135,13 @@ public:
 
     HRESULT GetBlendState(std::shared_ptr<ID3D11BlendState>& object, D3D11_BLEND srcBlend = D3D11_BLEND_SRC_ALPHA, D3D11_BLEND destBlend = D3D11_BLEND_INV_SRC_ALPHA,
         D3D11_BLEND_OP op = D3D11_BLEND_OP_ADD) const {
-        auto result = blendStates_.find(GenerateKey(srcBlend, destBlend, op));
+        auto result = blendStates_.find(BlendStateKey{ srcBlend, destBlend, op });
         if (result == blendStates_.end()) {
+            ++frameStatistics_.misses;
             return E_FAIL;
         }
         else {
+            ++frameStatistics_.hits;
             object = result->second;
             return S_OK;
         }
@@ -87,7 +154,7 @@ public:
     bool CheckSamplerState(D3D11_FILTER filter, D3D11_TEXTURE_ADDRESS_MODE modeU = D3D11_TEXTURE_ADDRESS_WRAP,
         D3D11_TEXTURE_ADDRESS_MODE modeV = D3D11_TEXTURE_ADDRESS_WRAP, D3D11_TEXTURE_ADDRESS_MODE modeW = D3D11_TEXTURE_ADDRESS_WRAP,
         D3D11_COMPARISON_FUNC compFunc = D3D11_COMPARISON_NEVER) const {
-        return samplerStates_.find(GenerateKey(filter, modeU, modeV, modeW, compFunc)) != samplerStates_.end();
+        return samplerStates_.find(SamplerStateKey{ filter, modeU, modeV, modeW, compFunc }) != samplerStates_.end();
     };
 
     HRESULT CreateSamplerState(std::shared_ptr<ID3D11SamplerState>& object, D3D11_FILTER filter,
@@ -113,7 +180,7 @@ public:
         HRESULT result = device_->GetDevice()->CreateSamplerState(&desc, &sampler);
         if (SUCCEEDED(result)) {
             object = std::shared_ptr<ID3D11SamplerState>(sampler, utilities::DXPtrDeleter<ID3D11SamplerState*>);
-            samplerStates_.emplace(GenerateKey(filter, modeU, modeV, modeW, compFunc), object);
+            samplerStates_.emplace(SamplerStateKey{ filter, modeU, modeV, modeW, compFunc }, object);
         }
         return result;
     };
@@ -128,11 +195,13 @@ public:
     HRESULT GetSamplerState(std::shared_ptr<ID3D11SamplerState>& object, D3D11_FILTER filter,
         D3D11_TEXTURE_ADDRESS_MODE modeU = D3D11_TEXTURE_ADDRESS_WRAP, D3D11_TEXTURE_ADDRESS_MODE modeV = D3D11_TEXTURE_ADDRESS_WRAP,
         D3D11_TEXTURE_ADDRESS_MODE modeW = D3D11_TEXTURE_ADDRESS_WRAP, D3D11_COMPARISON_FUNC compFunc = D3D11_COMPARISON_NEVER) const {
-        auto result = samplerStates_.find(GenerateKey(filter, modeU, modeV, modeW, compFunc));
+        auto result = samplerStates_.find(SamplerStateKey{ filter, modeU, modeV, modeW, compFunc });
         if (result == samplerStates_.end()) {
+            ++frameStatistics_.misses;
             return E_FAIL;
         }
         else {
+            ++frameStatistics_.hits;
             object = result->second;
             return S_OK;
         }
@@ -144,7 +213,7 @@ public:
 
     bool CheckDepthStencilState(D3D11_COMPARISON_FUNC compFunc = D3D11_COMPARISON_GREATER,
         D3D11_DEPTH_WRITE_MASK mask = D3D11_DEPTH_WRITE_MASK_ALL) const {
-        return depthStencilStates_.find(GenerateKey(compFunc, mask)) != depthStencilStates_.end();
+        return depthStencilStates_.find(DepthStencilStateKey{ compFunc, mask }) != depthStencilStates_.end();
     };
 
     HRESULT CreateDepthStencilState(std::shared_ptr<ID3D11DepthStencilState>& object, D3D11_COMPARISON_FUNC compFunc = D3D11_COMPARISON_GREATER,
@@ -163,7 +232,7 @@ public:
         HRESULT result = device_->GetDevice()->CreateDepthStencilState(&desc, &DSState);
         if (SUCCEEDED(result)) {
             object = std::shared_ptr<ID3D11DepthStencilState>(DSState, utilities::DXPtrDeleter<ID3D11DepthStencilState*>);
-            depthStencilStates_.emplace(GenerateKey(compFunc, mask), object);
+            depthStencilStates_.emplace(DepthStencilStateKey{ compFunc, mask }, object);
         }
         return result;
     };
@@ -176,11 +245,13 @@ public:
 
     HRESULT GetDepthStencilState(std::shared_ptr<ID3D11DepthStencilState>& object, D3D11_COMPARISON_FUNC compFunc = D3D11_COMPARISON_GREATER,
         D3D11_DEPTH_WRITE_MASK mask = D3D11_DEPTH_WRITE_MASK_ALL) const {
-        auto result = depthStencilStates_.find(GenerateKey(compFunc, mask));
+        auto result = depthStencilStates_.find(DepthStencilStateKey{ compFunc, mask });
         if (result == depthStencilStates_.end()) {
+            ++frameStatistics_.misses;
             return E_FAIL;
         }
         else {
+            ++frameStatistics_.hits;
             object = result->second;
             return S_OK;
         }
@@ -192,7 +263,7 @@ public:
 
     bool CheckRasterizerState(D3D11_FILL_MODE fillMode = D3D11_FILL_SOLID, D3D11_CULL_MODE cullMode = D3D11_CULL_NONE,
         INT depthBias = 0, FLOAT slopeScaleDepthBias = 0.0f) const {
-        return rasterizerStates_.find(GenerateKey(fillMode, cullMode, depthBias, slopeScaleDepthBias)) != rasterizerStates_.end();
+        return rasterizerStates_.find(RasterizerStateKey{ fillMode, cullMode, depthBias, slopeScaleDepthBias }) != rasterizerStates_.end();
     };
 
     HRESULT CreateRasterizerState(std::shared_ptr<ID3D11RasterizerState>& object, D3D11_FILL_MODE fillMode = D3D11_FILL_SOLID,
@@ -217,7 +288,7 @@ public:
         HRESULT result = device_->GetDevice()->CreateRasterizerState(&desc, &rasterizerState);
         if (SUCCEEDED(result)) {
             object = std::shared_ptr<ID3D11RasterizerState>(rasterizerState, utilities::DXPtrDeleter<ID3D11RasterizerState*>);
-            rasterizerStates_.emplace(GenerateKey(fillMode, cullMode, depthBias, slopeScaleDepthBias), object);
+            rasterizerStates_.emplace(RasterizerStateKey{ fillMode, cullMode, depthBias, slopeScaleDepthBias }, object);
         }
         return result;
     };
@@ -230,11 +301,13 @@ public:
 
     HRESULT GetRasterizerState(std::shared_ptr<ID3D11RasterizerState>& object, D3D11_FILL_MODE fillMode = D3D11_FILL_SOLID,
         D3D11_CULL_MODE cullMode = D3D11_CULL_NONE, INT depthBias = 0, FLOAT slopeScaleDepthBias = 0.0f) const {
-        auto result = rasterizerStates_.find(GenerateKey(fillMode, cullMode, depthBias, slopeScaleDepthBias));
+        auto result = rasterizerStates_.find(RasterizerStateKey{ fillMode, cullMode, depthBias, slopeScaleDepthBias });
         if (result == rasterizerStates_.end()) {
+            ++frameStatistics_.misses;
             return E_FAIL;
         }
         else {
+            ++frameStatistics_.hits;
             object = result->second;
             return S_OK;
         }
@@ -244,6 +317,15 @@ public:
         rasterizerStates_.clear();
     };
 
+    // lookups made through Get*/Create* since the last reset, a miss means that a state was created
+    const Statistics& GetFrameStatistics() const {
+        return frameStatistics_;
+    };
+
+    void ResetFrameStatistics() {
+        frameStatistics_ = {};
+    };
+
     void Cleanup() {
         device_.reset();
         ClearBlendState();
@@ -256,8 +338,9 @@ public:
 
 private:
     std::shared_ptr<Device> device_; // provided externally <-
-    std::map<std::string, std::shared_ptr<ID3D11BlendState>> blendStates_; // states are transmitted outward ->
-    std::map<std::string, std::shared_ptr<ID3D11SamplerState>> samplerStates_; // states are transmitted outward ->
-    std::map<std::string, std::shared_ptr<ID3D11DepthStencilState>> depthStencilStates_; // states are transmitted outward ->
-    std::map<std::string, std::shared_ptr<ID3D11RasterizerState>> rasterizerStates_; // states are transmitted outward ->
+    std::unordered_map<BlendStateKey, std::shared_ptr<ID3D11BlendState>, StateKeyHash> blendStates_; // states are transmitted outward ->
+    std::unordered_map<SamplerStateKey, std::shared_ptr<ID3D11SamplerState>, StateKeyHash> samplerStates_; // states are transmitted outward ->
+    std::unordered_map<DepthStencilStateKey, std::shared_ptr<ID3D11DepthStencilState>, StateKeyHash> depthStencilStates_; // states are transmitted outward ->
+    std::unordered_map<RasterizerStateKey, std::shared_ptr<ID3D11RasterizerState>, StateKeyHash> rasterizerStates_; // states are transmitted outward ->
+    mutable Statistics frameStatistics_; // transmitted outward ->
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Device.hpp"
+#include "CpuProfiler.hpp"
 
 class SwapChain {
 public:
@@ -55,6 +56,16 @@ public:
         return result;
     };
 
+    // a back buffer without a window, for the headless device; Present does nothing
+    HRESULT InitHeadless(const std::shared_ptr<Device>& device, UINT width, UINT height) {
+        if (!device->IsInit()) {
+            return E_FAIL;
+        }
+
+        device_ = device;
+        return CreateOffscreenTarget(width, height);
+    };
+
     bool IsInit() const {
         return !!renderTarget_;
     };
@@ -69,6 +80,9 @@ public:
         }
 
         renderTarget_.reset();
+        if (!swapChain_) {
+            return SUCCEEDED(CreateOffscreenTarget(width, height));
+        }
 
         HRESULT result = swapChain_->ResizeBuffers(2, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
         if (FAILED(result)) {
@@ -98,8 +112,9 @@ public:
     };
 
     HRESULT Present() const {
+        CPU_PROFILE_SCOPE("SwapChain::Present");
         if (IsInit()) {
-            return swapChain_->Present(0, 0);
+            return !!swapChain_ ? swapChain_->Present(0, 0) : S_OK;
         }
         else {
             return E_FAIL;
@@ -117,6 +132,39 @@ public:
     };
 
 private:
+    HRESULT CreateOffscreenTarget(UINT width, UINT height) {
+        D3D11_TEXTURE2D_DESC textureDesc = {};
+        textureDesc.Width = width;
+        textureDesc.Height = height;
+        textureDesc.MipLevels = 1;
+        textureDesc.ArraySize = 1;
+        textureDesc.Format = DXGI_FORMAT_R8G8B8A8_TYPELESS; // viewed as SRGB, which needs a typeless texture
+        textureDesc.SampleDesc.Count = 1;
+        textureDesc.Usage = D3D11_USAGE_DEFAULT;
+        textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+        textureDesc.CPUAccessFlags = 0;
+        textureDesc.MiscFlags = 0;
+
+        ID3D11Texture2D* backBuffer = nullptr;
+        HRESULT result = device_->GetDevice()->CreateTexture2D(&textureDesc, nullptr, &backBuffer);
+
+        ID3D11RenderTargetView* renderTargetView = nullptr;
+        if (SUCCEEDED(result)) {
+            D3D11_RENDER_TARGET_VIEW_DESC desc = {};
+            desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+            desc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+            desc.Texture2D.MipSlice = 0;
+
+            result = device_->GetDevice()->CreateRenderTargetView(backBuffer, &desc, &renderTargetView);
+        }
+        SAFE_RELEASE(backBuffer);
+
+        if (SUCCEEDED(result)) {
+            renderTarget_ = std::shared_ptr<ID3D11RenderTargetView>(renderTargetView, utilities::DXPtrDeleter<ID3D11RenderTargetView*>);
+        }
+        return result;
+    };
+
     std::shared_ptr<Device> device_; // provided externally <-
     std::shared_ptr<ID3D11RenderTargetView> renderTarget_; // transmitted outward ->
 
@@ -7,6 +7,7 @@
 #undef STB_IMAGE_IMPLEMENTATION
 
 HRESULT TextureManager::LoadTexture(std::shared_ptr<Texture>& texture, const std::string& name) {
+    CPU_PROFILE_SCOPE("TextureManager::LoadTexture");
     if (SUCCEEDED(GetTexture(texture, name))) {
         return S_OK;
     }
@@ -69,6 +70,7 @@ HRESULT TextureManager::LoadTexture(std::shared_ptr<Texture>& texture, const std
 };
 
 HRESULT TextureManager::LoadHDRTexture(std::shared_ptr<Texture>& texture, const std::string& name) {
+    CPU_PROFILE_SCOPE("TextureManager::LoadHDRTexture");
     if (SUCCEEDED(GetTexture(texture, name))) {
         return S_OK;
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Device.hpp"
+#include "CpuProfiler.hpp"
 #include <map>
 #include <vector>
 #include <string>
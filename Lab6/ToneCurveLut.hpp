@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+
+// Uncharted 2 curve and grading baked into a size^3 table indexed by the log2 of the exposed color
+class ToneCurveLut {
+public:
+    static const uint32_t size = 32;
+    static const int32_t minLog2 = -10;
+    static const int32_t maxLog2 = 6;
+
+    struct Color {
+        float r = 0.0f;
+        float g = 0.0f;
+        float b = 0.0f;
+    };
+
+    struct Settings {
+        // the Uncharted 2 curve
+        float shoulderStrength = 0.1f;
+        float linearStrength = 0.5f;
+        float linearAngle = 0.1f;
+        float toeStrength = 0.2f;
+        float toeNumerator = 0.02f;
+        float toeDenominator = 0.3f;
+        float whitePoint = 11.2f; // the exposed value mapped to 1
+        // grading after the curve
+        float saturation = 1.0f;
+        Color colorFilter = { 1.0f, 1.0f, 1.0f };
+
+        bool operator==(const Settings& other) const {
+            return shoulderStrength == other.shoulderStrength && linearStrength == other.linearStrength
+                && linearAngle == other.linearAngle && toeStrength == other.toeStrength && toeNumerator == other.toeNumerator
+                && toeDenominator == other.toeDenominator && whitePoint == other.whitePoint && saturation == other.saturation
+                && colorFilter.r == other.colorFilter.r && colorFilter.g == other.colorFilter.g && colorFilter.b == other.colorFilter.b;
+        };
+
+        bool operator!=(const Settings& other) const {
+            return !(*this == other);
+        };
+    };
+
+    static float Curve(const Settings& settings, float x) {
+        float a = settings.shoulderStrength;
+        float b = settings.linearStrength;
+        float c = settings.linearAngle;
+        float d = settings.toeStrength;
+        float e = settings.toeNumerator;
+        float f = settings.toeDenominator;
+        return (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f;
+    };
+
+    // the tone mapped and graded color of an exposed linear color; it is not clamped, so that the table stays smooth
+    // (the float texels keep the values outside [0, 1], the render target clamps them)
+    static Color Evaluate(const Settings& settings, const Color& color) {
+        float whiteScale = 1.0f / Curve(settings, settings.whitePoint);
+        Color mapped;
+        mapped.r = Curve(settings, color.r) * whiteScale * settings.colorFilter.r;
+        mapped.g = Curve(settings, color.g) * whiteScale * settings.colorFilter.g;
+        mapped.b = Curve(settings, color.b) * whiteScale * settings.colorFilter.b;
+        float luma = mapped.r * 0.2126f + mapped.g * 0.7151f + mapped.b * 0.0722f;
+        mapped.r = luma + (mapped.r - luma) * settings.saturation;
+        mapped.g = luma + (mapped.g - luma) * settings.saturation;
+        mapped.b = luma + (mapped.b - luma) * settings.saturation;
+        return mapped;
+    };
+
+    // the color of the texels along one axis
+    static float Decode(uint32_t texel) {
+        return std::exp2((float)minLog2 + (float)(maxLog2 - minLog2) * texel / (size - 1));
+    };
+
+    // texture coordinate = log2(value) * scale + offset, the centers of the first and the last texels at the ends of the range
+    static void GetCoordinateTransform(float& scale, float& offset) {
+        float span = (float)(size - 1) / size / (float)(maxLog2 - minLog2);
+        scale = span;
+        offset = 0.5f / size - (float)minLog2 * span;
+    };
+
+    // RGBA texels, red changes the fastest and blue the slowest, as the rows and the depth slices of a 3D texture
+    static void Bake(const Settings& settings, std::vector<float>& texels) {
+        texels.resize((size_t)size * size * size * 4);
+        float* texel = texels.data();
+        for (uint32_t b = 0; b < size; ++b) {
+            for (uint32_t g = 0; g < size; ++g) {
+                for (uint32_t r = 0; r < size; ++r) {
+                    Color color;
+                    color.r = Decode(r);
+                    color.g = Decode(g);
+                    color.b = Decode(b);
+                    Color mapped = Evaluate(settings, color);
+                    texel[0] = mapped.r;
+                    texel[1] = mapped.g;
+                    texel[2] = mapped.b;
+                    texel[3] = 1.0f;
+                    texel += 4;
+                }
+            }
+        }
+    };
+
+    // trilinear sample of the baked table for an exposed color, as the tone mapping shader takes it
+    static Color Sample(const std::vector<float>& texels, const Color& color) {
+        float scale, offset;
+        GetCoordinateTransform(scale, offset);
+        const float smallest = std::exp2((float)minLog2);
+        float position[3] = {
+            Coordinate((std::max)(color.r, smallest), scale, offset),
+            Coordinate((std::max)(color.g, smallest), scale, offset),
+            Coordinate((std::max)(color.b, smallest), scale, offset)
+        };
+        uint32_t first[3];
+        float weight[3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            float p = (std::min)((std::max)(position[k], 0.0f), (float)(size - 1));
+            first[k] = (std::min)((uint32_t)p, size - 2);
+            weight[k] = p - (float)first[k];
+        }
+
+        Color result;
+        for (uint32_t corner = 0; corner < 8; ++corner) {
+            uint32_t r = first[0] + (corner & 1);
+            uint32_t g = first[1] + ((corner >> 1) & 1);
+            uint32_t b = first[2] + ((corner >> 2) & 1);
+            float w = ((corner & 1) ? weight[0] : 1.0f - weight[0]) * (((corner >> 1) & 1) ? weight[1] : 1.0f - weight[1])
+                * (((corner >> 2) & 1) ? weight[2] : 1.0f - weight[2]);
+            const float* texel = &texels[(((size_t)b * size + g) * size + r) * 4];
+            result.r += texel[0] * w;
+            result.g += texel[1] * w;
+            result.b += texel[2] * w;
+        }
+        return result;
+    };
+
+private:
+    // texel position of a value, 0 at the center of the first texel
+    static float Coordinate(float value, float scale, float offset) {
+        return (std::log2(value) * scale + offset) * size - 0.5f;
+    };
+};
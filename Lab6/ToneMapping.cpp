@@ -12,16 +12,28 @@ ToneMapping::ToneMapping() {
 void ToneMapping::Cleanup() {
     CleanupTextures();
 
-    SAFE_RELEASE(adaptBuffer_);
+    SAFE_RELEASE(exposureBuffer_);
+    SAFE_RELEASE(toneLutSRV_);
+    SAFE_RELEASE(toneLut_);
+    toneLutBaked_ = false;
+    SAFE_RELEASE(histogramUAV_);
+    SAFE_RELEASE(histogramBuffer_);
+    for (auto& buffer : readHistogramBuffers_) {
+        SAFE_RELEASE(buffer);
+    }
+    readHistogramBuffers_.clear();
+    SAFE_RELEASE(histogramConstantBuffer_);
 
     samplerAvg_.reset();
     samplerMin_.reset();
     samplerMax_.reset();
     samplerDefault_.reset();
+    samplerLut_.reset();
     mappingVS_.reset();
     brightnessPS_.reset();
     downsamplePS_.reset();
     tonemapPS_.reset();
+    histogramPS_.reset();
     device_.reset();
     managerStorage_.reset();
 };
@@ -29,21 +41,16 @@ void ToneMapping::Cleanup() {
 void ToneMapping::CleanupTextures() {
     SAFE_RELEASE(frameSRV_);
     SAFE_RELEASE(frame_);
-    for (auto& scaledFrame : scaledFrames_) {
-        SAFE_RELEASE(scaledFrame.avg.SRV);
-        SAFE_RELEASE(scaledFrame.avg.RTV);
-        SAFE_RELEASE(scaledFrame.avg.texture);
-        SAFE_RELEASE(scaledFrame.min.SRV);
-        SAFE_RELEASE(scaledFrame.min.RTV);
-        SAFE_RELEASE(scaledFrame.min.texture);
-        SAFE_RELEASE(scaledFrame.max.SRV);
-        SAFE_RELEASE(scaledFrame.max.RTV);
-        SAFE_RELEASE(scaledFrame.max.texture);
-    }
-    SAFE_RELEASE(readAvgTexture_);
+    for (auto& texture : readAvgTextures_) {
+        SAFE_RELEASE(texture);
+    }
+    readAvgTextures_.clear();
 
     frameRTV_.reset();
     scaledFrames_.clear();
+    scaledFrameIds_.clear();
+    chainLive_ = false;
+    histogramLive_ = false;
     n = 0;
 }
 
@@ -70,16 +77,26 @@ HRESULT ToneMapping::Init(const std::shared_ptr<Device>& device, const std::shar
     if (SUCCEEDED(result)) {
         result = managerStorage_->GetStateManager()->CreateSamplerState(samplerDefault_, D3D11_FILTER_ANISOTROPIC);
     }
+    if (SUCCEEDED(result)) {
+        result = managerStorage_->GetStateManager()->CreateSamplerState(samplerLut_, D3D11_FILTER_MIN_MAG_MIP_LINEAR,
+            D3D11_TEXTURE_ADDRESS_CLAMP, D3D11_TEXTURE_ADDRESS_CLAMP, D3D11_TEXTURE_ADDRESS_CLAMP);
+    }
 
     if (SUCCEEDED(result)) {
         D3D11_BUFFER_DESC desc = {};
-        desc.ByteWidth = sizeof(AdaptBuffer);
+        desc.ByteWidth = sizeof(ExposureBuffer);
         desc.Usage = D3D11_USAGE_DEFAULT;
         desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
         desc.CPUAccessFlags = 0;
         desc.MiscFlags = 0;
         desc.StructureByteStride = 0;
-        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &adaptBuffer_);
+        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &exposureBuffer_);
+    }
+    if (SUCCEEDED(result)) {
+        result = CreateToneLut();
+    }
+    if (SUCCEEDED(result)) {
+        result = CreateHistogram();
     }
 
     if (SUCCEEDED(result)) {
@@ -94,11 +111,88 @@ HRESULT ToneMapping::Init(const std::shared_ptr<Device>& device, const std::shar
     if (SUCCEEDED(result)) {
         result = managerStorage_->GetPSManager()->LoadShader(tonemapPS_, L"shaders/tonemapPS.hlsl");
     }
+    if (SUCCEEDED(result)) {
+        result = managerStorage_->GetPSManager()->LoadShader(histogramPS_, L"shaders/histogramPS.hlsl");
+    }
+
+    return result;
+}
+
+HRESULT ToneMapping::CreateHistogram() {
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = ExposureHistogram::binCount * sizeof(UINT);
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+    desc.StructureByteStride = 0;
+    HRESULT result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &histogramBuffer_);
+
+    if (SUCCEEDED(result)) {
+        D3D11_UNORDERED_ACCESS_VIEW_DESC viewDesc = {};
+        viewDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+        viewDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        viewDesc.Buffer.FirstElement = 0;
+        viewDesc.Buffer.NumElements = ExposureHistogram::binCount;
+        viewDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+        result = device_->GetDevice()->CreateUnorderedAccessView(histogramBuffer_, &viewDesc, &histogramUAV_);
+    }
+
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.BindFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.MiscFlags = 0;
+    for (UINT i = 0; i < readbackSlots && SUCCEEDED(result); i++) {
+        ID3D11Buffer* buffer = nullptr;
+        result = device_->GetDevice()->CreateBuffer(&desc, nullptr, &buffer);
+        if (SUCCEEDED(result)) {
+            readHistogramBuffers_.push_back(buffer);
+        }
+    }
+
+    if (SUCCEEDED(result)) {
+        D3D11_BUFFER_DESC constantDesc = {};
+        constantDesc.ByteWidth = sizeof(HistogramBuffer);
+        constantDesc.Usage = D3D11_USAGE_DEFAULT;
+        constantDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        constantDesc.CPUAccessFlags = 0;
+        constantDesc.MiscFlags = 0;
+        constantDesc.StructureByteStride = 0;
+        result = device_->GetDevice()->CreateBuffer(&constantDesc, nullptr, &histogramConstantBuffer_);
+    }
+
+    return result;
+}
+
+HRESULT ToneMapping::CreateToneLut() {
+    D3D11_TEXTURE3D_DESC desc = {};
+    desc.Width = ToneCurveLut::size;
+    desc.Height = ToneCurveLut::size;
+    desc.Depth = ToneCurveLut::size;
+    desc.MipLevels = 1;
+    desc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = 0;
+    HRESULT result = device_->GetDevice()->CreateTexture3D(&desc, nullptr, &toneLut_);
+
+    if (SUCCEEDED(result)) {
+        D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+        viewDesc.Format = desc.Format;
+        viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+        viewDesc.Texture3D.MostDetailedMip = 0;
+        viewDesc.Texture3D.MipLevels = 1;
+        result = device_->GetDevice()->CreateShaderResourceView(toneLut_, &viewDesc, &toneLutSRV_);
+    }
+    toneLutBaked_ = false;
 
     return result;
 }
 
 HRESULT ToneMapping::CreateTextures(int textureWidth, int textureHeight) {
+    width = textureWidth;
+    height = textureHeight;
     RawPtrTexture tmp;
     HRESULT result = CreateTexture(tmp, textureWidth, textureHeight, DXGI_FORMAT_R32G32B32A32_FLOAT);
     if (SUCCEEDED(result)) {
@@ -106,39 +200,25 @@ HRESULT ToneMapping::CreateTextures(int textureWidth, int textureHeight) {
         frameSRV_ = tmp.SRV;
         frameRTV_ = std::shared_ptr<ID3D11RenderTargetView>(tmp.RTV, utilities::DXPtrDeleter<ID3D11RenderTargetView*>);
 
+        // the textures of the chain are transient, declared with the passes of every frame
         int minSide = min(textureWidth, textureHeight);
         while (minSide >>= 1) {
             n++;
         }
-        for (int i = 0; i < n + 1; i++) {
-            ScaledFrame scaledFrame;
-            result = CreateScaledFrame(scaledFrame, i);
-            if (FAILED(result)) {
-                break;
-            }
-            scaledFrames_.push_back(scaledFrame);
-        }
     }
 
-    if (SUCCEEDED(result)) {
-        result = CreateTexture2D(&readAvgTexture_, 1, 1, DXGI_FORMAT_R32_FLOAT, true);
+    for (UINT i = 0; i < readbackSlots && SUCCEEDED(result); i++) {
+        ID3D11Texture2D* texture = nullptr;
+        result = CreateTexture2D(&texture, 3, 1, DXGI_FORMAT_R32_FLOAT, true);
+        if (SUCCEEDED(result)) {
+            readAvgTextures_.push_back(texture);
+        }
     }
+    readback_.Reset(readbackSlots);
 
     return result;
 }
 
-HRESULT ToneMapping::CreateScaledFrame(ScaledFrame& scaledFrame, int num) {
-    int size = pow(2, num);
-    HRESULT result = CreateTexture(scaledFrame.avg, size, size, DXGI_FORMAT_R32_FLOAT);
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(scaledFrame.min, size, size, DXGI_FORMAT_R32_FLOAT);
-    }
-    if (SUCCEEDED(result)) {
-        result = CreateTexture(scaledFrame.max, size, size, DXGI_FORMAT_R32_FLOAT);
-    }
-    return result;
-}
-
 HRESULT ToneMapping::CreateTexture(RawPtrTexture& texture, int textureWidth, int textureHeight, DXGI_FORMAT format) {
     HRESULT result = CreateTexture2D(&texture.texture, textureWidth, textureHeight, format);
 
@@ -181,10 +261,62 @@ HRESULT ToneMapping::CreateTexture2D(ID3D11Texture2D** texture, int textureWidth
     return device_->GetDevice()->CreateTexture2D(&textureDesc, nullptr, texture);
 }
 
+void ToneMapping::DeclarePasses(FrameGraph& graph, UINT frame, UINT target) {
+    chainPass_ = graph.AddPass("Brightness chain");
+    graph.Read(chainPass_, frame);
+    scaledFrameIds_.resize(n + 1);
+    for (int i = n; i >= 0; i--) {
+        FrameGraph::TextureDesc desc;
+        desc.width = 1 << i;
+        desc.height = 1 << i;
+        desc.format = DXGI_FORMAT_R32_FLOAT;
+        desc.bytesPerTexel = 4;
+        scaledFrameIds_[i].avg = graph.CreateTexture(chainPass_, "Brightness avg", desc);
+        scaledFrameIds_[i].min = graph.CreateTexture(chainPass_, "Brightness min", desc);
+        scaledFrameIds_[i].max = graph.CreateTexture(chainPass_, "Brightness max", desc);
+    }
+
+    histogramPass_ = graph.AddPass("Exposure histogram", meteringMode_ == MeteringMode::histogram);
+    graph.Read(histogramPass_, frame);
+
+    UINT pass = graph.AddPass("Tone mapping");
+    graph.Read(pass, frame);
+    if (meteringMode_ == MeteringMode::brightnessChain) {
+        // the 1x1 level is copied for the readback
+        graph.Read(pass, scaledFrameIds_[0].avg);
+        graph.Read(pass, scaledFrameIds_[0].min);
+        graph.Read(pass, scaledFrameIds_[0].max);
+    }
+    graph.Write(pass, target);
+}
+
+void ToneMapping::BindTransientTextures(const FrameGraph& graph, const TransientTexturePool& pool) {
+    scaledFrames_.resize(scaledFrameIds_.size());
+    for (size_t i = 0; i < scaledFrames_.size(); ++i) {
+        RawPtrTexture* textures[] = { &scaledFrames_[i].avg, &scaledFrames_[i].min, &scaledFrames_[i].max };
+        UINT ids[] = { scaledFrameIds_[i].avg, scaledFrameIds_[i].min, scaledFrameIds_[i].max };
+        for (int k = 0; k < 3; k++) {
+            const TransientTexturePool::Views& views = pool.GetViews(graph, ids[k]);
+            textures[k]->texture = views.texture;
+            textures[k]->RTV = views.RTV;
+            textures[k]->SRV = views.SRV;
+        }
+    }
+    chainLive_ = chainPass_ != FrameGraph::invalidIndex && graph.IsPassLive(chainPass_);
+    histogramLive_ = histogramPass_ != FrameGraph::invalidIndex && graph.IsPassLive(histogramPass_);
+}
+
 bool ToneMapping::CalculateBrightness() {
+    CPU_PROFILE_SCOPE("ToneMapping::CalculateBrightness");
     if (!IsInit()) {
         return false;
     }
+    if (histogramLive_) {
+        CalculateHistogram();
+    }
+    if (!chainLive_) {
+        return true;
+    }
 
     float color[4] = { 0.25f, 0.25f, 0.25f, 1.0f };
     for (int i = n; i >= 0; i--) {
@@ -225,7 +357,94 @@ bool ToneMapping::CalculateBrightness() {
     return true;
 }
 
+void ToneMapping::CalculateHistogram() {
+    CPU_PROFILE_SCOPE("ToneMapping::CalculateHistogram");
+    static const UINT zero[4] = { 0, 0, 0, 0 };
+    device_->GetDeviceContext()->ClearUnorderedAccessViewUint(histogramUAV_, zero);
+
+    HistogramBuffer histogramBuffer;
+    histogramBuffer.frameSize = XMUINT4(width, height, histogramSettings_.centerWeight, 0);
+    device_->GetDeviceContext()->UpdateSubresource(histogramConstantBuffer_, 0, nullptr, &histogramBuffer, 0, 0);
+
+    // no render targets, the pixel shader only adds to the bins
+    device_->GetDeviceContext()->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 1, &histogramUAV_, nullptr);
+    viewport_.Width = (FLOAT)width;
+    viewport_.Height = (FLOAT)height;
+    device_->GetDeviceContext()->RSSetViewports(1, &viewport_);
+    device_->GetDeviceContext()->PSSetShaderResources(0, 1, &frameSRV_);
+    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &histogramConstantBuffer_);
+    device_->GetDeviceContext()->OMSetDepthStencilState(nullptr, 0);
+    device_->GetDeviceContext()->RSSetState(nullptr);
+    device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
+    device_->GetDeviceContext()->IASetInputLayout(nullptr);
+    device_->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    device_->GetDeviceContext()->VSSetShader(mappingVS_->GetShader().get(), nullptr, 0);
+    device_->GetDeviceContext()->PSSetShader(histogramPS_->GetShader().get(), nullptr, 0);
+    device_->GetDeviceContext()->Draw(6, 0);
+
+    ID3D11UnorderedAccessView* nullUAV = nullptr;
+    device_->GetDeviceContext()->OMSetRenderTargetsAndUnorderedAccessViews(0, nullptr, nullptr, 0, 1, &nullUAV, nullptr);
+}
+
+// false only on errors; a copy that the GPU has not finished yet sets stillDrawing
+bool ToneMapping::ReadBrightness(uint32_t slot, bool& stillDrawing) {
+    CPU_PROFILE_SCOPE("ToneMapping::ReadBrightness");
+    bool histogram = meteringMode_ == MeteringMode::histogram;
+    ID3D11Resource* resource = histogram ? (ID3D11Resource*)readHistogramBuffers_[slot] : (ID3D11Resource*)readAvgTextures_[slot];
+    D3D11_MAPPED_SUBRESOURCE ResourceDesc = {};
+    HRESULT result = device_->GetDeviceContext()->Map(resource, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &ResourceDesc);
+    stillDrawing = result == DXGI_ERROR_WAS_STILL_DRAWING;
+    if (stillDrawing) {
+        return true;
+    }
+    if (FAILED(result)) {
+        return false;
+    }
+
+    if (ResourceDesc.pData && histogram) {
+        ExposureHistogram::Metering metering = ExposureHistogram::Evaluate(reinterpret_cast<const uint32_t*>(ResourceDesc.pData),
+            histogramSettings_.lowPercentile, histogramSettings_.highPercentile);
+        if (metering.valid) {
+            // the tone mapping takes the average as log(1 + L) like the one of the brightness chain
+            metering_ = metering;
+            measuredAvg = log(metering.averageLuminance + 1.0f);
+            measuredMin = 0.0f;
+            measuredMax = FLT_MAX;
+        }
+    }
+    else if (ResourceDesc.pData) {
+        const float* brightness = reinterpret_cast<const float*>(ResourceDesc.pData);
+        measuredAvg = brightness[0];
+        measuredMin = brightness[1];
+        measuredMax = brightness[2];
+    }
+    device_->GetDeviceContext()->Unmap(resource, 0);
+    return true;
+}
+
+// the key value of the adapted brightness over the brightness clamped to the range of the frame, times the user factor
+float ToneMapping::ComputeExposure(float adaptedAvg) const {
+    float avg = exp(adaptedAvg) - 1.0f;
+    float keyValue = 1.03f - 2.0f / (2.0f + log(avg + 1.0f));
+    avg = (std::min)((std::max)(avg, measuredMin), measuredMax);
+    return keyValue / (std::max)(avg, 1e-4f) * factor;
+}
+
+void ToneMapping::UpdateToneLut() {
+    if (toneLutBaked_ && bakedToneCurveSettings_ == toneCurveSettings_) {
+        return;
+    }
+    CPU_PROFILE_SCOPE("ToneMapping::UpdateToneLut");
+    ToneCurveLut::Bake(toneCurveSettings_, toneLutTexels_);
+    UINT rowPitch = ToneCurveLut::size * 4 * sizeof(float);
+    device_->GetDeviceContext()->UpdateSubresource(toneLut_, 0, nullptr, toneLutTexels_.data(), rowPitch, rowPitch * ToneCurveLut::size);
+    bakedToneCurveSettings_ = toneCurveSettings_;
+    toneLutBaked_ = true;
+    ++toneLutBakes_;
+}
+
 bool ToneMapping::RenderTonemap() {
+    CPU_PROFILE_SCOPE("ToneMapping::RenderTonemap");
     if (!IsInit()) {
         return false;
     }
@@ -234,48 +453,56 @@ bool ToneMapping::RenderTonemap() {
     float dtime = std::chrono::duration<float, std::milli>(time - lastFrameTime_).count() * 0.001;
     lastFrameTime_ = time;
 
-    device_->GetDeviceContext()->CopyResource(readAvgTexture_, scaledFrames_[0].avg.texture);
-    D3D11_MAPPED_SUBRESOURCE ResourceDesc = {};
-    HRESULT result = device_->GetDeviceContext()->Map(readAvgTexture_, 0, D3D11_MAP_READ, 0, &ResourceDesc);
-    if (FAILED(result)) {
-        return false;
-    }
-
-    float avg;
-    if (ResourceDesc.pData) {
-        float* pData = reinterpret_cast<float*>(ResourceDesc.pData);
-        avg = pData[0];
+    // the copies of the previous frames that the GPU has finished are read without waiting, the newest value is kept
+    for (uint32_t slot = readback_.GetReadableSlot(); slot != ReadbackRing::invalidSlot; slot = readback_.GetReadableSlot()) {
+        bool stillDrawing = false;
+        if (!ReadBrightness(slot, stillDrawing)) {
+            return false;
+        }
+        if (stillDrawing) {
+            readback_.OnMiss();
+            break;
+        }
+        readback_.OnRead(slot);
+        if (adapt < 0.0f) {
+            adapt = measuredAvg;
+        }
     }
-    device_->GetDeviceContext()->Unmap(readAvgTexture_, 0);
-
-    if (adapt >= 0.0) {
-        adapt += (avg - adapt) * (1.0f - exp(-dtime / s));
+    uint32_t slot = readback_.Write();
+    if (meteringMode_ == MeteringMode::histogram) {
+        device_->GetDeviceContext()->CopyResource(readHistogramBuffers_[slot], histogramBuffer_);
     }
     else {
-        adapt = avg;
+        device_->GetDeviceContext()->CopySubresourceRegion(readAvgTextures_[slot], 0, 0, 0, 0, scaledFrames_[0].avg.texture, 0, nullptr);
+        device_->GetDeviceContext()->CopySubresourceRegion(readAvgTextures_[slot], 0, 1, 0, 0, scaledFrames_[0].min.texture, 0, nullptr);
+        device_->GetDeviceContext()->CopySubresourceRegion(readAvgTextures_[slot], 0, 2, 0, 0, scaledFrames_[0].max.texture, 0, nullptr);
     }
 
-    AdaptBuffer adaptBuffer;
-    adaptBuffer.adapt = XMFLOAT4(adapt, factor, 0.0f, 0.0f);
+    // until the first value after a reset arrives the last known one is shown
+    if (adapt >= 0.0f) {
+        adapt += (measuredAvg - adapt) * (1.0f - exp(-dtime / s));
+    }
+
+    UpdateToneLut();
+
+    ExposureBuffer exposureBuffer;
+    float scale, offset;
+    ToneCurveLut::GetCoordinateTransform(scale, offset);
+    exposureBuffer.exposure = XMFLOAT4(ComputeExposure(adapt >= 0.0f ? adapt : measuredAvg), scale, offset, 0.0f);
 
-    device_->GetDeviceContext()->UpdateSubresource(adaptBuffer_, 0, nullptr, &adaptBuffer, 0, 0);
+    device_->GetDeviceContext()->UpdateSubresource(exposureBuffer_, 0, nullptr, &exposureBuffer, 0, 0);
 
-    ID3D11SamplerState* samplers[] = { samplerDefault_.get() };
-    device_->GetDeviceContext()->PSSetSamplers(0, 1, samplers);
+    ID3D11SamplerState* samplers[] = { samplerDefault_.get(), samplerLut_.get() };
+    device_->GetDeviceContext()->PSSetSamplers(0, 2, samplers);
 
-    ID3D11ShaderResourceView* resources[] = {
-        frameSRV_, 
-        scaledFrames_[0].avg.SRV,
-        scaledFrames_[0].min.SRV,
-        scaledFrames_[0].max.SRV
-    };
-    device_->GetDeviceContext()->PSSetShaderResources(0, 4, resources);
+    ID3D11ShaderResourceView* resources[] = { frameSRV_, toneLutSRV_ };
+    device_->GetDeviceContext()->PSSetShaderResources(0, 2, resources);
     device_->GetDeviceContext()->OMSetDepthStencilState(nullptr, 0);
     device_->GetDeviceContext()->RSSetState(nullptr);
     device_->GetDeviceContext()->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
     device_->GetDeviceContext()->IASetInputLayout(mappingVS_->GetInputLayout().get());
     device_->GetDeviceContext()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &adaptBuffer_);
+    device_->GetDeviceContext()->PSSetConstantBuffers(0, 1, &exposureBuffer_);
     device_->GetDeviceContext()->VSSetShader(mappingVS_->GetShader().get(), nullptr, 0);
     device_->GetDeviceContext()->PSSetShader(tonemapPS_->GetShader().get(), nullptr, 0);
     device_->GetDeviceContext()->Draw(6, 0);
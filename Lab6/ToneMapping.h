@@ -1,6 +1,12 @@
 #pragma once
 
+#include "CpuProfiler.hpp"
+#include "ExposureHistogram.hpp"
+#include "FrameGraph.hpp"
 #include "ManagerStorage.hpp"
+#include "ReadbackRing.hpp"
+#include "ToneCurveLut.hpp"
+#include "TransientTexturePool.hpp"
 #include <vector>
 #include <chrono>
 
@@ -17,11 +23,26 @@ class ToneMapping {
         RawPtrTexture max;
     };
 
-    struct AdaptBuffer {
-        XMFLOAT4 adapt;
+    struct ScaledFrameIds {
+        UINT avg = FrameGraph::invalidIndex;
+        UINT min = FrameGraph::invalidIndex;
+        UINT max = FrameGraph::invalidIndex;
+    };
+
+    struct ExposureBuffer {
+        XMFLOAT4 exposure; // the multiplier of the frame, the scale and the offset of the coordinates of the tone LUT
+    };
+
+    struct HistogramBuffer {
+        XMUINT4 frameSize;
     };
 
 public:
+    enum class MeteringMode {
+        brightnessChain, // the log average and the min/max of the frame from the chains of downsampled textures
+        histogram // the log average between the percentiles of the exposure histogram
+    };
+
     ToneMapping();
 
     HRESULT Init(const std::shared_ptr<Device>& device, const std::shared_ptr<ManagerStorage>& managerStorage,
@@ -31,6 +52,11 @@ public:
     bool Resize(int textureWidth, int textureHeight);
     void Cleanup();
 
+    // the metering passes and the tone mapping of the frame; the brightness chain is culled unless the tone mapping
+    // reads it, the histogram pass is kept only in the histogram mode (its bins are read back to the CPU)
+    void DeclarePasses(FrameGraph& graph, UINT frame, UINT target);
+    void BindTransientTextures(const FrameGraph& graph, const TransientTexturePool& pool);
+
     bool IsInit() const {
         return !!tonemapPS_;
     };
@@ -39,8 +65,10 @@ public:
         return frameRTV_;
     };
 
+    // the next measured brightness is taken without adaptation, the readbacks still in flight are dropped
     void ResetEyeAdaptation() {
         adapt = -1.0f;
+        readback_.Discard();
     };
 
     void SetFactor(float f) {
@@ -51,16 +79,62 @@ public:
         return factor;
     };
 
+    const ReadbackRing& GetReadback() const {
+        return readback_;
+    };
+
+    void SetMeteringMode(MeteringMode mode) {
+        if (mode != meteringMode_) {
+            meteringMode_ = mode;
+            ResetEyeAdaptation();
+        }
+    };
+
+    MeteringMode GetMeteringMode() const {
+        return meteringMode_;
+    };
+
+    void SetHistogramSettings(const ExposureHistogram::Settings& settings) {
+        histogramSettings_ = settings;
+    };
+
+    const ExposureHistogram::Settings& GetHistogramSettings() const {
+        return histogramSettings_;
+    };
+
+    // the result of the last histogram read back
+    const ExposureHistogram::Metering& GetMetering() const {
+        return metering_;
+    };
+
+    // the tone LUT is baked again in the next frame if the settings differ from the baked ones
+    void SetToneCurveSettings(const ToneCurveLut::Settings& settings) {
+        toneCurveSettings_ = settings;
+    };
+
+    const ToneCurveLut::Settings& GetToneCurveSettings() const {
+        return toneCurveSettings_;
+    };
+
+    uint32_t GetToneLutBakeCount() const {
+        return toneLutBakes_;
+    };
+
     ~ToneMapping() {
         Cleanup();
     };
 
 private:
     HRESULT CreateTextures(int textureWidth, int textureHeight);
-    HRESULT CreateScaledFrame(ScaledFrame& scaledFrame, int num);
     HRESULT CreateTexture(RawPtrTexture& texture, int textureWidth, int textureHeight, DXGI_FORMAT format);
     HRESULT CreateTexture2D(ID3D11Texture2D** texture, int textureWidth, int textureHeight, DXGI_FORMAT format, bool CPUAccess = false);
     void CleanupTextures();
+    HRESULT CreateHistogram();
+    HRESULT CreateToneLut();
+    void UpdateToneLut();
+    float ComputeExposure(float adaptedAvg) const;
+    void CalculateHistogram();
+    bool ReadBrightness(uint32_t slot, bool& stillDrawing);
 
     D3D11_VIEWPORT viewport_;
 
@@ -71,24 +145,56 @@ private:
     ID3D11ShaderResourceView* frameSRV_ = nullptr; // always remains only inside the class #
     std::shared_ptr<ID3D11RenderTargetView> frameRTV_; // transmitted outward ->
 
-    ID3D11Texture2D* readAvgTexture_ = nullptr; // always remains only inside the class #
-    ID3D11Buffer* adaptBuffer_ = nullptr; // always remains only inside the class #
+    // the average, min and max brightness are read back readbackSlots - 1 frames after they are calculated, so the CPU
+    // does not wait for the GPU
+    static const UINT readbackSlots = 3;
+    std::vector<ID3D11Texture2D*> readAvgTextures_; // always remains only inside the class #
+    ReadbackRing readback_; // always remains only inside the class #
+
+    ID3D11Buffer* histogramBuffer_ = nullptr; // always remains only inside the class #
+    ID3D11UnorderedAccessView* histogramUAV_ = nullptr; // always remains only inside the class #
+    std::vector<ID3D11Buffer*> readHistogramBuffers_; // always remains only inside the class #
+    ID3D11Buffer* histogramConstantBuffer_ = nullptr; // always remains only inside the class #
+    MeteringMode meteringMode_ = MeteringMode::histogram;
+    ExposureHistogram::Settings histogramSettings_;
+    ExposureHistogram::Metering metering_;
+    ID3D11Buffer* exposureBuffer_ = nullptr; // always remains only inside the class #
+
+    ID3D11Texture3D* toneLut_ = nullptr; // always remains only inside the class #
+    ID3D11ShaderResourceView* toneLutSRV_ = nullptr; // always remains only inside the class #
+    std::vector<float> toneLutTexels_; // always remains only inside the class #
+    ToneCurveLut::Settings toneCurveSettings_;
+    ToneCurveLut::Settings bakedToneCurveSettings_; // always remains only inside the class #
+    bool toneLutBaked_ = false; // always remains only inside the class #
+    uint32_t toneLutBakes_ = 0; // always remains only inside the class #
 
     std::shared_ptr<ID3D11SamplerState> samplerAvg_; // provided externally <-
     std::shared_ptr<ID3D11SamplerState> samplerMin_; // provided externally <-
     std::shared_ptr<ID3D11SamplerState> samplerMax_; // provided externally <-
     std::shared_ptr<ID3D11SamplerState> samplerDefault_; // provided externally <-
+    std::shared_ptr<ID3D11SamplerState> samplerLut_; // provided externally <-
 
     std::shared_ptr<VertexShader> mappingVS_; // provided externally <-
     std::shared_ptr<PixelShader> brightnessPS_; // provided externally <-
     std::shared_ptr<PixelShader> downsamplePS_; // provided externally <-
     std::shared_ptr<PixelShader> tonemapPS_; // provided externally <-
-
-    std::vector<ScaledFrame> scaledFrames_;  // always remains only inside the class #
+    std::shared_ptr<PixelShader> histogramPS_; // provided externally <-
+
+    std::vector<ScaledFrame> scaledFrames_;  // provided externally <- (transient, from the frame graph)
+    std::vector<ScaledFrameIds> scaledFrameIds_; // the textures of the current frame in the frame graph
+    UINT chainPass_ = FrameGraph::invalidIndex;
+    UINT histogramPass_ = FrameGraph::invalidIndex;
+    bool chainLive_ = false; // the passes are not culled in the current frame
+    bool histogramLive_ = false;
     std::chrono::time_point<std::chrono::steady_clock> lastFrameTime_;
 
     int n = 0;
+    int width = 0;
+    int height = 0;
     float adapt = -1.0f;
+    float measuredAvg = 0.2231436f; // the last brightness read back, log(1 + 0.25) of the brightness clear value until the first one
+    float measuredMin = 0.0f; // the brightness range of the frame for the brightness chain
+    float measuredMax = FLT_MAX;
     float factor = 1.0f;
     float s = 0.5f;
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#ifdef _WIN32
+#include <directxmath.h>
+#else
+#include "DirectXMathPortable.hpp" // for the benchmarks outside of Windows
+#endif
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+
+// Node hierarchy flattened into arrays in topological order (a parent always precedes its children).
+// World matrices are cached and recomputed in one linear pass only for the changed nodes and their subtrees.
+// Depends only on DirectXMath.
+class TransformHierarchy {
+public:
+    TransformHierarchy() = default;
+
+    uint32_t AddNode(int parent, const DirectX::XMMATRIX& localTransformation) {
+        parents_.push_back(parent);
+        localTransformations_.push_back(localTransformation);
+        worldTransformations_.push_back(DirectX::XMMatrixIdentity());
+        dirty_.push_back(1);
+        lastChanges_.push_back(updateCount_);
+        anyDirty_ = true;
+        return (uint32_t)(parents_.size() - 1);
+    };
+
+    void SetLocalTransformation(uint32_t index, const DirectX::XMMATRIX& localTransformation) {
+        localTransformations_[index] = localTransformation;
+        dirty_[index] = 1;
+        anyDirty_ = true;
+    };
+
+    void SetRootTransformation(const DirectX::XMMATRIX& rootTransformation) {
+        rootTransformation_ = rootTransformation;
+        for (uint32_t i = 0; i < parents_.size(); ++i) {
+            if (parents_[i] < 0) {
+                dirty_[i] = 1;
+                anyDirty_ = true;
+            }
+        }
+    };
+
+    // returns the number of recomputed world matrices
+    uint32_t Update() {
+        ++updateCount_;
+        if (!anyDirty_) {
+            return 0;
+        }
+
+        uint32_t updated = 0;
+        for (uint32_t i = 0; i < parents_.size(); ++i) {
+            int parent = parents_[i];
+            if (dirty_[i] || (parent >= 0 && dirty_[parent])) {
+                worldTransformations_[i] = DirectX::XMMatrixMultiply(localTransformations_[i],
+                    parent >= 0 ? worldTransformations_[parent] : rootTransformation_);
+                dirty_[i] = 1; // the flag is propagated to the children that follow
+                lastChanges_[i] = updateCount_;
+                ++updated;
+            }
+        }
+        std::fill(dirty_.begin(), dirty_.end(), (uint8_t)0);
+        anyDirty_ = false;
+        return updated;
+    };
+
+    const DirectX::XMMATRIX& GetWorldTransformation(uint32_t index) const {
+        return worldTransformations_[index];
+    };
+
+    const DirectX::XMMATRIX& GetLocalTransformation(uint32_t index) const {
+        return localTransformations_[index];
+    };
+
+    // 0 if the world matrix was recomputed by the last Update
+    uint32_t GetUpdatesSinceChange(uint32_t index) const {
+        return updateCount_ - lastChanges_[index];
+    };
+
+    int GetParent(uint32_t index) const {
+        return parents_[index];
+    };
+
+    uint32_t Size() const {
+        return (uint32_t)parents_.size();
+    };
+
+    void Clear() {
+        parents_.clear();
+        localTransformations_.clear();
+        worldTransformations_.clear();
+        dirty_.clear();
+        lastChanges_.clear();
+        anyDirty_ = false;
+    };
+
+    ~TransformHierarchy() = default;
+
+private:
+    DirectX::XMMATRIX rootTransformation_ = DirectX::XMMatrixIdentity(); // always remains only inside the class #
+    std::vector<int> parents_; // always remains only inside the class #
+    std::vector<DirectX::XMMATRIX> localTransformations_; // always remains only inside the class #
+    std::vector<DirectX::XMMATRIX> worldTransformations_; // transmitted outward ->
+    std::vector<uint8_t> dirty_; // always remains only inside the class #
+    // the values of updateCount_ when the world matrices were recomputed
+    std::vector<uint32_t> lastChanges_; // always remains only inside the class #
+    uint32_t updateCount_ = 0; // always remains only inside the class #
+    bool anyDirty_ = false; // always remains only inside the class #
+};
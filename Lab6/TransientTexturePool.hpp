@@ -0,0 +1,193 @@
+#pragma once
+
+#include "Device.hpp"
+#include "FrameGraph.hpp"
+
+
+// Textures behind the physical slots of a compiled FrameGraph. A slot keeps the texture it had in the previous frame
+// when its description did not change, so the views stay the same from frame to frame; other slots take a free texture
+// of their description or a new one. Textures that no slot takes for unusedFrameLimit frames (after a resize or a change
+// of the settings) are released.
+class TransientTexturePool {
+public:
+    static const uint32_t unusedFrameLimit = 60;
+
+    struct Views {
+        ID3D11Texture2D* texture = nullptr;
+        ID3D11RenderTargetView* RTV = nullptr;
+        ID3D11DepthStencilView* DSV = nullptr;
+        ID3D11ShaderResourceView* SRV = nullptr;
+    };
+
+    struct Statistics {
+        uint32_t textures = 0; // in the pool, used or not
+        uint64_t bytes = 0;
+        uint32_t created = 0; // since Init
+    };
+
+    TransientTexturePool() = default;
+
+    HRESULT Init(const std::shared_ptr<Device>& device) {
+        Cleanup();
+        device_ = device;
+        return S_OK;
+    };
+
+    HRESULT Realize(const FrameGraph& graph) {
+        for (size_t i = 0; i < entries_.size();) {
+            if (entries_[i].unusedFrames > unusedFrameLimit) {
+                Release(entries_[i]);
+                entries_[i] = entries_.back();
+                entries_.pop_back();
+            }
+            else {
+                ++i;
+            }
+        }
+
+        const uint32_t physicalCount = graph.GetPhysicalCount();
+        slotEntries_.assign(physicalCount, FrameGraph::invalidIndex);
+        for (uint32_t i = 0; i < entries_.size(); ++i) {
+            Entry& entry = entries_[i];
+            if (entry.slot < physicalCount && graph.GetPhysicalDesc(entry.slot) == entry.desc) {
+                slotEntries_[entry.slot] = i;
+            }
+            else {
+                entry.slot = FrameGraph::invalidIndex;
+            }
+        }
+
+        HRESULT result = S_OK;
+        for (uint32_t s = 0; s < physicalCount && SUCCEEDED(result); ++s) {
+            if (slotEntries_[s] != FrameGraph::invalidIndex) {
+                continue;
+            }
+            const FrameGraph::TextureDesc& desc = graph.GetPhysicalDesc(s);
+            for (uint32_t i = 0; i < entries_.size(); ++i) {
+                if (entries_[i].slot == FrameGraph::invalidIndex && entries_[i].desc == desc) {
+                    slotEntries_[s] = i;
+                    break;
+                }
+            }
+            if (slotEntries_[s] == FrameGraph::invalidIndex) {
+                Entry entry;
+                entry.desc = desc;
+                result = Create(entry);
+                if (FAILED(result)) {
+                    Release(entry);
+                    break;
+                }
+                entries_.push_back(entry);
+                slotEntries_[s] = (uint32_t)entries_.size() - 1;
+                ++statistics_.created;
+            }
+            entries_[slotEntries_[s]].slot = s;
+        }
+
+        statistics_.textures = (uint32_t)entries_.size();
+        statistics_.bytes = 0;
+        for (Entry& entry : entries_) {
+            entry.unusedFrames = entry.slot == FrameGraph::invalidIndex ? entry.unusedFrames + 1 : 0;
+            statistics_.bytes += entry.desc.GetBytes();
+        }
+        return result;
+    };
+
+    // empty views for the imported textures and the textures of the culled passes
+    const Views& GetViews(const FrameGraph& graph, uint32_t texture) const {
+        static const Views empty;
+        uint32_t physical = graph.GetPhysicalIndex(texture);
+        if (physical == FrameGraph::invalidIndex || physical >= slotEntries_.size() || slotEntries_[physical] == FrameGraph::invalidIndex) {
+            return empty;
+        }
+        return entries_[slotEntries_[physical]].views;
+    };
+
+    const Statistics& GetStatistics() const {
+        return statistics_;
+    };
+
+    void Cleanup() {
+        for (auto& entry : entries_) {
+            Release(entry);
+        }
+        entries_.clear();
+        slotEntries_.clear();
+        statistics_ = Statistics();
+        device_.reset();
+    };
+
+    ~TransientTexturePool() {
+        Cleanup();
+    };
+
+private:
+    struct Entry {
+        FrameGraph::TextureDesc desc;
+        Views views;
+        uint32_t slot = FrameGraph::invalidIndex; // taken in the current frame
+        uint32_t unusedFrames = 0;
+    };
+
+    HRESULT Create(Entry& entry) {
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = entry.desc.width;
+        desc.Height = entry.desc.height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = (DXGI_FORMAT)entry.desc.format;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = (entry.desc.depthStencil ? D3D11_BIND_DEPTH_STENCIL : D3D11_BIND_RENDER_TARGET) | D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = 0;
+        desc.MiscFlags = 0;
+
+        // the depth textures are typeless, only the 32 bit float depth is used
+        DXGI_FORMAT viewFormat = desc.Format;
+        if (entry.desc.depthStencil) {
+            if (desc.Format != DXGI_FORMAT_R32_TYPELESS) {
+                return E_INVALIDARG;
+            }
+            viewFormat = DXGI_FORMAT_R32_FLOAT;
+        }
+
+        HRESULT result = device_->GetDevice()->CreateTexture2D(&desc, nullptr, &entry.views.texture);
+        if (SUCCEEDED(result) && entry.desc.depthStencil) {
+            D3D11_DEPTH_STENCIL_VIEW_DESC DSVDesc = {};
+            DSVDesc.Format = DXGI_FORMAT_D32_FLOAT;
+            DSVDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+            DSVDesc.Texture2D.MipSlice = 0;
+            DSVDesc.Flags = 0;
+            result = device_->GetDevice()->CreateDepthStencilView(entry.views.texture, &DSVDesc, &entry.views.DSV);
+        }
+        else if (SUCCEEDED(result)) {
+            D3D11_RENDER_TARGET_VIEW_DESC RTVDesc = {};
+            RTVDesc.Format = viewFormat;
+            RTVDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+            RTVDesc.Texture2D.MipSlice = 0;
+            result = device_->GetDevice()->CreateRenderTargetView(entry.views.texture, &RTVDesc, &entry.views.RTV);
+        }
+        if (SUCCEEDED(result)) {
+            D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
+            SRVDesc.Format = viewFormat;
+            SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            SRVDesc.Texture2D.MostDetailedMip = 0;
+            SRVDesc.Texture2D.MipLevels = 1;
+            result = device_->GetDevice()->CreateShaderResourceView(entry.views.texture, &SRVDesc, &entry.views.SRV);
+        }
+        return result;
+    };
+
+    static void Release(Entry& entry) {
+        SAFE_RELEASE(entry.views.SRV);
+        SAFE_RELEASE(entry.views.RTV);
+        SAFE_RELEASE(entry.views.DSV);
+        SAFE_RELEASE(entry.views.texture);
+    };
+
+    std::shared_ptr<Device> device_; // provided externally <-
+    std::vector<Entry> entries_; // always remains only inside the class #
+    std::vector<uint32_t> slotEntries_; // the entry of every physical slot of the graph
+    Statistics statistics_;
+};
@@ -6,9 +6,9 @@ TextureCube irradianceTexture : register (t0);
 TextureCube prefilteredTexture : register (t1);
 Texture2D brdfTexture : register (t2);
 #endif
-Texture2D shadowMaps[4] : register (t3);
+Texture2D shadowAtlas : register (t3);
 #if defined(TRANSPARENT) && (defined(WITH_SSAO) || defined(SSAO_MASK))
-Texture2D depthTexture : register (t7);
+Texture2D depthTexture : register (t4);
 #endif
 #ifdef TRANSPARENT
 SamplerState samplerAvg : register (s0);
@@ -27,17 +27,25 @@ struct LIGHT {
 struct DIRECTIONAL_LIGHT {
     float4 lightDir;
     float4 lightColor;
-    float4x4 viewProjectionMatrix;
-    int4 splitSizeRatio;
+    float4x4 viewProjectionMatrix; // of the first cascade
+    float4 cascadeSplits; // view depths where the cascades end
+    float4 cascadeScales[4]; // clip space of a cascade = clip space of the first one * scale + offset
+    float4 cascadeOffsets[4];
+    float4 cascadeAtlasRects[4]; // uv offset and scale of the tile in the shadow atlas, half of its texel
 };
 
 cbuffer SceneMatrixBuffer : register (b1) {
     float4x4 viewProjectionMatrix;
-    int4 lightParams;
+    int4 lightParams; // point light count, size of the cluster grid
+    float4 clusterParams; // slice scale and bias, smooth clamp and clamp radiance limits of the point lights
     DIRECTIONAL_LIGHT directionalLight;
-    LIGHT lights[64];
 };
 
+// point lights assigned to view space clusters on the CPU, see LightClusters.hpp
+StructuredBuffer<LIGHT> pointLights : register (t13);
+StructuredBuffer<uint2> lightClusters : register (t14); // offset and count in lightIndices
+StructuredBuffer<uint> lightIndices : register (t15);
+
 cbuffer MatricesBuffer : register (b2) {
     float4 cameraPos;
     float4x4 projectionMatrix;
@@ -56,34 +64,25 @@ cbuffer SSAOParamsBuffer : register (b3) {
 #endif
 
 static float4x4 M_uv = float4x4(0.5f, 0, 0, 0, 0, -0.5f, 0, 0, 0, 0, 1.0f, 0, 0.5f, 0.5f, 0, 1.0f);
+static const float3 cascadeColors[4] = {
+    float3(1.0f, 0.5f, 0.5f), float3(0.5f, 1.0f, 0.5f), float3(0.5f, 0.5f, 1.0f), float3(0.5f, 0.5f, 0.5f)
+};
 static float MAX_REFLECTION_LOD = 4.0f;
 
 #if defined(DEFAULT)
 float4 shadowFactor(in float3 pos) {
-    float4 lightProjPos = mul(directionalLight.viewProjectionMatrix, float4(pos, 1.0f));
-    uint splitSizeRatio[4] = { directionalLight.splitSizeRatio[0], directionalLight.splitSizeRatio[1],
-        directionalLight.splitSizeRatio[2], directionalLight.splitSizeRatio[3] };
-    int i = 0;
-    while ((lightProjPos.x > 1.0f || lightProjPos.x < -1.0f || lightProjPos.y > 1.0f || lightProjPos.y < -1.0f) && i < 3) {
-        ++i;
-        lightProjPos.xy = lightProjPos.xy * splitSizeRatio[i - 1] / splitSizeRatio[i];
+    float depth = -mul(viewMatrix, float4(pos, 1.0f)).z;
+    if (depth > directionalLight.cascadeSplits.w) {
+        return float4(1.0f, 1.0f, 1.0f, 1.0f); // beyond the shadow distance
     }
+    int i = (int)dot(float3(depth > directionalLight.cascadeSplits.xyz), float3(1.0f, 1.0f, 1.0f));
+    float4 lightProjPos = mul(directionalLight.viewProjectionMatrix, float4(pos, 1.0f));
+    lightProjPos.xyz = lightProjPos.xyz * directionalLight.cascadeScales[i].xyz + directionalLight.cascadeOffsets[i].xyz;
     lightProjPos = mul(lightProjPos, M_uv);
-    if (i == 0) {
-        return float4(shadowMaps[0].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 1.0f, 0.5f, 0.5f);
-    }
-    else if (i == 1) {
-        return float4(shadowMaps[1].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 0.5f, 1.0f, 0.5f);
-    }
-    else if (i == 2) {
-        return float4(shadowMaps[2].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 0.5f, 0.5f, 1.0f);
-    }
-    else if (lightProjPos.x > 1.0f || lightProjPos.x < 0.0f || lightProjPos.y > 1.0f || lightProjPos.y < 0.0f) {
-        return float4(shadowMaps[3].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 1.0f, 1.0f, 1.0f);
-    }
-    else {
-        return float4(shadowMaps[3].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 0.5f, 0.5f, 0.5f);
-    }
+    // the filter taps must not reach the neighbouring tiles
+    float4 rect = directionalLight.cascadeAtlasRects[i];
+    float2 uv = clamp(lightProjPos.xy, rect.w, 1.0f - rect.w) * rect.z + rect.xy;
+    return float4(shadowAtlas.SampleCmp(samplerPcf, uv, lightProjPos.z), cascadeColors[i]);
 }
 #endif
 
@@ -152,12 +151,25 @@ float3 CalculateColor(in float3 objColor, in float3 objNormal, in float3 pos, in
         radiance * max(dot(objNormal, lightDir), 0.0f);
 #endif
 
-    [unroll] for (int i = 0; i < lightParams.x; i++) {
-        float3 lightDir = lights[i].lightPos.xyz - pos;
+    float4 clipPos = mul(viewProjectionMatrix, float4(pos, 1.0f));
+    float2 ndc = clipPos.xy / clipPos.w;
+    float viewDepth = -mul(viewMatrix, float4(pos, 1.0f)).z;
+    uint3 cell = uint3(
+        clamp(floor((ndc.x * 0.5f + 0.5f) * lightParams.y), 0, lightParams.y - 1),
+        clamp(floor((0.5f - ndc.y * 0.5f) * lightParams.z), 0, lightParams.z - 1),
+        clamp(floor(log(max(viewDepth, 0.0001f)) * clusterParams.x + clusterParams.y), 0, lightParams.w - 1)
+    );
+    uint2 cluster = lightClusters[(cell.z * lightParams.z + cell.y) * lightParams.y + cell.x];
+
+    for (uint i = 0; i < cluster.y; i++) {
+        LIGHT light = pointLights[lightIndices[cluster.x + i]];
+        float3 lightDir = light.lightPos.xyz - pos;
         float lightDist = length(lightDir);
         lightDir /= lightDist;
         float atten = clamp(1.0 / (lightDist * lightDist), 0, 1.0f);
-        float3 radiance = lights[i].lightColor.xyz * lights[i].lightColor.w * atten;
+        float3 radiance = light.lightColor.xyz * light.lightColor.w * atten;
+        // fades to zero at the radius used for clustering, as the deferred light volumes do
+        radiance = light.lightColor.w * atten < clusterParams.z ? radiance * smoothstep(clusterParams.w, clusterParams.z, light.lightColor.w * atten) : radiance;
         float3 h = normalize((viewDir + lightDir) / 2.0f);
 
 #if defined(DEFAULT) || defined(FRESNEL)
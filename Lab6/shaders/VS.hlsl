@@ -1,10 +1,15 @@
-#ifndef INSTANCING
+#if defined(INSTANCING)
+cbuffer WorldMatrixBuffer : register (b0) {
+    float4x4 worldMatrix[64];
+};
+#elif !defined(INSTANCE_TRANSFORM)
 cbuffer WorldMatrixBuffer : register (b0) {
     float4x4 worldMatrix;
 };
 #else
-cbuffer WorldMatrixBuffer : register (b0) {
-    float4x4 worldMatrix[64];
+// world matrix of the node for the instances of EXT_mesh_gpu_instancing, the identity for the others
+cbuffer InstanceParentBuffer : register (b0) {
+    float4x4 parentMatrix;
 };
 #endif
 
@@ -42,6 +47,13 @@ struct VS_INPUT {
 #ifdef INSTANCING
     uint instanceId : SV_InstanceID;
 #endif
+#ifdef INSTANCE_TRANSFORM
+    // rows of the world matrix, from the per-instance vertex buffer
+    float4 world0 : WORLD0;
+    float4 world1 : WORLD1;
+    float4 world2 : WORLD2;
+    float4 world3 : WORLD3;
+#endif
 };
 
 struct PS_INPUT {
@@ -85,8 +97,11 @@ struct PS_INPUT {
 PS_INPUT main(VS_INPUT input) {
     PS_INPUT output;
 
-#ifdef INSTANCING
+#if defined(INSTANCING)
     float4 worldPos = mul(worldMatrix[input.instanceId], float4(input.position, 1.0f));
+#elif defined(INSTANCE_TRANSFORM)
+    float4x4 worldMatrix = float4x4(input.world0, input.world1, input.world2, input.world3);
+    float4 worldPos = mul(parentMatrix, mul(float4(input.position, 1.0f), worldMatrix));
 #else
     float4 worldPos = mul(worldMatrix, float4(input.position, 1.0f));
 #endif
@@ -99,8 +114,10 @@ PS_INPUT main(VS_INPUT input) {
     output.worldPos = worldPos;
 #endif
 #if defined(HAS_NORMAL_OUT) && defined(HAS_NORMAL)
-#ifdef INSTANCING
+#if defined(INSTANCING)
     output.normal = mul(worldMatrix[input.instanceId], input.normal);
+#elif defined(INSTANCE_TRANSFORM)
+    output.normal = mul((float3x3)parentMatrix, mul(input.normal, (float3x3)worldMatrix));
 #else
     output.normal = mul(worldMatrix, input.normal);
 #endif
@@ -5,15 +5,18 @@ Texture2D featureTexture : register (t1);
 Texture2D normalTexture : register (t2);
 Texture2D emissiveTexture : register (t3);
 Texture2D depthTexture : register (t4);
-Texture2D shadowMaps[4] : register (t5);
+Texture2D shadowAtlas : register (t5);
 SamplerState textureSampler : register (s0);
 SamplerComparisonState samplerPcf : register (s1);
 
 cbuffer DirectionalLightBuffer : register (b0) {
     float4 lightDir;
     float4 lightColor;
-    float4x4 viewProjectionMatrix;
-    int4 splitSizeRatio;
+    float4x4 viewProjectionMatrix; // of the first cascade
+    float4 cascadeSplits; // view depths where the cascades end
+    float4 cascadeScales[4]; // clip space of a cascade = clip space of the first one * scale + offset
+    float4 cascadeOffsets[4];
+    float4 cascadeAtlasRects[4]; // uv offset and scale of the tile in the shadow atlas, half of its texel
 };
 
 cbuffer MatricesBuffer : register (b1) {
@@ -30,32 +33,23 @@ struct PS_INPUT {
 };
 
 static float4x4 M_uv = float4x4(0.5f, 0, 0, 0, 0, -0.5f, 0, 0, 0, 0, 1.0f, 0, 0.5f, 0.5f, 0, 1.0f);
+static const float3 cascadeColors[4] = {
+    float3(1.0f, 0.5f, 0.5f), float3(0.5f, 1.0f, 0.5f), float3(0.5f, 0.5f, 1.0f), float3(0.5f, 0.5f, 0.5f)
+};
 
 
-float4 shadowFactor(in float4 pos) {
-    float4 lightProjPos = mul(viewProjectionMatrix, pos);
-    int shadowSplitSizeRatio[4] = { splitSizeRatio[0], splitSizeRatio[1], splitSizeRatio[2], splitSizeRatio[3] };
-    int i = 0;
-    while ((lightProjPos.x > 1.0f || lightProjPos.x < -1.0f || lightProjPos.y > 1.0f || lightProjPos.y < -1.0f) && i < 3) {
-        ++i;
-        lightProjPos.xy = lightProjPos.xy * shadowSplitSizeRatio[i - 1] / shadowSplitSizeRatio[i];
+float4 shadowFactor(in float4 pos, in float depth) {
+    if (depth > cascadeSplits.w) {
+        return float4(1.0f, 1.0f, 1.0f, 1.0f); // beyond the shadow distance
     }
+    int i = (int)dot(float3(depth > cascadeSplits.xyz), float3(1.0f, 1.0f, 1.0f));
+    float4 lightProjPos = mul(viewProjectionMatrix, pos);
+    lightProjPos.xyz = lightProjPos.xyz * cascadeScales[i].xyz + cascadeOffsets[i].xyz;
     lightProjPos = mul(lightProjPos, M_uv);
-    if (i == 0) {
-        return float4(shadowMaps[0].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 1.0f, 0.5f, 0.5f);
-    }
-    else if (i == 1) {
-        return float4(shadowMaps[1].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 0.5f, 1.0f, 0.5f);
-    }
-    else if (i == 2) {
-        return float4(shadowMaps[2].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 0.5f, 0.5f, 1.0f);
-    }
-    else if (lightProjPos.x > 1.0f || lightProjPos.x < 0.0f || lightProjPos.y > 1.0f || lightProjPos.y < 0.0f) {
-        return float4(shadowMaps[3].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 1.0f, 1.0f, 1.0f);
-    }
-    else {
-        return float4(shadowMaps[3].SampleCmp(samplerPcf, lightProjPos.xy, lightProjPos.z), 0.5f, 0.5f, 0.5f);
-    }
+    // the filter taps must not reach the neighbouring tiles
+    float4 rect = cascadeAtlasRects[i];
+    float2 uv = clamp(lightProjPos.xy, rect.w, 1.0f - rect.w) * rect.z + rect.xy;
+    return float4(shadowAtlas.SampleCmp(samplerPcf, uv, lightProjPos.z), cascadeColors[i]);
 }
 
 
@@ -64,7 +58,7 @@ float4 main(PS_INPUT input) : SV_TARGET {
     float4 viewPosition = mul(invProjectionMatrix, ndc);
     viewPosition /= viewPosition.w;
     float4 worldPosition = mul(invViewMatrix, viewPosition);
-    float4 shadowFactors = shadowFactor(worldPosition);
+    float4 shadowFactors = shadowFactor(worldPosition, -viewPosition.z);
 
 #ifndef SHADOW_SPLITS
     float3 objectColor = colorTexture.Sample(textureSampler, input.uv).xyz;
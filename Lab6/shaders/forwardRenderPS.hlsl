@@ -1,23 +1,23 @@
 #include "shaders/LightCalc.hlsli"
 
 #ifdef HAS_COLOR_TEXTURE
-Texture2D baseColorTexture : register (t8);
+Texture2D baseColorTexture : register (t5);
 SamplerState baseColorSampler : register (s3);
 #endif
 #ifdef HAS_MR_TEXTURE
-Texture2D mrTexture : register (t9);
+Texture2D mrTexture : register (t6);
 SamplerState mrSampler : register (s4);
 #endif
 #ifdef HAS_NORMAL_TEXTURE
-Texture2D normalTexture : register (t10);
+Texture2D normalTexture : register (t7);
 SamplerState normalSampler : register (s5);
 #endif
 #ifdef HAS_OCCLUSION_TEXTURE
-Texture2D occlusionTexture : register (t11);
+Texture2D occlusionTexture : register (t8);
 SamplerState occlusionSampler : register (s6);
 #endif
 #ifdef HAS_EMISSIVE_TEXTURE
-Texture2D emissiveTexture : register (t12);
+Texture2D emissiveTexture : register (t9);
 SamplerState emissiveSampler : register (s7);
 #endif
 
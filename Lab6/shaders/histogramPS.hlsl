@@ -0,0 +1,30 @@
+Texture2D frameTexture : register (t0);
+RWByteAddressBuffer histogram : register (u0);
+
+cbuffer HistogramBuffer : register (b0) {
+    uint4 frameSize; // width, height, weight of the center
+};
+
+struct PS_INPUT {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+// must match ExposureHistogram.hpp
+static const int binCount = 128;
+static const int firstKey = (127 - 12) * 4;
+static const int centerRadius = 512;
+
+// one pass over the frame: every pixel adds its weight to the bin of its log luminance
+void main(PS_INPUT input) {
+    int2 pixel = int2(input.position.xy);
+    float3 color = frameTexture.Load(int3(pixel, 0)).xyz;
+    precise float luminance = color.r * 0.2126f + color.g * 0.7151f;
+    luminance = luminance + color.b * 0.0722f;
+    int bin = clamp((asint(luminance) >> 21) - firstKey + 1, 0, binCount - 1);
+
+    int2 size = int2(frameSize.xy);
+    int2 uv = (pixel * 2 + 1 - size) * 1024 / size;
+    uint weight = dot(uv, uv) <= centerRadius * centerRadius ? frameSize.z : 1;
+    histogram.InterlockedAdd(bin * 4, weight);
+}
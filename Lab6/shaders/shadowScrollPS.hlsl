@@ -0,0 +1,20 @@
+Texture2D shadowMap : register (t0);
+
+cbuffer ShadowScrollBuffer : register (b0) {
+    int4 offset; // from the target texel to the source one
+    int4 bounds; // the source texels are taken from [x, z) x [y, w)
+};
+
+struct PS_INPUT {
+    float4 position : SV_POSITION;
+    float2 uv : TEXCOORD;
+};
+
+// depth of a cached shadow map moved by whole texels, the texels without a source are left empty for the casters
+float main(PS_INPUT input) : SV_DEPTH {
+    int2 source = int2(input.position.xy) + offset.xy;
+    if (any(source < bounds.xy) || any(source >= bounds.zw)) {
+        return 1.0f;
+    }
+    return shadowMap.Load(int3(source, 0)).x;
+}